@@ -43,9 +43,9 @@
 #include "common.h"
 #include "blacklist.h"
 #include "../utils/logging.h"
+#include "config.h"
 
 #include <sys/stat.h>
-#include <libgen.h>
 
 /* Default blacklist file location (set at compile time) */
 #define BLACKLIST_DIR "/etc/preheat.d"
@@ -87,10 +87,13 @@ load_blacklist_file(const char *filepath)
     }
     blacklist.count = 0;
 
+    /* Cached per-exe blacklist flags are stale from here on */
+    kp_config_bump_generation();
+
     /* Check if file exists */
     if (stat(filepath, &st) < 0) {
         if (errno == ENOENT) {
-            g_debug("Blacklist file not found: %s (this is normal)", filepath);
+            kp_debug("Blacklist file not found: %s (this is normal)", filepath);
         } else {
             g_warning("Cannot stat blacklist file %s: %s", filepath, strerror(errno));
         }
@@ -163,7 +166,7 @@ load_blacklist_file(const char *filepath)
 void
 kp_blacklist_init(void)
 {
-    g_debug("Initializing blacklist subsystem");
+    kp_debug("Initializing blacklist subsystem");
 
     /* Store filepath */
     blacklist.filepath = g_strdup(BLACKLIST_FILE);
@@ -188,7 +191,7 @@ kp_blacklist_reload(void)
     /* Check if file has changed */
     if (stat(blacklist.filepath, &st) == 0) {
         if (st.st_mtime == blacklist.last_modified) {
-            g_debug("Blacklist file unchanged, skipping reload");
+            kp_debug("Blacklist file unchanged, skipping reload");
             return;
         }
     }
@@ -203,25 +206,21 @@ kp_blacklist_reload(void)
 gboolean
 kp_blacklist_contains(const char *binary_name)
 {
-    char *base;
-    char *path_copy;
-    gboolean result;
+    const char *base;
 
     if (!blacklist.entries || !binary_name) {
         return FALSE;
     }
 
-    /* Extract basename if full path given */
+    /* Compare on the basename if a full path was given. Done in place
+     * (no copy + basename()) since exe paths never end in '/'. */
     if (binary_name[0] == '/') {
-        path_copy = g_strdup(binary_name);
-        base = basename(path_copy);
-        result = g_hash_table_contains(blacklist.entries, base);
-        g_free(path_copy);
+        base = strrchr(binary_name, '/') + 1;
     } else {
-        result = g_hash_table_contains(blacklist.entries, binary_name);
+        base = binary_name;
     }
 
-    return result;
+    return g_hash_table_contains(blacklist.entries, base);
 }
 
 /**
@@ -168,13 +168,13 @@ parse_script_for_exec(const char *script_path)
     
     /* Read file with size limit */
     if (!g_file_get_contents(script_path, &contents, &length, &error)) {
-        g_debug("Cannot read script %s: %s", script_path, error->message);
+        kp_debug("Cannot read script %s: %s", script_path, error->message);
         g_error_free(error);
         return NULL;
     }
     
     if (length > MAX_SCRIPT_SIZE) {
-        g_debug("Script too large (%zu bytes), skipping: %s", length, script_path);
+        kp_debug("Script too large (%zu bytes), skipping: %s", length, script_path);
         return NULL;
     }
     
@@ -344,13 +344,13 @@ resolve_binary_path(const char *path)
     int fd;
     
     if (!path || !*path || path[0] != '/') {
-        g_debug("Invalid path (must be absolute): %s", path ? path : "(null)");
+        kp_debug("Invalid path (must be absolute): %s", path ? path : "(null)");
         return NULL;
     }
     
     /* Step 1: Resolve symlinks to get canonical path */
     if (!realpath(path, resolved)) {
-        g_debug("Cannot resolve path %s: %s", path, strerror(errno));
+        kp_debug("Cannot resolve path %s: %s", path, strerror(errno));
         return NULL;
     }
     
@@ -363,28 +363,28 @@ resolve_binary_path(const char *path)
     /* Step 3: Open file with O_NOFOLLOW to prevent TOCTOU */
     fd = open(resolved, O_RDONLY | O_NOFOLLOW);
     if (fd < 0) {
-        g_debug("Cannot open %s: %s", resolved, strerror(errno));
+        kp_debug("Cannot open %s: %s", resolved, strerror(errno));
         return NULL;
     }
     
     /* Step 4: Stat using fd (TOCTOU-safe) */
     if (fstat(fd, &st) < 0) {
         close(fd);
-        g_debug("Cannot stat %s: %s", resolved, strerror(errno));
+        kp_debug("Cannot stat %s: %s", resolved, strerror(errno));
         return NULL;
     }
     
     /* Step 5: Must be regular file */
     if (!S_ISREG(st.st_mode)) {
         close(fd);
-        g_debug("Not a regular file: %s", resolved);
+        kp_debug("Not a regular file: %s", resolved);
         return NULL;
     }
     
     /* Step 6: Size sanity check */
     if (st.st_size < 64) {
         close(fd);
-        g_debug("File too small to be ELF: %s (%ld bytes)", resolved, (long)st.st_size);
+        kp_debug("File too small to be ELF: %s (%ld bytes)", resolved, (long)st.st_size);
         return NULL;
     }
     
@@ -397,7 +397,7 @@ resolve_binary_path(const char *path)
     close(fd);
     
     /* Step 8: Not ELF - try to parse as script wrapper */
-    g_debug("Attempting to parse script wrapper: %s", resolved);
+    kp_debug("Attempting to parse script wrapper: %s", resolved);
     
     char *real_binary = parse_script_for_exec(resolved);
     if (real_binary) {
@@ -423,6 +423,35 @@ resolve_binary_path(const char *path)
  */
 kp_conf_t kp_conf[1];
 
+/*
+ * Decision generation. Anything caching config-derived per-exe decisions
+ * (pool class, blacklist flag) compares against this to detect staleness.
+ * Starts at 0 so objects created before the first load are always stale.
+ */
+static unsigned int config_generation = 0;
+
+/**
+ * Invalidate cached per-exe decisions
+ *
+ * Called at the end of every config load (startup, SIGHUP) and whenever
+ * another input to those decisions changes (blacklist reload).
+ */
+void
+kp_config_bump_generation(void)
+{
+    if (++config_generation == 0)
+        config_generation = 1;
+}
+
+/**
+ * Get current decision generation
+ */
+unsigned int
+kp_config_generation(void)
+{
+    return config_generation;
+}
+
 /**
  * Load manual apps from whitelist file
  * 
@@ -464,13 +493,13 @@ load_manual_apps_file(kp_conf_t *conf)
 
 
     if (!conf->system.manualapps || !*conf->system.manualapps) {
-        g_debug("No manual apps file configured");
+        kp_debug("No manual apps file configured");
         return;
     }
 
     fp = fopen(conf->system.manualapps, "r");
     if (!fp) {
-        g_debug("Manual apps file not found: %s", conf->system.manualapps);
+        kp_debug("Manual apps file not found: %s", conf->system.manualapps);
         return;
     }
 
@@ -626,6 +655,68 @@ set_default_conf(kp_conf_t *conf)
     conf->system.excluded_patterns_count = 0;
     conf->system.user_app_paths_list = NULL;
     conf->system.user_app_paths_count = 0;
+
+    /* Compiled matchers are built after validation */
+    conf->system.mapprefix_matcher = NULL;
+    conf->system.exeprefix_matcher = NULL;
+    conf->system.pool_matcher = NULL;
+}
+
+/**
+ * Compile a mapprefix/exeprefix rule list
+ *
+ * Each entry is a plain prefix; a leading '!' makes it a reject rule.
+ * Verdicts are TRUE (accept) / FALSE (reject), in list order, so the
+ * compiled matcher keeps the first-match-wins semantics of the list.
+ *
+ * @param prefixes NULL-terminated prefix list (may be NULL)
+ * @return         Compiled matcher, or NULL if there are no rules
+ */
+static kp_path_matcher_t *
+compile_prefix_rules(char * const *prefixes)
+{
+    kp_path_matcher_t *m;
+
+    if (!prefixes || !*prefixes)
+        return NULL;
+
+    m = kp_path_matcher_new(FALSE);
+    for (; *prefixes; prefixes++) {
+        const char *p = *prefixes;
+        if (*p == '!')
+            kp_path_matcher_add_prefix(m, p + 1, FALSE);
+        else
+            kp_path_matcher_add_prefix(m, p, TRUE);
+    }
+    return m;
+}
+
+/**
+ * Compile the pool classification rules
+ *
+ * Exclusion globs come first so they keep precedence over user app
+ * directories, matching the order classify_app_pool() used to test them.
+ * Results are memoized: the same few hundred exe paths are classified
+ * over and over on every hit and miss.
+ */
+static kp_path_matcher_t *
+compile_pool_rules(kp_conf_t *conf)
+{
+    kp_path_matcher_t *m;
+    int i;
+
+    if (conf->system.excluded_patterns_count == 0 &&
+        conf->system.user_app_paths_count == 0)
+        return NULL;
+
+    m = kp_path_matcher_new(TRUE);
+    for (i = 0; i < conf->system.excluded_patterns_count; i++)
+        kp_path_matcher_add_glob(m, conf->system.excluded_patterns_list[i],
+                                 POOL_OBSERVATION);
+    for (i = 0; i < conf->system.user_app_paths_count; i++)
+        kp_path_matcher_add_directory(m, conf->system.user_app_paths_list[i],
+                                      POOL_PRIORITY);
+    return m;
 }
 
 /* Forward declaration for family config loading */
@@ -707,7 +798,7 @@ kp_config_load(const char *conffile, gboolean fail)
 
         /* Load family definitions */
         load_families_from_config(f);
-        g_debug("configuration loading complete");
+        kp_debug("configuration loading complete");
         
         g_key_file_free(f);
     }
@@ -717,6 +808,9 @@ kp_config_load(const char *conffile, gboolean fail)
     g_strfreev(kp_conf->system.mapprefix);
     g_free(kp_conf->system.exeprefix_raw);
     g_strfreev(kp_conf->system.exeprefix);
+    kp_path_matcher_free(kp_conf->system.mapprefix_matcher);
+    kp_path_matcher_free(kp_conf->system.exeprefix_matcher);
+    kp_path_matcher_free(kp_conf->system.pool_matcher);
     g_free(kp_conf->system.manualapps);
     g_strfreev(kp_conf->system.manual_apps_loaded);
     
@@ -725,6 +819,9 @@ kp_config_load(const char *conffile, gboolean fail)
     g_strfreev(kp_conf->system.excluded_patterns_list);
     g_free(kp_conf->system.user_app_paths);
     g_strfreev(kp_conf->system.user_app_paths_list);
+    g_free(kp_conf->system.interpreters);
+    g_free(kp_conf->system.cachesnapshot_extra);
+    g_free(kp_conf->system.pinapps);
 
 #ifdef ENABLE_PREHEAT_EXTENSIONS
     g_free(kp_conf->preheat.manual_apps_list);
@@ -765,6 +862,102 @@ kp_config_load(const char *conffile, gboolean fail)
         kp_conf->model.minsize = 2000000;
     }
 
+    if (kp_conf->system.rewarmmax < 0) {
+        g_warning("Invalid rewarmmax value (must be 0-2097151 KB), using default 131072");
+        kp_conf->system.rewarmmax = 131072 * 1024;
+    }
+
+    if (kp_conf->system.idlewait < 60) {
+        g_warning("Invalid idlewait value %d (must be >= 60), using default 600",
+                  kp_conf->system.idlewait);
+        kp_conf->system.idlewait = 600;
+    }
+
+    if (kp_conf->system.idlebudget < 0) {
+        g_warning("Invalid idlebudget value (must be 0-2097151 KB), using default 262144");
+        kp_conf->system.idlebudget = 262144 * 1024;
+    }
+
+    if (kp_conf->system.netfs < 0 || kp_conf->system.netfs > 2) {
+        g_warning("Invalid netfs value %d (must be 0-2), using default 2",
+                  kp_conf->system.netfs);
+        kp_conf->system.netfs = 2;
+    }
+
+    if (kp_conf->system.fusefs < 0 || kp_conf->system.fusefs > 2) {
+        g_warning("Invalid fusefs value %d (must be 0-2), using default 2",
+                  kp_conf->system.fusefs);
+        kp_conf->system.fusefs = 2;
+    }
+
+    if (kp_conf->system.netfsmax < 0) {
+        g_warning("Invalid netfsmax value (must be 0-2097151 KB), using default 16384");
+        kp_conf->system.netfsmax = 16384 * 1024;
+    }
+
+    if (kp_conf->system.netfstimeout < 1 || kp_conf->system.netfstimeout > 600) {
+        g_warning("Invalid netfstimeout value %d (must be 1-600), using default 15",
+                  kp_conf->system.netfstimeout);
+        kp_conf->system.netfstimeout = 15;
+    }
+
+    if (kp_conf->system.cgroupprotect < 0) {
+        g_warning("Invalid cgroupprotect value (must be 0-2097151 KB), using default 262144");
+        kp_conf->system.cgroupprotect = 262144 * 1024;
+    }
+
+    if (kp_conf->system.cgroupmax < 0) {
+        g_warning("Invalid cgroupmax value (must be 0-2097151 KB), using default 1048576");
+        kp_conf->system.cgroupmax = 1048576 * 1024;
+    }
+
+    if (kp_conf->system.reclaimpsi < 0 || kp_conf->system.reclaimpsi > 100) {
+        g_warning("Invalid reclaimpsi value %d (must be 0-100), using default 10",
+                  kp_conf->system.reclaimpsi);
+        kp_conf->system.reclaimpsi = 10;
+    }
+
+    if (kp_conf->system.pinmax < 0) {
+        g_warning("Invalid pinmax value (must be 0-2097151 KB), pinning disabled");
+        kp_conf->system.pinmax = 0;
+    }
+
+    if (kp_conf->model.predictslice < 0) {
+        g_warning("Invalid predictslice value %d (must be >= 0 ms), using default 10",
+                  kp_conf->model.predictslice);
+        kp_conf->model.predictslice = 10;
+    }
+
+    if (kp_conf->power.battery_cycle < 0) {
+        g_warning("Invalid battery_cycle value %d (must be >= 0), using the AC cycle",
+                  kp_conf->power.battery_cycle);
+        kp_conf->power.battery_cycle = 0;
+    }
+
+    if (kp_conf->power.battery_maxprocs < 0) {
+        g_warning("Invalid battery_maxprocs value %d (must be >= 0), using the AC value",
+                  kp_conf->power.battery_maxprocs);
+        kp_conf->power.battery_maxprocs = 0;
+    }
+
+    if (kp_conf->power.battery_budget < 0 || kp_conf->power.battery_budget > 100) {
+        g_warning("Invalid battery_budget value %d (must be 0-100), using default 50",
+                  kp_conf->power.battery_budget);
+        kp_conf->power.battery_budget = 50;
+    }
+
+    if (kp_conf->power.lowbattery < 0 || kp_conf->power.lowbattery > 100) {
+        g_warning("Invalid lowbattery value %d (must be 0-100), using default 20",
+                  kp_conf->power.lowbattery);
+        kp_conf->power.lowbattery = 20;
+    }
+
+    if (kp_conf->power.low_budget < 0 || kp_conf->power.low_budget > 100) {
+        g_warning("Invalid low_budget value %d (must be 0-100), using default 0",
+                  kp_conf->power.low_budget);
+        kp_conf->power.low_budget = 0;
+    }
+
     /* Parse pattern lists */
     parse_pattern_list(kp_conf->system.excluded_patterns,
                        &kp_conf->system.excluded_patterns_list,
@@ -788,6 +981,11 @@ kp_config_load(const char *conffile, gboolean fail)
         for (char **p = kp_conf->system.exeprefix; p && *p; p++) count++;
         g_message("Parsed %d exe prefixes from config", count);
     }
+
+    /* Compile rule lists into one-pass matchers (rebuilt on every reload) */
+    kp_conf->system.mapprefix_matcher = compile_prefix_rules(kp_conf->system.mapprefix);
+    kp_conf->system.exeprefix_matcher = compile_prefix_rules(kp_conf->system.exeprefix);
+    kp_conf->system.pool_matcher = compile_pool_rules(kp_conf);
     
     if (kp_conf->system.excluded_patterns_count > 0) {
         g_message("Loaded %d exclusion patterns for observation pool",
@@ -801,6 +999,9 @@ kp_config_load(const char *conffile, gboolean fail)
     
     /* Load manual apps from file */
     load_manual_apps_file(kp_conf);
+
+    /* Prefix rules, patterns and the manual list may all have changed */
+    kp_config_bump_generation();
 }
 
 /**
@@ -852,7 +1053,7 @@ kp_config_dump_log(void)
     fprintf(stderr, "# loaded configuration - end\n");
     fprintf(stderr, "#\n");
 
-    g_debug("configuration dump complete");
+    kp_debug("configuration dump complete");
 }
 
 /**
@@ -876,14 +1077,14 @@ load_families_from_config(GKeyFile *keyfile)
     
     /* BUG 2 FIX: Guard against NULL state during early startup */
     if (!kp_state->app_families) {
-        g_debug("Deferring family loading - state not initialized");
+        kp_debug("Deferring family loading - state not initialized");
         return;
     }
     
     keys = g_key_file_get_keys(keyfile, "families", &num_keys, &error);
     if (!keys) {
         if (error && error->code != G_KEY_FILE_ERROR_GROUP_NOT_FOUND) {
-            g_debug("Error reading [families] section: %s", error->message);
+            kp_debug("Error reading [families] section: %s", error->message);
         }
         g_clear_error(&error);
         return;
@@ -14,6 +14,7 @@
 #define CONFIG_H
 
 #include <glib.h>
+#include "../utils/pattern.h"
 
 /* Unit definitions (for confkeys.h) */
 #define bytes			   1
@@ -22,6 +23,7 @@
 #define seconds			   1
 #define minutes			  60
 #define hours			3600
+#define milliseconds		   1  /* Preheat extension: kept in ms */
 
 #define signed_integer_percent	   1
 #define percent_times_100	   1  /* Preheat extension */
@@ -44,8 +46,10 @@ typedef struct _kp_conf_t
         int memtotal;           /* % of total memory */
         int memfree;            /* % of free memory */
         int memcached;          /* % of cached memory */
+        gboolean memadapt;      /* Refault-aware scaling of the budget */
         
         int hitstats_window;    /* Hit/miss detection window (seconds) */
+        int predictslice;       /* CPU ms per prediction slice (0 = one slice) */
     } model;
 
 
@@ -59,6 +63,8 @@ typedef struct _kp_conf_t
         char **mapprefix;       /* Parsed prefixes for mapped files */
         char *exeprefix_raw;    /* Raw semicolon-separated prefix string */
         char **exeprefix;       /* Parsed prefixes for executables */
+        kp_path_matcher_t *mapprefix_matcher;  /* Compiled mapprefix (runtime) */
+        kp_path_matcher_t *exeprefix_matcher;  /* Compiled exeprefix (runtime) */
 
         int maxprocs;           /* Max parallel readahead processes */
         enum {
@@ -80,8 +86,51 @@ typedef struct _kp_conf_t
         char *user_app_paths;          /* User app directories (semicolon-separated) */
         char **user_app_paths_list;    /* Parsed user app paths (runtime) */
         int user_app_paths_count;      /* Number of user app paths */
+
+        /* excluded_patterns (→ POOL_OBSERVATION) followed by
+         * user_app_paths (→ POOL_PRIORITY), compiled (runtime) */
+        kp_path_matcher_t *pool_matcher;
+
+        char *interpreters;            /* Interpreter identity rules (glob=kind;...) */
+
+        gboolean cachesnapshot;        /* Snapshot page cache at shutdown */
+        char *cachesnapshot_extra;     /* Extra snapshot files (semicolon-separated) */
+
+        gboolean rewarm;               /* Re-warm after resume/reclaim */
+        int rewarmmax;                 /* Re-warm read cap (bytes) */
+
+        gboolean idlepreload;          /* Idle-time opportunistic tier */
+        int idlewait;                  /* Sustained idleness before it starts (s) */
+        int idlebudget;                /* Idle tier read cap per idle period (bytes) */
+
+        int netfs;                     /* Network fs policy: 0=skip, 1=limit, 2=lane */
+        int fusefs;                    /* Other FUSE fs policy, same values */
+        int netfsmax;                  /* Network/FUSE read cap per batch (bytes) */
+        int netfstimeout;              /* Lane worker timeout (s) */
+
+        gboolean cgroup;               /* Readahead workers in their own cgroup */
+        int cgroupprotect;             /* memory.low of that cgroup (bytes) */
+        int cgroupmax;                 /* memory.high of that cgroup (bytes, 0 = max) */
+        gboolean reclaim;              /* Drop mispredicted preloads under pressure */
+        int reclaimpsi;                /* Memory PSI some avg10 % that triggers it */
+        char *pinapps;                 /* Apps to keep mlocked (semicolon-separated) */
+        int pinmax;                    /* Cap on mlocked bytes (0 = no pinning) */
+        gboolean pipeline;             /* Scanner and I/O threads (read at startup) */
+        gboolean schedidle;            /* SCHED_IDLE instead of nice (read at startup) */
     } system;
 
+    /* [power] section - Policy profiles on battery */
+    struct _conf_power {
+        gboolean enable;               /* Switch profiles on power source */
+        gboolean platformprofile;      /* Low-power platform profile counts as battery */
+        int battery_cycle;             /* Cycle on battery (seconds, 0 = AC value) */
+        int battery_maxprocs;          /* Readahead processes on battery (0 = AC value) */
+        int battery_budget;            /* Preload budget on battery (%) */
+        gboolean battery_idle;         /* Idle tier on battery */
+        int lowbattery;                /* Charge (%) at or below which "low" applies */
+        int low_budget;                /* Preload budget on low battery (%) */
+    } power;
+
 #ifdef ENABLE_PREHEAT_EXTENSIONS
     /* [preheat] section - Preheat extensions */
     struct _conf_preheat {
@@ -108,6 +157,23 @@ extern kp_conf_t kp_conf[1];
  */
 void kp_config_load(const char *conffile, gboolean fail);
 
+/**
+ * Invalidate cached config-derived decisions
+ *
+ * Bumped by kp_config_load() (startup and SIGHUP, which also covers the
+ * manual apps list) and by blacklist reloads.
+ */
+void kp_config_bump_generation(void);
+
+/**
+ * Get current config decision generation
+ *
+ * Per-exe caches (pool classification, blacklist flag) store the value
+ * they were computed under and recompute when it differs. Never 0 once
+ * configuration has been loaded.
+ */
+unsigned int kp_config_generation(void);
+
 /**
  * Dump loaded configuration to log
  * (VERBATIM signature from upstream preload_conf_dump_log)
@@ -65,11 +65,23 @@ confkey(model,	integer,	memtotal,	    -10,	signed_integer_percent)
 confkey(model,	integer,	memfree,	     50,	signed_integer_percent)
 confkey(model,	integer,	memcached,	      0,	signed_integer_percent)
 
+/* memadapt: Scale the memtotal/memfree/memcached budget by page cache
+ *           refault pressure (shrink while preloading evicts the working
+ *           set, grow while the inactive list is cold), capped to
+ *           MemAvailable. false = use the formula as is. */
+confkey(model,	boolean,	memadapt,	   true,	-)
+
 /* hitstats_window: Sliding window (seconds) for hit/miss detection.
  *                  A launch is a "hit" if app was preloaded within this window.
  *                  Default: 3600 (1 hour). Range: 60-86400 */
 confkey(model,	integer,	hitstats_window,   3600,	seconds)
 
+/* predictslice: CPU time (ms) the prediction may use before yielding to the
+ *               main loop; the rest runs in further slices, so signals and
+ *               control requests are not held up by a large model.
+ *               0 = predict in one go */
+confkey(model,	integer,	predictslice,	     10,	milliseconds)
+
 /* [system] section - Controls daemon behavior and I/O strategy */
 
 /* doscan: Enable /proc filesystem scanning to discover running processes */
@@ -111,6 +123,108 @@ confkey(system,	string,		excluded_patterns, "/bin/sh;/bin/bash;/usr/bin/grep;/us
  *                 Apps in these paths auto-promoted to priority pool. */
 confkey(system,	string,		user_app_paths,	   "/usr/share/applications;/usr/local/share/applications;~/.local/share/applications;/opt",	-)
 
+/* interpreters: Exe basename globs whose processes are identified by what
+ *               they run (script, -jar target, -m module, app.asar) instead
+ *               of by the interpreter. "glob=kind;..." with kind one of
+ *               python, java, node, script. Empty disables. */
+confkey(system,	string,		interpreters,	   "python*=python;pypy*=python;java=java;node=node;nodejs=node;electron*=node;perl*=script;ruby*=script;php*=script;sh=script;bash=script;dash=script;zsh=script",	-)
+
+/* cachesnapshot: On shutdown, record which ranges of tracked files are in the
+ *                page cache and restore the most valuable ones on next start */
+confkey(system,	boolean,	cachesnapshot,	   false,	-)
+
+/* cachesnapshot_extra: Extra files (semicolon-separated) to include in the
+ *                      page-cache snapshot, regardless of the model */
+confkey(system,	string,		cachesnapshot_extra, NULL,	-)
+
+/* rewarm: After resume from suspend or a large memory reclaim, immediately
+ *         re-read the evicted parts of running and top predicted apps */
+confkey(system,	boolean,	rewarm,		   true,	-)
+
+/* rewarmmax: Upper bound (KB) of data read by one re-warm */
+confkey(system,	integer,	rewarmmax,	 131072,	kilobytes)
+
+/* idlepreload: When disk, IO pressure and load stay low for idlewait
+ *              seconds, preload next-best candidates (including the
+ *              observation pool) in small, abortable, idle-priority chunks */
+confkey(system,	boolean,	idlepreload,	   true,	-)
+confkey(system,	integer,	idlewait,	    600,	seconds)
+
+/* idlebudget: Upper bound (KB) of data read per idle period */
+confkey(system,	integer,	idlebudget,	 262144,	kilobytes)
+
+/* netfs/fusefs: What to do with maps on network filesystems (NFS, CIFS,
+ *               sshfs, Ceph...) and on other FUSE filesystems, whose reads
+ *               can stall the readahead batch:
+ *   0 = SKIP  - Never read them
+ *   1 = LIMIT - Read inline with local files, up to netfsmax per batch
+ *   2 = LANE  - Read in a detached worker, killed after netfstimeout */
+confkey(system,	enum,		netfs,		      2,	-)
+confkey(system,	enum,		fusefs,		      2,	-)
+
+/* netfsmax: Upper bound (KB) of network/FUSE data read per batch */
+confkey(system,	integer,	netfsmax,	  16384,	kilobytes)
+
+/* netfstimeout: Seconds before the network lane worker gives up */
+confkey(system,	integer,	netfstimeout,	     15,	seconds)
+
+/* cgroup: Run readahead workers in a child cgroup (cgroup v2, needs
+ *         Delegate=yes) whose memory.low protects cgroupprotect KB of
+ *         preloaded cache and whose memory.high caps it at cgroupmax KB
+ *         (0 = no cap) */
+confkey(system,	boolean,	cgroup,		  false,	-)
+confkey(system,	integer,	cgroupprotect,	 262144,	kilobytes)
+confkey(system,	integer,	cgroupmax,	1048576,	kilobytes)
+
+/* reclaim: Remember preloaded ranges and POSIX_FADV_DONTNEED the ones no
+ *          running exe maps, least likely first, when memory PSI "some
+ *          avg10" reaches reclaimpsi % (0 = only on working set thrashing) */
+confkey(system,	boolean,	reclaim,	   true,	-)
+confkey(system,	integer,	reclaimpsi,	     10,	signed_integer_percent)
+
+/* pinapps/pinmax: Keep the maps of these apps (semicolon-separated paths)
+ *                 mmap'ed and mlock'ed, up to pinmax KB (0 = off). Unpinned
+ *                 under severe memory pressure, re-pinned after upgrades */
+confkey(system,	string,		pinapps,	   NULL,	-)
+confkey(system,	integer,	pinmax,		      0,	kilobytes)
+
+/* pipeline: Walk /proc on a scanner thread and read the readahead plans on
+ *           an I/O thread, so a slow disk no longer stretches the cycle;
+ *           false runs the whole cycle on the main loop. Read at startup */
+confkey(system,	boolean,	pipeline,	   true,	-)
+
+/* schedidle: Run the daemon and its readahead workers under SCHED_IDLE, so
+ *            they only get CPU no other task wants (the nice level set with
+ *            -n is used otherwise). Read at startup */
+confkey(system,	boolean,	schedidle,	  false,	-)
+
+/* [power] section: policy on battery, switched without a restart */
+
+/* enable: Read /sys/class/power_supply every cycle and use the battery
+ *         profile below while running on battery */
+confkey(power,	boolean,	enable,		   true,	-)
+
+/* platformprofile: Also use the battery profile while
+ *                  /sys/firmware/acpi/platform_profile is low-power or quiet
+ *                  (opt-in: quiet desktops on AC would be throttled too) */
+confkey(power,	boolean,	platformprofile,  false,	-)
+
+/* battery_cycle/battery_maxprocs: Cycle length and readahead processes on
+ *                                 battery (0 = same as on AC) */
+confkey(power,	integer,	battery_cycle,	     60,	seconds)
+confkey(power,	integer,	battery_maxprocs,     4,	processes)
+
+/* battery_budget: Percentage of the preload budget used on battery */
+confkey(power,	integer,	battery_budget,	     50,	signed_integer_percent)
+
+/* battery_idle: Run the idle-time tier on battery */
+confkey(power,	boolean,	battery_idle,	  false,	-)
+
+/* lowbattery/low_budget: At or below lowbattery % charge, use low_budget %
+ *                        of the preload budget instead (0 = no preloading) */
+confkey(power,	integer,	lowbattery,	     20,	signed_integer_percent)
+confkey(power,	integer,	low_budget,	      0,	signed_integer_percent)
+
 /* PREHEAT EXTENSIONS (opt-in, only active if --enable-preheat-extensions) */
 
 #ifdef ENABLE_PREHEAT_EXTENSIONS
@@ -23,9 +23,9 @@
  * MAIN LOOP (kp_daemon_run):
  *   1. Create PID file (/run/preheat.pid)
  *   2. Check for competing daemons (systemd-readahead, ureadahead, preload)
- *   3. Start state management periodic tasks
+ *   3. Start the task scheduler and the state management periodic tasks
  *   4. Run GLib main loop (blocks until exit signal)
- *   5. Cleanup: remove PID file
+ *   5. Cleanup: stop the scheduler, remove PID file
  *
  * COMPETING DAEMON DETECTION:
  *   Other preload daemons can conflict with preheat. We check for:
@@ -38,6 +38,7 @@
 
 #include "common.h"
 #include "daemon.h"
+#include "scheduler.h"
 #include "../utils/logging.h"
 
 #include <sys/types.h>
@@ -96,7 +97,7 @@ kp_daemonize(void)
     /* Change to root directory to not block unmounts */
     (void) chdir("/");
 
-    g_debug("daemonized successfully");
+    kp_debug("daemonized successfully");
 }
 
 /**
@@ -128,7 +129,7 @@ kp_write_pidfile(void)
     fprintf(f, "%d\n", getpid());
     fclose(f);  /* Also closes fd */
 
-    g_debug("PID file created: %s", PIDFILE);
+    kp_debug("PID file created: %s", PIDFILE);
 }
 
 /**
@@ -141,7 +142,7 @@ kp_remove_pidfile(void)
         if (errno != ENOENT)
             g_warning("failed to remove PID file %s: %s", PIDFILE, strerror(errno));
     } else {
-        g_debug("PID file removed");
+        kp_debug("PID file removed");
     }
 }
 
@@ -222,7 +223,7 @@ kp_check_competing_daemons(void)
 void
 kp_daemon_run(const char *statefile)
 {
-    g_debug("starting main event loop");
+    kp_debug("starting main event loop");
 
     /* Create PID file */
     kp_write_pidfile();
@@ -239,13 +240,16 @@ kp_daemon_run(const char *statefile)
     /* Check for competing daemons at startup */
     kp_check_competing_daemons();
 
-    /* Start state management (sets up periodic tasks) */
+    /* One timer for all periodic tasks, then start state management */
+    kp_sched_start();
     kp_state_run(statefile);
 
     /* Run the loop - blocks until g_main_loop_quit() is called */
     g_main_loop_run(main_loop);
 
-    g_debug("main loop exited");
+    kp_debug("main loop exited");
+
+    kp_sched_stop();
 
     /* Cleanup */
     if (main_loop) {
@@ -29,13 +29,22 @@
  *   5. kp_session_init()   → Initialize session detection
  *   6. kp_signals_init()   → Set up signal handlers
  *   7. kp_daemonize()      → Fork to background (unless -f)
- *   8. kp_state_load()     → Load learned state from disk
- *   9. kp_daemon_run()     → Enter main event loop
+ *      nice() / SCHED_IDLE → CPU priority (system.schedidle)
+ *      kp_pipeline_start() → Scanner and I/O threads (if enabled)
+ *      kp_power_tick()     → Power profile (AC, battery, low)
+ *   8. kp_bootplan_load()  → Replay precompiled boot readahead plan
+ *   9. kp_state_load()     → Load learned state from disk
+ *  10. kp_cachesnap_restore() → Restore page-cache snapshot (if enabled)
+ *  11. kp_daemon_run()     → Enter main event loop
  *
  * SHUTDOWN SEQUENCE:
- *   1. kp_state_save()     → Persist learned state
- *   2. kp_state_free()     → Release memory
- *   3. exit(0)
+ *   1. kp_seed_shutdown()  → Stop first-run seeding threads (if any)
+ *      kp_prophet_cancel() → Drop a prediction still in flight
+ *      kp_pipeline_stop()  → Join scanner and I/O threads
+ *   2. kp_cachesnap_save() → Snapshot resident page cache (if enabled)
+ *   3. kp_state_save()     → Persist learned state (and next boot plan)
+ *   4. kp_state_free()     → Release memory
+ *   5. exit(0)
  *
  * SELF-TEST MODE (-t):
  *   Runs diagnostics without starting daemon:
@@ -52,11 +61,17 @@
 #include "../config/config.h"
 #include "../config/blacklist.h"
 #include "../utils/desktop.h"
+#include "../utils/seeding.h"
+#include "../readahead/bootplan.h"
+#include "../readahead/cachesnap.h"
 #include "daemon.h"
 #include "signals.h"
 #include "session.h"
 #include "stats.h"
+#include "pipeline.h"
+#include "power.h"
 #include "../state/state.h"
+#include "../predict/prophet.h"
 
 #include <getopt.h>
 #include <dirent.h>
@@ -64,6 +79,7 @@
 #include <ctype.h>
 #include <string.h>     /* For strcspn() */
 #include <sys/file.h>   /* For flock() */
+#include <sched.h>      /* For sched_setscheduler() */
 
 /* Default file paths */
 #define DEFAULT_CONFFILE SYSCONFDIR "/" PACKAGE ".conf"
@@ -274,7 +290,7 @@ acquire_pidfile_lock(const char *pidfile)
     }
     
     /* Keep fd open - lock is held until process exits */
-    g_debug("PID file lock acquired: %s", pidfile);
+    kp_debug("PID file lock acquired: %s", pidfile);
     return TRUE;
 }
 
@@ -288,7 +304,7 @@ release_pidfile_lock(void)
         close(pidfile_fd);
         pidfile_fd = -1;
         unlink(DEFAULT_PIDFILE);  /* Clean up PID file */
-        g_debug("PID file lock released");
+        kp_debug("PID file lock released");
     }
 }
 
@@ -450,10 +466,34 @@ main(int argc, char **argv)
     if (!foreground)
         kp_daemonize();
 
+    /* After the fork: the writer thread must live in the daemon process */
+    kp_log_start_writer();
+
     if (0 > nice(nicelevel))
         g_warning("nice: %s", strerror(errno));
 
-    g_debug("starting up");
+    /* Only run when no other task wants the CPU (the nice level no longer
+     * matters then). Readahead workers inherit it */
+    if (kp_conf->system.schedidle) {
+        struct sched_param param = { 0 };
+
+        if (sched_setscheduler(0, SCHED_IDLE, &param) < 0)
+            g_warning("sched_setscheduler(SCHED_IDLE): %s", strerror(errno));
+    }
+
+    kp_debug("starting up");
+
+    /* After nice() and SCHED_IDLE, which threads inherit; before the boot plan, so its
+     * reads overlap with loading the state */
+    kp_pipeline_start();
+
+    /* Power profile before the first replay: its budget applies to them */
+    kp_power_tick();
+
+    /* Warm the disk from last session's plan before parsing the model;
+     * the plan stays loaded for the login boot window (session.c) */
+    if (kp_bootplan_load(statefile) && kp_conf->system.dopredict)
+        kp_bootplan_replay();
 
     /* Load state from file */
     kp_state_load(statefile);
@@ -471,14 +511,24 @@ main(int argc, char **argv)
     kp_state->dirty = TRUE;  /* Ensure save actually writes */
     kp_state_save(statefile);
 
+    /* Bring back what was cached at last shutdown, within budget */
+    if (kp_conf->system.cachesnapshot && kp_conf->system.dopredict)
+        kp_cachesnap_restore(statefile);
+
     g_message("%s %s started", PACKAGE, VERSION);
 
     /* Main loop */
     kp_daemon_run(statefile);
 
     /* Clean up */
+    kp_seed_shutdown();  /* Join seeding threads before touching state */
+    kp_prophet_cancel(); /* Its slices would never run again */
+    kp_pipeline_stop();  /* Join scanner and I/O threads, drop queued work */
+    if (kp_conf->system.cachesnapshot)
+        kp_cachesnap_save(statefile);
     kp_state_save(statefile);
     kp_state_free();
+    kp_bootplan_free();
 
     /* Release PID file lock */
     release_pidfile_lock();
@@ -488,6 +538,6 @@ main(int argc, char **argv)
     g_free((gchar*)statefile);
     g_free((gchar*)logfile);
 
-    g_debug("exiting");
+    kp_debug("exiting");
     return EXIT_SUCCESS;
 }
@@ -94,7 +94,7 @@ load_pause_file(void)
         g_message("Pause state loaded: paused for %ld more seconds", expiry - now);
     } else {
         /* Expired */
-        g_debug("Pause expired, removing stale pause file");
+        kp_debug("Pause expired, removing stale pause file");
         unlink(PAUSE_FILE);
         pause_state.active = FALSE;
         pause_state.expiry = -1;
@@ -126,7 +126,7 @@ save_pause_file(time_t expiry)
 void
 kp_pause_init(void)
 {
-    g_debug("Initializing pause subsystem");
+    kp_debug("Initializing pause subsystem");
     pause_state.initialized = TRUE;
     load_pause_file();
 }
@@ -0,0 +1,379 @@
+/* pipeline.c - Threaded scan/model/I-O pipeline for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Cycle Pipeline
+ * =============================================================================
+ *
+ * On one main loop the cycle is the sum of its phases: walking /proc,
+ * updating the model and predicting, then reading the plan (fork, wait
+ * for every worker). A slow disk stretches the whole cycle, and signals,
+ * autosave and the next scan all wait for it.
+ *
+ * With system.pipeline the cycle runs as three stages:
+ *
+ *   ┌──────────┐ scan_msg_t  ┌─────────────────────┐  io_msg_t  ┌──────────┐
+ *   │ scanner  │ ──────────▶ │ model (main loop)   │ ─────────▶ │ I/O      │
+ *   │ thread   │ ◀────────── │ owns kp_state:      │ ◀───────── │ thread   │
+ *   │ /proc    │   request   │ spy, prophet, stats │  finished  │ fork/    │
+ *   └──────────┘             └─────────────────────┘            │ readahead│
+ *                                                               └──────────┘
+ *
+ * - Each arrow is a lock-free SPSC queue (spsc.c); a message belongs to
+ *   one stage at a time and is not changed by the receiver
+ * - The scanner only reads /proc (kp_proc_snapshot), the I/O thread only
+ *   reads plans (kp_readahead_execute); neither touches kp_state, the
+ *   configuration or the stats, so the main loop needs no locks
+ * - Prediction hands a plan over and goes on: the next cycle no longer
+ *   waits for the previous cycle's reads
+ * - Plans queue up to PIPELINE_IO_DEPTH; beyond that the I/O thread is
+ *   hopelessly behind and new plans are dropped (and counted)
+ *
+ * Without system.pipeline, or if a thread cannot be started, every stage
+ * runs inline on the main loop exactly as before. Stage latencies go to
+ * the stats file either way.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "pipeline.h"
+#include "../utils/logging.h"
+#include "../utils/spsc.h"
+#include "../config/config.h"
+#include "stats.h"
+
+#include <signal.h>
+
+#define PIPELINE_IO_DEPTH   8       /* Plans waiting for the I/O thread */
+
+/* Scanner request and reply (same message, filled in by the scanner) */
+typedef struct {
+    kp_pipeline_scan_func func;
+    gpointer data;
+    kp_proc_snapshot_t *snap;
+    double scan_ms;
+} scan_msg_t;
+
+/* I/O request and reply */
+typedef struct {
+    kp_readahead_plan_t *plan;
+    gint64 queued;          /* g_get_monotonic_time() when handed over */
+    double wait_ms;
+    double io_ms;
+} io_msg_t;
+
+typedef struct {
+    GThread *thread;
+    kp_spsc_t *in;          /* main loop → thread */
+    kp_spsc_t *out;         /* thread → main loop */
+    guint watch;            /* Main loop source draining 'out' */
+} stage_t;
+
+static struct {
+    stage_t scanner;
+    stage_t io;
+    gint stop;              /* Set (atomic) to make the threads exit */
+    gboolean scan_pending;
+    kp_pipeline_scan_func deferred_func;    /* Scan asked for while one was in flight */
+    gpointer deferred_data;
+    kp_pipeline_stats_t stats;
+} pipe_state;
+
+static double
+elapsed_ms(gint64 since)
+{
+    return (g_get_monotonic_time() - since) / 1000.0;
+}
+
+static void
+scan_msg_free(gpointer data)
+{
+    scan_msg_t *msg = data;
+
+    kp_proc_snapshot_free(msg->snap);
+    g_slice_free(scan_msg_t, msg);
+}
+
+static void
+io_msg_free(gpointer data)
+{
+    io_msg_t *msg = data;
+
+    kp_readahead_plan_free(msg->plan);
+    g_slice_free(io_msg_t, msg);
+}
+
+/**
+ * Leave signals to the main thread; stages never see EINTR or run handlers
+ */
+static void
+block_signals(void)
+{
+    sigset_t all;
+
+    sigfillset(&all);
+    pthread_sigmask(SIG_BLOCK, &all, NULL);
+}
+
+static gpointer
+scanner_main(gpointer G_GNUC_UNUSED data)
+{
+    block_signals();
+
+    while (!g_atomic_int_get(&pipe_state.stop)) {
+        scan_msg_t *msg;
+
+        kp_spsc_wait(pipe_state.scanner.in, -1);
+        while ((msg = kp_spsc_pop(pipe_state.scanner.in))) {
+            gint64 start = g_get_monotonic_time();
+
+            msg->snap = kp_proc_snapshot();
+            msg->scan_ms = elapsed_ms(start);
+
+            /* One scan in flight at a time: never full */
+            if (!kp_spsc_push(pipe_state.scanner.out, msg))
+                scan_msg_free(msg);
+        }
+    }
+    return NULL;
+}
+
+static gpointer
+io_main(gpointer G_GNUC_UNUSED data)
+{
+    block_signals();
+
+    while (!g_atomic_int_get(&pipe_state.stop)) {
+        io_msg_t *msg;
+
+        kp_spsc_wait(pipe_state.io.in, -1);
+        while (!g_atomic_int_get(&pipe_state.stop) &&
+               (msg = kp_spsc_pop(pipe_state.io.in))) {
+            gint64 start = g_get_monotonic_time();
+
+            msg->wait_ms = (start - msg->queued) / 1000.0;
+            kp_readahead_execute(msg->plan);
+            msg->io_ms = elapsed_ms(start);
+
+            kp_readahead_plan_free(msg->plan);
+            msg->plan = NULL;
+            if (!kp_spsc_push(pipe_state.io.out, msg))
+                io_msg_free(msg);
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Run the model stage on a snapshot, timing it
+ */
+static void
+run_model(kp_pipeline_scan_func func, gpointer data, kp_proc_snapshot_t *snap)
+{
+    gint64 start = g_get_monotonic_time();
+
+    func(snap, data);
+    pipe_state.stats.model_ms = elapsed_ms(start);
+    kp_stats_record_pipeline(&pipe_state.stats);
+}
+
+static gboolean
+scanner_done(GIOChannel G_GNUC_UNUSED *source, GIOCondition G_GNUC_UNUSED condition,
+             gpointer G_GNUC_UNUSED data)
+{
+    scan_msg_t *msg;
+    kp_pipeline_scan_func func;
+
+    kp_spsc_clear(pipe_state.scanner.out);
+    while ((msg = kp_spsc_pop(pipe_state.scanner.out))) {
+        pipe_state.scan_pending = FALSE;
+        pipe_state.stats.scan_ms = msg->scan_ms;
+        run_model(msg->func, msg->data, msg->snap);
+        scan_msg_free(msg);
+    }
+
+    /* A scan asked for meanwhile gets a fresh snapshot of its own */
+    func = pipe_state.deferred_func;
+    if (func && !pipe_state.scan_pending) {
+        pipe_state.deferred_func = NULL;
+        kp_pipeline_scan(func, pipe_state.deferred_data);
+    }
+    return TRUE;
+}
+
+static gboolean
+io_done(GIOChannel G_GNUC_UNUSED *source, GIOCondition G_GNUC_UNUSED condition,
+        gpointer G_GNUC_UNUSED data)
+{
+    io_msg_t *msg;
+
+    kp_spsc_clear(pipe_state.io.out);
+    while ((msg = kp_spsc_pop(pipe_state.io.out))) {
+        if (pipe_state.stats.io_queued)
+            pipe_state.stats.io_queued--;
+        pipe_state.stats.io_plans++;
+        pipe_state.stats.io_wait_ms = msg->wait_ms;
+        pipe_state.stats.io_ms = msg->io_ms;
+        kp_debug("pipeline: plan read in %.0f ms after waiting %.0f ms",
+                 msg->io_ms, msg->wait_ms);
+        io_msg_free(msg);
+    }
+    kp_stats_record_pipeline(&pipe_state.stats);
+    return TRUE;
+}
+
+static gboolean
+stage_start(stage_t *stage, const char *name, GThreadFunc func, guint depth,
+            GIOFunc done)
+{
+    GIOChannel *channel;
+    GError *error = NULL;
+
+    stage->in = kp_spsc_new(depth);
+    stage->out = kp_spsc_new(depth);
+    if (!stage->in || !stage->out) {
+        g_warning("pipeline: cannot create %s queues: %s", name, strerror(errno));
+        return FALSE;
+    }
+
+    stage->thread = g_thread_try_new(name, func, NULL, &error);
+    if (!stage->thread) {
+        g_warning("pipeline: cannot start %s thread: %s", name, error->message);
+        g_error_free(error);
+        return FALSE;
+    }
+
+    channel = g_io_channel_unix_new(kp_spsc_fd(stage->out));
+    stage->watch = g_io_add_watch(channel, G_IO_IN, done, NULL);
+    g_io_channel_unref(channel);
+    return TRUE;
+}
+
+static void
+stage_stop(stage_t *stage, GDestroyNotify free_func)
+{
+    if (stage->thread) {
+        kp_spsc_wake(stage->in);
+        g_thread_join(stage->thread);
+        stage->thread = NULL;
+    }
+    if (stage->watch) {
+        g_source_remove(stage->watch);
+        stage->watch = 0;
+    }
+    kp_spsc_free(stage->in, free_func);
+    kp_spsc_free(stage->out, free_func);
+    stage->in = stage->out = NULL;
+}
+
+void
+kp_pipeline_start(void)
+{
+    if (pipe_state.stats.threaded || !kp_conf->system.pipeline) {
+        kp_stats_record_pipeline(&pipe_state.stats);
+        return;
+    }
+
+    g_atomic_int_set(&pipe_state.stop, 0);
+    if (!stage_start(&pipe_state.scanner, "scanner", scanner_main, 2, scanner_done) ||
+        !stage_start(&pipe_state.io, "readahead-io", io_main, PIPELINE_IO_DEPTH, io_done)) {
+        g_warning("pipeline: running single-threaded");
+        kp_pipeline_stop();
+        kp_stats_record_pipeline(&pipe_state.stats);
+        return;
+    }
+
+    pipe_state.stats.threaded = TRUE;
+    kp_stats_record_pipeline(&pipe_state.stats);
+    kp_debug("pipeline: scanner and I/O threads started");
+}
+
+void
+kp_pipeline_stop(void)
+{
+    g_atomic_int_set(&pipe_state.stop, 1);
+    stage_stop(&pipe_state.scanner, scan_msg_free);
+    stage_stop(&pipe_state.io, io_msg_free);
+
+    pipe_state.scan_pending = FALSE;
+    pipe_state.deferred_func = NULL;
+    pipe_state.stats.threaded = FALSE;
+    pipe_state.stats.io_queued = 0;
+}
+
+void
+kp_pipeline_scan(kp_pipeline_scan_func func, gpointer data)
+{
+    kp_proc_snapshot_t *snap;
+    gint64 start;
+
+    g_return_if_fail(func);
+
+    /* Scanner still busy: an inline snapshot taken now would be applied
+     * first and then overwritten by the older one in flight. Scan again
+     * once it is in */
+    if (pipe_state.stats.threaded && pipe_state.scan_pending) {
+        kp_debug("pipeline: previous scan not done yet, deferring this one");
+        pipe_state.deferred_func = func;
+        pipe_state.deferred_data = data;
+        return;
+    }
+
+    if (pipe_state.stats.threaded) {
+        scan_msg_t *msg = g_slice_new0(scan_msg_t);
+
+        msg->func = func;
+        msg->data = data;
+        if (kp_spsc_push(pipe_state.scanner.in, msg)) {
+            pipe_state.scan_pending = TRUE;
+            return;
+        }
+        g_slice_free(scan_msg_t, msg);
+    }
+
+    start = g_get_monotonic_time();
+    snap = kp_proc_snapshot();
+    pipe_state.stats.scan_ms = elapsed_ms(start);
+    run_model(func, data, snap);
+    kp_proc_snapshot_free(snap);
+}
+
+void
+kp_pipeline_readahead(kp_readahead_plan_t *plan)
+{
+    gint64 start;
+
+    g_return_if_fail(plan);
+
+    if (pipe_state.stats.threaded) {
+        io_msg_t *msg = g_slice_new0(io_msg_t);
+
+        msg->plan = plan;
+        msg->queued = g_get_monotonic_time();
+        if (kp_spsc_push(pipe_state.io.in, msg)) {
+            pipe_state.stats.io_queued++;
+        } else {
+            pipe_state.stats.io_dropped++;
+            kp_debug("pipeline: I/O thread %u plans behind, dropping this one",
+                     pipe_state.stats.io_queued);
+            io_msg_free(msg);
+        }
+        kp_stats_record_pipeline(&pipe_state.stats);
+        return;
+    }
+
+    start = g_get_monotonic_time();
+    kp_readahead_execute(plan);
+    kp_readahead_plan_free(plan);
+    pipe_state.stats.io_ms = elapsed_ms(start);
+    pipe_state.stats.io_wait_ms = 0;
+    pipe_state.stats.io_plans++;
+    kp_stats_record_pipeline(&pipe_state.stats);
+}
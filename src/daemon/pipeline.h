@@ -0,0 +1,67 @@
+/* pipeline.h - Threaded scan/model/I-O pipeline for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <glib.h>
+#include "../monitor/proc.h"
+#include "../readahead/readahead.h"
+
+/**
+ * kp_pipeline_stats_t: Stage latencies of the last cycle
+ */
+typedef struct _kp_pipeline_stats_t
+{
+    gboolean threaded;      /* Scanner and I/O threads running */
+    double scan_ms;         /* Last /proc snapshot */
+    double model_ms;        /* Last spy update + first prediction slice */
+    double io_ms;           /* Last readahead plan read */
+    double io_wait_ms;      /* Time it waited for the I/O thread */
+    guint io_queued;        /* Plans handed over and not read yet */
+    gulong io_plans;        /* Plans read */
+    gulong io_dropped;      /* Plans dropped: I/O thread too far behind */
+} kp_pipeline_stats_t;
+
+/**
+ * Called on the main loop with a /proc snapshot (NULL if none was taken)
+ */
+typedef void (*kp_pipeline_scan_func)(kp_proc_snapshot_t *snap, gpointer data);
+
+/**
+ * Start the scanner and I/O threads if system.pipeline is set
+ *
+ * Without them (disabled, or thread creation failed), every stage runs
+ * inline on the main loop as before. Read once at startup.
+ */
+void kp_pipeline_start(void);
+
+/**
+ * Stop and join the threads; queued snapshots and plans are dropped
+ */
+void kp_pipeline_stop(void);
+
+/**
+ * Take a /proc snapshot and hand it to func on the main loop
+ *
+ * Threaded: returns at once, func runs when the scanner thread is done;
+ * while a scan is still in flight, this one is queued behind it (the
+ * latest request only). Otherwise: scans and calls func before returning.
+ */
+void kp_pipeline_scan(kp_pipeline_scan_func func, gpointer data);
+
+/**
+ * Read a readahead plan (takes ownership)
+ *
+ * Threaded: queued for the I/O thread. Otherwise: read before returning.
+ */
+void kp_pipeline_readahead(kp_readahead_plan_t *plan);
+
+#endif /* PIPELINE_H */
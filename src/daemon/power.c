@@ -0,0 +1,302 @@
+/* power.c - Power-aware preload policy for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Power Profiles
+ * =============================================================================
+ *
+ * Preloading trades disk and CPU time now for faster starts later. On AC
+ * that is cheap; on battery every cycle, every readahead worker and every
+ * spin-up of a rotating disk costs charge.
+ *
+ * Every cycle the power supply is read from sysfs and one of three
+ * profiles is applied:
+ *
+ *   Profile   When                                 Policy ([power] section)
+ *   ───────   ──────────────────────────────────   ──────────────────────────
+ *   ac        On mains/USB power, or no battery    [model]/[system] as set
+ *   battery   On battery, or platform_profile is   battery_cycle, _maxprocs,
+ *             low-power/quiet (platformprofile)    _budget, _idle
+ *   low       On battery at <= lowbattery charge   as battery, low_budget,
+ *                                                  never the idle tier
+ *
+ * - /sys/class/power_supply: a Mains or USB supply that is online means
+ *   AC; batteries with scope "Device" (mice, headsets) are ignored, the
+ *   others are averaged for the charge. Without any Mains supply listed,
+ *   a battery that is Discharging means battery
+ * - Cycle and maxprocs are written into kp_conf; the AC values are kept
+ *   here and restored when back on AC, or re-taken after a SIGHUP reload
+ * - The budget is asked for through kp_power_budget() by the prophet and
+ *   by kp_readahead_memavail(), which every replay (boot plan, cache
+ *   snapshot, rewarm, idle tier) uses; the idle tier also asks
+ *   kp_power_idle_allowed()
+ *
+ * The profile, battery charge and time spent in each profile go to the
+ * stats file.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "power.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "stats.h"
+
+#include <dirent.h>
+
+#define POWER_SUPPLY_DIR        "/sys/class/power_supply"
+#define PLATFORM_PROFILE_FILE   "/sys/firmware/acpi/platform_profile"
+
+typedef enum {
+    PROFILE_AC = 0,
+    PROFILE_BATTERY,
+    PROFILE_LOW
+} power_profile_t;
+
+static const char *profile_names[] = { "ac", "battery", "low" };
+
+static struct {
+    gboolean have_base;
+    int base_cycle;             /* kp_conf values for the ac profile */
+    int base_maxprocs;
+    power_profile_t profile;
+    gboolean picked;            /* profile set by a tick (the first is no switch) */
+    gint64 since;               /* g_get_monotonic_time() of the last tick */
+    char platform[32];
+    kp_power_stats_t stats;
+} power = { FALSE, 0, 0, PROFILE_AC, FALSE, 0, "none",
+            { FALSE, "ac", -1, "none", 0, 0, 0, 0 } };
+
+/**
+ * Read a sysfs attribute, stripped (FALSE if missing or unreadable)
+ */
+static gboolean
+read_attr(const char *dir, const char *name, char *buf, gsize len)
+{
+    char *path, *contents;
+    gboolean ok;
+
+    path = dir ? g_build_filename(dir, name, NULL) : g_strdup(name);
+    ok = g_file_get_contents(path, &contents, NULL, NULL);
+    g_free(path);
+    if (!ok)
+        return FALSE;
+
+    g_strlcpy(buf, g_strstrip(contents), len);
+    g_free(contents);
+    return TRUE;
+}
+
+/**
+ * Walk /sys/class/power_supply
+ *
+ * @param capacity Set to the mean charge of the system batteries, -1 if none
+ * @return TRUE when running on battery
+ */
+static gboolean
+read_power_supply(int *capacity)
+{
+    DIR *dir;
+    struct dirent *entry;
+    gboolean mains = FALSE, online = FALSE, discharging = FALSE;
+    int batteries = 0, charge = 0;
+
+    *capacity = -1;
+
+    dir = opendir(POWER_SUPPLY_DIR);
+    if (!dir)
+        return FALSE;
+
+    while ((entry = readdir(dir))) {
+        char *supply, type[32], value[32];
+
+        if (entry->d_name[0] == '.')
+            continue;
+
+        supply = g_build_filename(POWER_SUPPLY_DIR, entry->d_name, NULL);
+        if (!read_attr(supply, "type", type, sizeof(type))) {
+            g_free(supply);
+            continue;
+        }
+
+        if (strcmp(type, "Mains") == 0 || g_str_has_prefix(type, "USB")) {
+            mains = TRUE;
+            if (read_attr(supply, "online", value, sizeof(value)) &&
+                strcmp(value, "1") == 0)
+                online = TRUE;
+        } else if (strcmp(type, "Battery") == 0) {
+            /* Peripherals report their own batteries here too */
+            if (read_attr(supply, "scope", value, sizeof(value)) &&
+                strcmp(value, "Device") == 0) {
+                g_free(supply);
+                continue;
+            }
+            if (read_attr(supply, "capacity", value, sizeof(value))) {
+                charge += CLAMP(atoi(value), 0, 100);
+                batteries++;
+            }
+            if (read_attr(supply, "status", value, sizeof(value)) &&
+                strcmp(value, "Discharging") == 0)
+                discharging = TRUE;
+        }
+        g_free(supply);
+    }
+    closedir(dir);
+
+    if (batteries)
+        *capacity = charge / batteries;
+
+    /* No system battery: a desktop, whatever the supplies say */
+    if (!batteries && !discharging)
+        return FALSE;
+    return mains ? !online : discharging;
+}
+
+/**
+ * Pick the profile from the power supply and the platform profile
+ */
+static power_profile_t
+power_read(void)
+{
+    gboolean battery;
+    int capacity;
+
+    battery = read_power_supply(&capacity);
+    power.stats.capacity = capacity;
+
+    if (!read_attr(NULL, PLATFORM_PROFILE_FILE, power.platform, sizeof(power.platform)))
+        g_strlcpy(power.platform, "none", sizeof(power.platform));
+
+    if (battery && capacity >= 0 && capacity <= kp_conf->power.lowbattery)
+        return PROFILE_LOW;
+    if (battery)
+        return PROFILE_BATTERY;
+    if (kp_conf->power.platformprofile &&
+        (strcmp(power.platform, "low-power") == 0 ||
+         strcmp(power.platform, "quiet") == 0))
+        return PROFILE_BATTERY;
+    return PROFILE_AC;
+}
+
+/**
+ * Write the cycle and maxprocs of the current profile into kp_conf
+ */
+static void
+power_apply(void)
+{
+    kp_conf->model.cycle = power.base_cycle;
+    kp_conf->system.maxprocs = power.base_maxprocs;
+
+    if (power.profile == PROFILE_AC)
+        return;
+
+    if (kp_conf->power.battery_cycle > 0)
+        kp_conf->model.cycle = kp_conf->power.battery_cycle;
+    if (kp_conf->power.battery_maxprocs > 0)
+        kp_conf->system.maxprocs = kp_conf->power.battery_maxprocs;
+}
+
+/**
+ * Charge the time since the last tick to the profile that was in effect
+ */
+static void
+power_account(gint64 now)
+{
+    double elapsed;
+
+    if (power.since) {
+        elapsed = (now - power.since) / (double)G_USEC_PER_SEC;
+        switch (power.profile) {
+        case PROFILE_AC:      power.stats.ac_s += elapsed; break;
+        case PROFILE_BATTERY: power.stats.battery_s += elapsed; break;
+        case PROFILE_LOW:     power.stats.low_s += elapsed; break;
+        }
+    }
+    power.since = now;
+}
+
+/* ========================================================================
+ * PUBLIC API
+ * ======================================================================== */
+
+void
+kp_power_tick(void)
+{
+    power_profile_t profile = PROFILE_AC;
+
+    if (!power.have_base) {
+        power.base_cycle = kp_conf->model.cycle;
+        power.base_maxprocs = kp_conf->system.maxprocs;
+        power.have_base = TRUE;
+    }
+
+    power_account(g_get_monotonic_time());
+
+    power.stats.enabled = kp_conf->power.enable;
+    if (kp_conf->power.enable) {
+        profile = power_read();
+    } else {
+        power.stats.capacity = -1;
+        g_strlcpy(power.platform, "none", sizeof(power.platform));
+    }
+
+    if (!power.picked || profile != power.profile) {
+        if (power.stats.capacity >= 0)
+            g_message("power: %s profile (battery %d%%, platform profile %s)",
+                      profile_names[profile], power.stats.capacity, power.platform);
+        else
+            g_message("power: %s profile (platform profile %s)",
+                      profile_names[profile], power.platform);
+        if (power.picked)
+            power.stats.switches++;
+        power.profile = profile;
+        power.picked = TRUE;
+    }
+
+    power_apply();
+    power.stats.profile = profile_names[power.profile];
+    power.stats.platform = power.platform;
+    kp_stats_record_power(&power.stats);
+}
+
+void
+kp_power_reload(void)
+{
+    /* kp_conf now holds the file's values: they are the new AC values */
+    power.base_cycle = kp_conf->model.cycle;
+    power.base_maxprocs = kp_conf->system.maxprocs;
+    power.have_base = TRUE;
+
+    kp_power_tick();
+}
+
+long
+kp_power_budget(long memavail)
+{
+    int percent;
+
+    switch (power.profile) {
+    case PROFILE_BATTERY: percent = kp_conf->power.battery_budget; break;
+    case PROFILE_LOW:     percent = kp_conf->power.low_budget; break;
+    default:              return memavail;
+    }
+
+    if (percent < 100)
+        kp_debug("power: %s profile, budget %d%% of %ld KB",
+                 profile_names[power.profile], percent, memavail);
+    return memavail / 100 * percent;
+}
+
+gboolean
+kp_power_idle_allowed(void)
+{
+    return power.profile == PROFILE_AC ||
+           (power.profile == PROFILE_BATTERY && kp_conf->power.battery_idle);
+}
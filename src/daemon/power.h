@@ -0,0 +1,61 @@
+/* power.h - Power-aware preload policy for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef POWER_H
+#define POWER_H
+
+#include <glib.h>
+
+/**
+ * kp_power_stats_t: Current policy profile and time spent in each
+ */
+typedef struct _kp_power_stats_t
+{
+    gboolean enabled;           /* power.enable */
+    const char *profile;        /* "ac", "battery" or "low" */
+    int capacity;               /* Battery charge %, -1 without a battery */
+    const char *platform;       /* platform_profile, "none" if unavailable */
+    double ac_s;                /* Seconds spent in each profile */
+    double battery_s;
+    double low_s;
+    gulong switches;            /* Profile transitions since start */
+} kp_power_stats_t;
+
+/**
+ * Read the power supply and apply the matching profile
+ *
+ * Called at the start of every cycle. The cycle and maxprocs of the
+ * profile are written to kp_conf, so the rest of the daemon picks them
+ * up without knowing about profiles.
+ */
+void kp_power_tick(void);
+
+/**
+ * Take the new AC values from a reloaded configuration
+ *
+ * Called after a successful kp_config_load() on SIGHUP; the profile is
+ * re-applied on top of them at once.
+ */
+void kp_power_reload(void);
+
+/**
+ * Scale a preload budget by the current profile
+ *
+ * @param memavail Budget in kilobytes
+ * @return Budget in kilobytes, never larger than memavail
+ */
+long kp_power_budget(long memavail);
+
+/**
+ * May the idle-time tier run in the current profile?
+ */
+gboolean kp_power_idle_allowed(void);
+
+#endif /* POWER_H */
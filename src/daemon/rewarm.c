@@ -0,0 +1,321 @@
+/* rewarm.c - Resume/reclaim aware re-warming for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Re-warming After Resume and Reclaim
+ * =============================================================================
+ *
+ * Two events empty a large part of the page cache behind the daemon's back:
+ * resuming from suspend/hibernate, and a memory-hungry job (VM, build,
+ * large compile) pushing the cache out and then exiting. The normal cycle
+ * only notices gradually, and never re-reads the maps of apps that are
+ * already running - those refault one page at a time on next use.
+ *
+ * DETECTION (kp_rewarm_check, once per scan cycle):
+ *
+ *   RESUME:  CLOCK_BOOTTIME counts suspended time, CLOCK_MONOTONIC does
+ *            not. If (BOOTTIME - MONOTONIC) grew by ≥ REWARM_RESUME_MIN_SEC
+ *            since the last cycle, the machine was asleep.
+ *
+ *   RECLAIM: Cached fell sharply below its recent peak (last
+ *            REWARM_WINDOW cycles)  →  armed, remember MemAvailable
+ *            ... MemAvailable later climbs back by REWARM_RECOVER_PERCENT
+ *            of RAM (the hog exited)  →  fire, disarm
+ *
+ * RE-WARM (kp_rewarm_run, before the normal prediction):
+ *   1. maps of running exes        (they will refault first)
+ *   2. top maps of last prediction (lnprob < 0, highest first)
+ *   maps off local filesystems are left out (the probe below opens the
+ *   file on the main loop); the rest are probed with
+ *   kp_cachesnap_resident() - mostly resident maps are skipped - and
+ *   charged only for their missing bytes, until
+ *   min(system.rewarmmax, kp_readahead_memavail()) is used.
+ *   The batch is read through kp_readahead() at best-effort I/O priority 0
+ *   (inherited by the readahead workers), then the priority is restored.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "rewarm.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../monitor/proc.h"
+#include "../readahead/readahead.h"
+#include "../readahead/cachesnap.h"
+#include "../readahead/fsclass.h"
+
+#include <time.h>
+
+/* Clock gap that counts as a suspend (shorter gaps are timer jitter) */
+#define REWARM_RESUME_MIN_SEC 30
+
+/* Cycles of Cached history a drop is measured against */
+#define REWARM_WINDOW 3
+
+/* A drop arms reclaim detection if it is both this share of the recent
+ * peak and this share of total RAM */
+#define REWARM_DROP_PERCENT 25
+#define REWARM_DROP_MIN_PERCENT 5
+
+/* MemAvailable recovery (share of RAM) that fires an armed reclaim */
+#define REWARM_RECOVER_PERCENT 10
+
+/* Maps at least this resident are left alone */
+#define REWARM_RESIDENT_PERCENT 90
+
+typedef enum {
+    REWARM_NONE,
+    REWARM_RESUME,
+    REWARM_RECLAIM
+} rewarm_reason_t;
+
+static struct {
+    gboolean initialized;
+    double sleep_offset;            /* BOOTTIME - MONOTONIC, seconds */
+    int cached[REWARM_WINDOW];      /* Recent Cached samples (KB) */
+    int samples;                    /* Samples taken so far */
+    gboolean reclaim_armed;         /* Sharp drop seen, waiting for recovery */
+    int avail_low;                  /* Lowest MemAvailable while armed (KB) */
+    rewarm_reason_t pending;        /* Event to act on in kp_rewarm_run() */
+} rewarm_state = {0};
+
+/**
+ * Seconds spent suspended since boot: BOOTTIME - MONOTONIC
+ */
+static double
+sleep_offset(void)
+{
+    struct timespec boot, mono;
+
+    if (clock_gettime(CLOCK_BOOTTIME, &boot) < 0 ||
+        clock_gettime(CLOCK_MONOTONIC, &mono) < 0)
+        return rewarm_state.sleep_offset;
+
+    return (boot.tv_sec - mono.tv_sec) + (boot.tv_nsec - mono.tv_nsec) / 1e9;
+}
+
+/**
+ * MemAvailable, or an approximation on kernels that lack it
+ */
+static int
+mem_available(const kp_memory_t *mem)
+{
+    if (mem->available > 0)
+        return mem->available;
+    return mem->free + mem->buffers + mem->cached;
+}
+
+/**
+ * Feed one memory sample to the reclaim detector
+ * @return TRUE if an armed reclaim just recovered
+ */
+static gboolean
+reclaim_sample(const kp_memory_t *mem)
+{
+    int avail = mem_available(mem);
+    gboolean fired = FALSE;
+    int peak = 0;
+    int i, n;
+
+    if (mem->total <= 0)
+        return FALSE;
+
+    if (rewarm_state.reclaim_armed) {
+        if (avail < rewarm_state.avail_low)
+            rewarm_state.avail_low = avail;
+        if ((long)(avail - rewarm_state.avail_low) * 100 >=
+            (long)mem->total * REWARM_RECOVER_PERCENT) {
+            rewarm_state.reclaim_armed = FALSE;
+            fired = TRUE;
+        }
+    }
+
+    n = MIN(rewarm_state.samples, REWARM_WINDOW);
+    for (i = 0; i < n; i++)
+        peak = MAX(peak, rewarm_state.cached[i]);
+
+    if (!fired && !rewarm_state.reclaim_armed && peak > 0 &&
+        (long)(peak - mem->cached) * 100 >= (long)peak * REWARM_DROP_PERCENT &&
+        (long)(peak - mem->cached) * 100 >= (long)mem->total * REWARM_DROP_MIN_PERCENT) {
+        kp_debug("rewarm: page cache dropped %dkb -> %dkb, waiting for memory to recover",
+                 peak, mem->cached);
+        rewarm_state.reclaim_armed = TRUE;
+        rewarm_state.avail_low = avail;
+    }
+
+    rewarm_state.cached[rewarm_state.samples % REWARM_WINDOW] = mem->cached;
+    rewarm_state.samples++;
+    return fired;
+}
+
+/**
+ * Initialize re-warm detection
+ */
+void
+kp_rewarm_init(void)
+{
+    kp_memory_t mem;
+
+    memset(&rewarm_state, 0, sizeof(rewarm_state));
+    rewarm_state.sleep_offset = sleep_offset();
+
+    kp_proc_get_memstat(&mem);
+    reclaim_sample(&mem);
+
+    rewarm_state.initialized = TRUE;
+}
+
+/**
+ * Detect resume or a finished reclaim
+ */
+gboolean
+kp_rewarm_check(void)
+{
+    kp_memory_t mem;
+    double offset;
+    gboolean resumed;
+
+    if (!rewarm_state.initialized)
+        kp_rewarm_init();
+
+    offset = sleep_offset();
+    resumed = offset - rewarm_state.sleep_offset >= REWARM_RESUME_MIN_SEC;
+    if (resumed) {
+        g_message("rewarm: resumed after %.0f seconds of sleep",
+                  offset - rewarm_state.sleep_offset);
+        rewarm_state.pending = REWARM_RESUME;
+        /* Whatever was armed before the sleep is moot now; restart the
+         * drop history from the post-resume level */
+        rewarm_state.reclaim_armed = FALSE;
+        rewarm_state.samples = 0;
+    }
+    rewarm_state.sleep_offset = offset;
+
+    kp_proc_get_memstat(&mem);
+    if (reclaim_sample(&mem) && !resumed) {
+        g_message("rewarm: memory recovered after page-cache reclaim");
+        rewarm_state.pending = REWARM_RECLAIM;
+    }
+
+    if (!kp_conf->system.rewarm)
+        rewarm_state.pending = REWARM_NONE;
+
+    return rewarm_state.pending != REWARM_NONE;
+}
+
+/* Selection context for consider_map() */
+typedef struct {
+    GPtrArray *plan;        /* kp_map_t* to read */
+    GHashTable *seen;       /* kp_map_t* already considered */
+    long budget;            /* KB left */
+    int resident;           /* Maps skipped as resident */
+} rewarm_plan_t;
+
+/**
+ * Add a map to the plan unless it is resident, not local or does not fit
+ */
+static void
+consider_map(kp_map_t *map, rewarm_plan_t *rp)
+{
+    size_t resident;
+    long missing;
+
+    if (!map || !map->path || map->length == 0 || rp->budget <= 0)
+        return;
+    if (g_hash_table_contains(rp->seen, map))
+        return;
+    g_hash_table_add(rp->seen, map);
+
+    /* The residency probe opens the file: never on a remote server */
+    if (kp_fsclass_get(map->dev, map->path) != KP_FS_LOCAL)
+        return;
+
+    resident = kp_cachesnap_resident(map->path, map->offset, map->length);
+    if ((double)resident * 100 >= (double)map->length * REWARM_RESIDENT_PERCENT) {
+        rp->resident++;
+        return;
+    }
+
+    /* Resident pages cost no I/O; charge only what has to be read */
+    missing = (long)((map->length - MIN(resident, map->length) + 1023) / 1024);
+    if (missing > rp->budget)
+        return;
+
+    rp->budget -= missing;
+    g_ptr_array_add(rp->plan, map);
+}
+
+static void
+consider_exemap(gpointer data, gpointer user_data)
+{
+    consider_map(((kp_exemap_t *)data)->map, user_data);
+}
+
+/**
+ * Re-read evicted parts of running apps and top predicted maps
+ */
+int
+kp_rewarm_run(void)
+{
+    rewarm_plan_t rp;
+    GSList *l;
+    long budget;
+    int ioprio;
+    int count = 0;
+    guint i;
+
+    if (rewarm_state.pending == REWARM_NONE)
+        return 0;
+    rewarm_state.pending = REWARM_NONE;
+
+    if (!kp_state->maps_arr)
+        return 0;
+
+    budget = MIN((long)kp_conf->system.rewarmmax / 1024, kp_readahead_memavail());
+    if (budget <= 0) {
+        kp_debug("rewarm: no memory budget, skipping");
+        return 0;
+    }
+
+    rp.plan = g_ptr_array_new();
+    rp.seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+    rp.budget = budget;
+    rp.resident = 0;
+
+    /* Running apps first: they refault on their very next use */
+    for (l = kp_state->running_exes; l && rp.budget > 0; l = l->next) {
+        kp_exe_t *exe = l->data;
+        if (exe->exemaps)
+            g_set_foreach(exe->exemaps, consider_exemap, &rp);
+    }
+
+    /* Then the last prediction, in probability order */
+    for (i = 0; i < kp_state->maps_arr->len && rp.budget > 0; i++) {
+        kp_map_t *map = g_ptr_array_index(kp_state->maps_arr, i);
+        if (map->lnprob >= 0)
+            break;
+        consider_map(map, &rp);
+    }
+
+    if (rp.plan->len > 0) {
+        ioprio = kp_readahead_set_ioprio(KP_IOPRIO_CLASS_BE, 0);
+        count = kp_readahead((kp_map_t **)rp.plan->pdata, rp.plan->len);
+        kp_readahead_restore_ioprio(ioprio);
+    }
+
+    g_message("rewarm: %u maps re-read (%ldkb), %d still resident",
+              rp.plan->len, budget - rp.budget,
+              rp.resident);
+
+    g_hash_table_destroy(rp.seen);
+    g_ptr_array_free(rp.plan, TRUE);
+    return count;
+}
@@ -0,0 +1,34 @@
+/* rewarm.h - Resume/reclaim aware re-warming for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef REWARM_H
+#define REWARM_H
+
+#include <glib.h>
+
+/**
+ * Initialize re-warm detection (records clock and memory baselines)
+ */
+void kp_rewarm_init(void);
+
+/**
+ * Sample clocks and memory, detect resume or a finished reclaim
+ * Call once per scan cycle
+ * @return TRUE if a re-warm should run now
+ */
+gboolean kp_rewarm_check(void);
+
+/**
+ * Re-read the evicted parts of running apps and top predicted maps
+ * @return Number of readahead requests issued
+ */
+int kp_rewarm_run(void);
+
+#endif /* REWARM_H */
@@ -0,0 +1,372 @@
+/* scheduler.c - Coalescing timerfd task scheduler for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Task Scheduler
+ * =============================================================================
+ *
+ * The cycle halves and the autosave each used to arm their own GLib
+ * timeout, so an idle machine was woken at unrelated moments. Every wakeup
+ * keeps a laptop CPU out of its deep idle states a little longer.
+ *
+ * Here the periodic tasks share one timerfd. Each task has a due time and
+ * a slack, the time it may run late:
+ *
+ *   task A   due ├──────────┤ deadline          (slack 0: ├ only)
+ *   task B         due ├────────────────┤ deadline
+ *                      ▲
+ *                      wakeup = earliest deadline; every task already
+ *                      due by then (A and B) runs in the same wakeup
+ *
+ * - Tasks are kept in a min-heap on their deadline, so the next wakeup is
+ *   the heap top; one absolute timerfd_settime() arms it
+ * - The timer runs on CLOCK_BOOTTIME, which keeps counting during suspend:
+ *   an hour-long autosave is due an hour of wall time later, and whatever
+ *   fell due while suspended runs in one wakeup on resume
+ * - Without CLOCK_BOOTTIME the timerfd uses CLOCK_MONOTONIC; without a
+ *   timerfd at all the next wakeup is a GLib timeout
+ *
+ * Wakeups, tasks run and wakeups per hour go to the stats file.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "scheduler.h"
+#include "../utils/logging.h"
+#include "stats.h"
+
+#include <time.h>
+#include <sys/timerfd.h>
+
+typedef struct {
+    gint64 due;             /* µs on the scheduler clock */
+    gint64 deadline;        /* due + slack */
+    guint delay;            /* Seconds, to run again when func returns TRUE */
+    guint slack;
+    GSourceFunc func;
+    gpointer data;
+} sched_task_t;
+
+static struct {
+    gboolean started;
+    int fd;                 /* timerfd, -1 for the GLib fallback */
+    clockid_t clock;
+    guint watch;            /* Main loop source on fd */
+    guint fallback;         /* GLib timeout for the next wakeup, no timerfd */
+    GPtrArray *heap;        /* sched_task_t*, min-heap on deadline */
+    gint64 started_at;
+    kp_sched_stats_t stats;
+} sched = { FALSE, -1, CLOCK_MONOTONIC, 0, 0, NULL, 0, { "glib", 0, 0, 0, 0 } };
+
+/**
+ * Pick the clock and create the timer (once; tasks may be added before
+ * kp_sched_start, and their due times must be on the same clock)
+ */
+static void
+sched_init(void)
+{
+    if (sched.heap)
+        return;
+
+    sched.heap = g_ptr_array_new();
+    sched.clock = CLOCK_BOOTTIME;
+    sched.stats.clock = "boottime";
+    sched.fd = timerfd_create(CLOCK_BOOTTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (sched.fd < 0) {
+        /* Kernels before 2.6.39 */
+        sched.clock = CLOCK_MONOTONIC;
+        sched.stats.clock = "monotonic";
+        sched.fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    }
+    if (sched.fd < 0) {
+        g_warning("scheduler: no timerfd (%s), using GLib timeouts", strerror(errno));
+        sched.clock = CLOCK_MONOTONIC;
+        sched.stats.clock = "glib";
+    }
+}
+
+static gint64
+sched_now(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(sched.clock, &ts) < 0)
+        return g_get_monotonic_time();
+    return (gint64)ts.tv_sec * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+}
+
+/* ========================================================================
+ * MIN-HEAP ON DEADLINE
+ * ======================================================================== */
+
+#define heap_task(i) ((sched_task_t *)g_ptr_array_index(sched.heap, (i)))
+
+static void
+heap_swap(guint i, guint j)
+{
+    gpointer tmp = sched.heap->pdata[i];
+
+    sched.heap->pdata[i] = sched.heap->pdata[j];
+    sched.heap->pdata[j] = tmp;
+}
+
+static void
+heap_sift_up(guint i)
+{
+    while (i > 0) {
+        guint parent = (i - 1) / 2;
+
+        if (heap_task(parent)->deadline <= heap_task(i)->deadline)
+            break;
+        heap_swap(i, parent);
+        i = parent;
+    }
+}
+
+static void
+heap_sift_down(guint i)
+{
+    for (;;) {
+        guint left = 2 * i + 1, right = left + 1, least = i;
+
+        if (left < sched.heap->len &&
+            heap_task(left)->deadline < heap_task(least)->deadline)
+            least = left;
+        if (right < sched.heap->len &&
+            heap_task(right)->deadline < heap_task(least)->deadline)
+            least = right;
+        if (least == i)
+            break;
+        heap_swap(i, least);
+        i = least;
+    }
+}
+
+static void
+heap_push(sched_task_t *task)
+{
+    g_ptr_array_add(sched.heap, task);
+    heap_sift_up(sched.heap->len - 1);
+}
+
+static sched_task_t *
+heap_remove(guint i)
+{
+    sched_task_t *task = heap_task(i);
+    guint last = sched.heap->len - 1;
+
+    if (i != last) {
+        sched.heap->pdata[i] = sched.heap->pdata[last];
+        g_ptr_array_set_size(sched.heap, last);
+        heap_sift_up(i);
+        heap_sift_down(i);
+    } else {
+        g_ptr_array_set_size(sched.heap, last);
+    }
+    return task;
+}
+
+/* ========================================================================
+ * WAKEUPS
+ * ======================================================================== */
+
+static gboolean sched_fallback_fired(gpointer data);
+
+/**
+ * Arm the timer for the earliest deadline (or disarm it)
+ */
+static void
+sched_arm(void)
+{
+    gint64 deadline;
+
+    if (!sched.started)
+        return;
+
+    if (sched.fallback) {
+        g_source_remove(sched.fallback);
+        sched.fallback = 0;
+    }
+
+    if (sched.fd >= 0) {
+        struct itimerspec its;
+
+        memset(&its, 0, sizeof(its));
+        if (sched.heap->len) {
+            /* Absolute, so time spent here does not shift it; never 0,
+             * which would disarm */
+            deadline = MAX(heap_task(0)->deadline, 1);
+            its.it_value.tv_sec = deadline / G_USEC_PER_SEC;
+            its.it_value.tv_nsec = (deadline % G_USEC_PER_SEC) * 1000;
+        }
+        if (timerfd_settime(sched.fd, TFD_TIMER_ABSTIME, &its, NULL) < 0)
+            g_warning("scheduler: cannot arm timer: %s", strerror(errno));
+        return;
+    }
+
+    if (sched.heap->len) {
+        deadline = heap_task(0)->deadline - sched_now();
+        sched.fallback = g_timeout_add(MAX(deadline, 0) / 1000, sched_fallback_fired, NULL);
+    }
+}
+
+static gint
+task_due_compare(gconstpointer a, gconstpointer b)
+{
+    const sched_task_t *ta = *(sched_task_t * const *)a;
+    const sched_task_t *tb = *(sched_task_t * const *)b;
+
+    return ta->due < tb->due ? -1 : ta->due > tb->due ? 1 : 0;
+}
+
+/**
+ * Run every task that is due, in due order, then arm the next wakeup
+ */
+static void
+sched_run_due(void)
+{
+    GPtrArray *batch = g_ptr_array_new();
+    gint64 now = sched_now();
+    guint i;
+
+    /* The heap orders deadlines, not due times: look at every task, and
+     * start over after a removal reshuffles the heap (a handful of tasks) */
+    i = 0;
+    while (i < sched.heap->len) {
+        if (heap_task(i)->due <= now) {
+            g_ptr_array_add(batch, heap_remove(i));
+            i = 0;
+        } else {
+            i++;
+        }
+    }
+    g_ptr_array_sort(batch, task_due_compare);
+
+    if (batch->len) {
+        gint64 elapsed = now - sched.started_at;
+
+        sched.stats.wakeups++;
+        sched.stats.tasks += batch->len;
+        sched.stats.batched += batch->len - 1;
+        sched.stats.wakeups_per_hour = elapsed > 0 ?
+            sched.stats.wakeups * 3600.0 * G_USEC_PER_SEC / elapsed : 0;
+        if (batch->len > 1)
+            kp_debug("scheduler: %u tasks in one wakeup", batch->len);
+        kp_stats_record_sched(&sched.stats);
+    }
+
+    for (i = 0; i < batch->len; i++) {
+        sched_task_t *task = g_ptr_array_index(batch, i);
+
+        if (task->func(task->data)) {
+            task->due = sched_now() + (gint64)task->delay * G_USEC_PER_SEC;
+            task->deadline = task->due + (gint64)task->slack * G_USEC_PER_SEC;
+            heap_push(task);
+        } else {
+            g_slice_free(sched_task_t, task);
+        }
+    }
+    g_ptr_array_free(batch, TRUE);
+
+    sched_arm();
+}
+
+static gboolean
+sched_timer_fired(GIOChannel G_GNUC_UNUSED *source, GIOCondition G_GNUC_UNUSED condition,
+                  gpointer G_GNUC_UNUSED data)
+{
+    guint64 expirations;
+    ssize_t n G_GNUC_UNUSED;
+
+    n = read(sched.fd, &expirations, sizeof(expirations));
+    sched_run_due();
+    return TRUE;
+}
+
+static gboolean
+sched_fallback_fired(gpointer G_GNUC_UNUSED data)
+{
+    sched.fallback = 0;
+    sched_run_due();
+    return FALSE;
+}
+
+/* ========================================================================
+ * PUBLIC API
+ * ======================================================================== */
+
+void
+kp_sched_start(void)
+{
+    GIOChannel *channel;
+
+    if (sched.started)
+        return;
+
+    sched_init();
+    if (sched.fd >= 0) {
+        channel = g_io_channel_unix_new(sched.fd);
+        sched.watch = g_io_add_watch(channel, G_IO_IN, sched_timer_fired, NULL);
+        g_io_channel_unref(channel);
+    }
+
+    sched.started = TRUE;
+    sched.started_at = sched_now();
+    kp_stats_record_sched(&sched.stats);
+    sched_arm();
+    kp_debug("scheduler: started on %s clock", sched.stats.clock);
+}
+
+void
+kp_sched_stop(void)
+{
+    if (sched.watch) {
+        g_source_remove(sched.watch);
+        sched.watch = 0;
+    }
+    if (sched.fallback) {
+        g_source_remove(sched.fallback);
+        sched.fallback = 0;
+    }
+    if (sched.fd >= 0) {
+        close(sched.fd);
+        sched.fd = -1;
+    }
+    if (sched.heap) {
+        for (guint i = 0; i < sched.heap->len; i++)
+            g_slice_free(sched_task_t, heap_task(i));
+        g_ptr_array_free(sched.heap, TRUE);
+        sched.heap = NULL;
+    }
+    sched.started = FALSE;
+}
+
+void
+kp_sched_add(guint delay, guint slack, GSourceFunc func, gpointer data)
+{
+    sched_task_t *task;
+
+    g_return_if_fail(func);
+
+    sched_init();
+
+    task = g_slice_new(sched_task_t);
+    task->delay = delay;
+    task->slack = slack;
+    task->func = func;
+    task->data = data;
+    task->due = sched_now() + (gint64)delay * G_USEC_PER_SEC;
+    task->deadline = task->due + (gint64)slack * G_USEC_PER_SEC;
+    heap_push(task);
+
+    /* Only a new earliest deadline moves the wakeup */
+    if (heap_task(0) == task)
+        sched_arm();
+}
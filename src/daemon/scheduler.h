@@ -0,0 +1,53 @@
+/* scheduler.h - Coalescing timerfd task scheduler for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <glib.h>
+
+/**
+ * kp_sched_stats_t: Wakeup counters since the scheduler started
+ */
+typedef struct _kp_sched_stats_t
+{
+    const char *clock;          /* "boottime", "monotonic" or "glib" */
+    gulong wakeups;             /* Timer expirations that ran tasks */
+    gulong tasks;               /* Tasks run */
+    gulong batched;             /* ...that shared a wakeup with an earlier one */
+    double wakeups_per_hour;
+} kp_sched_stats_t;
+
+/**
+ * Start the scheduler on the default main context
+ *
+ * Tasks added before are armed now. Without a timerfd the scheduler
+ * falls back to a GLib timeout for the next wakeup.
+ */
+void kp_sched_start(void);
+
+/**
+ * Stop the scheduler and drop all tasks
+ */
+void kp_sched_stop(void);
+
+/**
+ * Run func on the main loop after delay seconds
+ *
+ * The task may run up to slack seconds late, so that tasks due close to
+ * each other share one wakeup. If func returns TRUE it runs again delay
+ * seconds later, like a GLib timeout.
+ *
+ * @param delay Seconds from now (0 = right away)
+ * @param slack Seconds the task may be delayed to join another wakeup
+ */
+void kp_sched_add(guint delay, guint slack, GSourceFunc func, gpointer data);
+
+#endif /* SCHEDULER_H */
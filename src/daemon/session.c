@@ -30,6 +30,10 @@
  *   │   ↓ Window closes, normal prediction resumes                │
  *   └─────────────────────────────────────────────────────────────┘
  *
+ * BOOT PLAN:
+ *   If a precompiled boot plan was loaded at startup (see bootplan.c),
+ *   it is replayed once when the window opens instead of the steps above.
+ *
  * TOP APP SELECTION:
  *   Apps are ranked by total running time (exe->time). Applications
  *   with more usage history are assumed to be more important to the user.
@@ -48,6 +52,7 @@
 #include "../config/config.h"
 #include "../state/state.h"
 #include "../predict/prophet.h"
+#include "../readahead/bootplan.h"
 
 #include <sys/stat.h>
 #include <dirent.h>
@@ -59,14 +64,12 @@
 #define SESSION_MEMORY_THRESHOLD 20   /* 20% minimum free */
 
 /**
- * Load a single file as a map for an exe
+ * Load a single file (its loaded ELF ranges) as maps for an exe
  */
 static gboolean
 load_single_map(kp_exe_t *exe, const char *path)
 {
     struct stat st;
-    kp_map_t *map;
-    kp_exemap_t *exemap;
     
     if (stat(path, &st) < 0)
         return FALSE;
@@ -74,20 +77,8 @@ load_single_map(kp_exe_t *exe, const char *path)
     if ((size_t)st.st_size < (size_t)kp_conf->model.minsize)
         return FALSE;
     
-    map = kp_map_new(path, 0, st.st_size);
-    if (!map)
-        return FALSE;
-    
-    exemap = kp_exe_map_new(exe, map);
-    if (!exemap) {
-        kp_map_free(map);
-        return FALSE;
-    }
-    
-    exemap->prob = 1.0;
-    exe->size += st.st_size;
-    
-    return TRUE;
+    /* kp_exe_map_new() already accounts the maps in exe->size */
+    return kp_exe_map_file(exe, path, st.st_size) > 0;
 }
 
 /**
@@ -107,7 +98,7 @@ load_maps_for_session_app(kp_exe_t *exe)
     /* Load main binary */
     if (load_single_map(exe, exe->path)) {
         loaded++;
-        g_debug("Session: loaded binary %s", exe->path);
+        kp_debug("Session: loaded binary %s", exe->path);
     }
     
     /* Scan and load shared libraries */
@@ -140,6 +131,7 @@ static struct {
     int max_apps;
     uid_t target_uid;
     gboolean preload_done;
+    gboolean plan_replayed;     /* Boot plan already replayed for this login */
 } session_state = {0};
 
 /**
@@ -224,7 +216,7 @@ check_memory_available(void)
     int percent_available = (int)((mem_available * 100) / mem_total);
 
     if (percent_available < SESSION_MEMORY_THRESHOLD) {
-        g_debug("Session preload: low memory (%d%% available), skipping", percent_available);
+        kp_debug("Session preload: low memory (%d%% available), skipping", percent_available);
         return FALSE;
     }
 
@@ -267,7 +259,7 @@ kp_session_init(void)
         }
     }
 
-    g_debug("Session detection initialized for UID %d", session_state.target_uid);
+    kp_debug("Session detection initialized for UID %d", session_state.target_uid);
 }
 
 /**
@@ -418,7 +410,18 @@ kp_session_preload_top_apps(int max_apps)
     int maps_loaded = 0;
 
     if (!check_memory_available()) {
-        g_debug("Session preload: skipping due to memory constraints");
+        kp_debug("Session preload: skipping due to memory constraints");
+        return;
+    }
+
+    /* The boot plan already holds the top apps' ranges in block order.
+     * Replaying it once beats re-deriving them on a cold disk. */
+    if (kp_bootplan_available()) {
+        if (!session_state.plan_replayed) {
+            session_state.plan_replayed = TRUE;
+            if (kp_bootplan_replay() > 0)
+                g_message("Session preload: replayed boot plan");
+        }
         return;
     }
 
@@ -440,8 +443,8 @@ kp_session_preload_top_apps(int max_apps)
         exe->lnprob = -15.0;  /* Very high priority */
         preloaded++;
 
-        g_debug("Session preload: boosting %s (usage: %d sec, maps: %u)",
-                exe->path, exe->time, g_set_size(exe->exemaps));
+        kp_debug("Session preload: boosting %s (usage: %d sec, maps: %u)",
+                 exe->path, exe->time, g_set_size(exe->exemaps));
     }
 
     g_ptr_array_free(top_apps, TRUE);
@@ -461,4 +464,5 @@ kp_session_free(void)
     session_state.initialized = FALSE;
     session_state.session_detected = FALSE;
     session_state.preload_done = FALSE;
+    session_state.plan_replayed = FALSE;
 }
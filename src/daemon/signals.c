@@ -43,9 +43,14 @@
 #include "../config/config.h"
 #include "../config/blacklist.h"
 #include "stats.h"
+#include "power.h"
+#include "../predict/prophet.h"
 
 #include <signal.h>
 
+/* Retry interval for a SIGHUP deferred behind a prediction in flight */
+#define SIGHUP_RETRY_MS 100
+
 /* External references from main.c */
 extern const char *conffile;
 extern const char *statefile;
@@ -71,6 +76,8 @@ static volatile sig_atomic_t state_saving = 0;  /* B004: Defer SIGHUP during sav
  * 
  * B002 FIX: Uses atomic flags to prevent multiple queued handlers
  * B004 FIX: Defers SIGHUP if state save is in progress
+ * SIGHUP also waits for a prediction in flight, which reads the
+ * configuration and the model between main loop slices
  */
 static gboolean
 sig_handler_sync(gpointer data)
@@ -78,13 +85,20 @@ sig_handler_sync(gpointer data)
     (void)data;  /* Unused - we check atomic flags instead */
 
     /* B004: If saving state, defer SIGHUP processing */
-    if (pending_sighup && !state_saving) {
+    if (pending_sighup && !state_saving && !kp_prophet_busy()) {
+        unsigned int generation = kp_config_generation();
+
         pending_sighup = 0;
         g_message("SIGHUP received - reloading configuration");
         kp_config_load(conffile, FALSE);
+        /* Only a load that went through replaced the profile's values */
+        if (kp_config_generation() != generation)
+            kp_power_reload();
         kp_blacklist_reload();
         kp_state_register_manual_apps();
         kp_log_reopen(logfile);
+    } else if (pending_sighup && !state_saving) {
+        g_timeout_add(SIGHUP_RETRY_MS, sig_handler_sync, NULL);
     }
 
     if (pending_sigusr1) {
@@ -175,5 +189,5 @@ kp_signals_init(void)
     sa.sa_flags = SA_NOCLDWAIT;
     sigaction(SIGCHLD, &sa, NULL);
 
-    g_debug("Signal handlers installed (using sigaction)");
+    kp_debug("Signal handlers installed (using sigaction)");
 }
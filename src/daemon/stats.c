@@ -18,6 +18,14 @@
  *   - hits: Apps that were preloaded when launched (success!)
  *   - misses: Apps that were NOT preloaded when launched
  *   - hit_rate: hits / (hits + misses) × 100%
+ *   - shared_maps_last: Multi-app maps in the last preload plan
+ *   - predict_*: Main loop slices and CPU time of the last prediction
+ *   - budget_*: Budget model inputs (refault rates, MemAvailable) and budget
+ *   - reclaim_*: Mispredicted preloads dropped under memory pressure
+ *   - pin_state, pinned_*: Pinned (mlocked) tier size and residency
+ *   - pipeline_*: Stage latencies of the scan/model/I-O pipeline
+ *   - sched_*: Timer wakeups of the task scheduler (per hour)
+ *   - power_*: Power profile (AC/battery/low) and time spent in each
  *   - top_apps: Most frequently launched applications
  *
  * OUTPUT FORMAT (/run/preheat.stats):
@@ -49,6 +57,11 @@
 #include "../config/config.h"
 #include "../utils/pattern.h"
 #include "../utils/desktop.h"
+#include "../config/blacklist.h"
+#include "../predict/budget.h"
+#include "pipeline.h"
+#include "scheduler.h"
+#include "power.h"
 
 #include <libgen.h>
 
@@ -61,6 +74,15 @@ typedef struct {
     char *reason;  /* Why in this pool (for debugging) */
 } app_pool_info_t;
 
+/* GDestroyNotify for app_pools values */
+static void
+app_pool_info_free(gpointer data)
+{
+    app_pool_info_t *info = data;
+    g_free(info->reason);
+    g_free(info);
+}
+
 /* Global statistics state */
 static struct {
     gboolean initialized;
@@ -72,6 +94,40 @@ static struct {
     unsigned long misses;
     unsigned long memory_pressure_events;
 
+    /* Shared-map scoring (prophet) */
+    int shared_maps_last;
+    size_t shared_bytes_last;
+    unsigned long long shared_bytes_total;
+
+    /* Time-sliced prediction (prophet) */
+    int predict_slices_last;
+    int predict_slices_max;
+    double predict_cpu_ms;
+    double predict_wall_ms;
+
+    /* Budget model (prophet), budget.budget after the cgroup cap */
+    kp_budget_model_t budget;
+
+    /* Reclaim of mispredicted preloads */
+    unsigned long reclaim_events;
+    unsigned long reclaim_ranges;
+    unsigned long long reclaim_bytes;
+
+    /* Pinned tier */
+    const char *pin_state;      /* Static string */
+    int pinned_apps;
+    size_t pinned_bytes;
+    size_t pinned_resident_bytes;
+
+    /* Cycle pipeline */
+    kp_pipeline_stats_t pipeline;
+
+    /* Task scheduler */
+    kp_sched_stats_t sched;
+
+    /* Power profile */
+    kp_power_stats_t power;
+
     /* Per-app tracking (simple hash) */
     GHashTable *app_launches;   /* app_name -> launch_count */
     GHashTable *preload_times;  /* app_name -> preload_timestamp (time_t) */
@@ -92,6 +148,7 @@ kp_stats_init(void)
     stats.preloads_total = 0;
     stats.hits = 0;
     stats.misses = 0;
+    stats.budget = *kp_budget_model();
 
     /* Use configured window or default to 1 hour */
     extern kp_conf_t kp_conf[1];
@@ -102,14 +159,51 @@ kp_stats_init(void)
 
     stats.app_launches = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
     stats.preload_times = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
-    stats.app_pools = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, 
-                                             (GDestroyNotify)g_free);
+    stats.app_pools = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                             app_pool_info_free);
 
-    g_debug("Statistics subsystem initialized");
+    kp_debug("Statistics subsystem initialized");
 }
 
-/* Forward declaration */
-static pool_type_t classify_app_pool(const char *app_path, char **reason_out);
+/* Forward declarations */
+static pool_type_t classify_canonical_path(const char *check_path, char **reason_out);
+static char *canonicalize_app_path(const char *app_path);
+
+/**
+ * Refresh an exe's cached decisions if they are stale
+ *
+ * Pool class, reason, canonical path and blacklist flag are recomputed
+ * only when the config generation (config load, SIGHUP, blacklist reload)
+ * or the desktop index generation moved since they were last computed.
+ * The common case is two integer compares: no allocation, no realpath(),
+ * no desktop lookup, no pattern matching.
+ *
+ * Note that a symlink retargeted behind our back (e.g. update-alternatives)
+ * is only picked up on the next generation bump.
+ */
+void
+kp_stats_refresh_exe(kp_exe_t *exe)
+{
+    unsigned int gen = kp_config_generation();
+    unsigned int desktop_gen = kp_desktop_generation();
+
+    if (exe->decision_gen == gen && exe->desktop_gen == desktop_gen)
+        return;
+
+    g_free(exe->canonical_path);
+    exe->canonical_path = canonicalize_app_path(exe->path);
+
+    g_free(exe->class_reason);
+    exe->class_reason = NULL;
+    exe->class_pool = classify_canonical_path(
+        exe->canonical_path ? exe->canonical_path : exe->path,
+        &exe->class_reason);
+
+    exe->blacklisted = kp_blacklist_contains(exe->path);
+
+    exe->decision_gen = gen;
+    exe->desktop_gen = desktop_gen;
+}
 
 /**
  * Reclassify callback for g_hash_table_foreach
@@ -118,27 +212,23 @@ static void
 reclassify_one_exe(gpointer key, gpointer value, gpointer user_data)
 {
     kp_exe_t *exe = (kp_exe_t *)value;
-    char *reason = NULL;
     pool_type_t old_pool = exe->pool;
-    pool_type_t new_pool;
     
     (void)key;      /* Unused */
     (void)user_data; /* Unused */
     
-    /* Reclassify using current logic */
-    new_pool = classify_app_pool(exe->path, &reason);
+    /* Reclassify using current logic (cached per generation) */
+    kp_stats_refresh_exe(exe);
     
     /* Update if changed */
-    if (new_pool != old_pool) {
-        exe->pool = new_pool;
+    if (exe->class_pool != old_pool) {
+        exe->pool = exe->class_pool;
         g_message("Reclassified %s: %s → %s (reason: %s)",
                   exe->path,
                   old_pool == POOL_PRIORITY ? "priority" : "observation",
-                  new_pool == POOL_PRIORITY ? "priority" : "observation",
-                  reason ? reason : "unknown");
+                  exe->pool == POOL_PRIORITY ? "priority" : "observation",
+                  exe->class_reason ? exe->class_reason : "unknown");
     }
-    
-    g_free(reason);
 }
 
 /**
@@ -207,44 +297,65 @@ is_manual_app(const char *app_path)
 }
 
 /**
- * Classify application into appropriate pool
+ * Resolve an app path to the form used for classification
  *
- * Priority order (highest to lowest):
- * 1. Manual apps list → POOL_PRIORITY
- * 2. Has .desktop file → POOL_PRIORITY  
- * 3. Matches excluded pattern → POOL_OBSERVATION
- * 4. In user app directory → POOL_PRIORITY
- * 5. Default → POOL_OBSERVATION
+ * Converts file:// URIs to plain paths and resolves symlinks so desktop
+ * and manual-list matching see the real binary.
+ *
+ * @return Newly allocated canonical path, or NULL if it equals app_path
+ *         (or cannot be resolved)
  */
-static pool_type_t
-classify_app_pool(const char *app_path, char **reason_out)
+static char *
+canonicalize_app_path(const char *app_path)
 {
-    extern kp_conf_t kp_conf[1];
     char *plain_path = NULL;
-    char *canonical_path = NULL;
     const char *check_path = app_path;
-    pool_type_t result;
+    char *result = NULL;
     char resolved[PATH_MAX];
-    
+
+    if (!app_path)
+        return NULL;
+
     /* Convert file:// URI to plain path if needed */
-    if (app_path && g_str_has_prefix(app_path, "file://")) {
+    if (g_str_has_prefix(app_path, "file://")) {
         plain_path = g_filename_from_uri(app_path, NULL, NULL);
         if (plain_path) {
             check_path = plain_path;
         }
     }
-    
+
     /* Resolve symlinks to canonical path for desktop matching */
-    if (check_path && realpath(check_path, resolved)) {
-        canonical_path = g_strdup(resolved);
-        check_path = canonical_path;
+    if (realpath(check_path, resolved)) {
+        if (strcmp(resolved, app_path) != 0)
+            result = g_strdup(resolved);
+    } else if (plain_path) {
+        result = plain_path;
+        plain_path = NULL;
     }
+
+    g_free(plain_path);
+    return result;
+}
+
+/**
+ * Classify an already canonicalized path into the appropriate pool
+ *
+ * Priority order (highest to lowest):
+ * 1. Manual apps list → POOL_PRIORITY
+ * 2. Has .desktop file → POOL_PRIORITY  
+ * 3. Matches excluded pattern → POOL_OBSERVATION
+ * 4. In user app directory → POOL_PRIORITY
+ * 5. Default → POOL_OBSERVATION
+ */
+static pool_type_t
+classify_canonical_path(const char *check_path, char **reason_out)
+{
+    extern kp_conf_t kp_conf[1];
     
     /* Priority 1: Manual apps list (highest priority) */
     if (is_manual_app(check_path)) {
         if (reason_out) *reason_out = g_strdup("manual list");
-        result = POOL_PRIORITY;
-        goto cleanup;
+        return POOL_PRIORITY;
     }
     
     /* Priority 2: Has .desktop file */
@@ -254,39 +365,102 @@ classify_app_pool(const char *app_path, char **reason_out)
             *reason_out = g_strdup_printf(".desktop (%s)", 
                                            app_name ? app_name : "unknown");
         }
-        result = POOL_PRIORITY;
-        goto cleanup;
+        return POOL_PRIORITY;
     }
 
-    
-    /* Priority 3: Excluded pattern check */
-    if (kp_pattern_matches_any(check_path,
-                                kp_conf->system.excluded_patterns_list,
-                                kp_conf->system.excluded_patterns_count)) {
+    /* Priority 3+4: Excluded patterns, then user app paths.
+     * Both lists are compiled into one matcher at config load; exclusion
+     * rules are inserted first so they still take precedence. */
+    switch (kp_path_matcher_match(kp_conf->system.pool_matcher, check_path, -1)) {
+    case POOL_OBSERVATION:
         if (reason_out) *reason_out = g_strdup("excluded pattern");
-        result = POOL_OBSERVATION;
-        goto cleanup;
-    }
-    
-    /* Priority 4: User app path check */
-    if (kp_path_in_directories(check_path,
-                                 kp_conf->system.user_app_paths_list,
-                                 kp_conf->system.user_app_paths_count)) {
+        return POOL_OBSERVATION;
+    case POOL_PRIORITY:
         if (reason_out) *reason_out = g_strdup("user app directory");
-        result = POOL_PRIORITY;
-        goto cleanup;
+        return POOL_PRIORITY;
+    default:
+        break;
     }
     
     /* Default: Observation pool */
     if (reason_out) *reason_out = g_strdup("default (no match)");
-    result = POOL_OBSERVATION;
-    
-cleanup:
-    g_free(plain_path);
+    return POOL_OBSERVATION;
+}
+
+/**
+ * Classify application into appropriate pool
+ *
+ * Uncached variant for paths that are not (yet) tracked exes; tracked
+ * exes go through kp_stats_refresh_exe() instead.
+ */
+static pool_type_t
+classify_app_pool(const char *app_path, char **reason_out)
+{
+    char *canonical_path = canonicalize_app_path(app_path);
+    pool_type_t result;
+
+    result = classify_canonical_path(canonical_path ? canonical_path : app_path,
+                                     reason_out);
     g_free(canonical_path);
     return result;
 }
 
+/**
+ * Look up the pool of a launched app
+ *
+ * Tracked exes answer from their cached decision; anything else falls
+ * back to a full classification.
+ *
+ * @param app_path   Path of the app
+ * @param reason_out Output: reason (borrowed if *owned_out is NULL)
+ * @param owned_out  Output: allocated reason the caller must free, or NULL
+ */
+static pool_type_t
+lookup_app_pool(const char *app_path, const char **reason_out, char **owned_out)
+{
+    extern kp_state_t kp_state[1];
+    kp_exe_t *exe = NULL;
+    pool_type_t pool;
+
+    *owned_out = NULL;
+
+    if (kp_state->exes && app_path)
+        exe = g_hash_table_lookup(kp_state->exes, app_path);
+
+    if (exe) {
+        kp_stats_refresh_exe(exe);
+        *reason_out = exe->class_reason;
+        return exe->class_pool;
+    }
+
+    pool = classify_app_pool(app_path, owned_out);
+    *reason_out = *owned_out;
+    return pool;
+}
+
+/**
+ * Remember the pool an app was last seen in (for top-apps output)
+ *
+ * Updates the existing entry in place, so repeated launches of the same
+ * app only allocate when its classification actually changes.
+ */
+static void
+note_app_pool(const char *name, pool_type_t pool, const char *reason)
+{
+    app_pool_info_t *pool_info = g_hash_table_lookup(stats.app_pools, name);
+
+    if (!pool_info) {
+        pool_info = g_new0(app_pool_info_t, 1);
+        g_hash_table_insert(stats.app_pools, g_strdup(name), pool_info);
+    } else if (pool_info->pool == pool && g_strcmp0(pool_info->reason, reason) == 0) {
+        return;
+    }
+
+    pool_info->pool = pool;
+    g_free(pool_info->reason);
+    pool_info->reason = g_strdup(reason);
+}
+
 /**
  * Record a preload event
  */
@@ -304,7 +478,7 @@ kp_stats_record_preload(const char *app_path)
     time_t now = time(NULL);
     g_hash_table_replace(stats.preload_times, g_strdup(name), GSIZE_TO_POINTER((gsize)now));
     
-    g_debug("Stats: Preloaded %s at time %ld", name, (long)now);
+    kp_debug("Stats: Preloaded %s at time %ld", name, (long)now);
 }
 
 /**
@@ -316,20 +490,17 @@ kp_stats_record_hit(const char *app_path)
     const char *name;
     gpointer count;
     pool_type_t pool;
-    char *reason = NULL;
-    app_pool_info_t *pool_info;
+    const char *reason;
+    char *owned_reason;
 
     if (!stats.initialized) return;
 
     name = get_app_name(app_path);
-    pool = classify_app_pool(app_path, &reason);
+    pool = lookup_app_pool(app_path, &reason, &owned_reason);
     stats.hits++;
 
     /* Track pool classification */
-    pool_info = g_new0(app_pool_info_t, 1);
-    pool_info->pool = pool;
-    pool_info->reason = reason;  /* Takes ownership */
-    g_hash_table_replace(stats.app_pools, g_strdup(name), pool_info);
+    note_app_pool(name, pool, reason);
 
     /* Increment launch count */
     count = g_hash_table_lookup(stats.app_launches, name);
@@ -337,10 +508,12 @@ kp_stats_record_hit(const char *app_path)
                          GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
 
     if (pool == POOL_PRIORITY) {
-        g_debug("Stats: HIT for %s (priority pool: %s)", name, reason ? reason : "unknown");
+        kp_debug("Stats: HIT for %s (priority pool: %s)", name, reason ? reason : "unknown");
     } else {
-        g_debug("Stats: HIT for %s (observation pool: %s)", name, reason ? reason : "unknown");
+        kp_debug("Stats: HIT for %s (observation pool: %s)", name, reason ? reason : "unknown");
     }
+
+    g_free(owned_reason);
 }
 
 /**
@@ -352,20 +525,17 @@ kp_stats_record_miss(const char *app_path)
     const char *name;
     gpointer count;
     pool_type_t pool;
-    char *reason = NULL;
-    app_pool_info_t *pool_info;
+    const char *reason;
+    char *owned_reason;
 
     if (!stats.initialized) return;
 
     name = get_app_name(app_path);
-    pool = classify_app_pool(app_path, &reason);
+    pool = lookup_app_pool(app_path, &reason, &owned_reason);
     stats.misses++;
 
     /* Track pool classification */
-    pool_info = g_new0(app_pool_info_t, 1);
-    pool_info->pool = pool;
-    pool_info->reason = reason;  /* Takes ownership */
-    g_hash_table_replace(stats.app_pools, g_strdup(name), pool_info);
+    note_app_pool(name, pool, reason);
 
     /* Increment launch count */
     count = g_hash_table_lookup(stats.app_launches, name);
@@ -373,10 +543,12 @@ kp_stats_record_miss(const char *app_path)
                          GINT_TO_POINTER(GPOINTER_TO_INT(count) + 1));
 
     if (pool == POOL_PRIORITY) {
-        g_debug("Stats: MISS for %s (priority pool: %s)", name, reason ? reason : "unknown");
+        kp_debug("Stats: MISS for %s (priority pool: %s)", name, reason ? reason : "unknown");
     } else {
-        g_debug("Stats: MISS for %s (observation pool: %s)", name, reason ? reason : "unknown");
+        kp_debug("Stats: MISS for %s (observation pool: %s)", name, reason ? reason : "unknown");
     }
+
+    g_free(owned_reason);
 }
 
 /**
@@ -466,6 +638,50 @@ kp_stats_get_summary(kp_stats_summary_t *summary)
     summary->observation_pool_count = 0;
     summary->total_preloaded_bytes = 0;
     summary->memory_pressure_events = stats.memory_pressure_events;
+    summary->shared_maps_last = stats.shared_maps_last;
+    summary->shared_bytes_last = stats.shared_bytes_last;
+    summary->shared_bytes_total = stats.shared_bytes_total;
+    summary->predict_slices_last = stats.predict_slices_last;
+    summary->predict_slices_max = stats.predict_slices_max;
+    summary->predict_cpu_ms = stats.predict_cpu_ms;
+    summary->predict_wall_ms = stats.predict_wall_ms;
+    summary->budget_state = kp_budget_state_name(stats.budget.state);
+    summary->budget_factor = stats.budget.factor;
+    summary->budget_base_kb = stats.budget.base;
+    summary->budget_kb = stats.budget.budget;
+    summary->budget_available_kb = stats.budget.available;
+    summary->budget_inactive_kb = stats.budget.inactive_file;
+    summary->budget_refault_kbps = stats.budget.refault_rate;
+    summary->budget_activate_kbps = stats.budget.activate_rate;
+    summary->budget_steal_kbps = stats.budget.steal_rate;
+    summary->reclaim_events = stats.reclaim_events;
+    summary->reclaim_ranges = stats.reclaim_ranges;
+    summary->reclaim_bytes = stats.reclaim_bytes;
+    summary->pin_state = stats.pin_state ? stats.pin_state : "off";
+    summary->pinned_apps = stats.pinned_apps;
+    summary->pinned_bytes = stats.pinned_bytes;
+    summary->pinned_resident_bytes = stats.pinned_resident_bytes;
+    summary->pipeline_threaded = stats.pipeline.threaded;
+    summary->pipeline_scan_ms = stats.pipeline.scan_ms;
+    summary->pipeline_model_ms = stats.pipeline.model_ms;
+    summary->pipeline_io_ms = stats.pipeline.io_ms;
+    summary->pipeline_io_wait_ms = stats.pipeline.io_wait_ms;
+    summary->pipeline_io_queued = stats.pipeline.io_queued;
+    summary->pipeline_io_plans = stats.pipeline.io_plans;
+    summary->pipeline_io_dropped = stats.pipeline.io_dropped;
+    summary->sched_clock = stats.sched.clock ? stats.sched.clock : "glib";
+    summary->sched_wakeups = stats.sched.wakeups;
+    summary->sched_tasks = stats.sched.tasks;
+    summary->sched_batched = stats.sched.batched;
+    summary->sched_wakeups_per_hour = stats.sched.wakeups_per_hour;
+    summary->power_profile = !stats.power.enabled ? "off" :
+                             stats.power.profile ? stats.power.profile : "ac";
+    summary->power_capacity = stats.power.enabled ? stats.power.capacity : -1;
+    summary->power_platform = stats.power.platform ? stats.power.platform : "none";
+    summary->power_ac_s = stats.power.ac_s;
+    summary->power_battery_s = stats.power.battery_s;
+    summary->power_low_s = stats.power.low_s;
+    summary->power_switches = stats.power.switches;
 
     if (kp_state->exes) {
         g_hash_table_iter_init(&iter, kp_state->exes);
@@ -579,7 +795,7 @@ kp_stats_get_summary(kp_stats_summary_t *summary)
     guint sorted_len = sorted->len;  /* BUG 1 FIX: Save before freeing */
     g_array_free(sorted, TRUE);
     
-    g_debug("Stats summary: %u priority pool apps in top list", sorted_len);
+    kp_debug("Stats summary: %u priority pool apps in top list", sorted_len);
 }
 
 /**
@@ -642,6 +858,61 @@ kp_stats_dump_to_file(const char *path)
     fprintf(f, "\n# Memory\n");
     fprintf(f, "total_preloaded_mb=%zu\n", summary.total_preloaded_bytes / (1024 * 1024));
     fprintf(f, "memory_pressure_events=%lu\n", summary.memory_pressure_events);
+    fprintf(f, "budget_state=%s\n", summary.budget_state);
+    fprintf(f, "budget_factor=%.2f\n", summary.budget_factor);
+    fprintf(f, "budget_base_kb=%ld\n", summary.budget_base_kb);
+    fprintf(f, "budget_kb=%ld\n", summary.budget_kb);
+    fprintf(f, "budget_available_kb=%d\n", summary.budget_available_kb);
+    fprintf(f, "budget_inactive_file_kb=%d\n", summary.budget_inactive_kb);
+    fprintf(f, "budget_refault_kbps=%.1f\n", summary.budget_refault_kbps);
+    fprintf(f, "budget_activate_kbps=%.1f\n", summary.budget_activate_kbps);
+    fprintf(f, "budget_steal_kbps=%.1f\n", summary.budget_steal_kbps);
+    fprintf(f, "reclaim_events=%lu\n", summary.reclaim_events);
+    fprintf(f, "reclaim_ranges=%lu\n", summary.reclaim_ranges);
+    fprintf(f, "reclaim_mb_total=%llu\n", summary.reclaim_bytes / (1024 * 1024));
+    fprintf(f, "pin_state=%s\n", summary.pin_state);
+    fprintf(f, "pinned_apps=%d\n", summary.pinned_apps);
+    fprintf(f, "pinned_kb=%zu\n", summary.pinned_bytes / 1024);
+    fprintf(f, "pinned_resident_kb=%zu\n", summary.pinned_resident_bytes / 1024);
+
+    /* Prediction metrics */
+    fprintf(f, "\n# Prediction\n");
+    fprintf(f, "shared_maps_last=%d\n", summary.shared_maps_last);
+    fprintf(f, "shared_kb_last=%zu\n", summary.shared_bytes_last / 1024);
+    fprintf(f, "shared_mb_total=%llu\n", summary.shared_bytes_total / (1024 * 1024));
+    fprintf(f, "predict_slices_last=%d\n", summary.predict_slices_last);
+    fprintf(f, "predict_slices_max=%d\n", summary.predict_slices_max);
+    fprintf(f, "predict_cpu_ms=%.1f\n", summary.predict_cpu_ms);
+    fprintf(f, "predict_wall_ms=%.1f\n", summary.predict_wall_ms);
+
+    /* Pipeline stages */
+    fprintf(f, "\n# Pipeline\n");
+    fprintf(f, "pipeline=%s\n", summary.pipeline_threaded ? "threaded" : "single");
+    fprintf(f, "pipeline_scan_ms=%.1f\n", summary.pipeline_scan_ms);
+    fprintf(f, "pipeline_model_ms=%.1f\n", summary.pipeline_model_ms);
+    fprintf(f, "pipeline_io_ms=%.1f\n", summary.pipeline_io_ms);
+    fprintf(f, "pipeline_io_wait_ms=%.1f\n", summary.pipeline_io_wait_ms);
+    fprintf(f, "pipeline_io_queued=%u\n", summary.pipeline_io_queued);
+    fprintf(f, "pipeline_io_plans=%lu\n", summary.pipeline_io_plans);
+    fprintf(f, "pipeline_io_dropped=%lu\n", summary.pipeline_io_dropped);
+
+    /* Scheduler wakeups */
+    fprintf(f, "\n# Scheduler\n");
+    fprintf(f, "sched_clock=%s\n", summary.sched_clock);
+    fprintf(f, "sched_wakeups=%lu\n", summary.sched_wakeups);
+    fprintf(f, "sched_tasks=%lu\n", summary.sched_tasks);
+    fprintf(f, "sched_batched=%lu\n", summary.sched_batched);
+    fprintf(f, "sched_wakeups_per_hour=%.1f\n", summary.sched_wakeups_per_hour);
+
+    /* Power profile */
+    fprintf(f, "\n# Power\n");
+    fprintf(f, "power_profile=%s\n", summary.power_profile);
+    fprintf(f, "power_capacity=%d\n", summary.power_capacity);
+    fprintf(f, "power_platform_profile=%s\n", summary.power_platform);
+    fprintf(f, "power_ac_s=%.0f\n", summary.power_ac_s);
+    fprintf(f, "power_battery_s=%.0f\n", summary.power_battery_s);
+    fprintf(f, "power_low_s=%.0f\n", summary.power_low_s);
+    fprintf(f, "power_switches=%lu\n", summary.power_switches);
 
     /* Top apps (extended to 20 with more details) */
     fprintf(f, "\n# Top Apps (name:weighted:raw:preloaded:pool)\n");
@@ -675,7 +946,109 @@ kp_stats_record_memory_pressure(void)
     if (!stats.initialized) return;
     
     stats.memory_pressure_events++;
-    g_debug("Memory pressure event recorded (total: %lu)", stats.memory_pressure_events);
+    kp_debug("Memory pressure event recorded (total: %lu)", stats.memory_pressure_events);
+}
+
+/**
+ * Record shared maps in the current preload plan
+ */
+void
+kp_stats_record_shared_maps(int maps, size_t length)
+{
+    if (!stats.initialized) return;
+
+    stats.shared_maps_last = maps;
+    stats.shared_bytes_last = length;
+    stats.shared_bytes_total += length;
+}
+
+/**
+ * Record how the last prediction was sliced
+ */
+void
+kp_stats_record_predict(int slices, double cpu_ms, double wall_ms)
+{
+    if (!stats.initialized) return;
+
+    stats.predict_slices_last = slices;
+    stats.predict_slices_max = MAX(stats.predict_slices_max, slices);
+    stats.predict_cpu_ms = cpu_ms;
+    stats.predict_wall_ms = wall_ms;
+}
+
+/**
+ * Record the budget model's inputs and the budget of the current cycle
+ */
+void
+kp_stats_record_budget(const kp_budget_model_t *model, long budget)
+{
+    if (!stats.initialized || !model) return;
+
+    stats.budget = *model;
+    stats.budget.budget = budget;
+}
+
+/**
+ * Record preloaded ranges dropped under memory pressure
+ */
+void
+kp_stats_record_reclaim(int ranges, size_t length)
+{
+    if (!stats.initialized || ranges <= 0) return;
+
+    stats.reclaim_events++;
+    stats.reclaim_ranges += ranges;
+    stats.reclaim_bytes += length;
+}
+
+/**
+ * Record the state of the pinned tier
+ */
+void
+kp_stats_record_pin(const char *state, int apps, size_t length, size_t resident)
+{
+    if (!stats.initialized) return;
+
+    stats.pin_state = state;
+    stats.pinned_apps = apps;
+    stats.pinned_bytes = length;
+    stats.pinned_resident_bytes = resident;
+}
+
+/**
+ * Record the cycle pipeline's stage latencies and plan counters
+ */
+void
+kp_stats_record_pipeline(const kp_pipeline_stats_t *ps)
+{
+    if (!stats.initialized) return;
+
+    g_return_if_fail(ps);
+    stats.pipeline = *ps;
+}
+
+/**
+ * Record the task scheduler's wakeup counters
+ */
+void
+kp_stats_record_sched(const kp_sched_stats_t *ss)
+{
+    if (!stats.initialized) return;
+
+    g_return_if_fail(ss);
+    stats.sched = *ss;
+}
+
+/**
+ * Record the power profile and the time spent in each
+ */
+void
+kp_stats_record_power(const kp_power_stats_t *ws)
+{
+    if (!stats.initialized) return;
+
+    g_return_if_fail(ws);
+    stats.power = *ws;
 }
 
 /**
@@ -765,7 +1138,7 @@ kp_stats_save_preload_times(GIOChannel *channel)
     /* Write each preload time */
     g_hash_table_foreach(stats.preload_times, write_preload_time, channel);
     
-    g_debug("Saved %u preload timestamps to state file", count);
+    kp_debug("Saved %u preload timestamps to state file", count);
 }
 
 /**
@@ -787,9 +1160,9 @@ kp_stats_load_preload_time(const char *app_name, time_t timestamp)
     if (elapsed < stats.hitstats_window) {
         g_hash_table_replace(stats.preload_times, g_strdup(app_name), 
                             GSIZE_TO_POINTER((gsize)timestamp));
-        g_debug("Loaded preload time for %s (age: %ld sec)", app_name, (long)elapsed);
+        kp_debug("Loaded preload time for %s (age: %ld sec)", app_name, (long)elapsed);
     } else {
-        g_debug("Skipped stale preload time for %s (age: %ld sec > window %d)",
-                app_name, (long)elapsed, stats.hitstats_window);
+        kp_debug("Skipped stale preload time for %s (age: %ld sec > window %d)",
+                 app_name, (long)elapsed, stats.hitstats_window);
     }
 }
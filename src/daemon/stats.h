@@ -14,6 +14,12 @@
 #include <glib.h>
 #include <time.h>
 
+struct _kp_exe_t;
+struct _kp_budget_model_t;
+struct _kp_pipeline_stats_t;
+struct _kp_sched_stats_t;
+struct _kp_power_stats_t;
+
 /* Maximum apps to track in top list */
 #define STATS_TOP_APPS 20
 
@@ -41,6 +47,63 @@ typedef struct _kp_stats_summary {
     size_t total_preloaded_bytes;
     unsigned long memory_pressure_events;
 
+    /* Budget model (last prediction cycle) */
+    const char *budget_state;       /* warmup, cold, steady, refaulting, thrashing, off */
+    double budget_factor;           /* Scale applied to the formula budget */
+    long budget_base_kb;            /* memtotal/memfree/memcached formula */
+    long budget_kb;                 /* Budget used, after scaling and cgroup cap */
+    int budget_available_kb;        /* MemAvailable */
+    int budget_inactive_kb;         /* Inactive(file) */
+    double budget_refault_kbps;     /* workingset_refault_file rate */
+    double budget_activate_kbps;    /* workingset_activate_file rate */
+    double budget_steal_kbps;       /* pgsteal (file) rate */
+
+    /* Reclaim of mispredicted preloads */
+    unsigned long reclaim_events;   /* Cycles that dropped preloaded ranges */
+    unsigned long reclaim_ranges;   /* Ranges dropped */
+    unsigned long long reclaim_bytes; /* Bytes dropped */
+
+    /* Pinned tier */
+    const char *pin_state;          /* off, active, limited, suspended */
+    int pinned_apps;                /* Apps with locked ranges */
+    size_t pinned_bytes;            /* Bytes mlocked */
+    size_t pinned_resident_bytes;   /* ...of which resident */
+
+    /* Cycle pipeline (last cycle's stage latencies) */
+    gboolean pipeline_threaded;     /* Scanner and I/O threads running */
+    double pipeline_scan_ms;        /* /proc snapshot */
+    double pipeline_model_ms;       /* Spy update + first prediction slice */
+    double pipeline_io_ms;          /* Reading the plan */
+    double pipeline_io_wait_ms;     /* Plan waiting for the I/O thread */
+    unsigned int pipeline_io_queued; /* Plans not read yet */
+    unsigned long pipeline_io_plans; /* Plans read */
+    unsigned long pipeline_io_dropped; /* Plans dropped, I/O thread behind */
+
+    /* Task scheduler wakeups */
+    const char *sched_clock;        /* boottime, monotonic or glib */
+    unsigned long sched_wakeups;    /* Timer wakeups since start */
+    unsigned long sched_tasks;      /* Tasks run in them */
+    unsigned long sched_batched;    /* ...sharing a wakeup with another */
+    double sched_wakeups_per_hour;
+
+    /* Power profile */
+    const char *power_profile;      /* ac, battery, low; off if disabled */
+    int power_capacity;             /* Battery charge %, -1 if none */
+    const char *power_platform;     /* platform_profile, none if unavailable */
+    double power_ac_s;              /* Seconds spent in each profile */
+    double power_battery_s;
+    double power_low_s;
+    unsigned long power_switches;   /* Profile transitions since start */
+
+    /* Prediction metrics */
+    int shared_maps_last;           /* Shared maps in the last preload plan */
+    size_t shared_bytes_last;       /* Bytes of those maps */
+    unsigned long long shared_bytes_total; /* Cumulative shared bytes planned */
+    int predict_slices_last;        /* Main loop slices of the last prediction */
+    int predict_slices_max;         /* Most slices any prediction needed */
+    double predict_cpu_ms;          /* CPU time of the last prediction */
+    double predict_wall_ms;         /* Start to end of the last prediction */
+
     /* Top apps */
     struct {
         char *name;
@@ -57,6 +120,15 @@ typedef struct _kp_stats_summary {
  */
 void kp_stats_init(void);
 
+/**
+ * Refresh an exe's cached pool class, canonical path and blacklist flag
+ *
+ * No-op unless kp_config_generation() or kp_desktop_generation() changed
+ * since the exe's decisions were last computed.
+ * @param exe Tracked executable
+ */
+void kp_stats_refresh_exe(struct _kp_exe_t *exe);
+
 /**
  * Record a preload event
  * @param app_path Path of preloaded application
@@ -94,6 +166,67 @@ void kp_stats_get_summary(kp_stats_summary_t *summary);
  */
 void kp_stats_record_memory_pressure(void);
 
+/**
+ * Record shared maps in the current preload plan
+ * Called by the prophet after each budget pass
+ * @param maps Maps bid on by 2+ candidate exes that made the cut
+ * @param length Total length of those maps in bytes
+ */
+void kp_stats_record_shared_maps(int maps, size_t length);
+
+/**
+ * Record how a prediction was sliced
+ * Called by the prophet when a prediction completes
+ * @param slices Main loop slices it ran in
+ * @param cpu_ms CPU time it used
+ * @param wall_ms Time from start to end, including the main loop in between
+ */
+void kp_stats_record_predict(int slices, double cpu_ms, double wall_ms);
+
+/**
+ * Record the budget model's inputs and the budget of the current cycle
+ * Called by the prophet after computing its budget
+ * @param model Model as last updated (copied)
+ * @param budget Budget used, in KB (after any cgroup cap)
+ */
+void kp_stats_record_budget(const struct _kp_budget_model_t *model, long budget);
+
+/**
+ * Record preloaded ranges dropped under memory pressure
+ * Called by the reclaim tick
+ * @param ranges Ranges dropped with POSIX_FADV_DONTNEED
+ * @param length Total length of those ranges in bytes
+ */
+void kp_stats_record_reclaim(int ranges, size_t length);
+
+/**
+ * Record the state of the pinned tier
+ * Called by the pin tick every cycle
+ * @param state "off", "active", "limited" (mlock refused) or "suspended"
+ * @param apps Apps with at least one range locked
+ * @param length Bytes locked
+ * @param resident Bytes of the locked ranges resident in memory
+ */
+void kp_stats_record_pin(const char *state, int apps, size_t length, size_t resident);
+
+/**
+ * Record the cycle pipeline's stage latencies and plan counters
+ * Called by the pipeline whenever a stage finishes
+ */
+void kp_stats_record_pipeline(const struct _kp_pipeline_stats_t *ps);
+
+/**
+ * Record the task scheduler's wakeup counters
+ * Called by the scheduler after every wakeup
+ */
+void kp_stats_record_sched(const struct _kp_sched_stats_t *ss);
+
+/**
+ * Record the power profile and the time spent in each
+ * Called by the power module every cycle
+ */
+void kp_stats_record_power(const struct _kp_power_stats_t *ws);
+
 /**
  * Get hit rate for a specific app
  * @param app_path Path of application
@@ -0,0 +1,515 @@
+/* identity.c - Interpreter- and wrapper-aware app identity for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: App Identity Resolver
+ * =============================================================================
+ *
+ * /proc/PID/exe of a Python, Java, Node/Electron or shell-run application
+ * is the interpreter. Keyed by exe alone, burpsuite, sqlmap, ghidra and
+ * every in-house tool collapse into one kp_exe_t holding the union of
+ * everyone's maps. The resolver gives each of them its own key.
+ *
+ * RULES (system.interpreters, "glob=kind;..." on the exe basename):
+ *   python  script | -m module           (-c CMD: no app, stay interpreter)
+ *   java    -jar JAR | -m module | main class, skipping -cp & co.
+ *   node    first non-option: script.js, app dir or app.asar (Electron)
+ *           (-e/-p/--eval/--print: no app)
+ *   script  first non-option (perl, ruby, sh, bash...)
+ *           (perl/ruby -e, shells -c: no app)
+ *
+ * KEYS:
+ *   script/jar/asar → its canonical path     /usr/share/sqlmap/sqlmap.py
+ *   module/class    → interpreter#name       /usr/bin/python3.11#http.server
+ *   relative paths are resolved against /proc/PID/cwd, and realpath()
+ *   follows wrapper symlinks (/usr/bin/sqlmap → .../sqlmap.py)
+ *   a path key must pass exeprefix like any exe; if it does not, the
+ *   process stays keyed by its interpreter
+ *
+ * CHILDREN:
+ *   An interpreter process with no app argument (Electron renderers,
+ *   multiprocessing workers) inherits the key of a parent running the
+ *   same exe, so helpers count toward the app that spawned them.
+ *
+ * CACHE:
+ *   pid → (exe, key), re-resolved only if the exe changed (exec); pids not
+ *   seen during a scan are dropped by kp_identity_sweep().
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "identity.h"
+#include "spy.h"
+#include "../utils/logging.h"
+#include "../utils/pattern.h"
+#include "../config/config.h"
+#include "../state/state.h"
+
+/* Bytes of /proc/PID/cmdline considered */
+#define IDENTITY_CMDLINE_MAX 4096
+
+/* Parent levels searched for an app key */
+#define IDENTITY_PARENT_DEPTH 4
+
+typedef enum {
+    KIND_PYTHON,
+    KIND_JAVA,
+    KIND_NODE,
+    KIND_SCRIPT
+} interp_kind_t;
+
+typedef struct {
+    char *glob;             /* Matched against the exe basename */
+    interp_kind_t kind;
+} interp_rule_t;
+
+typedef struct {
+    char *exe;              /* /proc/PID/exe the key was derived for */
+    char *key;              /* App key (may equal exe) */
+    gboolean seen;          /* Resolved since the last sweep */
+} identity_entry_t;
+
+static GArray *rules = NULL;            /* interp_rule_t */
+static unsigned int rules_gen = 0;      /* kp_config_generation() of rules */
+static GHashTable *cache = NULL;        /* pid → identity_entry_t */
+
+static void
+identity_entry_free(gpointer data)
+{
+    identity_entry_t *entry = data;
+
+    g_free(entry->exe);
+    g_free(entry->key);
+    g_free(entry);
+}
+
+static void
+rules_free(void)
+{
+    if (!rules)
+        return;
+    for (guint i = 0; i < rules->len; i++)
+        g_free(g_array_index(rules, interp_rule_t, i).glob);
+    g_array_free(rules, TRUE);
+    rules = NULL;
+}
+
+/**
+ * (Re)compile system.interpreters when the configuration changed
+ */
+static void
+rules_update(void)
+{
+    char **items;
+    unsigned int gen = kp_config_generation();
+
+    if (rules && rules_gen == gen)
+        return;
+
+    rules_free();
+    rules = g_array_new(FALSE, FALSE, sizeof(interp_rule_t));
+    rules_gen = gen;
+
+    /* Keys derived under the old rules would be stale */
+    if (cache)
+        g_hash_table_remove_all(cache);
+
+    if (!kp_conf->system.interpreters || !*kp_conf->system.interpreters)
+        return;
+
+    items = g_strsplit(kp_conf->system.interpreters, ";", -1);
+    for (char **p = items; *p; p++) {
+        char *eq;
+        interp_rule_t rule;
+
+        g_strstrip(*p);
+        eq = strchr(*p, '=');
+        if (!**p || !eq || eq == *p) {
+            if (**p)
+                g_warning("interpreters: ignoring malformed rule '%s'", *p);
+            continue;
+        }
+        *eq = '\0';
+
+        if (strcmp(eq + 1, "python") == 0)
+            rule.kind = KIND_PYTHON;
+        else if (strcmp(eq + 1, "java") == 0)
+            rule.kind = KIND_JAVA;
+        else if (strcmp(eq + 1, "node") == 0)
+            rule.kind = KIND_NODE;
+        else if (strcmp(eq + 1, "script") == 0)
+            rule.kind = KIND_SCRIPT;
+        else {
+            g_warning("interpreters: unknown kind '%s' for '%s'", eq + 1, *p);
+            continue;
+        }
+
+        rule.glob = g_strdup(*p);
+        g_array_append_val(rules, rule);
+    }
+    g_strfreev(items);
+}
+
+/**
+ * Interpreter kind of an exe, or -1
+ */
+static int
+match_interpreter(const char *exe_path)
+{
+    const char *base = strrchr(exe_path, '/');
+
+    base = base ? base + 1 : exe_path;
+    for (guint i = 0; i < rules->len; i++) {
+        interp_rule_t *rule = &g_array_index(rules, interp_rule_t, i);
+        if (kp_pattern_match(base, rule->glob))
+            return rule->kind;
+    }
+    return -1;
+}
+
+/**
+ * Read /proc/PID/cmdline into a NULL-terminated argv
+ */
+static char **
+read_cmdline(pid_t pid)
+{
+    char path[64];
+    char buf[IDENTITY_CMDLINE_MAX];
+    GPtrArray *argv;
+    size_t len, i;
+    FILE *f;
+
+    g_snprintf(path, sizeof(path), "/proc/%d/cmdline", pid);
+    f = fopen(path, "r");
+    if (!f)
+        return NULL;
+    len = fread(buf, 1, sizeof(buf) - 1, f);
+    fclose(f);
+    if (len == 0)
+        return NULL;
+    buf[len] = '\0';
+
+    argv = g_ptr_array_new();
+    for (i = 0; i < len; i += strlen(buf + i) + 1)
+        g_ptr_array_add(argv, g_strdup(buf + i));
+    g_ptr_array_add(argv, NULL);
+    return (char **)g_ptr_array_free(argv, FALSE);
+}
+
+/**
+ * Is this KIND_SCRIPT interpreter a shell (not perl or ruby)?
+ */
+static gboolean
+script_is_shell(const char *exe_path)
+{
+    const char *base = strrchr(exe_path, '/');
+
+    base = base ? base + 1 : exe_path;
+    return !g_str_has_prefix(base, "perl") && !g_str_has_prefix(base, "ruby");
+}
+
+/**
+ * Is arg an option rather than the script or app?
+ *
+ * Shells also take options with a '+' (+o, +O, +x...).
+ */
+static gboolean
+arg_is_option(interp_kind_t kind, const char *exe_path, const char *arg)
+{
+    if (arg[0] == '-' && strcmp(arg, "-") != 0)
+        return TRUE;
+    return arg[0] == '+' && arg[1] && kind == KIND_SCRIPT && script_is_shell(exe_path);
+}
+
+/**
+ * Does an interpreter option consume the next argument?
+ */
+static gboolean
+option_takes_value(interp_kind_t kind, const char *exe_path, const char *opt)
+{
+    static const char *python_opts[] = { "-W", "-X", "--check-hash-based-pycs", NULL };
+    static const char *java_opts[] = {
+        "-cp", "-classpath", "--class-path", "-p", "--module-path",
+        "--upgrade-module-path", "--add-modules", "--add-opens",
+        "--add-exports", "--add-reads", "--patch-module",
+        "--limit-modules", "--enable-native-access", NULL
+    };
+    static const char *node_opts[] = {
+        "-r", "--require", "--loader", "--experimental-loader", "--import",
+        "--inspect-port", "--title", NULL
+    };
+    static const char *shell_opts[] = {
+        "-o", "-O", "+o", "+O", "--rcfile", "--init-file", NULL
+    };
+    const char **opts;
+
+    switch (kind) {
+        case KIND_PYTHON: opts = python_opts; break;
+        case KIND_JAVA:   opts = java_opts;   break;
+        case KIND_NODE:   opts = node_opts;   break;
+        case KIND_SCRIPT:
+            if (!script_is_shell(exe_path))
+                return FALSE;
+            opts = shell_opts;
+            break;
+        default:          return FALSE;
+    }
+    for (; *opts; opts++)
+        if (strcmp(opt, *opts) == 0)
+            return TRUE;
+    return FALSE;
+}
+
+/**
+ * Is opt the inline-code option of this interpreter?
+ *
+ * Shells take -c; their -e (errexit) and -p (privileged) are plain
+ * flags, which perl and ruby spell -e for code instead.
+ */
+static gboolean
+option_is_inline_code(interp_kind_t kind, const char *exe_path, const char *opt)
+{
+    switch (kind) {
+        case KIND_PYTHON:
+            return strcmp(opt, "-c") == 0;
+        case KIND_NODE:
+            return strcmp(opt, "-e") == 0 || strcmp(opt, "--eval") == 0 ||
+                   strcmp(opt, "-p") == 0 || strcmp(opt, "--print") == 0;
+        case KIND_SCRIPT:
+            if (!script_is_shell(exe_path))
+                return strcmp(opt, "-e") == 0;
+            return strcmp(opt, "-c") == 0;
+        default:
+            return FALSE;
+    }
+}
+
+/**
+ * Absolute, canonical form of a path argument of process pid
+ * @return NULL if it does not resolve to an existing file
+ */
+static char *
+resolve_arg_path(pid_t pid, const char *arg)
+{
+    char *path, *real;
+
+    if (arg[0] == '/') {
+        path = g_strdup(arg);
+    } else {
+        char link[64], cwd[FILELEN];
+        ssize_t len;
+
+        g_snprintf(link, sizeof(link), "/proc/%d/cwd", pid);
+        len = readlink(link, cwd, sizeof(cwd) - 1);
+        if (len <= 0)
+            return NULL;
+        cwd[len] = '\0';
+        path = g_build_filename(cwd, arg, NULL);
+    }
+
+    real = realpath(path, NULL);
+    g_free(path);
+    if (!real)
+        return NULL;
+    path = g_strdup(real);
+    free(real);
+    return path;
+}
+
+/**
+ * Derive the app key from an interpreter's argv
+ * @return Newly allocated key, or NULL if the process runs no app
+ */
+static char *
+key_from_argv(pid_t pid, const char *exe_path, interp_kind_t kind, char **argv)
+{
+    int i;
+
+    for (i = 1; argv[i]; i++) {
+        const char *arg = argv[i];
+
+        if (!arg_is_option(kind, exe_path, arg)) {
+            if (strcmp(arg, "-") == 0)
+                return NULL;                            /* stdin */
+            if (kind == KIND_JAVA && !strchr(arg, '/'))
+                return g_strdup_printf("%s%c%s", exe_path, KP_IDENTITY_SEP, arg);
+            return resolve_arg_path(pid, arg);          /* script / app */
+        }
+
+        /* Inline code: nothing to tell apps apart by */
+        if (option_is_inline_code(kind, exe_path, arg))
+            return NULL;
+
+        if (kind == KIND_JAVA && strcmp(arg, "-jar") == 0)
+            return argv[i + 1] ? resolve_arg_path(pid, argv[i + 1]) : NULL;
+
+        if ((kind == KIND_PYTHON && strcmp(arg, "-m") == 0) ||
+            (kind == KIND_JAVA && (strcmp(arg, "-m") == 0 || strcmp(arg, "--module") == 0))) {
+            char *name, *slash;
+
+            if (!argv[i + 1])
+                return NULL;
+            name = g_strdup(argv[i + 1]);
+            /* java -m module/main.Class → module */
+            if ((slash = strchr(name, '/')))
+                *slash = '\0';
+            {
+                char *key = g_strdup_printf("%s%c%s", exe_path, KP_IDENTITY_SEP, name);
+                g_free(name);
+                return key;
+            }
+        }
+
+        if (option_takes_value(kind, exe_path, arg) && argv[i + 1])
+            i++;
+    }
+    return NULL;
+}
+
+/**
+ * May a key derived from argv become a model exe?
+ *
+ * The interpreter passed exeprefix in the scan; a script or jar path has
+ * to pass it too, or everything run from /tmp or $HOME gets tracked.
+ * interpreter#module keys live under the interpreter and need no check.
+ */
+static gboolean
+key_accepted(const char *exe_path, const char *key)
+{
+    size_t len = strlen(exe_path);
+
+    if (strncmp(key, exe_path, len) == 0 && key[len] == KP_IDENTITY_SEP)
+        return TRUE;
+    return kp_path_matcher_match(kp_conf->system.exeprefix_matcher, key, TRUE);
+}
+
+/**
+ * Key of the nearest ancestor running the same exe, if it has one
+ */
+static char *
+key_from_parent(pid_t pid, const char *exe_path)
+{
+    pid_t ppid = pid;
+
+    for (int depth = 0; depth < IDENTITY_PARENT_DEPTH; depth++) {
+        identity_entry_t *entry;
+
+        ppid = get_parent_pid(ppid);
+        if (ppid <= 1)
+            return NULL;
+
+        entry = g_hash_table_lookup(cache, GINT_TO_POINTER(ppid));
+        if (!entry || strcmp(entry->exe, exe_path) != 0)
+            return NULL;
+        if (strcmp(entry->key, entry->exe) != 0)
+            return g_strdup(entry->key);
+    }
+    return NULL;
+}
+
+/**
+ * Resolve the logical application of a process
+ */
+const char *
+kp_identity_resolve(pid_t pid, const char *exe_path)
+{
+    identity_entry_t *entry;
+    char **argv;
+    char *key = NULL;
+    int kind;
+
+    rules_update();
+    if (rules->len == 0)
+        return exe_path;
+
+    if (!cache)
+        cache = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                      NULL, identity_entry_free);
+
+    entry = g_hash_table_lookup(cache, GINT_TO_POINTER(pid));
+    if (entry && strcmp(entry->exe, exe_path) == 0) {
+        entry->seen = TRUE;
+        return entry->key;
+    }
+
+    kind = match_interpreter(exe_path);
+    if (kind >= 0) {
+        argv = read_cmdline(pid);
+        if (argv && argv[0])
+            key = key_from_argv(pid, exe_path, kind, argv);
+        g_strfreev(argv);
+
+        if (key && !key_accepted(exe_path, key)) {
+            /* Excluded app: keep it under the interpreter */
+            kp_debug("identity: pid %d (%s) runs %s, not in exeprefix", pid, exe_path, key);
+            g_free(key);
+            key = NULL;
+        } else if (!key) {
+            key = key_from_parent(pid, exe_path);
+        }
+        if (key && strlen(key) >= FILELEN) {
+            g_free(key);
+            key = NULL;
+        }
+        if (key)
+            kp_debug("identity: pid %d (%s) is %s", pid, exe_path, key);
+    }
+
+    entry = g_new0(identity_entry_t, 1);
+    entry->exe = g_strdup(exe_path);
+    entry->key = key ? key : g_strdup(exe_path);
+    entry->seen = TRUE;
+    g_hash_table_replace(cache, GINT_TO_POINTER(pid), entry);
+
+    return entry->key;
+}
+
+static gboolean
+entry_unseen(gpointer G_GNUC_UNUSED key, gpointer value, gpointer G_GNUC_UNUSED user_data)
+{
+    identity_entry_t *entry = value;
+
+    if (!entry->seen)
+        return TRUE;
+    entry->seen = FALSE;
+    return FALSE;
+}
+
+/**
+ * Forget processes not resolved since the previous sweep
+ */
+void
+kp_identity_sweep(void)
+{
+    if (cache)
+        g_hash_table_foreach_remove(cache, entry_unseen, NULL);
+}
+
+/**
+ * File behind a resolved app key worth preloading with the app
+ */
+char *
+kp_identity_target(pid_t pid, const char *key)
+{
+    identity_entry_t *entry;
+    struct stat st;
+
+    if (!cache || !key)
+        return NULL;
+
+    entry = g_hash_table_lookup(cache, GINT_TO_POINTER(pid));
+    if (!entry || strcmp(entry->key, key) != 0 || strcmp(entry->key, entry->exe) == 0)
+        return NULL;
+    if (strchr(key, KP_IDENTITY_SEP))
+        return NULL;                /* module or class name */
+    if (stat(key, &st) < 0 || !S_ISREG(st.st_mode))
+        return NULL;                /* app directory */
+    return g_strdup(key);
+}
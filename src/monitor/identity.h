@@ -0,0 +1,51 @@
+/* identity.h - Interpreter- and wrapper-aware app identity for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef IDENTITY_H
+#define IDENTITY_H
+
+#include <sys/types.h>
+#include <glib.h>
+
+/* Separates interpreter and module/class name in a logical app key,
+ * e.g. "/usr/bin/python3.11#http.server" */
+#define KP_IDENTITY_SEP '#'
+
+/**
+ * Resolve the logical application a process belongs to
+ *
+ * For processes whose exe matches system.interpreters, the key is derived
+ * from /proc/PID/cmdline (script, -jar target, -m module, app.asar...).
+ * Everything else is identified by its exe.
+ *
+ * @param pid Process ID
+ * @param exe_path Resolved /proc/PID/exe
+ * @return App key, owned by the resolver and valid until the next
+ *         kp_identity_sweep(); exe_path itself if nothing better was found
+ */
+const char *kp_identity_resolve(pid_t pid, const char *exe_path);
+
+/**
+ * Forget processes not resolved since the previous sweep
+ * Call once per scan, after all processes were resolved
+ */
+void kp_identity_sweep(void);
+
+/**
+ * File behind an app key that should be preloaded with the app
+ *
+ * @param pid Process the key was resolved for
+ * @param key App key returned by kp_identity_resolve()
+ * @return Newly allocated path of the script/jar/asar, or NULL if the key
+ *         is a plain exe, a module/class name or a directory
+ */
+char *kp_identity_target(pid_t pid, const char *key);
+
+#endif /* IDENTITY_H */
@@ -0,0 +1,479 @@
+/* mntns.c - Mount-namespace aware path resolution for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Namespace-Aware Map Paths
+ * =============================================================================
+ *
+ * Flatpak, Docker, toolbox and chrooted processes list paths in
+ * /proc/PID/maps as they see them. Opened from the daemon, /usr/lib/x.so of
+ * a Flatpak app is the host's library (wrong file) and a container's
+ * /app/bin/tool does not exist at all. This module translates such paths
+ * into host paths that reach the very same inode.
+ *
+ * FOREIGN PROCESS:
+ *   /proc/PID/ns/mnt differs from ours, or /proc/PID/root is not "/"
+ *
+ * TRANSLATION (kp_mntns_host_path, kp_mntns_host_exe):
+ *   identity = stat(/proc/PID/map_files/START-END)   (dev, ino) of the
+ *              or stat(/proc/PID/exe)                 mapped file or exe
+ *              or stat(/proc/PID/root/PATH)           itself
+ *   candidates, first with the same (dev, ino) wins:
+ *     1. ROOT/PATH                  chroot in our namespace
+ *     2. PATH                       shared bind mounts (/usr of toolbox)
+ *     3. mountinfo translation:
+ *          their mount covering PATH:  major:minor, fs root R, mountpoint M
+ *          → file is at R + (PATH - M) inside that filesystem
+ *          our mount of major:minor with root R' ⊆ that path, at M'
+ *          → M' + (R + (PATH - M) - R')
+ *   nothing matches → NULL: the map is skipped instead of wasting budget
+ *
+ * CACHES:
+ *   per namespace: their mount table, PATH → host path (or unreachable)
+ *   global:        (dev, ino) → host path, shared by containers that run
+ *                  the same image layers
+ *   mount tables are re-read after MNTNS_TTL_SEC; namespaces nobody
+ *   asked about for MNTNS_IDLE_SEC are dropped.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "mntns.h"
+#include "../utils/logging.h"
+#include "../utils/mountinfo.h"
+#include "../state/state.h"
+
+/* Mount tables older than this are re-read */
+#define MNTNS_TTL_SEC 300
+
+/* Namespaces unused for this long are forgotten */
+#define MNTNS_IDLE_SEC 3600
+
+/* Translation cache bound (entries) before it is flushed */
+#define MNTNS_CACHE_MAX 8192
+
+/* Marks an unreachable path in kp_mntns_t.paths */
+#define MNTNS_UNREACHABLE ""
+
+typedef struct {
+    unsigned int major, minor;
+    char *root;             /* Directory of the filesystem that is mounted */
+    char *mountpoint;       /* Where it is mounted */
+} mount_entry_t;
+
+struct _kp_mntns_t {
+    char *key;              /* "<ns inode>:<root>" */
+    char *root;             /* /proc/PID/root link target */
+    gboolean foreign_ns;    /* Other mount namespace (not just a chroot) */
+    GArray *mounts;         /* mount_entry_t, /proc/PID/mountinfo */
+    GHashTable *paths;      /* their path → host path / MNTNS_UNREACHABLE */
+    gint64 loaded;          /* When mounts were read (monotonic us) */
+    gint64 used;            /* Last kp_mntns_get() (monotonic us) */
+};
+
+/* (st_dev, st_ino) key of the global inode cache */
+typedef struct {
+    dev_t dev;
+    ino_t ino;
+} file_id_t;
+
+static ino_t self_ns = 0;
+static GArray *host_mounts = NULL;      /* mount_entry_t, /proc/self/mountinfo */
+static gint64 host_loaded = 0;
+static GHashTable *namespaces = NULL;    /* key → kp_mntns_t */
+static GHashTable *inodes = NULL;       /* file_id_t → host path */
+
+static guint
+file_id_hash(gconstpointer v)
+{
+    const file_id_t *id = v;
+    guint64 ino = id->ino;
+    return (guint)(ino ^ (ino >> 32) ^ ((guint64)id->dev * 31));
+}
+
+static gboolean
+file_id_equal(gconstpointer a, gconstpointer b)
+{
+    const file_id_t *ia = a, *ib = b;
+    return ia->dev == ib->dev && ia->ino == ib->ino;
+}
+
+static void
+mounts_free(GArray *mounts)
+{
+    if (!mounts)
+        return;
+    for (guint i = 0; i < mounts->len; i++) {
+        mount_entry_t *m = &g_array_index(mounts, mount_entry_t, i);
+        g_free(m->root);
+        g_free(m->mountpoint);
+    }
+    g_array_free(mounts, TRUE);
+}
+
+static void
+mntns_free(gpointer data)
+{
+    kp_mntns_t *ns = data;
+
+    g_free(ns->key);
+    g_free(ns->root);
+    mounts_free(ns->mounts);
+    g_hash_table_destroy(ns->paths);
+    g_free(ns);
+}
+
+/**
+ * Parse a mountinfo file
+ * Format: ID PARENT MAJOR:MINOR ROOT MOUNTPOINT OPTIONS ...
+ */
+static GArray *
+read_mountinfo(const char *file)
+{
+    GArray *mounts;
+    char line[4096];
+    FILE *f;
+
+    f = fopen(file, "r");
+    if (!f)
+        return NULL;
+
+    mounts = g_array_new(FALSE, FALSE, sizeof(mount_entry_t));
+    while (fgets(line, sizeof(line), f)) {
+        mount_entry_t m;
+        char root[FILELEN], mountpoint[FILELEN];
+
+        if (sscanf(line, "%*d %*d %u:%u %"FILELENSTR"s %"FILELENSTR"s",
+                   &m.major, &m.minor, root, mountpoint) != 4)
+            continue;
+        kp_mountinfo_unescape(root);
+        kp_mountinfo_unescape(mountpoint);
+        m.root = g_strdup(root);
+        m.mountpoint = g_strdup(mountpoint);
+        g_array_append_val(mounts, m);
+    }
+    fclose(f);
+    return mounts;
+}
+
+/**
+ * Is prefix a path prefix of path, ending at a component boundary?
+ * @return Length to skip in path, or -1
+ */
+static int
+path_prefix_len(const char *prefix, const char *path)
+{
+    size_t len = strlen(prefix);
+
+    if (len == 1 && prefix[0] == '/')
+        return 0;
+    if (strncmp(prefix, path, len) != 0)
+        return -1;
+    if (path[len] != '\0' && path[len] != '/')
+        return -1;
+    return (int)len;
+}
+
+/**
+ * a + b, where b is "" or starts with '/'
+ */
+static char *
+join_path(const char *a, const char *b)
+{
+    if (strcmp(a, "/") == 0)
+        return g_strdup(*b ? b : "/");
+    return g_strconcat(a, b, NULL);
+}
+
+/**
+ * Does path reach the file identified by id?
+ */
+static gboolean
+same_file(const char *path, const struct stat *id)
+{
+    struct stat st;
+
+    return strlen(path) < FILELEN && stat(path, &st) == 0 &&
+           st.st_dev == id->st_dev && st.st_ino == id->st_ino;
+}
+
+/**
+ * Candidate 3: map through their mount table onto ours
+ */
+static char *
+translate_mounts(kp_mntns_t *ns, const char *path, const struct stat *id)
+{
+    mount_entry_t *best = NULL;
+    int best_len = -1;
+    char *fs_path, *found = NULL;
+
+    if (!ns->mounts || !host_mounts)
+        return NULL;
+
+    /* Their mount covering path; later entries are stacked on top */
+    for (guint i = 0; i < ns->mounts->len; i++) {
+        mount_entry_t *m = &g_array_index(ns->mounts, mount_entry_t, i);
+        int len = path_prefix_len(m->mountpoint, path);
+        if (len >= best_len && len >= 0) {
+            best = m;
+            best_len = len;
+        }
+    }
+    if (!best)
+        return NULL;
+
+    fs_path = join_path(best->root, path + best_len);
+
+    /* Our mounts of the same filesystem whose root contains fs_path */
+    for (guint i = 0; i < host_mounts->len && !found; i++) {
+        mount_entry_t *m = &g_array_index(host_mounts, mount_entry_t, i);
+        int len;
+        char *candidate;
+
+        if (m->major != best->major || m->minor != best->minor)
+            continue;
+        len = path_prefix_len(m->root, fs_path);
+        if (len < 0)
+            continue;
+
+        candidate = join_path(m->mountpoint, fs_path + len);
+        if (same_file(candidate, id))
+            found = candidate;
+        else
+            g_free(candidate);
+    }
+
+    g_free(fs_path);
+    return found;
+}
+
+/**
+ * Drop namespaces nobody asked about for a while
+ */
+static gboolean
+mntns_idle(gpointer G_GNUC_UNUSED key, gpointer value, gpointer user_data)
+{
+    kp_mntns_t *ns = value;
+    gint64 now = *(gint64 *)user_data;
+
+    return now - ns->used > (gint64)MNTNS_IDLE_SEC * G_USEC_PER_SEC;
+}
+
+/**
+ * Re-read our own mount table when it is stale
+ */
+static void
+host_mounts_update(gint64 now)
+{
+    if (host_mounts && now - host_loaded < (gint64)MNTNS_TTL_SEC * G_USEC_PER_SEC)
+        return;
+
+    mounts_free(host_mounts);
+    host_mounts = read_mountinfo("/proc/self/mountinfo");
+    host_loaded = now;
+
+    /* Host paths may have moved with the mounts */
+    if (inodes)
+        g_hash_table_remove_all(inodes);
+    if (namespaces)
+        g_hash_table_foreach_remove(namespaces, mntns_idle, &now);
+}
+
+/**
+ * Look up the filesystem view of a process
+ */
+kp_mntns_t *
+kp_mntns_get(pid_t pid)
+{
+    char link[64], root[FILELEN];
+    struct stat st;
+    kp_mntns_t *ns;
+    ssize_t len;
+    gint64 now;
+    char *key;
+
+    if (!self_ns) {
+        if (stat("/proc/self/ns/mnt", &st) < 0)
+            return NULL;
+        self_ns = st.st_ino;
+    }
+
+    g_snprintf(link, sizeof(link), "/proc/%d/ns/mnt", pid);
+    if (stat(link, &st) < 0)
+        return NULL;
+
+    g_snprintf(link, sizeof(link), "/proc/%d/root", pid);
+    len = readlink(link, root, sizeof(root) - 1);
+    if (len <= 0)
+        return NULL;
+    root[len] = '\0';
+
+    if (st.st_ino == self_ns && strcmp(root, "/") == 0)
+        return NULL;
+
+    now = g_get_monotonic_time();
+    host_mounts_update(now);
+
+    if (!namespaces)
+        namespaces = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, mntns_free);
+
+    key = g_strdup_printf("%lu:%s", (unsigned long)st.st_ino, root);
+    ns = g_hash_table_lookup(namespaces, key);
+    if (!ns) {
+        ns = g_new0(kp_mntns_t, 1);
+        ns->key = key;
+        ns->root = g_strdup(root);
+        ns->foreign_ns = st.st_ino != self_ns;
+        ns->paths = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+        g_hash_table_insert(namespaces, ns->key, ns);
+        kp_debug("mntns: pid %d sees files through %s", pid, key);
+    } else {
+        g_free(key);
+    }
+
+    if (ns->foreign_ns &&
+        (!ns->mounts || now - ns->loaded > (gint64)MNTNS_TTL_SEC * G_USEC_PER_SEC)) {
+        g_snprintf(link, sizeof(link), "/proc/%d/mountinfo", pid);
+        mounts_free(ns->mounts);
+        ns->mounts = read_mountinfo(link);
+        ns->loaded = now;
+        g_hash_table_remove_all(ns->paths);
+    }
+    ns->used = now;
+
+    return ns;
+}
+
+/**
+ * Find a host path reaching the same file as path, and cache it
+ *
+ * @param id stat() of the file as the process sees it
+ */
+static char *
+host_path_of(kp_mntns_t *ns, pid_t pid, const char *path, const struct stat *id)
+{
+    const char *cached;
+    file_id_t fid;
+    char *host = NULL;
+
+    if (!inodes)
+        inodes = g_hash_table_new_full(file_id_hash, file_id_equal, g_free, g_free);
+    if (g_hash_table_size(inodes) >= MNTNS_CACHE_MAX)
+        g_hash_table_remove_all(inodes);
+
+    fid.dev = id->st_dev;
+    fid.ino = id->st_ino;
+    cached = g_hash_table_lookup(inodes, &fid);
+    if (cached && same_file(cached, id))
+        host = g_strdup(cached);
+
+    /* 1. Chroot in our namespace */
+    if (!host && !ns->foreign_ns) {
+        host = join_path(ns->root, path);
+        if (!same_file(host, id)) {
+            g_free(host);
+            host = NULL;
+        }
+    }
+
+    /* 2. Same path on the host (shared bind mounts) */
+    if (!host && same_file(path, id))
+        host = g_strdup(path);
+
+    /* 3. Through the mount tables */
+    if (!host && ns->foreign_ns)
+        host = translate_mounts(ns, path, id);
+
+    g_hash_table_insert(ns->paths, g_strdup(path), g_strdup(host ? host : MNTNS_UNREACHABLE));
+    if (host) {
+        file_id_t *k = g_new(file_id_t, 1);
+        *k = fid;
+        g_hash_table_insert(inodes, k, g_strdup(host));
+        if (strcmp(host, path) != 0)
+            kp_debug("mntns: %s → %s", path, host);
+    } else {
+        kp_debug("mntns: %s of pid %d is not reachable from the host", path, pid);
+    }
+
+    return host;
+}
+
+/**
+ * Cached translation of path, if there is one
+ * @return TRUE if *host was answered from the cache
+ */
+static gboolean
+host_path_cached(kp_mntns_t *ns, const char *path, char **host)
+{
+    const char *cached;
+
+    cached = g_hash_table_lookup(ns->paths, path);
+    if (cached) {
+        *host = *cached ? g_strdup(cached) : NULL;
+        return TRUE;
+    }
+
+    if (g_hash_table_size(ns->paths) >= MNTNS_CACHE_MAX)
+        g_hash_table_remove_all(ns->paths);
+    return FALSE;
+}
+
+/**
+ * Translate a path seen by pid into a host path to the same file
+ */
+char *
+kp_mntns_host_path(kp_mntns_t *ns, pid_t pid, const char *path,
+                   unsigned long start, unsigned long end)
+{
+    char probe[FILELEN + 64];
+    struct stat id;
+    char *host;
+
+    g_return_val_if_fail(ns, NULL);
+
+    if (host_path_cached(ns, path, &host))
+        return host;
+
+    /* Identity of the mapped file, as the process sees it */
+    g_snprintf(probe, sizeof(probe), "/proc/%d/map_files/%lx-%lx", pid, start, end);
+    if (stat(probe, &id) < 0) {
+        g_snprintf(probe, sizeof(probe), "/proc/%d/root%s", pid, path);
+        if (stat(probe, &id) < 0)
+            return NULL;    /* Process gone: do not cache */
+    }
+
+    return host_path_of(ns, pid, path, &id);
+}
+
+/**
+ * Translate the /proc/PID/exe target of pid into a host path
+ */
+char *
+kp_mntns_host_exe(kp_mntns_t *ns, pid_t pid, const char *path)
+{
+    char probe[FILELEN + 64];
+    struct stat id;
+    char *host;
+
+    g_return_val_if_fail(ns, NULL);
+
+    if (host_path_cached(ns, path, &host))
+        return host;
+
+    /* The exe link reaches the running binary even if path does not */
+    g_snprintf(probe, sizeof(probe), "/proc/%d/exe", pid);
+    if (stat(probe, &id) < 0) {
+        g_snprintf(probe, sizeof(probe), "/proc/%d/root%s", pid, path);
+        if (stat(probe, &id) < 0)
+            return NULL;    /* Process gone: do not cache */
+    }
+
+    return host_path_of(ns, pid, path, &id);
+}
@@ -0,0 +1,55 @@
+/* mntns.h - Mount-namespace aware path resolution for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef MNTNS_H
+#define MNTNS_H
+
+#include <sys/types.h>
+#include <glib.h>
+
+/* Mount namespace (or chroot) a process sees its files through */
+typedef struct _kp_mntns_t kp_mntns_t;
+
+/**
+ * Look up the view of the filesystem a process has
+ * @param pid Process ID
+ * @return Namespace handle owned by the module, or NULL if pid sees the
+ *         same paths as the daemon (same mount namespace and root)
+ */
+kp_mntns_t *kp_mntns_get(pid_t pid);
+
+/**
+ * Translate a path from a process's /proc/PID/maps into a path that
+ * reaches the same file (same st_dev/st_ino) from the daemon
+ *
+ * @param ns Namespace from kp_mntns_get()
+ * @param pid Process the path was seen in
+ * @param path Path as listed in /proc/PID/maps
+ * @param start Start address of the mapping (for /proc/PID/map_files)
+ * @param end End address of the mapping
+ * @return Newly allocated host path, or NULL if the file is not reachable
+ */
+char *kp_mntns_host_path(kp_mntns_t *ns, pid_t pid, const char *path,
+                         unsigned long start, unsigned long end);
+
+/**
+ * Translate the /proc/PID/exe target of a process into a host path
+ *
+ * As kp_mntns_host_path(), with the file identified through the exe
+ * link instead of a mapping.
+ *
+ * @param ns Namespace from kp_mntns_get()
+ * @param pid Process the exe path was read from
+ * @param path Target of /proc/PID/exe
+ * @return Newly allocated host path, or NULL if the file is not reachable
+ */
+char *kp_mntns_host_exe(kp_mntns_t *ns, pid_t pid, const char *path);
+
+#endif /* MNTNS_H */
@@ -32,7 +32,8 @@
  *   /proc/vmstat     - Virtual memory statistics (page in/out counts)
  *
  * DATA FLOW:
- *   kp_proc_foreach() → discovers processes → calls callback with (pid, exe_path)
+ *   kp_proc_snapshot() → discovers processes → (pid, exe_path) list
+ *   kp_proc_foreach() → snapshot + exeprefix filter → calls callback
  *   kp_proc_get_maps() → parses /proc/PID/maps → returns memory map regions
  *   kp_proc_get_memstat() → parses /proc/meminfo → returns memory stats
  *
@@ -51,6 +52,7 @@
 #include "common.h"
 #include "../utils/logging.h"
 #include "proc.h"
+#include "mntns.h"
 #include "../config/config.h"
 #include "../state/state.h"
 
@@ -120,35 +122,23 @@ sanitize_file(char *file)
  *   - "!/usr/share"   → Exclude files starting with /usr/share (! prefix)
  *
  * First matching prefix wins. If no prefix matches, file is accepted.
+ * The rule list is compiled into a prefix trie at config load (see
+ * compile_prefix_rules() in config.c), so this is one walk over the path
+ * instead of a strncmp per rule.
  *
- * @param file    Full path to check
- * @param prefix  NULL-terminated array of prefix rules, or NULL for no filtering
- * @return        TRUE to accept file, FALSE to reject
+ * @param file     Full path to check
+ * @param matcher  Compiled prefix rules, or NULL for no filtering
+ * @return         TRUE to accept file, FALSE to reject
  *
  * EXAMPLE PREFIXES:
  *   { "/usr", "!/usr/share", "/opt", NULL }
  *   → Accepts /usr/bin/foo, /opt/bar
  *   → Rejects /usr/share/icons/x.png, /home/user/app
  */
-static gboolean
-accept_file(char *file, char * const *prefix)
+static inline gboolean
+accept_file(const char *file, kp_path_matcher_t *matcher)
 {
-    if (prefix)
-        for (; *prefix; prefix++) {
-            const char *p = *prefix;
-            gboolean accept;
-            if (*p == '!') {
-                p++;
-                accept = FALSE;
-            } else {
-                accept = TRUE;
-            }
-            if (!strncmp(file, p, strlen(p)))
-                return accept;
-        }
-
-    /* Accept if no match */
-    return TRUE;
+    return kp_path_matcher_match(matcher, file, TRUE);
 }
 
 /**
@@ -171,6 +161,11 @@ accept_file(char *file, char * const *prefix)
  *   - Process exited between /proc scan and this call
  *   - Permission denied (process owned by different user)
  *   - /proc not mounted (unusual configuration)
+ *
+ * NAMESPACES:
+ *   For processes in another mount namespace or chroot, paths are
+ *   translated to host paths of the same inode (see mntns.c); maps that
+ *   cannot be reached from the host are skipped.
  */
 size_t
 kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
@@ -179,6 +174,7 @@ kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
     FILE *in;
     size_t size = 0;
     char buffer[1024];
+    kp_mntns_t *ns;
 
     g_snprintf(name, sizeof(name) - 1, "/proc/%d/maps", pid);
     in = fopen(name, "r");
@@ -192,6 +188,9 @@ kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
     if (exemaps)
         *exemaps = g_set_new();
 
+    /* Flatpak/containers/chroots: their paths are not ours */
+    ns = kp_mntns_get(pid);
+
     while (fgets(buffer, sizeof(buffer) - 1, in)) {
         char file[FILELEN];
         unsigned long start, end, offset;
@@ -202,13 +201,23 @@ kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
         count = sscanf(buffer, "%lx-%lx %*15s %lx %*x:%*x %*u %"FILELENSTR"s",
                        &start, &end, &offset, file);
 
-        if (count != 4 || !sanitize_file(file) || !accept_file(file, kp_conf->system.mapprefix))
+        if (count != 4 || !sanitize_file(file) || !accept_file(file, kp_conf->system.mapprefix_matcher))
             continue;
 
         /* BUG 2 FIX: Validate address range */
         if (end <= start)
             continue;
 
+        /* Store a path the daemon can open; prefixes were checked
+         * against the path as the app sees it */
+        if (ns) {
+            char *host = kp_mntns_host_path(ns, pid, file, start, end);
+            if (!host)
+                continue;
+            g_strlcpy(file, host, sizeof(file));
+            g_free(host);
+        }
+
         length = end - start;
         size += length;
 
@@ -221,6 +230,7 @@ kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps)
 
             if (maps) {
                 if (g_hash_table_lookup_extended(maps, map, &orig_map, &value)) {
+                    kp_map_add_alias((kp_map_t *)orig_map, file);
                     kp_map_free(map);
                     map = (kp_map_t *)orig_map;
                 }
@@ -254,32 +264,38 @@ all_digits(const char *s)
 }
 
 /**
- * Iterate over all running processes on the system
+ * Take a snapshot of all running processes on the system
  *
- * Scans /proc for numeric directories (PIDs), reads /proc/PID/exe to get
- * the executable path, and calls the callback for each valid process.
+ * Scans /proc for numeric directories (PIDs) and reads /proc/PID/exe to
+ * get the executable path. Touches neither the state nor the
+ * configuration, so the pipeline's scanner thread can run it.
  *
- * @param func       GHFunc callback: func(GINT_TO_POINTER(pid), exe_path, user_data)
- * @param user_data  Passed through to callback
+ * @return Snapshot, free with kp_proc_snapshot_free()
  *
  * SKIPPED PROCESSES:
  *   - Our own PID (self-preloading is pointless)
  *   - Kernel threads (no /proc/PID/exe symlink)
  *   - Processes that exit between scan and read
- *   - Files filtered by exeprefix configuration
+ *   - Deleted executables (prelink renames are mapped back)
  *
  * GRACEFUL DEGRADATION:
- *   If /proc cannot be opened (very unusual), logs a warning and returns.
- *   The daemon continues, hoping /proc becomes available next cycle.
+ *   If /proc cannot be opened (very unusual), logs a warning and returns
+ *   an empty snapshot. The daemon continues, hoping /proc becomes
+ *   available next cycle.
  */
-void
-kp_proc_foreach(GHFunc func, gpointer user_data)
+kp_proc_snapshot_t *
+kp_proc_snapshot(void)
 {
+    kp_proc_snapshot_t *snap;
     DIR *proc;
     struct dirent *entry;
     pid_t selfpid = getpid();
     static int proc_fail_logged = 0;
 
+    snap = g_slice_new(kp_proc_snapshot_t);
+    snap->procs = g_array_new(FALSE, FALSE, sizeof(kp_proc_entry_t));
+    snap->paths = g_string_chunk_new(4096);
+
     proc = opendir("/proc");
     if (!proc) {
         /* Graceful degradation: log once and skip this cycle */
@@ -287,7 +303,7 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
             g_warning("failed opening /proc: %s - will retry next cycle", strerror(errno));
             proc_fail_logged = 1;
         }
-        return;  /* Skip this scan cycle, don't crash */
+        return snap;  /* Skip this scan cycle, don't crash */
     }
 
     /* Reset failure counter on success */
@@ -298,6 +314,7 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
             pid_t pid;
             char name[32];
             char exe_buffer[FILELEN];
+            kp_proc_entry_t e;
             int len;
 
             pid = atoi(entry->d_name);
@@ -335,7 +352,7 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
                             
                             /* Only proceed if we got a valid path starting with / */
                             if (exe_buffer[0] == '/') {
-                                g_debug("Snap fallback: using cmdline for pid %d", pid);
+                                kp_debug("Snap fallback: using cmdline for pid %d", pid);
                                 goto process_exe;  /* Skip to processing */
                             }
                         }
@@ -345,7 +362,7 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
             }
             if (len == sizeof(exe_buffer)) {
                 /* Buffer overflow - path too long */
-                g_debug("exe path too long for pid %d", pid);
+                kp_debug("exe path too long for pid %d", pid);
                 continue;
             }
 
@@ -354,17 +371,65 @@ kp_proc_foreach(GHFunc func, gpointer user_data)
 process_exe:
             if (!sanitize_file(exe_buffer))
                 continue;
-            
-            if (!accept_file(exe_buffer, kp_conf->system.exeprefix))
-                continue;
 
-            func(GUINT_TO_POINTER(pid), exe_buffer, user_data);
+            e.pid = pid;
+            e.exe = g_string_chunk_insert(snap->paths, exe_buffer);
+            g_array_append_val(snap->procs, e);
         }
     }
 
     closedir(proc);
+    return snap;
+}
+
+/**
+ * Call func for each process of a snapshot that passes the exeprefix rules
+ *
+ * @param func       GHFunc callback: func(GINT_TO_POINTER(pid), exe_path, user_data)
+ * @param user_data  Passed through to callback
+ */
+void
+kp_proc_snapshot_foreach(const kp_proc_snapshot_t *snap, GHFunc func, gpointer user_data)
+{
+    for (guint i = 0; i < snap->procs->len; i++) {
+        kp_proc_entry_t *e = &g_array_index(snap->procs, kp_proc_entry_t, i);
+
+        if (!accept_file(e->exe, kp_conf->system.exeprefix_matcher))
+            continue;
+
+        func(GUINT_TO_POINTER(e->pid), e->exe, user_data);
+    }
+}
+
+void
+kp_proc_snapshot_free(kp_proc_snapshot_t *snap)
+{
+    if (!snap)
+        return;
+    g_array_free(snap->procs, TRUE);
+    g_string_chunk_free(snap->paths);
+    g_slice_free(kp_proc_snapshot_t, snap);
 }
 
+/**
+ * Iterate over all running processes on the system
+ *
+ * Snapshot of /proc, filtered by the exeprefix configuration, walked
+ * in the calling thread.
+ *
+ * @param func       GHFunc callback: func(GINT_TO_POINTER(pid), exe_path, user_data)
+ * @param user_data  Passed through to callback
+ */
+void
+kp_proc_foreach(GHFunc func, gpointer user_data)
+{
+    kp_proc_snapshot_t *snap = kp_proc_snapshot();
+
+    kp_proc_snapshot_foreach(snap, func, user_data);
+    kp_proc_snapshot_free(snap);
+}
+
+
 /* Macros for reading /proc files (VERBATIM from upstream) */
 #define open_file(filename) G_STMT_START {              \
     int fd, len;                                        \
@@ -383,6 +448,12 @@ process_exe:
     if (b) sscanf(b, tag" %d", &(v));                   \
 } G_STMT_END
 
+#define read_tag_ul(tag, v) G_STMT_START {              \
+    const char *b;                                      \
+    b = strstr(buf, tag" ");                            \
+    if (b) sscanf(b, tag" %lu", &(v));                  \
+} G_STMT_END
+
 #define read_tag2(tag, v1, v2) G_STMT_START {           \
     const char *b;                                      \
     b = strstr(buf, tag" ");                            \
@@ -407,14 +478,19 @@ process_exe:
  *   free     - Completely unused memory
  *   buffers  - File metadata cache
  *   cached   - Page cache (file contents)
+ *   available - Kernel estimate of memory available without swapping
  *   pagein   - Cumulative pages read from disk since boot
  *   pageout  - Cumulative pages written to disk since boot
+ *   active_file/inactive_file - The two LRU lists of the page cache
+ *   refault/activate/steal    - Page cache eviction and refault counters,
+ *                               the inputs of the budget model (budget.c)
  */
 void
 kp_proc_get_memstat(kp_memory_t *mem)
 {
     static int pagesize = 0;
-    char buf[4096];
+    unsigned long steal_direct = 0;
+    char buf[16384];    /* /proc/vmstat is well past 4 KB on recent kernels */
 
     memset(mem, 0, sizeof(*mem));
 
@@ -426,11 +502,30 @@ kp_proc_get_memstat(kp_memory_t *mem)
     read_tag("MemFree:", mem->free);
     read_tag("Buffers:", mem->buffers);
     read_tag("Cached:", mem->cached);
+    read_tag("MemAvailable:", mem->available);
+    read_tag("Active(file):", mem->active_file);
+    read_tag("Inactive(file):", mem->inactive_file);
 
     open_file("/proc/vmstat");
     read_tag("pgpgin", mem->pagein);
     read_tag("pgpgout", mem->pageout);
 
+    /* Split into _anon/_file since Linux 5.9 */
+    read_tag_ul("workingset_refault_file", mem->refault);
+    if (!mem->refault)
+        read_tag_ul("workingset_refault", mem->refault);
+    read_tag_ul("workingset_activate_file", mem->activate);
+    if (!mem->activate)
+        read_tag_ul("workingset_activate", mem->activate);
+
+    /* pgsteal_file since Linux 5.8; anon included before that */
+    read_tag_ul("pgsteal_file", mem->steal);
+    if (!mem->steal) {
+        read_tag_ul("pgsteal_kswapd", mem->steal);
+        read_tag_ul("pgsteal_direct", steal_direct);
+        mem->steal += steal_direct;
+    }
+
     if (!mem->pagein) {
         open_file("/proc/stat");
         read_tag2("page", mem->pagein, mem->pageout);
@@ -438,6 +533,9 @@ kp_proc_get_memstat(kp_memory_t *mem)
 
     mem->pagein *= pagesize / 1024;
     mem->pageout *= pagesize / 1024;
+    mem->refault *= pagesize / 1024;
+    mem->activate *= pagesize / 1024;
+    mem->steal *= pagesize / 1024;
 
     if (!mem->total || !mem->pagein)
         g_warning("failed to read memory stat, is /proc mounted?");
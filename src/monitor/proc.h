@@ -25,10 +25,19 @@ typedef struct _kp_memory_t
     int free;       /* Free memory */
     int buffers;    /* Buffers memory */
     int cached;     /* Page-cache memory */
+    int available;  /* MemAvailable estimate (0 before Linux 3.14) */
 
     int pagein;     /* Total data paged (read) in since boot */
     int pageout;    /* Total data paged (written) out since boot */
 
+    int active_file;    /* Active(file): recently used page cache */
+    int inactive_file;  /* Inactive(file): page cache next in line for reclaim */
+
+    /* Cumulative since boot, in kilobytes (0 when the kernel lacks them) */
+    unsigned long refault;  /* workingset_refault_file: evicted pages read back */
+    unsigned long activate; /* workingset_activate_file: ...that were still in use */
+    unsigned long steal;    /* pgsteal_file (or kswapd + direct): pages reclaimed */
+
 } kp_memory_t;
 
 /**
@@ -49,6 +58,51 @@ void kp_proc_get_memstat(kp_memory_t *mem);
  */
 size_t kp_proc_get_maps(pid_t pid, GHashTable *maps, GSet **exemaps);
 
+/**
+ * One running process of a snapshot
+ */
+typedef struct _kp_proc_entry_t
+{
+    pid_t pid;
+    char *exe;          /* Executable path (in the snapshot's string chunk) */
+} kp_proc_entry_t;
+
+/**
+ * kp_proc_snapshot_t: Running processes at one point in time
+ *
+ * Immutable once taken; owned by whoever holds it, so it can be taken on
+ * one thread and consumed on another.
+ */
+typedef struct _kp_proc_snapshot_t
+{
+    GArray *procs;          /* kp_proc_entry_t */
+    GStringChunk *paths;
+} kp_proc_snapshot_t;
+
+/**
+ * Scan /proc for running processes and their executables
+ *
+ * Reads neither state nor configuration (safe on any thread); the
+ * exeprefix rules are applied by kp_proc_snapshot_foreach().
+ *
+ * @return Snapshot, free with kp_proc_snapshot_free()
+ */
+kp_proc_snapshot_t *kp_proc_snapshot(void);
+
+/**
+ * Iterate over the processes of a snapshot accepted by system.exeprefix
+ *
+ * @param snap Snapshot from kp_proc_snapshot()
+ * @param func Callback function (pid as key, exe path as value)
+ * @param user_data Data to pass to callback
+ */
+void kp_proc_snapshot_foreach(const kp_proc_snapshot_t *snap, GHFunc func, gpointer user_data);
+
+/**
+ * Free a snapshot from kp_proc_snapshot()
+ */
+void kp_proc_snapshot_free(kp_proc_snapshot_t *snap);
+
 /**
  * Iterate over all running processes
  * (VERBATIM signature from upstream)
@@ -19,8 +19,9 @@
  * TWO-PHASE SCANNING:
  *   The daemon calls these functions in sequence each cycle:
  *
- *   PHASE 1 - kp_spy_scan():
- *     Called at start of cycle. Scans /proc for running processes and:
+ *   PHASE 1 - kp_spy_scan() / kp_spy_scan_snapshot():
+ *     Called at start of cycle. Scans /proc for running processes (or
+ *     takes the pipeline scanner's snapshot) and:
  *     - Updates timestamps for already-known executables
  *     - Queues newly-discovered executables for evaluation
  *     - Identifies executables that stopped running
@@ -48,11 +49,14 @@
 
 #include "common.h"
 #include "spy.h"
+#include "../utils/logging.h"
 #include "../config/config.h"
 #include "../state/state.h"
 #include "../daemon/stats.h"
 #include "../utils/desktop.h"
 #include "proc.h"
+#include "mntns.h"
+#include "identity.h"
 #include <math.h>
 
 /*
@@ -291,7 +295,7 @@ track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid)
      */
     if (!proc_info->user_initiated && kp_desktop_has_file(exe->path)) {
         proc_info->user_initiated = TRUE;
-        g_debug("Desktop app fallback: %s (pid %d)", exe->path, pid);
+        kp_debug("Desktop app fallback: %s (pid %d)", exe->path, pid);
     }
     
     /* Multi-process app handling: only count first user-initiated instance as
@@ -302,8 +306,8 @@ track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid)
             /* This is the first user-initiated instance - it's a real launch */
             is_new_launch = TRUE;
             exe->raw_launches++;
-            g_debug("Launch detected: %s (pid %d, first user-initiated)",
-                    exe->path, pid);
+            kp_debug("Launch detected: %s (pid %d, first user-initiated)",
+                     exe->path, pid);
             
             /* Record hit or miss for stats tracking */
             if (kp_stats_is_app_preloaded(exe->path)) {
@@ -313,12 +317,12 @@ track_process_start(kp_exe_t *exe, pid_t pid, pid_t parent_pid)
             }
         } else {
             /* Already have a user-initiated instance - this is a worker process */
-            g_debug("Worker process detected: %s (pid %d, user-initiated instance already running)",
-                    exe->path, pid);
+            kp_debug("Worker process detected: %s (pid %d, user-initiated instance already running)",
+                     exe->path, pid);
         }
     } else {
-        g_debug("Child process detected: %s (pid %d, parent %d)",
-                exe->path, pid, parent_pid);
+        kp_debug("Child process detected: %s (pid %d, parent %d)",
+                 exe->path, pid, parent_pid);
     }
     
     g_hash_table_insert(exe->running_pids, GINT_TO_POINTER(pid), proc_info);
@@ -360,8 +364,8 @@ track_process_exit(kp_exe_t *exe, pid_t pid)
         final_weight = calculate_launch_weight((time_t)unaccounted_duration, 
                                                proc_info->user_initiated);
         exe->weighted_launches += final_weight;
-        g_debug("Exit weight for %s (pid %d): +%.2f (unaccounted %lds)",
-                exe->path, pid, final_weight, (long)unaccounted_duration);
+        kp_debug("Exit weight for %s (pid %d): +%.2f (unaccounted %lds)",
+                 exe->path, pid, final_weight, (long)unaccounted_duration);
     }
     
     exe->total_duration_sec += (unsigned long)total_duration;
@@ -468,10 +472,25 @@ update_running_weights(kp_exe_t *exe)
 static void
 running_process_callback(pid_t pid, const char *path)
 {
+    kp_mntns_t *ns;
+    char *host = NULL;
     kp_exe_t *exe;
 
     g_return_if_fail(path);
 
+    /* Flatpak/containers/chroots: key by the host path of the binary,
+     * as their maps are */
+    ns = kp_mntns_get(pid);
+    if (ns) {
+        host = kp_mntns_host_exe(ns, pid, path);
+        if (!host)
+            return;
+        path = host;
+    }
+
+    /* Interpreters are keyed by the app they run */
+    path = kp_identity_resolve(pid, path);
+
     exe = g_hash_table_lookup(kp_state->exes, path);
     if (exe) {
         /* Already existing exe */
@@ -495,6 +514,8 @@ running_process_callback(pid_t pid, const char *path)
         /* An exe we have never seen before, just queue it */
         g_hash_table_insert(new_exes, g_strdup(path), GUINT_TO_POINTER(pid));
     }
+
+    g_free(host);
 }
 
 /**
@@ -510,6 +531,33 @@ already_running_exe_callback(kp_exe_t *exe)
         state_changed_exes = g_slist_prepend(state_changed_exes, exe);
 }
 
+/**
+ * Add the script/jar/asar behind an interpreter app key as a whole-file map
+ */
+static void
+add_identity_target(pid_t pid, const char *key, GSet *exemaps)
+{
+    char *target = kp_identity_target(pid, key);
+    struct stat st;
+    kp_map_t *map;
+    gpointer orig_map, value;
+
+    if (!target)
+        return;
+
+    if (stat(target, &st) == 0 && st.st_size > 0 &&
+        kp_path_matcher_match(kp_conf->system.mapprefix_matcher, target, TRUE)) {
+        map = kp_map_new(target, 0, st.st_size);
+        if (g_hash_table_lookup_extended(kp_state->maps, map, &orig_map, &value)) {
+            kp_map_add_alias((kp_map_t *)orig_map, target);
+            kp_map_free(map);
+            map = (kp_map_t *)orig_map;
+        }
+        g_set_add(exemaps, kp_exemap_new(map));
+    }
+    g_free(target);
+}
+
 /**
  * There is an exe we've never seen before. Check if it's a piggy one or not.
  * If yes, add it to our farm, add it to the blacklist otherwise.
@@ -540,6 +588,9 @@ new_exe_callback(char *path, pid_t pid)
             return;
         }
 
+        /* Scripts and jars are read(), not mapped: add the app's own file */
+        add_identity_target(pid, path, exemaps);
+
         exe = kp_exe_new(path, TRUE, exemaps);
         kp_state_register_exe(exe, TRUE);
         kp_state->running_exes = g_slist_prepend(kp_state->running_exes, exe);
@@ -605,6 +656,16 @@ already_running_exe_callback_wrapper(gpointer data, gpointer user_data)
 
 void
 kp_spy_scan(gpointer data)
+{
+    kp_proc_snapshot_t *snap = kp_proc_snapshot();
+
+    (void)data;
+    kp_spy_scan_snapshot(snap);
+    kp_proc_snapshot_free(snap);
+}
+
+void
+kp_spy_scan_snapshot(const kp_proc_snapshot_t *snap)
 {
     /* Scan processes */
     state_changed_exes = new_running_exes = NULL;
@@ -620,11 +681,12 @@ kp_spy_scan(gpointer data)
     }
 
     /* Mark each running exe with fresh timestamp */
-    kp_proc_foreach(running_process_callback_wrapper, data);
+    kp_proc_snapshot_foreach(snap, running_process_callback_wrapper, NULL);
+    kp_identity_sweep();
     kp_state->last_running_timestamp = kp_state->time;
 
     /* Figure out who's not running by checking their timestamp */
-    g_slist_foreach(kp_state->running_exes, already_running_exe_callback_wrapper, data);
+    g_slist_foreach(kp_state->running_exes, already_running_exe_callback_wrapper, NULL);
 
     /* Update weights for running processes */
     g_hash_table_iter_init(&iter, kp_state->exes);
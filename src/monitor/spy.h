@@ -13,16 +13,34 @@
 #ifndef SPY_H
 #define SPY_H
 
+#include <sys/types.h>
+#include <glib.h>
+#include "proc.h"
+
 /**
  * Scan running processes
  * (VERBATIM signature from upstream preload_spy_scan)
  */
 void kp_spy_scan(gpointer data);
 
+/**
+ * Scan running processes from a snapshot taken elsewhere
+ * (the pipeline's scanner thread)
+ *
+ * @param snap Snapshot from kp_proc_snapshot()
+ */
+void kp_spy_scan_snapshot(const kp_proc_snapshot_t *snap);
+
 /**
  * Update prediction model
  * (VERBATIM signature from upstream preload_spy_update_model)
  */
 void kp_spy_update_model(gpointer data);
 
+/**
+ * Get parent PID of a process from /proc/PID/stat
+ * @return Parent PID, or 0 if it could not be determined
+ */
+pid_t get_parent_pid(pid_t pid);
+
 #endif /* SPY_H */
@@ -0,0 +1,214 @@
+/* budget.c - Refault-aware preload memory budget for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Budget Model
+ * =============================================================================
+ *
+ * The memtotal/memfree/memcached formula only looks at how much memory
+ * there is, not at whether the page cache is under pressure. Preloading
+ * 500 MB into a cache that is already being reclaimed evicts pages some
+ * running program needs, which the kernel then reads back (refaults).
+ *
+ * The kernel's workingset detection tells us exactly that. Per cycle the
+ * model takes the deltas of three /proc/vmstat counters:
+ *
+ *   pgsteal_file               file pages reclaimed
+ *   workingset_refault_file    ...of which were read back in soon after
+ *   workingset_activate_file   ...and were hot enough to go straight to
+ *                              the active list: the working set itself
+ *
+ * and adapts a scale factor on the formula budget (AIMD):
+ *
+ *   activate ≥ 10% of steal    THRASHING    factor × 0.5
+ *   refault  ≥ 25% of steal    REFAULTING   factor × 0.85
+ *   steal ≈ 0, refault ≈ 0     COLD         factor + 0.1
+ *   otherwise                  STEADY       factor → 1.0 by 0.05
+ *   (rates under BUDGET_NOISE_KBPS count as zero)
+ *
+ *   factor ∈ [0.1, 2.0]
+ *
+ *   budget = base × factor                      factor ≤ 1
+ *          = base + min((factor - 1) × base,    factor > 1: only pages
+ *                       Inactive(file) / 2)     nobody touches are displaced
+ *   budget ≤ MemAvailable
+ *
+ * Inputs, state, factor and the budget handed out go to the stats file.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "budget.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+
+#define BUDGET_NOISE_KBPS       64.0    /* Rates below this are background noise */
+#define BUDGET_THRASH_RATIO     0.10    /* activate / steal */
+#define BUDGET_REFAULT_RATIO    0.25    /* refault / steal */
+
+#define BUDGET_FACTOR_MIN       0.1
+#define BUDGET_FACTOR_MAX       2.0
+#define BUDGET_SHRINK_THRASH    0.5
+#define BUDGET_SHRINK_REFAULT   0.85
+#define BUDGET_GROW_STEP        0.1
+#define BUDGET_RELAX_STEP       0.05
+
+#define BUDGET_MIN_INTERVAL     1       /* seconds: shorter samples are ignored */
+#define BUDGET_MAX_INTERVAL     600     /* seconds: longer gaps start over */
+
+static struct {
+    gboolean have_prev;
+    gint64 prev_time;       /* g_get_monotonic_time() of the previous sample */
+    unsigned long prev_refault;
+    unsigned long prev_activate;
+    unsigned long prev_steal;
+    kp_budget_model_t model;
+} bm = { FALSE, 0, 0, 0, 0, { KP_BUDGET_WARMUP, 0, 0, 0, 0, 0, 1.0, 0, 0 } };
+
+static void
+budget_remember(const kp_memory_t *mem, gint64 now)
+{
+    bm.have_prev = TRUE;
+    bm.prev_time = now;
+    bm.prev_refault = mem->refault;
+    bm.prev_activate = mem->activate;
+    bm.prev_steal = mem->steal;
+}
+
+/**
+ * Classify the last interval and adapt the factor
+ */
+static kp_budget_state_t
+budget_adapt(kp_budget_model_t *m)
+{
+    double steal = MAX(m->steal_rate, BUDGET_NOISE_KBPS);
+
+    if (m->activate_rate >= BUDGET_NOISE_KBPS &&
+        m->activate_rate >= BUDGET_THRASH_RATIO * steal) {
+        m->factor *= BUDGET_SHRINK_THRASH;
+        return KP_BUDGET_THRASHING;
+    }
+    if (m->refault_rate >= BUDGET_NOISE_KBPS &&
+        m->refault_rate >= BUDGET_REFAULT_RATIO * steal) {
+        m->factor *= BUDGET_SHRINK_REFAULT;
+        return KP_BUDGET_REFAULTING;
+    }
+    if (m->steal_rate < BUDGET_NOISE_KBPS && m->refault_rate < BUDGET_NOISE_KBPS) {
+        m->factor += BUDGET_GROW_STEP;
+        return KP_BUDGET_COLD;
+    }
+
+    if (m->factor > 1.0)
+        m->factor = MAX(1.0, m->factor - BUDGET_RELAX_STEP);
+    else
+        m->factor = MIN(1.0, m->factor + BUDGET_RELAX_STEP);
+    return KP_BUDGET_STEADY;
+}
+
+void
+kp_budget_update(const kp_memory_t *mem)
+{
+    kp_budget_model_t *m = &bm.model;
+    gint64 now = g_get_monotonic_time();
+    double dt;
+
+    g_return_if_fail(mem);
+
+    m->available = mem->available;
+    m->inactive_file = mem->inactive_file;
+
+    dt = (double)(now - bm.prev_time) / G_USEC_PER_SEC;
+    if (bm.have_prev && dt < BUDGET_MIN_INTERVAL)
+        return;
+
+    /* First sample, long gap (suspend, pause) or counters went back */
+    if (!bm.have_prev || dt > BUDGET_MAX_INTERVAL ||
+        mem->refault < bm.prev_refault || mem->activate < bm.prev_activate ||
+        mem->steal < bm.prev_steal) {
+        budget_remember(mem, now);
+        m->refault_rate = m->activate_rate = m->steal_rate = 0;
+        m->state = kp_conf->model.memadapt ? KP_BUDGET_WARMUP : KP_BUDGET_OFF;
+        return;
+    }
+
+    m->refault_rate = (mem->refault - bm.prev_refault) / dt;
+    m->activate_rate = (mem->activate - bm.prev_activate) / dt;
+    m->steal_rate = (mem->steal - bm.prev_steal) / dt;
+    budget_remember(mem, now);
+
+    if (!kp_conf->model.memadapt) {
+        m->state = KP_BUDGET_OFF;
+        m->factor = 1.0;
+        return;
+    }
+
+    m->state = budget_adapt(m);
+    m->factor = CLAMP(m->factor, BUDGET_FACTOR_MIN, BUDGET_FACTOR_MAX);
+
+    kp_debug("budget model: %s, factor %.2f (refault %.0f, activate %.0f, steal %.0f KB/s; "
+             "%d KB available, %d KB inactive file)",
+             kp_budget_state_name(m->state), m->factor, m->refault_rate,
+             m->activate_rate, m->steal_rate, m->available, m->inactive_file);
+}
+
+long
+kp_budget_apply(long base, const kp_memory_t *mem)
+{
+    const kp_budget_model_t *m = &bm.model;
+    long budget;
+
+    g_return_val_if_fail(mem, base);
+
+    if (!kp_conf->model.memadapt)
+        return base;
+
+    if (m->factor <= 1.0) {
+        budget = (long)(base * m->factor);
+    } else {
+        /* Grow into the cold part of the cache only */
+        long extra = (long)(base * (m->factor - 1.0));
+        budget = base + MIN(extra, (long)mem->inactive_file / 2);
+    }
+
+    if (mem->available > 0)
+        budget = MIN(budget, (long)mem->available);
+
+    return MAX(0, budget);
+}
+
+long
+kp_budget_scale(long base, const kp_memory_t *mem)
+{
+    g_return_val_if_fail(mem, base);
+
+    bm.model.base = base;
+    bm.model.budget = kp_budget_apply(base, mem);
+    return bm.model.budget;
+}
+
+const kp_budget_model_t *
+kp_budget_model(void)
+{
+    return &bm.model;
+}
+
+const char *
+kp_budget_state_name(kp_budget_state_t state)
+{
+    switch (state) {
+        case KP_BUDGET_WARMUP:      return "warmup";
+        case KP_BUDGET_COLD:        return "cold";
+        case KP_BUDGET_STEADY:      return "steady";
+        case KP_BUDGET_REFAULTING:  return "refaulting";
+        case KP_BUDGET_THRASHING:   return "thrashing";
+        case KP_BUDGET_OFF:         return "off";
+    }
+    return "unknown";
+}
@@ -0,0 +1,86 @@
+/* budget.h - Refault-aware preload memory budget for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <glib.h>
+#include "../monitor/proc.h"
+
+/* What the last sample said about the page cache */
+typedef enum {
+    KP_BUDGET_WARMUP = 0,   /* No rates yet (first sample, counters reset) */
+    KP_BUDGET_COLD,         /* Hardly any reclaim: the inactive list is idle */
+    KP_BUDGET_STEADY,       /* Reclaim without notable refaults */
+    KP_BUDGET_REFAULTING,   /* Evicted pages are being read back */
+    KP_BUDGET_THRASHING,    /* ...and they were part of the working set */
+    KP_BUDGET_OFF           /* model.memadapt is off */
+} kp_budget_state_t;
+
+/* Inputs and output of the budget model, as last computed */
+typedef struct _kp_budget_model_t
+{
+    kp_budget_state_t state;
+
+    /* Inputs (kilobytes, rates in KB/s over the last sample interval) */
+    int available;          /* MemAvailable */
+    int inactive_file;      /* Inactive(file) */
+    double refault_rate;    /* workingset_refault_file */
+    double activate_rate;   /* workingset_activate_file */
+    double steal_rate;      /* pgsteal (file pages) */
+
+    /* Output */
+    double factor;          /* Scale applied to the formula budget */
+    long base;              /* memtotal/memfree/memcached formula, KB */
+    long budget;            /* Budget handed out, KB */
+} kp_budget_model_t;
+
+/**
+ * Feed a new memory sample to the model and adapt its scale factor
+ *
+ * Call once per prediction cycle, with a fresh kp_proc_get_memstat().
+ * @param mem Memory statistics
+ */
+void kp_budget_update(const kp_memory_t *mem);
+
+/**
+ * Apply the model to a formula budget
+ *
+ * Shrinks the budget while refaults show preloading evicts a working set,
+ * grows it (by at most half of Inactive(file)) while the inactive list is
+ * cold, and never exceeds MemAvailable. Returns base unchanged when
+ * model.memadapt is off.
+ *
+ * @param base Budget from the memtotal/memfree/memcached formula, in KB
+ * @param mem  Memory statistics the base was computed from
+ * @return Budget in kilobytes
+ */
+long kp_budget_scale(long base, const kp_memory_t *mem);
+
+/**
+ * Apply the model to a budget without recording it
+ *
+ * Same result as kp_budget_scale(), but the model's base and budget (what
+ * the stats report) stay those of the last prediction cycle. For
+ * out-of-cycle replays: boot plan, cache snapshot, rewarm, idle tier.
+ */
+long kp_budget_apply(long base, const kp_memory_t *mem);
+
+/**
+ * Model inputs and the last budget, for statistics
+ */
+const kp_budget_model_t *kp_budget_model(void);
+
+/**
+ * Short name of a model state, for logs and stats
+ */
+const char *kp_budget_state_name(kp_budget_state_t state);
+
+#endif /* BUDGET_H */
@@ -0,0 +1,575 @@
+/* idle.c - Idle-time opportunistic preloading for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Idle Tier
+ * =============================================================================
+ *
+ * The normal cycle only spends its budget on maps with lnprob < 0, and
+ * observation-pool apps never get a Markov bid, so they are essentially
+ * never preloaded - even after the machine has sat idle for an hour. The
+ * idle tier uses such quiet periods to read the next-best candidates.
+ *
+ * IDLE DETECTION (kp_idle_tick, once per cycle):
+ *   busiest disk utilization  (/proc/diskstats io_ticks)  < IDLE_DISK_UTIL
+ *   IO pressure "some avg10"  (/proc/pressure/io)         < IDLE_IO_PSI
+ *   1-minute load per CPU     (/proc/loadavg)              < IDLE_LOAD_PER_CPU
+ *   ... held for system.idlewait seconds  →  start one run
+ *
+ * CANDIDATES (snapshotted when a run starts, paths copied):
+ *   1. predicted maps (lnprob < 0) - the tail the normal budget cut off
+ *   2. maps of idle exes of either pool, most weighted launches first
+ *   capped at IDLE_MAX_MAPS; running and blacklisted exes are skipped,
+ *   and so are maps off local filesystems (the residency probe opens the
+ *   file on the main loop)
+ *
+ * RUN (GLib timer, one chunk every IDLE_CHUNK_INTERVAL_MS):
+ *   ┌─────────────────────────────────────────────────────────────┐
+ *   │ other I/O since last chunk > IDLE_DEMAND_BYTES → abort      │
+ *   │ load per CPU over threshold, pause active      → abort      │
+ *   │ next ≤ IDLE_CHUNK_BYTES of the current map:                  │
+ *   │   resident (cachestat/mincore) → skip, no budget charged     │
+ *   │   else readahead at IOPRIO_CLASS_IDLE, charge idle budget    │
+ *   │ budget (min(system.idlebudget, memavail)) or list exhausted  │
+ *   │                                               → done         │
+ *   └─────────────────────────────────────────────────────────────┘
+ *   After a run ends, the system must go busy and idle again before the
+ *   next one starts.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "idle.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../daemon/pause.h"
+#include "../daemon/power.h"
+#include "../readahead/readahead.h"
+#include "../readahead/cachesnap.h"
+#include "../readahead/fsclass.h"
+#include "../readahead/reclaim.h"
+
+/* Idleness thresholds */
+#define IDLE_DISK_UTIL 5            /* % of the cycle the busiest disk was busy */
+#define IDLE_IO_PSI 1.0             /* % IO pressure (some, avg10) */
+#define IDLE_LOAD_PER_CPU 0.3       /* 1-minute loadavg / online CPUs */
+
+/* Chunking */
+#define IDLE_CHUNK_BYTES (1024 * 1024)
+#define IDLE_CHUNK_INTERVAL_MS 100
+
+/* Foreign I/O between two chunks that counts as real demand */
+#define IDLE_DEMAND_BYTES (512 * 1024)
+
+/* Upper bound on candidate maps per run */
+#define IDLE_MAX_MAPS 1024
+
+/* One candidate range, copied out of the model so the run survives
+ * maps being freed while it is in progress */
+typedef struct {
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    size_t offset;
+    size_t length;
+} idle_range_t;
+
+/* Cumulative counters over all whole disks */
+typedef struct {
+    guint64 read_sectors;
+    guint64 write_sectors;
+    GHashTable *io_ticks;       /* disk name → io_ticks (per-disk deltas) */
+} disk_sample_t;
+
+static struct {
+    /* Idle detection */
+    gboolean sampled;           /* prev_disk/prev_time valid */
+    disk_sample_t prev_disk;
+    gint64 prev_time;           /* g_get_monotonic_time() of prev_disk */
+    gint64 idle_since;          /* 0 = not idle */
+    gboolean spent;             /* A run finished in this idle period */
+
+    /* Current run */
+    guint timer;                /* GLib source, 0 = not running */
+    GArray *ranges;             /* idle_range_t */
+    guint next;                 /* Current range index */
+    size_t cursor;              /* Offset into the current range */
+    long budget;                /* KB left */
+    long used;                  /* KB read so far */
+    guint64 owed_sectors;       /* Our reads not yet seen in diskstats */
+} idle_state = {0};
+
+/* Whole-disk decision per diskstats name (partitions, loop, ram... = no) */
+static GHashTable *whole_disks = NULL;
+
+/**
+ * Is this diskstats entry a physical whole disk?
+ */
+static gboolean
+is_whole_disk(const char *name)
+{
+    gpointer cached;
+    gboolean whole;
+    char *sys;
+
+    if (!whole_disks)
+        whole_disks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    if (g_hash_table_lookup_extended(whole_disks, name, NULL, &cached))
+        return GPOINTER_TO_INT(cached);
+
+    /* Stacked and memory-backed devices would count the same I/O twice
+     * or none at all */
+    if (g_str_has_prefix(name, "loop") || g_str_has_prefix(name, "ram") ||
+        g_str_has_prefix(name, "zram") || g_str_has_prefix(name, "dm-") ||
+        g_str_has_prefix(name, "md")) {
+        whole = FALSE;
+    } else {
+        /* Partitions only appear under their parent in /sys/block */
+        sys = g_strconcat("/sys/block/", name, NULL);
+        whole = access(sys, F_OK) == 0;
+        g_free(sys);
+    }
+
+    g_hash_table_insert(whole_disks, g_strdup(name), GINT_TO_POINTER(whole));
+    return whole;
+}
+
+/**
+ * Read cumulative I/O counters of all whole disks
+ */
+static gboolean
+read_diskstats(disk_sample_t *ds)
+{
+    FILE *f;
+    char line[512];
+
+    memset(ds, 0, sizeof(*ds));
+    f = fopen("/proc/diskstats", "r");
+    if (!f)
+        return FALSE;
+
+    ds->io_ticks = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+    while (fgets(line, sizeof(line), f)) {
+        unsigned int major, minor;
+        char name[64];
+        unsigned long long rd, rd_merged, rd_sectors, rd_ticks;
+        unsigned long long wr, wr_merged, wr_sectors, wr_ticks;
+        unsigned long long in_flight, io_ticks;
+        guint64 *ticks;
+
+        if (sscanf(line, "%u %u %63s %llu %llu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &major, &minor, name, &rd, &rd_merged, &rd_sectors, &rd_ticks,
+                   &wr, &wr_merged, &wr_sectors, &wr_ticks,
+                   &in_flight, &io_ticks) != 13)
+            continue;
+        if (!is_whole_disk(name))
+            continue;
+
+        ds->read_sectors += rd_sectors;
+        ds->write_sectors += wr_sectors;
+        ticks = g_new(guint64, 1);
+        *ticks = io_ticks;
+        g_hash_table_insert(ds->io_ticks, g_strdup(name), ticks);
+    }
+    fclose(f);
+    return TRUE;
+}
+
+static void
+disk_sample_clear(disk_sample_t *ds)
+{
+    if (ds->io_ticks)
+        g_hash_table_destroy(ds->io_ticks);
+    ds->io_ticks = NULL;
+}
+
+/**
+ * Busy time (ms) of the busiest disk between two samples
+ */
+static guint64
+busiest_disk_ms(const disk_sample_t *prev, const disk_sample_t *cur)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    guint64 busiest = 0;
+
+    g_hash_table_iter_init(&iter, cur->io_ticks);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        guint64 *before = g_hash_table_lookup(prev->io_ticks, key);
+        guint64 now = *(guint64 *)value;
+
+        if (before && now >= *before && now - *before > busiest)
+            busiest = now - *before;
+    }
+    return busiest;
+}
+
+/**
+ * IO pressure, "some" avg10, in percent (0 if PSI is unavailable)
+ */
+static double
+read_io_pressure(void)
+{
+    FILE *f;
+    double avg10 = 0;
+
+    f = fopen("/proc/pressure/io", "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "some avg10=%lf", &avg10) != 1)
+        avg10 = 0;
+    fclose(f);
+    return avg10;
+}
+
+/**
+ * 1-minute load average per online CPU
+ */
+static double
+read_load_per_cpu(void)
+{
+    FILE *f;
+    double load1 = 0;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+    f = fopen("/proc/loadavg", "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "%lf", &load1) != 1)
+        load1 = 0;
+    fclose(f);
+    return load1 / MAX(cpus, 1);
+}
+
+/* ========================================================================
+ * RUN
+ * ======================================================================== */
+
+static void
+idle_ranges_free(void)
+{
+    if (!idle_state.ranges)
+        return;
+    for (guint i = 0; i < idle_state.ranges->len; i++)
+        g_free(g_array_index(idle_state.ranges, idle_range_t, i).path);
+    g_array_free(idle_state.ranges, TRUE);
+    idle_state.ranges = NULL;
+}
+
+/**
+ * End the current run
+ * @param from_timer TRUE when called from idle_chunk(), whose FALSE return
+ *                   removes the source
+ */
+static void
+idle_finish(const char *why, gboolean from_timer)
+{
+    if (!idle_state.timer)
+        return;
+
+    if (!from_timer)
+        g_source_remove(idle_state.timer);
+    idle_state.timer = 0;
+
+    g_message("idle preload %s: %ldkb read, %u of %u candidates done",
+              why, idle_state.used, idle_state.next,
+              idle_state.ranges ? idle_state.ranges->len : 0);
+
+    idle_ranges_free();
+    idle_state.spent = TRUE;
+
+    /* Our own reads must not count against the next idle period */
+    idle_state.sampled = FALSE;
+    idle_state.idle_since = 0;
+}
+
+/**
+ * Has anything but us used the disk or CPU since the last chunk?
+ */
+static gboolean
+demand_appeared(void)
+{
+    disk_sample_t ds;
+    guint64 reads, writes, foreign;
+
+    if (read_load_per_cpu() >= IDLE_LOAD_PER_CPU)
+        return TRUE;
+
+    if (!read_diskstats(&ds))
+        return FALSE;
+
+    reads = ds.read_sectors - MIN(ds.read_sectors, idle_state.prev_disk.read_sectors);
+    writes = ds.write_sectors - MIN(ds.write_sectors, idle_state.prev_disk.write_sectors);
+
+    /* Our readahead completes asynchronously; reads up to what we issued
+     * are ours, and what is left is carried to the next chunk */
+    foreign = reads > idle_state.owed_sectors ? reads - idle_state.owed_sectors : 0;
+    idle_state.owed_sectors -= MIN(reads, idle_state.owed_sectors);
+
+    disk_sample_clear(&idle_state.prev_disk);
+    idle_state.prev_disk = ds;
+
+    return (foreign + writes) * 512 > IDLE_DEMAND_BYTES;
+}
+
+/**
+ * Issue the next chunk; one call per timer tick
+ */
+static gboolean
+idle_chunk(gpointer G_GNUC_UNUSED data)
+{
+    if (kp_pause_is_active()) {
+        idle_finish("paused", TRUE);
+        return FALSE;
+    }
+    if (demand_appeared()) {
+        idle_finish("aborted (I/O demand)", TRUE);
+        return FALSE;
+    }
+
+    /* Skip resident chunks until one needs reading */
+    while (idle_state.next < idle_state.ranges->len) {
+        idle_range_t *r = &g_array_index(idle_state.ranges, idle_range_t, idle_state.next);
+        size_t offset = r->offset + idle_state.cursor;
+        size_t length = MIN((size_t)IDLE_CHUNK_BYTES, r->length - idle_state.cursor);
+        size_t missing;
+        gboolean issued;
+        long kb;
+        int ioprio;
+
+        idle_state.cursor += length;
+        if (idle_state.cursor >= r->length) {
+            idle_state.next++;
+            idle_state.cursor = 0;
+        }
+
+        /* Dropped under memory pressure a moment ago */
+        if (kp_reclaim_cooling(r->path, r->dev, r->ino, offset, length))
+            continue;
+
+        missing = length - MIN(length, kp_cachesnap_resident(r->path, offset, length));
+        if (missing == 0)
+            continue;
+
+        kb = (long)((missing + 1023) / 1024);
+        if (kb > idle_state.budget) {
+            idle_finish("reached its budget", TRUE);
+            return FALSE;
+        }
+        /* Idle I/O class for this chunk only: prediction plans built on
+         * this thread in between take over its priority */
+        ioprio = kp_readahead_set_ioprio(KP_IOPRIO_CLASS_IDLE, 0);
+        issued = kp_readahead_range(r->path, offset, length);
+        kp_readahead_restore_ioprio(ioprio);
+        if (issued) {
+            /* Speculative by nature: first to go under pressure */
+            kp_reclaim_record(r->path, r->dev, r->ino, offset, length, 0.0);
+            idle_state.budget -= kb;
+            idle_state.used += kb;
+            idle_state.owed_sectors += missing / 512;
+        }
+        return TRUE;
+    }
+
+    idle_finish("done", TRUE);
+    return FALSE;
+}
+
+/* Candidate collection context */
+typedef struct {
+    GHashTable *seen;       /* kp_map_t* already added */
+} collect_t;
+
+static void
+add_candidate(kp_map_t *map, collect_t *cc)
+{
+    idle_range_t r;
+
+    if (!map || !map->path || map->length == 0)
+        return;
+    if (idle_state.ranges->len >= IDLE_MAX_MAPS)
+        return;
+    if (g_hash_table_contains(cc->seen, map))
+        return;
+    g_hash_table_add(cc->seen, map);
+    if (kp_fsclass_get(map->dev, map->path) != KP_FS_LOCAL)
+        return;
+
+    r.path = g_strdup(map->path);
+    r.dev = map->dev;
+    r.ino = map->ino;
+    r.offset = map->offset;
+    r.length = map->length;
+    g_array_append_val(idle_state.ranges, r);
+}
+
+static void
+add_exemap_candidate(gpointer data, gpointer user_data)
+{
+    add_candidate(((kp_exemap_t *)data)->map, user_data);
+}
+
+static gint
+exe_launches_compare(gconstpointer a, gconstpointer b)
+{
+    const kp_exe_t *ea = *(const kp_exe_t **)a;
+    const kp_exe_t *eb = *(const kp_exe_t **)b;
+
+    if (ea->weighted_launches > eb->weighted_launches) return -1;
+    if (ea->weighted_launches < eb->weighted_launches) return 1;
+    return eb->time - ea->time;
+}
+
+/**
+ * Snapshot the next-best candidates and start the chunk timer
+ */
+static void
+idle_start(void)
+{
+    collect_t cc;
+    GPtrArray *exes;
+    GHashTableIter iter;
+    gpointer key, value;
+    long memavail;
+    guint i;
+
+    if (!kp_state->maps_arr || !kp_state->exes)
+        return;
+
+    memavail = kp_readahead_memavail();
+    idle_state.budget = MIN((long)kp_conf->system.idlebudget / 1024, memavail);
+    if (idle_state.budget <= 0) {
+        kp_debug("idle preload: no memory budget");
+        idle_state.spent = TRUE;
+        return;
+    }
+
+    idle_state.ranges = g_array_new(FALSE, FALSE, sizeof(idle_range_t));
+    cc.seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+    /* 1. What the normal cycle wanted but could not fit */
+    for (i = 0; i < kp_state->maps_arr->len; i++) {
+        kp_map_t *map = g_ptr_array_index(kp_state->maps_arr, i);
+        if (map->lnprob >= 0)
+            break;
+        add_candidate(map, &cc);
+    }
+
+    /* 2. Idle exes of either pool, most launched first */
+    exes = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, kp_state->exes);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        kp_exe_t *exe = value;
+        if (exe_is_running(exe) || exe->blacklisted || !exe->exemaps)
+            continue;
+        if (exe->weighted_launches <= 0 && exe->time <= 0)
+            continue;
+        g_ptr_array_add(exes, exe);
+    }
+    g_ptr_array_sort(exes, exe_launches_compare);
+    for (i = 0; i < exes->len && idle_state.ranges->len < IDLE_MAX_MAPS; i++)
+        g_set_foreach(((kp_exe_t *)g_ptr_array_index(exes, i))->exemaps,
+                      add_exemap_candidate, &cc);
+    g_ptr_array_free(exes, TRUE);
+    g_hash_table_destroy(cc.seen);
+
+    if (idle_state.ranges->len == 0) {
+        idle_ranges_free();
+        idle_state.spent = TRUE;
+        return;
+    }
+
+    idle_state.next = 0;
+    idle_state.cursor = 0;
+    idle_state.used = 0;
+    idle_state.owed_sectors = 0;
+
+    g_message("idle preload: system idle for %ds, %u candidate maps, budget %ldkb",
+              kp_conf->system.idlewait, idle_state.ranges->len, idle_state.budget);
+
+    idle_state.timer = g_timeout_add(IDLE_CHUNK_INTERVAL_MS, idle_chunk, NULL);
+}
+
+/* ========================================================================
+ * PUBLIC API
+ * ======================================================================== */
+
+/**
+ * Per-cycle idle detection
+ */
+void
+kp_idle_tick(void)
+{
+    disk_sample_t ds;
+    gint64 now;
+    gboolean idle = TRUE;
+
+    if (!kp_conf->system.idlepreload || !kp_power_idle_allowed()) {
+        kp_idle_stop();
+        return;
+    }
+
+    /* A run checks for demand between its own chunks */
+    if (idle_state.timer)
+        return;
+
+    now = g_get_monotonic_time();
+    if (!read_diskstats(&ds))
+        return;
+
+    if (idle_state.sampled) {
+        gint64 elapsed_ms = (now - idle_state.prev_time) / 1000;
+
+        if (elapsed_ms > 0 &&
+            busiest_disk_ms(&idle_state.prev_disk, &ds) * 100 >=
+                (guint64)elapsed_ms * IDLE_DISK_UTIL)
+            idle = FALSE;
+        if (read_io_pressure() >= IDLE_IO_PSI)
+            idle = FALSE;
+        if (read_load_per_cpu() >= IDLE_LOAD_PER_CPU)
+            idle = FALSE;
+
+        if (!idle) {
+            idle_state.idle_since = 0;
+            idle_state.spent = FALSE;
+        } else if (!idle_state.idle_since) {
+            idle_state.idle_since = idle_state.prev_time;
+        }
+    }
+
+    disk_sample_clear(&idle_state.prev_disk);
+    idle_state.prev_disk = ds;
+    idle_state.prev_time = now;
+    idle_state.sampled = TRUE;
+
+    if (idle_state.idle_since && !idle_state.spent &&
+        now - idle_state.idle_since >= (gint64)kp_conf->system.idlewait * G_USEC_PER_SEC)
+        idle_start();
+}
+
+/**
+ * Abort a running idle tier
+ */
+void
+kp_idle_stop(void)
+{
+    idle_finish("stopped", FALSE);
+}
+
+/**
+ * Is the idle tier reading right now?
+ */
+gboolean
+kp_idle_active(void)
+{
+    return idle_state.timer != 0;
+}
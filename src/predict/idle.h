@@ -0,0 +1,34 @@
+/* idle.h - Idle-time opportunistic preloading for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <glib.h>
+
+/**
+ * Sample disk, IO pressure and load; start the idle tier once the system
+ * has been idle for system.idlewait seconds
+ * Call once per cycle, after the normal prediction
+ */
+void kp_idle_tick(void);
+
+/**
+ * Abort a running idle tier (pause, shutdown)
+ */
+void kp_idle_stop(void);
+
+/**
+ * Check whether the idle tier is currently reading
+ * @return TRUE while chunks are being issued
+ */
+gboolean kp_idle_active(void);
+
+#endif /* IDLE_H */
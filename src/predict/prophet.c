@@ -35,9 +35,24 @@
  *      │   Else:           map.lnprob += exe.lnprob                  │
  *      └─────────────────────────────────────────────────────────────┘
  *
- *   5. SORT: Maps sorted by lnprob (most negative = most needed)
+ *   5. SHARED MAPS: Maps needed by several candidate exes get more weight
+ *      ┌─────────────────────────────────────────────────────────────┐
+ *      │ served = Σ P(Xi runs) / P(M needed)   (apps per useful read)│
+ *      │ If 2+ candidates: map.lnprob *= min(served, 2.0)            │
+ *      └─────────────────────────────────────────────────────────────┘
+ *
+ *   6. SORT: Maps sorted by lnprob (most negative = most needed)
+ *
+ *   7. READAHEAD: Preload maps until memory budget exhausted
  *
- *   6. READAHEAD: Preload maps until memory budget exhausted
+ * TIME SLICING:
+ *   Each pass is a phase that walks exes, maps or merges one step at a
+ *   time and can stop after any step. A slice runs steps until
+ *   model.predictslice ms of thread CPU time are used, then yields to the
+ *   main loop (idle priority, behind signals and control requests) and
+ *   the next slice carries on. Sorting is a bottom-up merge sort, one merge
+ *   per step, on copies of maps_arr, so other readers never see it half
+ *   sorted. The rest of the cycle continues from the done callback.
  *
  * PROBABILITY MATH:
  *   We compute log-probability of NOT needing each item:
@@ -46,9 +61,11 @@
  *   Negative lnprob → likely to be needed → should preload
  *   Positive lnprob → unlikely to be needed → skip
  *
- * MEMORY BUDGET (kp_prophet_readahead):
+ * MEMORY BUDGET (select phase):
  *   Available = (memtotal% × total) + (memfree% × free) + (memcached% × cached)
  *   Preload maps in order until budget exhausted or lnprob becomes positive.
+ *   Maps are collected into a per-file extent set (extents.c), so a range
+ *   overlapping one already selected is only charged for its new bytes.
  *
  * =============================================================================
  */
@@ -57,13 +74,18 @@
 #include "prophet.h"
 #include "../utils/logging.h"
 #include "../config/config.h"
-#include "../config/blacklist.h"
 #include "../state/state.h"
 #include "../monitor/proc.h"
 #include "../readahead/readahead.h"
+#include "../readahead/extents.h"
+#include "../readahead/cgroup.h"
+#include "../readahead/reclaim.h"
+#include "budget.h"
 #include "../daemon/stats.h"
+#include "../daemon/power.h"
 
 #include <math.h>
+#include <time.h>
 
 /*
  * Priority boost for manually-configured apps.
@@ -75,6 +97,14 @@
  */
 #define MANUAL_APP_BOOST_LNPROB -10.0
 
+/*
+ * Upper bound for the shared-map weight factor.
+ * A library serving N likely apps is worth up to N single-app files per byte,
+ * but capping at 2x keeps a barely-likely shared lib from outranking a
+ * near-certain app binary.
+ */
+#define SHARED_MAP_MAX_FACTOR 2.0
+
 /* CRITICAL ALGORITHM: Markov-based probability inference
  * (VERBATIM from upstream lines 33-49)
  *
@@ -177,6 +207,8 @@ static void
 map_zero_prob(kp_map_t *map)
 {
     map->lnprob = 0;
+    map->sharers = 0;
+    map->share_users = 0;
 }
 
 /**
@@ -197,8 +229,11 @@ map_prob_compare(const kp_map_t **pa, const kp_map_t **pb)
 static void
 exe_zero_prob(gpointer G_GNUC_UNUSED key, kp_exe_t *exe)
 {
-    /* Skip blacklisted apps - they get no probability boost */
-    if (kp_blacklist_contains(exe->path)) {
+    /* Skip blacklisted apps - they get no probability boost.
+     * The flag is cached on the exe and only recomputed when the
+     * config/blacklist generation changes. */
+    kp_stats_refresh_exe(exe);
+    if (exe->blacklisted) {
         exe->lnprob = 1;  /* Positive = low priority, won't be preloaded */
         return;
     }
@@ -243,154 +278,72 @@ exemap_bid_in_maps(kp_exemap_t *exemap, kp_exe_t *exe)
         /* Normal case: Accumulate exe's lnprob into map's lnprob.
          * This implements: lnprob(M) = Σ lnprob(Xi) for non-running exes. */
         exemap->map->lnprob += exe->lnprob;
+
+        /* Track candidate exes for shared-map scoring */
+        if (exe->lnprob < 0) {
+            exemap->map->sharers++;
+            exemap->map->share_users += 1 - exp(exe->lnprob);
+        }
     }
 }
 
-/* Wrapper with correct GHFunc signature for exe_zero_prob */
+/**
+ * Weight maps shared by several candidate exes (Preheat extension)
+ *
+ * lnprob(M) alone is the probability that *some* candidate needs M, so a
+ * library used by five likely apps sorts like any single-app file of the
+ * same probability. But one read of that library serves every one of them.
+ *
+ * The expected number of candidates served when M is needed is
+ *   served = Σ P(Xi=1) / P(M=1)
+ * and lnprob(M) is scaled by min(served, SHARED_MAP_MAX_FACTOR). Scaling a
+ * negative lnprob keeps its sign, so no map becomes (un)needed. The order
+ * does change, and with it the budget cutoff: selection stops at the first
+ * map that does not fit, so a boosted library can push single-app maps
+ * that used to fit past it.
+ */
 static void
-exe_zero_prob_wrapper(gpointer key, gpointer value, gpointer user_data)
+map_share_bid(kp_map_t *map)
 {
-    (void)key;
-    (void)user_data;
-    exe_zero_prob(NULL, (kp_exe_t *)value);
-}
+    double p_needed, served;
 
-/* Wrapper with correct GFunc signature for map_zero_prob */
-static void
-map_zero_prob_wrapper(gpointer data, gpointer user_data)
-{
-    (void)user_data;
-    map_zero_prob((kp_map_t *)data);
-}
+    if (map->sharers < 2 || map->lnprob >= 0)
+        return;
 
-/* Wrapper with correct GFunc signature for markov_bid_in_exes */
-static void
-markov_bid_in_exes_wrapper(gpointer data, gpointer user_data)
-{
-    (void)user_data;
-    markov_bid_in_exes((kp_markov_t *)data);
+    p_needed = 1 - exp(map->lnprob);
+    if (p_needed <= 0)
+        return;
+
+    served = map->share_users / p_needed;
+    if (served > 1)
+        map->lnprob *= served < SHARED_MAP_MAX_FACTOR ? served : SHARED_MAP_MAX_FACTOR;
 }
 
-/* Wrapper with correct GHFunc signature for exemap_bid_in_maps */
+/**
+ * Keep maps dropped under memory pressure out of this selection
+ *
+ * lnprob 0 sorts them behind every needed map, past the cutoff.
+ */
 static void
-exemap_bid_in_maps_wrapper(gpointer exemap, gpointer exe, gpointer user_data)
+map_skip_reclaimed(kp_map_t *map)
 {
-    (void)user_data;
-    exemap_bid_in_maps((kp_exemap_t *)exemap, (kp_exe_t *)exe);
+    if (map->lnprob < 0 &&
+        kp_reclaim_cooling(map->path, map->dev, map->ino, map->offset, map->length))
+        map->lnprob = 0;
 }
 
 /**
  * Helper macros for memory calculations
  * (VERBATIM from upstream lines 179-181)
  */
-#define clamp_percent(v) ((v)>100 ? 100 : (v) < -100 ? -100 : (v))
-#define max(a,b) ((a)>(b) ? (a) : (b))
 #define kb(v) ((int)(((v) + 1023) / 1024))
 
-/**
- * Perform readahead based on memory budget
- * (VERBATIM from upstream preload_prophet_readahead)
- *
- * Input is the list of maps sorted on the need.
- * Decide a cutoff based on memory conditions and readahead.
- */
-/**
- * Record preload timestamps for exes whose maps are being preloaded.
- * Used for hit/miss tracking when processes start.
- */
-static void
-record_preloaded_exes(kp_map_t **maps, int count)
-{
-    GHashTable *recorded = g_hash_table_new(g_str_hash, g_str_equal);
-    
-    for (int i = 0; i < count; i++) {
-        const char *map_path = maps[i]->path;
-        
-        /* Find all exes that use this map */
-        GHashTableIter iter;
-        gpointer key, value;
-        g_hash_table_iter_init(&iter, kp_state->exes);
-        while (g_hash_table_iter_next(&iter, &key, &value)) {
-            kp_exe_t *exe = (kp_exe_t *)value;
-            
-            /* Check if exe uses this map */
-            for (guint j = 0; j < exe->exemaps->len; j++) {
-                kp_exemap_t *exemap = g_ptr_array_index(exe->exemaps, j);
-                if (exemap && exemap->map && exemap->map->path && 
-                    strcmp(exemap->map->path, map_path) == 0) {
-                    /* Record this exe as preloaded (only once per exe) */
-                    if (!g_hash_table_contains(recorded, exe->path)) {
-                        kp_stats_record_preload(exe->path);
-                        g_hash_table_insert(recorded, (gpointer)exe->path, 
-                                          GINT_TO_POINTER(1));
-                        g_debug("Recorded preload for exe: %s (via map %s)",
-                                exe->path, map_path);
-                    }
-                    break;  /* Found match, no need to check more exemaps */
-                }
-            }
-        }
-    }
-    
-    g_hash_table_destroy(recorded);
-}
-
-void
-kp_prophet_readahead(GPtrArray *maps_arr)
-{
-    int i;
-    long memavail, memavailtotal; /* in kilobytes - use long for 32-bit safety */
-    kp_memory_t memstat;
-    kp_map_t *map;
-
-    kp_proc_get_memstat(&memstat);
-
-    /* Memory we are allowed to use for prefetching
-     * (VERBATIM upstream formula lines 196-199)
-     */
-    memavail  = clamp_percent(kp_conf->model.memtotal)  * (memstat.total  / 100)
-              + clamp_percent(kp_conf->model.memfree)   * (memstat.free   / 100);
-    memavail  = max(0, memavail);
-    memavail += clamp_percent(kp_conf->model.memcached) * (memstat.cached / 100);
-
-    memavailtotal = memavail;
-
-    memcpy(&(kp_state->memstat), &memstat, sizeof(memstat));
-    kp_state->memstat_timestamp = kp_state->time;
-
-    i = 0;
-    while (i < (int)(maps_arr->len) &&
-           (map = g_ptr_array_index(maps_arr, i)) &&
-           map->lnprob < 0 && kb(map->length) <= memavail) {
-        i++;
-
-        memavail -= kb(map->length);
-
-        /* Debug logging for individual maps (if log level high enough) */
-        if (kp_is_debugging()) {
-            g_debug("ln(prob(~MAP)) = %13.10lf %s", map->lnprob, map->path);
-        }
-    }
-
-    g_debug("%ldkb available for preloading, using %ldkb of it",
-            memavailtotal, memavailtotal - memavail);
-
-    if (i) {
-        /* Record preload times for hit tracking */
-        record_preloaded_exes((kp_map_t **)maps_arr->pdata, i);
-        
-        i = kp_readahead((kp_map_t **)maps_arr->pdata, i);
-        g_debug("readahead %d files", i);
-    } else {
-        g_debug("nothing to readahead");
-    }
-}
-
 /**
  * Load memory maps for an executable that has none (lazy loading)
  * 
- * Creates a single map covering the entire binary file. This is used for
- * manual apps that weren't discovered through process scanning.
+ * Creates maps for the ranges of the binary the dynamic loader reads (a
+ * single whole-file map for non-ELF files). This is used for manual apps
+ * that weren't discovered through process scanning.
  * 
  * @param exe Executable to load maps for
  * @return TRUE if successfully loaded, FALSE if file doesn't exist or is too small
@@ -399,8 +352,7 @@ static gboolean
 load_maps_for_exe(kp_exe_t *exe)
 {
     struct stat st;
-    kp_map_t *map;
-    kp_exemap_t *exemap;
+    size_t covered;
     
     g_return_val_if_fail(exe, FALSE);
     g_return_val_if_fail(exe->path, FALSE);
@@ -413,31 +365,21 @@ load_maps_for_exe(kp_exe_t *exe)
     
     /* Check minimum size threshold */
     if ((size_t)st.st_size < (size_t)kp_conf->model.minsize) {
-        g_debug("Manual app too small to preload: %s (%zu bytes < %d)",
-                exe->path, (size_t)st.st_size, kp_conf->model.minsize);
+        kp_debug("Manual app too small to preload: %s (%zu bytes < %d)",
+                 exe->path, (size_t)st.st_size, kp_conf->model.minsize);
         return FALSE;
     }
     
-    /* Create single map for entire file */
-    map = kp_map_new(exe->path, 0, st.st_size);
-    if (!map) {
+    /* Maps for the parts of the binary the loader reads (whole file if
+     * it is not a plain ELF object) */
+    covered = kp_exe_map_file(exe, exe->path, st.st_size);
+    if (!covered) {
         g_warning("Failed to create map for manual app: %s", exe->path);
         return FALSE;
     }
     
-    /* Create exemap and add to exe.
-     * NOTE: kp_exe_map_new() takes ownership of map via kp_map_ref(),
-     * but if it fails, we must free the map ourselves. */
-    exemap = kp_exe_map_new(exe, map);
-    if (!exemap) {
-        g_warning("Failed to create exemap for manual app: %s", exe->path);
-        kp_map_free(map);  /* FIX: Prevent memory leak on failure */
-        return FALSE;
-    }
-    
-    exemap->prob = 1.0;  /* Assume entire file is needed */
-    
-    g_debug("Loaded map for manual app: %s (%zu bytes)", exe->path, (size_t)st.st_size);
+    kp_debug("Loaded map for manual app: %s (%zu of %zu bytes)", exe->path,
+             covered, (size_t)st.st_size);
     
     return TRUE;
 }
@@ -485,36 +427,524 @@ boost_manual_apps(void)
 
     if (boosted > 0) {
         if (maps_loaded > 0) {
-            g_debug("Boosted %d manual apps (%d had maps loaded)", boosted, maps_loaded);
+            kp_debug("Boosted %d manual apps (%d had maps loaded)", boosted, maps_loaded);
         } else {
-            g_debug("Boosted %d manual apps for preloading", boosted);
+            kp_debug("Boosted %d manual apps for preloading", boosted);
         }
     }
 }
 
+
+/* ========================================================================
+ * TIME-SLICED PREDICTION
+ * ======================================================================== */
+
+/* Steps (an exe, a map, a merge) between two reads of the CPU clock */
+#define PREDICT_CHECK_EVERY 32
+
+typedef enum {
+    PREDICT_IDLE,           /* No prediction in flight */
+    PREDICT_ZERO_EXES,
+    PREDICT_ZERO_MAPS,
+    PREDICT_BID_EXES,       /* Markovs bid in exes */
+    PREDICT_BID_MAPS,       /* Exes bid in maps */
+    PREDICT_SHARE,
+    PREDICT_SORT,
+    PREDICT_SELECT,         /* Maps into the budget */
+    PREDICT_RECORD,         /* Exes whose maps were selected */
+    PREDICT_DONE
+} predict_phase_t;
+
+static struct {
+    predict_phase_t phase;
+    kp_prophet_done_func done;
+    gpointer data;
+    guint source;           /* Idle source running the next slice */
+
+    GPtrArray *exes;        /* Exes when the prediction started */
+    GPtrArray *maps;        /* Maps being ranked, sorted in place at the end */
+    guint pos;              /* Next exe, map or merge of the phase */
+
+    /* Bottom-up merge sort on private copies of maps->pdata */
+    kp_map_t **from;
+    kp_map_t **to;
+    guint count;
+    guint width;
+
+    /* Selection */
+    kp_extents_t *extents;
+    long memavail;          /* in kilobytes */
+    long memavailtotal;
+    int shared_maps;
+    size_t shared_bytes;
+    guint selected;
+    GHashTable *paths;      /* Paths of the selected maps */
+
+    /* Accounting */
+    int slices;
+    double cpu_ms;
+    gint64 started;
+} job;
+
+/**
+ * CPU time used by this thread, in milliseconds
+ *
+ * CPU rather than wall time: a slice preempted by the foreground app
+ * should not be cut short for time it did not get.
+ */
+static double
+thread_cpu_ms(void)
+{
+    struct timespec ts;
+
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) < 0)
+        return g_get_monotonic_time() / 1000.0;
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+/**
+ * Start the budget: memory we are allowed to use for prefetching
+ */
+static void
+select_begin(void)
+{
+    kp_memory_t memstat;
+
+    kp_proc_get_memstat(&memstat);
+
+    /* Memory we are allowed to use for prefetching (upstream formula,
+     * shared with the out-of-cycle replays) */
+    job.memavail = kp_readahead_membase(&memstat);
+
+    /* Shrink while preloading evicts a working set, grow while the cache is cold */
+    kp_budget_update(&memstat);
+    job.memavail = kp_budget_scale(job.memavail, &memstat);
+
+    /* Stay under the readahead cgroup's memory.high, if there is one */
+    job.memavail = kp_cgroup_budget(job.memavail);
+
+    /* A share of it on battery, none at all on low battery by default */
+    job.memavail = kp_power_budget(job.memavail);
+
+    job.memavailtotal = job.memavail;
+    kp_stats_record_budget(kp_budget_model(), job.memavail);
+
+    memcpy(&(kp_state->memstat), &memstat, sizeof(memstat));
+    kp_state->memstat_timestamp = kp_state->time;
+
+    /* Overlapping maps of one file are only charged for the bytes they
+     * add to what is already selected */
+    job.extents = kp_extents_new();
+    job.shared_maps = 0;
+    job.shared_bytes = 0;
+    job.selected = 0;
+}
+
+/**
+ * Select the next map if it is needed and fits
+ *
+ * @return FALSE once the cutoff is reached
+ */
+static gboolean
+select_map(kp_map_t *map)
+{
+    size_t added;
+
+    if (!map || map->lnprob >= 0 ||
+        kb(kp_extents_uncovered(job.extents, map)) > job.memavail)
+        return FALSE;
+
+    job.selected++;
+    added = kp_extents_add(job.extents, map);
+    job.memavail -= kb(added);
+
+    /* Only what the map adds: overlapping ranges are read once */
+    if (map->sharers >= 2) {
+        job.shared_maps++;
+        job.shared_bytes += added;
+    }
+
+    /* Debug logging for individual maps (if log level high enough) */
+    if (kp_is_debugging()) {
+        kp_debug("ln(prob(~MAP)) = %13.10lf %s", map->lnprob, map->path);
+    }
+    return TRUE;
+}
+
+/**
+ * Cutoff reached: report, and collect the selected paths for recording
+ */
+static void
+select_end(void)
+{
+    kp_debug("%ldkb available for preloading, using %ldkb of it",
+             job.memavailtotal, job.memavailtotal - job.memavail);
+
+    if (job.shared_maps > 0) {
+        kp_debug("%d shared maps (%zukb) in preload plan",
+                 job.shared_maps, job.shared_bytes / 1024);
+    }
+    kp_stats_record_shared_maps(job.shared_maps, job.shared_bytes);
+
+    if (!job.selected)
+        return;
+
+    job.paths = g_hash_table_new(g_str_hash, g_str_equal);
+    for (guint i = 0; i < job.selected; i++) {
+        kp_map_t *map = g_ptr_array_index(job.maps, i);
+        g_hash_table_add(job.paths, map->path);
+    }
+}
+
+/**
+ * Record a preload for an exe that uses one of the selected files.
+ * Used for hit/miss tracking when processes start.
+ */
+static void
+record_preloaded_exe(kp_exe_t *exe)
+{
+    for (guint i = 0; i < exe->exemaps->len; i++) {
+        kp_exemap_t *exemap = g_ptr_array_index(exe->exemaps, i);
+
+        if (exemap && exemap->map && exemap->map->path &&
+            g_hash_table_contains(job.paths, exemap->map->path)) {
+            /* Only once per exe */
+            kp_stats_record_preload(exe->path);
+            kp_debug("Recorded preload for exe: %s (via map %s)",
+                     exe->path, exemap->map->path);
+            return;
+        }
+    }
+}
+
+/**
+ * Hand the selection to readahead
+ */
+static void
+readahead_selected(void)
+{
+    int files;
+
+    /* Remembered so they can be dropped again under memory pressure */
+    for (guint i = 0; i < job.selected; i++) {
+        kp_map_t *map = g_ptr_array_index(job.maps, i);
+        kp_reclaim_record(map->path, map->dev, map->ino,
+                          map->offset, map->length, map->lnprob);
+    }
+
+    kp_debug("%u maps coalesced to %zukb", job.selected,
+             kp_extents_total(job.extents) / 1024);
+    files = kp_extents_readahead(job.extents);
+    kp_debug("readahead %d files", files);
+}
+
+/**
+ * One stable merge of the sort: from[lo, mid) and from[mid, hi) into to[]
+ */
+static void
+sort_merge(kp_map_t **from, kp_map_t **to, guint lo, guint mid, guint hi)
+{
+    guint i = lo, j = mid, k = lo;
+
+    while (i < mid && j < hi) {
+        if (map_prob_compare((const kp_map_t **)&from[j], (const kp_map_t **)&from[i]) < 0)
+            to[k++] = from[j++];
+        else
+            to[k++] = from[i++];
+    }
+    while (i < mid)
+        to[k++] = from[i++];
+    while (j < hi)
+        to[k++] = from[j++];
+}
+
+/**
+ * Enter a phase
+ */
+static void
+predict_enter(predict_phase_t phase)
+{
+    job.phase = phase;
+    job.pos = 0;
+
+    switch (phase) {
+    case PREDICT_SORT:
+        /* Sorted on copies, so maps_arr stays whole between slices */
+        job.count = job.maps->len;
+        job.from = g_new(kp_map_t *, MAX(job.count, 1));
+        job.to = g_new(kp_map_t *, MAX(job.count, 1));
+        memcpy(job.from, job.maps->pdata, job.count * sizeof(gpointer));
+        job.width = 1;
+        break;
+    case PREDICT_SELECT:
+        select_begin();
+        break;
+    default:
+        break;
+    }
+}
+
+/**
+ * Do one step of the prediction
+ *
+ * @return FALSE once the prediction is complete
+ */
+static gboolean
+predict_step(void)
+{
+    kp_exe_t *exe;
+    guint i;
+
+    switch (job.phase) {
+    case PREDICT_ZERO_EXES:
+        /* Reset probabilities that we are gonna compute */
+        if (job.pos < job.exes->len) {
+            exe_zero_prob(NULL, g_ptr_array_index(job.exes, job.pos++));
+            return TRUE;
+        }
+        predict_enter(PREDICT_ZERO_MAPS);
+        return TRUE;
+
+    case PREDICT_ZERO_MAPS:
+        if (job.pos < job.maps->len) {
+            map_zero_prob(g_ptr_array_index(job.maps, job.pos++));
+            return TRUE;
+        }
+        /* Boost manual apps first (Preheat extension) */
+        boost_manual_apps();
+        predict_enter(PREDICT_BID_EXES);
+        return TRUE;
+
+    case PREDICT_BID_EXES:
+        /* Markovs bid in exes; each markov once, from its a side
+         * (as kp_markov_foreach does) */
+        if (job.pos < job.exes->len) {
+            exe = g_ptr_array_index(job.exes, job.pos++);
+            for (i = 0; i < g_set_size(exe->markovs); i++) {
+                kp_markov_t *markov = g_ptr_array_index(exe->markovs, i);
+                if (markov->a == exe)
+                    markov_bid_in_exes(markov);
+            }
+            return TRUE;
+        }
+        predict_enter(PREDICT_BID_MAPS);
+        return TRUE;
+
+    case PREDICT_BID_MAPS:
+        /* Exes bid in maps */
+        if (job.pos < job.exes->len) {
+            exe = g_ptr_array_index(job.exes, job.pos++);
+            for (i = 0; i < g_set_size(exe->exemaps); i++)
+                exemap_bid_in_maps(g_ptr_array_index(exe->exemaps, i), exe);
+            return TRUE;
+        }
+        predict_enter(PREDICT_SHARE);
+        return TRUE;
+
+    case PREDICT_SHARE:
+        /* Maps shared by several candidates move ahead, recently
+         * reclaimed ones drop out (Preheat extensions) */
+        if (job.pos < job.maps->len) {
+            kp_map_t *map = g_ptr_array_index(job.maps, job.pos++);
+
+            map_share_bid(map);
+            map_skip_reclaimed(map);
+            return TRUE;
+        }
+        predict_enter(PREDICT_SORT);
+        return TRUE;
+
+    case PREDICT_SORT:
+        /* Sort maps on probability, one merge per step */
+        if (job.width < job.count) {
+            guint lo = job.pos;
+            guint mid = MIN(lo + job.width, job.count);
+            guint hi = MIN(lo + 2 * job.width, job.count);
+
+            sort_merge(job.from, job.to, lo, mid, hi);
+            job.pos = hi;
+            if (job.pos >= job.count) {
+                kp_map_t **sorted = job.to;
+                job.to = job.from;
+                job.from = sorted;
+                job.width *= 2;
+                job.pos = 0;
+            }
+            return TRUE;
+        }
+        if (job.maps->len == job.count) {
+            memcpy(job.maps->pdata, job.from, job.count * sizeof(gpointer));
+        } else {
+            kp_debug("maps changed while sorting, sorting them at once");
+            g_ptr_array_sort(job.maps, (GCompareFunc)map_prob_compare);
+        }
+        g_clear_pointer(&job.from, g_free);
+        g_clear_pointer(&job.to, g_free);
+        predict_enter(PREDICT_SELECT);
+        return TRUE;
+
+    case PREDICT_SELECT:
+        if (job.pos < job.maps->len &&
+            select_map(g_ptr_array_index(job.maps, job.pos))) {
+            job.pos++;
+            return TRUE;
+        }
+        select_end();
+        if (job.selected) {
+            predict_enter(PREDICT_RECORD);
+        } else {
+            kp_debug("nothing to readahead");
+            job.phase = PREDICT_DONE;
+        }
+        return TRUE;
+
+    case PREDICT_RECORD:
+        /* Record preload times for hit tracking */
+        if (job.pos < job.exes->len) {
+            record_preloaded_exe(g_ptr_array_index(job.exes, job.pos++));
+            return TRUE;
+        }
+        /* Read them in */
+        readahead_selected();
+        job.phase = PREDICT_DONE;
+        return TRUE;
+
+    case PREDICT_IDLE:
+    case PREDICT_DONE:
+        break;
+    }
+    return FALSE;
+}
+
+/**
+ * Free what the prediction holds
+ */
+static void
+predict_clear(void)
+{
+    if (job.source) {
+        g_source_remove(job.source);
+        job.source = 0;
+    }
+    g_clear_pointer(&job.exes, g_ptr_array_unref);
+    g_clear_pointer(&job.from, g_free);
+    g_clear_pointer(&job.to, g_free);
+    g_clear_pointer(&job.extents, kp_extents_free);
+    g_clear_pointer(&job.paths, g_hash_table_destroy);
+    job.maps = NULL;
+    job.done = NULL;
+    job.data = NULL;
+    job.phase = PREDICT_IDLE;
+}
+
+static void
+predict_begin(kp_prophet_done_func done, gpointer data)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    job.done = done;
+    job.data = data;
+    job.maps = kp_state->maps_arr;
+    job.slices = 0;
+    job.cpu_ms = 0;
+    job.started = g_get_monotonic_time();
+
+    /* Exes registered meanwhile (seeding) wait for the next cycle */
+    job.exes = g_ptr_array_sized_new(g_hash_table_size(kp_state->exes));
+    g_hash_table_iter_init(&iter, kp_state->exes);
+    while (g_hash_table_iter_next(&iter, NULL, &value))
+        g_ptr_array_add(job.exes, value);
+}
+
+static void
+predict_finish(void)
+{
+    kp_prophet_done_func done = job.done;
+    gpointer data = job.data;
+
+    if (job.slices) {
+        double wall_ms = (g_get_monotonic_time() - job.started) / 1000.0;
+
+        kp_debug("prediction took %d slices, %.1f ms CPU in %.1f ms",
+                 job.slices, job.cpu_ms, wall_ms);
+        kp_stats_record_predict(job.slices, job.cpu_ms, wall_ms);
+    }
+
+    job.source = 0;
+    predict_clear();
+    if (done)
+        done(data);
+}
+
+/**
+ * Run steps until the prediction is complete or the slice budget is spent
+ *
+ * @return TRUE if another slice is needed
+ */
+static gboolean
+predict_slice(gpointer G_GNUC_UNUSED data)
+{
+    double budget = kp_conf->model.predictslice;   /* ms, 0 = no limit */
+    double start = thread_cpu_ms();
+    guint steps = 0;
+    gboolean more;
+
+    job.slices++;
+    while ((more = predict_step())) {
+        if (budget > 0 && ++steps % PREDICT_CHECK_EVERY == 0 &&
+            thread_cpu_ms() - start >= budget)
+            break;
+    }
+    job.cpu_ms += thread_cpu_ms() - start;
+
+    if (!more) {
+        predict_finish();
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+/* ========================================================================
+ * PUBLIC API
+ * ======================================================================== */
+
 /**
  * Main prediction function
- * (VERBATIM from upstream preload_prophet_predict)
+ * (from upstream preload_prophet_predict, split into resumable phases)
  */
 void
-kp_prophet_predict(gpointer data)
+kp_prophet_predict(kp_prophet_done_func done, gpointer data)
 {
-    /* Reset probabilities that we are gonna compute */
-    g_hash_table_foreach(kp_state->exes, exe_zero_prob_wrapper, data);
-    g_ptr_array_foreach(kp_state->maps_arr, map_zero_prob_wrapper, data);
+    if (job.phase != PREDICT_IDLE) {
+        /* Its plan covers this request too */
+        kp_debug("prediction already in flight, not starting another");
+        if (done)
+            done(data);
+        return;
+    }
 
-    /* Boost manual apps first (Preheat extension) */
-    boost_manual_apps();
+    predict_begin(done, data);
+    predict_enter(PREDICT_ZERO_EXES);
 
-    /* Markovs bid in exes */
-    kp_markov_foreach(markov_bid_in_exes_wrapper, data);
+    /* The first slice runs right away; the rest yield to the main loop
+     * in between, behind signals, control requests and timers */
+    if (predict_slice(NULL))
+        job.source = g_idle_add(predict_slice, NULL);
+}
 
-    /* Exes bid in maps */
-    kp_exemap_foreach(exemap_bid_in_maps_wrapper, data);
+gboolean
+kp_prophet_busy(void)
+{
+    return job.phase != PREDICT_IDLE;
+}
 
-    /* Sort maps on probability */
-    g_ptr_array_sort(kp_state->maps_arr, (GCompareFunc)map_prob_compare);
+void
+kp_prophet_cancel(void)
+{
+    if (job.phase == PREDICT_IDLE)
+        return;
 
-    /* Read them in */
-    kp_prophet_readahead(kp_state->maps_arr);
+    kp_debug("prediction cancelled after %d slices", job.slices);
+    predict_clear();
 }
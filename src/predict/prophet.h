@@ -16,15 +16,32 @@
 #include <glib.h>
 
 /**
- * Predict which maps should be preloaded
- * (VERBATIM signature from upstream preload_prophet_predict)
+ * Called on the main loop when a prediction is complete
  */
-void kp_prophet_predict(gpointer data);
+typedef void (*kp_prophet_done_func)(gpointer data);
 
 /**
- * Perform readahead based on memory budget
- * (VERBATIM signature from upstream preload_prophet_readahead)
+ * Predict which maps should be preloaded, and read them in
+ * (from upstream preload_prophet_predict)
+ *
+ * Runs in slices of model.predictslice ms of CPU time, yielding to the
+ * main loop in between. done is called once the readahead plan is handed
+ * over, possibly before this returns. While one is in flight, no other
+ * is started and done is called at once.
+ */
+void kp_prophet_predict(kp_prophet_done_func done, gpointer data);
+
+/**
+ * Whether a prediction is in flight
+ *
+ * The model and configuration must not change under it: callers that
+ * free exes or reload the configuration wait until this is FALSE.
+ */
+gboolean kp_prophet_busy(void);
+
+/**
+ * Drop a prediction in flight without calling its done function (shutdown)
  */
-void kp_prophet_readahead(GPtrArray *maps_arr);
+void kp_prophet_cancel(void);
 
 #endif /* PROPHET_H */
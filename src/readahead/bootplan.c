@@ -0,0 +1,432 @@
+/* bootplan.c - Precompiled boot readahead plan for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Boot Readahead Plan
+ * =============================================================================
+ *
+ * At boot the disk is cold, and the model is not even loaded yet. Deriving
+ * the top apps from exe->time, stat()ing binaries, resolving libraries and
+ * running the prediction pipeline all compete for the very disk we are
+ * trying to warm. Instead, everything that can be decided in advance is
+ * decided while the system is warm and written to a compact plan file:
+ *
+ *   WRITE (every state save, including the one at shutdown):
+ *     top priority apps by running time
+ *       └─ their maps, deduplicated across apps
+ *          └─ kp_readahead_sort()   → physical block order (sortstrategy)
+ *             └─ merge adjacent ranges of the same file
+ *                └─ <statefile>.bootplan (atomic tmp + rename)
+ *
+ *   REPLAY (daemon startup, before kp_state_load; again at login):
+ *     read plan → check memory → kp_readahead_ordered()
+ *
+ * FILE FORMAT (tab separated, paths as file:// URIs like the state file):
+ *   BOOTPLAN  <version>  <apps>  <ranges>  <total bytes>
+ *   APP       <bytes>    <uri>                 (one per app, informative)
+ *   RANGE     <offset>   <length>  <uri>       (in replay order)
+ *
+ * A plan that fails to parse is ignored; the normal session preload path
+ * then runs as before.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "bootplan.h"
+#include "readahead.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "../state/state.h"
+
+/* Plan file lives next to the state file */
+#define BOOTPLAN_SUFFIX ".bootplan"
+#define BOOTPLAN_VERSION 1
+
+/* Plan contents */
+#define BOOTPLAN_MAX_APPS 8                     /* Apps considered */
+#define BOOTPLAN_MIN_TIME 10                    /* Seconds of use, as session.c */
+#define BOOTPLAN_MAX_BYTES (256 * 1024 * 1024)  /* Cap on planned bytes */
+
+#define TAG_BOOTPLAN "BOOTPLAN"
+#define TAG_APP      "APP"
+#define TAG_RANGE    "RANGE"
+
+/* One merged range, in replay order */
+typedef struct {
+    char *path;
+    size_t offset;
+    size_t length;
+} plan_range_t;
+
+/* Loaded plan */
+static struct {
+    GArray *ranges;         /* plan_range_t */
+    int apps;
+    size_t total;           /* Sum of range lengths, bytes */
+} plan = {0};
+
+/**
+ * Plan file path for a given state file
+ */
+static char *
+plan_path(const char *statefile)
+{
+    return g_strconcat(statefile, BOOTPLAN_SUFFIX, NULL);
+}
+
+/**
+ * Compare exes by running time, most used first
+ */
+static gint
+exe_time_compare(gconstpointer a, gconstpointer b)
+{
+    const kp_exe_t *exe_a = *(const kp_exe_t **)a;
+    const kp_exe_t *exe_b = *(const kp_exe_t **)b;
+
+    if (exe_a->time > exe_b->time) return -1;
+    if (exe_a->time < exe_b->time) return 1;
+    return 0;
+}
+
+/**
+ * Pick the apps to plan for: priority pool, most running time first
+ */
+static GPtrArray *
+select_plan_apps(void)
+{
+    GPtrArray *apps = g_ptr_array_new();
+    GHashTableIter iter;
+    gpointer key, value;
+
+    g_hash_table_iter_init(&iter, kp_state->exes);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        kp_exe_t *exe = (kp_exe_t *)value;
+
+        if (exe->pool != POOL_PRIORITY)
+            continue;
+        if (exe->time < BOOTPLAN_MIN_TIME)
+            continue;
+        if (g_set_size(exe->exemaps) == 0)
+            continue;
+
+        g_ptr_array_add(apps, exe);
+    }
+
+    g_ptr_array_sort(apps, exe_time_compare);
+    if (apps->len > BOOTPLAN_MAX_APPS)
+        g_ptr_array_set_size(apps, BOOTPLAN_MAX_APPS);
+
+    return apps;
+}
+
+/* Per-app gathering context for collect_exemap() */
+typedef struct {
+    GHashTable *seen;       /* kp_map_t* set, across all apps */
+    GPtrArray *pending;     /* This app's new maps */
+    size_t pending_bytes;   /* Their total length */
+    size_t app_bytes;       /* All of this app's maps, shared or not */
+} collect_t;
+
+static void
+collect_exemap(gpointer data, gpointer user_data)
+{
+    kp_exemap_t *exemap = (kp_exemap_t *)data;
+    collect_t *cc = (collect_t *)user_data;
+    kp_map_t *map = exemap->map;
+
+    cc->app_bytes += map->length;
+    if (g_hash_table_contains(cc->seen, map))
+        return;
+
+    g_hash_table_add(cc->seen, map);
+    g_ptr_array_add(cc->pending, map);
+    cc->pending_bytes += map->length;
+}
+
+/**
+ * Write the boot plan for the current model
+ *
+ * Called after every successful state save; the save at shutdown thus
+ * leaves the freshest plan for the next boot.
+ */
+void
+kp_bootplan_write(const char *statefile)
+{
+    GPtrArray *apps, *maps;
+    GHashTable *seen;
+    GString *body;
+    char *path, *tmpfile;
+    size_t total = 0;
+    int napps = 0, nranges = 0;
+    FILE *out;
+    int fd;
+    guint i;
+
+    if (!statefile || !*statefile || !kp_state->exes)
+        return;
+
+    apps = select_plan_apps();
+    maps = g_ptr_array_new();
+    seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+    body = g_string_new(NULL);
+
+    /* Gather maps app by app, skipping apps that would blow the cap */
+    for (i = 0; i < apps->len; i++) {
+        kp_exe_t *exe = g_ptr_array_index(apps, i);
+        collect_t cc = { seen, g_ptr_array_new(), 0, 0 };
+        char *uri;
+
+        g_set_foreach(exe->exemaps, collect_exemap, &cc);
+
+        if (total + cc.pending_bytes > BOOTPLAN_MAX_BYTES) {
+            for (guint j = 0; j < cc.pending->len; j++)
+                g_hash_table_remove(seen, g_ptr_array_index(cc.pending, j));
+            g_ptr_array_free(cc.pending, TRUE);
+            continue;
+        }
+
+        uri = g_filename_to_uri(exe->path, NULL, NULL);
+        if (uri) {
+            g_string_append_printf(body, "%s\t%zu\t%s\n", TAG_APP, cc.app_bytes, uri);
+            g_free(uri);
+            napps++;
+        }
+
+        for (guint j = 0; j < cc.pending->len; j++)
+            g_ptr_array_add(maps, g_ptr_array_index(cc.pending, j));
+        total += cc.pending_bytes;
+        g_ptr_array_free(cc.pending, TRUE);
+    }
+
+    /* Order once, now, while block lookups are cheap */
+    kp_readahead_sort((kp_map_t **)maps->pdata, maps->len);
+
+    /* Merge in the same way kp_readahead_ordered() would */
+    for (i = 0; i < maps->len; ) {
+        kp_map_t *map = g_ptr_array_index(maps, i);
+        size_t offset = map->offset;
+        size_t length = map->length;
+        char *uri;
+
+        for (i++; i < maps->len; i++) {
+            kp_map_t *next = g_ptr_array_index(maps, i);
+            if (strcmp(next->path, map->path) ||
+                next->offset < offset || next->offset > offset + length)
+                break;
+            if (next->offset + next->length > offset + length)
+                length = next->offset + next->length - offset;
+        }
+
+        uri = g_filename_to_uri(map->path, NULL, NULL);
+        if (uri) {
+            g_string_append_printf(body, "%s\t%zu\t%zu\t%s\n",
+                                   TAG_RANGE, offset, length, uri);
+            g_free(uri);
+            nranges++;
+        }
+    }
+
+    g_hash_table_destroy(seen);
+    g_ptr_array_free(maps, TRUE);
+    g_ptr_array_free(apps, TRUE);
+
+    path = plan_path(statefile);
+    tmpfile = g_strconcat(path, ".tmp", NULL);
+
+    fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        g_warning("cannot write boot plan %s: %s", tmpfile, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+    } else {
+        gboolean ok;
+
+        ok = fprintf(out, "%s\t%d\t%d\t%d\t%zu\n",
+                     TAG_BOOTPLAN, BOOTPLAN_VERSION, napps, nranges, total) > 0;
+        ok = ok && fputs(body->str, out) >= 0;
+        ok = (fclose(out) == 0) && ok;
+
+        if (!ok || rename(tmpfile, path) < 0) {
+            g_warning("failed writing boot plan %s: %s", path, strerror(errno));
+            unlink(tmpfile);
+        } else {
+            kp_debug("boot plan: %d apps, %d ranges, %zu KB written to %s",
+                     napps, nranges, total / 1024, path);
+        }
+    }
+
+    g_string_free(body, TRUE);
+    g_free(tmpfile);
+    g_free(path);
+}
+
+/**
+ * Drop the loaded plan
+ */
+void
+kp_bootplan_free(void)
+{
+    if (plan.ranges) {
+        for (guint i = 0; i < plan.ranges->len; i++)
+            g_free(g_array_index(plan.ranges, plan_range_t, i).path);
+        g_array_free(plan.ranges, TRUE);
+        plan.ranges = NULL;
+    }
+    plan.apps = 0;
+    plan.total = 0;
+}
+
+/**
+ * Load the boot plan written for this state file
+ *
+ * @return TRUE if a non-empty plan was loaded
+ */
+gboolean
+kp_bootplan_load(const char *statefile)
+{
+    char *path;
+    FILE *in;
+    char line[FILELEN + 128];
+    int version = 0, napps = 0, nranges = 0;
+    size_t total = 0;
+    gboolean ok = TRUE;
+
+    kp_bootplan_free();
+
+    if (!statefile || !*statefile)
+        return FALSE;
+
+    path = plan_path(statefile);
+    in = fopen(path, "r");
+    if (!in) {
+        if (errno != ENOENT)
+            g_warning("cannot open boot plan %s: %s", path, strerror(errno));
+        g_free(path);
+        return FALSE;
+    }
+
+    if (!fgets(line, sizeof(line), in) ||
+        sscanf(line, TAG_BOOTPLAN "\t%d\t%d\t%d\t%zu",
+               &version, &napps, &nranges, &total) != 4 ||
+        version != BOOTPLAN_VERSION) {
+        g_warning("ignoring boot plan %s: bad header", path);
+        fclose(in);
+        g_free(path);
+        return FALSE;
+    }
+
+    plan.ranges = g_array_sized_new(FALSE, FALSE, sizeof(plan_range_t),
+                                    MAX(nranges, 0));
+
+    while (ok && fgets(line, sizeof(line), in)) {
+        plan_range_t range;
+        char uri[FILELEN];
+        int off = 0;
+
+        if (g_str_has_prefix(line, TAG_APP "\t"))
+            continue;
+
+        if (sscanf(line, TAG_RANGE "\t%zu\t%zu\t%n",
+                   &range.offset, &range.length, &off) != 2 || !off ||
+            sscanf(line + off, "%" FILELENSTR "s", uri) != 1) {
+            ok = FALSE;
+            break;
+        }
+
+        range.path = g_filename_from_uri(uri, NULL, NULL);
+        if (!range.path) {
+            ok = FALSE;
+            break;
+        }
+        g_array_append_val(plan.ranges, range);
+        plan.total += range.length;
+    }
+    fclose(in);
+
+    if (!ok) {
+        g_warning("ignoring boot plan %s: syntax error", path);
+        kp_bootplan_free();
+        g_free(path);
+        return FALSE;
+    }
+
+    plan.apps = napps;
+    kp_debug("boot plan: loaded %u ranges (%zu KB) for %d apps from %s",
+             plan.ranges->len, plan.total / 1024, plan.apps, path);
+    g_free(path);
+
+    if (plan.ranges->len == 0) {
+        kp_bootplan_free();
+        return FALSE;
+    }
+    return TRUE;
+}
+
+/**
+ * Is a plan loaded?
+ */
+gboolean
+kp_bootplan_available(void)
+{
+    return plan.ranges != NULL;
+}
+
+/**
+ * Replay the loaded plan through the readahead engine
+ *
+ * Uses the same available-memory estimate as the prophet, and skips the
+ * replay entirely if the whole plan does not fit: a partial replay in
+ * block order would favour whichever app happens to sit first on disk.
+ *
+ * @return Number of readahead requests issued, 0 if skipped
+ */
+int
+kp_bootplan_replay(void)
+{
+    long memavail;
+    GArray *maps;
+    GPtrArray *ptrs;
+    int issued;
+
+    if (!plan.ranges)
+        return 0;
+
+    memavail = kp_readahead_memavail();
+
+    if ((long)(plan.total / 1024) > memavail) {
+        g_message("boot plan: %zu KB does not fit in %ld KB available, skipping",
+                  plan.total / 1024, memavail);
+        return 0;
+    }
+
+    /* kp_readahead_ordered() only needs path/offset/length */
+    maps = g_array_sized_new(FALSE, TRUE, sizeof(kp_map_t), plan.ranges->len);
+    g_array_set_size(maps, plan.ranges->len);
+    ptrs = g_ptr_array_sized_new(plan.ranges->len);
+    for (guint i = 0; i < plan.ranges->len; i++) {
+        plan_range_t *range = &g_array_index(plan.ranges, plan_range_t, i);
+        kp_map_t *map = &g_array_index(maps, kp_map_t, i);
+
+        map->path = range->path;
+        map->offset = range->offset;
+        map->length = range->length;
+        g_ptr_array_add(ptrs, map);
+    }
+
+    issued = kp_readahead_ordered((kp_map_t **)ptrs->pdata, ptrs->len);
+
+    g_ptr_array_free(ptrs, TRUE);
+    g_array_free(maps, TRUE);
+
+    g_message("boot plan: replayed %d requests (%zu KB) for %d apps",
+              issued, plan.total / 1024, plan.apps);
+    return issued;
+}
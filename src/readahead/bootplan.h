@@ -0,0 +1,48 @@
+/* bootplan.h - Precompiled boot readahead plan for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef BOOTPLAN_H
+#define BOOTPLAN_H
+
+#include <glib.h>
+
+/**
+ * Write <statefile>.bootplan from the current model
+ * Top priority apps' maps, in block order, merged
+ * @param statefile Path of the state file the plan belongs to
+ */
+void kp_bootplan_write(const char *statefile);
+
+/**
+ * Load <statefile>.bootplan into memory
+ * @param statefile Path of the state file the plan belongs to
+ * @return TRUE if a non-empty plan was loaded
+ */
+gboolean kp_bootplan_load(const char *statefile);
+
+/**
+ * Check whether a plan is loaded
+ * @return TRUE if kp_bootplan_replay() has something to replay
+ */
+gboolean kp_bootplan_available(void);
+
+/**
+ * Replay the loaded plan through the readahead engine (no sorting,
+ * no stat, no model needed)
+ * @return Number of readahead requests issued, 0 if skipped
+ */
+int kp_bootplan_replay(void);
+
+/**
+ * Free the loaded plan
+ */
+void kp_bootplan_free(void);
+
+#endif /* BOOTPLAN_H */
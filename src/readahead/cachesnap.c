@@ -0,0 +1,613 @@
+/* cachesnap.c - Page-cache snapshot and restore for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Page-Cache Snapshot
+ * =============================================================================
+ *
+ * A reboot throws away a page cache that took hours of use to warm. When
+ * system.cachesnapshot is enabled, the daemon records at shutdown which
+ * ranges of the files it knows about are actually resident, and restores
+ * the most valuable part of that on the next start.
+ *
+ * SNAPSHOT (clean shutdown, SIGTERM/SIGINT):
+ *   every map in kp_state->maps  +  system.cachesnapshot_extra files
+ *     └─ weight = max over exes of P(exe needed) × P(map | exe)
+ *        (running exes count as needed; extra files weigh 1.0)
+ *     └─ cachestat()  → skip fully-evicted / take fully-cached ranges whole
+ *        mincore()    → exact resident page runs otherwise
+ *     └─ <statefile>.cachesnap  (atomic tmp + rename)
+ *
+ * RESTORE (startup, after the state is loaded):
+ *   files by weight, highest first, until kp_readahead_memavail() is used
+ *     └─ kp_readahead()  → normal path: block-order sort, merge, readahead
+ *
+ * FILE FORMAT (tab separated, paths as file:// URIs like the state file):
+ *   CACHESNAP  <version>  <files>  <extents>  <total bytes>
+ *   FILE       <weight>   <uri>
+ *   EXTENT     <offset>   <length>          (belongs to the preceding FILE)
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "cachesnap.h"
+#include "readahead.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+#include "../state/state.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#define CACHESNAP_SUFFIX ".cachesnap"
+#define CACHESNAP_VERSION 1
+
+/* Weight of a tracked map no candidate exe currently bids on: still worth
+ * more than nothing, since it was resident for a reason */
+#define CACHESNAP_MIN_WEIGHT 0.01
+#define CACHESNAP_EXTRA_WEIGHT 1.0
+
+#define TAG_CACHESNAP "CACHESNAP"
+#define TAG_FILE      "FILE"
+#define TAG_EXTENT    "EXTENT"
+
+/*
+ * cachestat(2) (Linux 6.5+). Declared locally so older headers still
+ * build; at runtime ENOSYS just means "use mincore() for everything".
+ * The syscall number is the same on every architecture.
+ */
+#ifndef __NR_cachestat
+#define __NR_cachestat 451
+#endif
+struct snap_cachestat_range {
+    uint64_t off;
+    uint64_t len;
+};
+struct snap_cachestat {
+    uint64_t nr_cache;
+    uint64_t nr_dirty;
+    uint64_t nr_writeback;
+    uint64_t nr_evicted;
+    uint64_t nr_recently_evicted;
+};
+
+/* One resident range */
+typedef struct {
+    size_t offset;
+    size_t length;
+} snap_extent_t;
+
+/* One file in the snapshot */
+typedef struct {
+    char *path;
+    double weight;
+    GArray *ranges;         /* snap_extent_t: ranges to probe (snapshot) */
+    GArray *extents;        /* snap_extent_t: resident ranges */
+} snap_file_t;
+
+static void
+snap_file_free(gpointer data)
+{
+    snap_file_t *file = data;
+
+    g_free(file->path);
+    if (file->ranges)
+        g_array_free(file->ranges, TRUE);
+    if (file->extents)
+        g_array_free(file->extents, TRUE);
+    g_free(file);
+}
+
+/**
+ * Snapshot file path for a given state file
+ */
+static char *
+snap_path(const char *statefile)
+{
+    return g_strconcat(statefile, CACHESNAP_SUFFIX, NULL);
+}
+
+/**
+ * Get (or create) the entry for path and raise its weight
+ */
+static snap_file_t *
+snap_file_get(GHashTable *files, const char *path, double weight)
+{
+    snap_file_t *file = g_hash_table_lookup(files, path);
+
+    if (!file) {
+        file = g_new0(snap_file_t, 1);
+        file->path = g_strdup(path);
+        file->ranges = g_array_new(FALSE, FALSE, sizeof(snap_extent_t));
+        file->extents = g_array_new(FALSE, FALSE, sizeof(snap_extent_t));
+        g_hash_table_insert(files, file->path, file);
+    }
+    if (weight > file->weight)
+        file->weight = weight;
+    return file;
+}
+
+/* Weighing context for weigh_exe()/weigh_exemap() */
+typedef struct {
+    GHashTable *weights;    /* kp_map_t* → boxed double */
+    double exe_weight;      /* P(current exe needed) */
+} weigh_t;
+
+/**
+ * Raise a map's weight to P(exe needed) × P(map | exe) if higher
+ */
+static void
+weigh_exemap(gpointer data, gpointer user_data)
+{
+    kp_exemap_t *exemap = (kp_exemap_t *)data;
+    weigh_t *wc = (weigh_t *)user_data;
+    double w = wc->exe_weight * exemap->prob;
+    double *cur = g_hash_table_lookup(wc->weights, exemap->map);
+
+    if (!cur) {
+        cur = g_new(double, 1);
+        *cur = 0;
+        g_hash_table_insert(wc->weights, exemap->map, cur);
+    }
+    if (w > *cur)
+        *cur = w;
+}
+
+static void
+weigh_exe(gpointer G_GNUC_UNUSED key, gpointer value, gpointer user_data)
+{
+    kp_exe_t *exe = (kp_exe_t *)value;
+    weigh_t wc;
+
+    wc.weights = user_data;
+    if (exe_is_running(exe))
+        wc.exe_weight = 1.0;    /* Running at shutdown: likely wanted again */
+    else if (exe->lnprob < 0)
+        wc.exe_weight = 1.0 - exp(exe->lnprob);
+    else
+        return;
+
+    g_set_foreach(exe->exemaps, weigh_exemap, &wc);
+}
+
+/* Snapshot context for add_map() */
+typedef struct {
+    GHashTable *files;      /* path → snap_file_t */
+    GHashTable *weights;    /* kp_map_t* → boxed double */
+} collect_t;
+
+static void
+add_map(gpointer data, gpointer user_data)
+{
+    kp_map_t *map = (kp_map_t *)data;
+    collect_t *cc = (collect_t *)user_data;
+    double *w = g_hash_table_lookup(cc->weights, map);
+    snap_file_t *file;
+    snap_extent_t range;
+
+    file = snap_file_get(cc->files, map->path,
+                         MAX(w ? *w : 0, CACHESNAP_MIN_WEIGHT));
+    range.offset = map->offset;
+    range.length = map->length;
+    g_array_append_val(file->ranges, range);
+}
+
+/**
+ * Append the resident parts of [offset, offset+length) of fd to extents
+ */
+static void
+probe_range(int fd, size_t file_size, size_t offset, size_t length,
+            GArray *extents, gboolean *use_cachestat)
+{
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t start, end, npages, i, run;
+    unsigned char *vec;
+    void *addr;
+
+    if (offset >= file_size)
+        return;
+    start = offset & ~(page - 1);
+    end = MIN(offset + length, file_size);
+    if (end <= start)
+        return;
+
+    if (*use_cachestat) {
+        struct snap_cachestat_range csr = { start, end - start };
+        struct snap_cachestat cs;
+
+        if (syscall(__NR_cachestat, fd, &csr, &cs, 0) == 0) {
+            size_t pages = (end - start + page - 1) / page;
+            if (cs.nr_cache == 0)
+                return;
+            if (cs.nr_cache >= pages) {
+                snap_extent_t ext = { start, end - start };
+                g_array_append_val(extents, ext);
+                return;
+            }
+        } else if (errno == ENOSYS) {
+            *use_cachestat = FALSE;
+        }
+    }
+
+    /* Mapping faults nothing in; for a shared file mapping mincore()
+     * reports page-cache residency */
+    addr = mmap(NULL, end - start, PROT_READ, MAP_SHARED, fd, start);
+    if (addr == MAP_FAILED)
+        return;
+
+    npages = (end - start + page - 1) / page;
+    vec = g_malloc(npages);
+    if (mincore(addr, end - start, vec) == 0) {
+        for (i = 0; i < npages; i = run) {
+            if (!(vec[i] & 1)) {
+                run = i + 1;
+                continue;
+            }
+            for (run = i + 1; run < npages && (vec[run] & 1); run++)
+                ;
+            {
+                snap_extent_t ext;
+                ext.offset = start + i * page;
+                ext.length = MIN(run * page, end - start) - i * page;
+                g_array_append_val(extents, ext);
+            }
+        }
+    }
+    g_free(vec);
+    munmap(addr, end - start);
+}
+
+static gint
+extent_compare(gconstpointer a, gconstpointer b)
+{
+    const snap_extent_t *ea = a, *eb = b;
+    return ea->offset < eb->offset ? -1 : ea->offset > eb->offset ? 1 : 0;
+}
+
+/**
+ * Sort a file's extents and coalesce overlapping/adjacent ones
+ */
+static void
+merge_extents(GArray *extents)
+{
+    guint i, out = 0;
+
+    if (extents->len < 2)
+        return;
+
+    g_array_sort(extents, extent_compare);
+    for (i = 1; i < extents->len; i++) {
+        snap_extent_t *cur = &g_array_index(extents, snap_extent_t, out);
+        snap_extent_t *next = &g_array_index(extents, snap_extent_t, i);
+
+        if (next->offset <= cur->offset + cur->length) {
+            size_t end = MAX(cur->offset + cur->length, next->offset + next->length);
+            cur->length = end - cur->offset;
+        } else {
+            g_array_index(extents, snap_extent_t, ++out) = *next;
+        }
+    }
+    g_array_set_size(extents, out + 1);
+}
+
+/**
+ * Probe residency of every range of a file
+ */
+static void
+probe_file(snap_file_t *file, gboolean *use_cachestat)
+{
+    struct stat st;
+    int fd;
+
+    fd = open(file->path, O_RDONLY | O_NOCTTY | O_NOFOLLOW
+#ifdef O_NOATIME
+              | O_NOATIME
+#endif
+             );
+    if (fd < 0)
+        return;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        for (guint i = 0; i < file->ranges->len; i++) {
+            snap_extent_t *r = &g_array_index(file->ranges, snap_extent_t, i);
+            probe_range(fd, st.st_size, r->offset, r->length,
+                        file->extents, use_cachestat);
+        }
+        merge_extents(file->extents);
+    }
+    close(fd);
+}
+
+/**
+ * Bytes of [offset, offset+length) of path currently in the page cache
+ */
+size_t
+kp_cachesnap_resident(const char *path, size_t offset, size_t length)
+{
+    static gboolean use_cachestat = TRUE;
+    GArray *extents;
+    struct stat st;
+    size_t resident = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY | O_NOCTTY | O_NOFOLLOW
+#ifdef O_NOATIME
+              | O_NOATIME
+#endif
+             );
+    if (fd < 0)
+        return 0;
+
+    extents = g_array_new(FALSE, FALSE, sizeof(snap_extent_t));
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode))
+        probe_range(fd, st.st_size, offset, length, extents, &use_cachestat);
+    close(fd);
+
+    for (guint i = 0; i < extents->len; i++)
+        resident += g_array_index(extents, snap_extent_t, i).length;
+    g_array_free(extents, TRUE);
+
+    return resident;
+}
+
+static gint
+snap_file_weight_compare(gconstpointer a, gconstpointer b)
+{
+    const snap_file_t *fa = *(const snap_file_t **)a;
+    const snap_file_t *fb = *(const snap_file_t **)b;
+
+    if (fa->weight > fb->weight) return -1;
+    if (fa->weight < fb->weight) return 1;
+    return strcmp(fa->path, fb->path);
+}
+
+/**
+ * Record resident ranges of tracked files
+ */
+void
+kp_cachesnap_save(const char *statefile)
+{
+    GHashTable *files, *weights;
+    GPtrArray *order;
+    GHashTableIter iter;
+    gpointer key, value;
+    gboolean use_cachestat = TRUE;
+    char *path, *tmpfile;
+    size_t total = 0;
+    int nfiles = 0, nextents = 0;
+    GString *body;
+    FILE *out;
+    int fd;
+    collect_t cc;
+
+    if (!statefile || !*statefile || !kp_state->maps)
+        return;
+
+    files = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, snap_file_free);
+    weights = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+
+    /* Model weights, then every tracked map */
+    g_hash_table_foreach(kp_state->exes, weigh_exe, weights);
+    cc.files = files;
+    cc.weights = weights;
+    g_ptr_array_foreach(kp_state->maps_arr, add_map, &cc);
+    g_hash_table_destroy(weights);
+
+    /* Extra files: whole file */
+    if (kp_conf->system.cachesnapshot_extra) {
+        char **extra = g_strsplit(kp_conf->system.cachesnapshot_extra, ";", -1);
+        for (char **p = extra; *p; p++) {
+            char *name = g_strstrip(*p);
+            snap_extent_t whole = { 0, G_MAXSIZE / 2 };
+
+            if (*name != '/')
+                continue;
+            g_array_append_val(snap_file_get(files, name, CACHESNAP_EXTRA_WEIGHT)->ranges,
+                               whole);
+        }
+        g_strfreev(extra);
+    }
+
+    /* Probe and order by value */
+    order = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, files);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        snap_file_t *file = value;
+
+        probe_file(file, &use_cachestat);
+        if (file->extents->len > 0)
+            g_ptr_array_add(order, file);
+    }
+    g_ptr_array_sort(order, snap_file_weight_compare);
+
+    body = g_string_new(NULL);
+    for (guint i = 0; i < order->len; i++) {
+        snap_file_t *file = g_ptr_array_index(order, i);
+        char weight[G_ASCII_DTOSTR_BUF_SIZE];
+        char *uri = g_filename_to_uri(file->path, NULL, NULL);
+
+        if (!uri)
+            continue;
+
+        g_ascii_formatd(weight, sizeof(weight), "%.4f", file->weight);
+        g_string_append_printf(body, "%s\t%s\t%s\n", TAG_FILE, weight, uri);
+        g_free(uri);
+        nfiles++;
+
+        for (guint j = 0; j < file->extents->len; j++) {
+            snap_extent_t *ext = &g_array_index(file->extents, snap_extent_t, j);
+            g_string_append_printf(body, "%s\t%zu\t%zu\n",
+                                   TAG_EXTENT, ext->offset, ext->length);
+            total += ext->length;
+            nextents++;
+        }
+    }
+    g_ptr_array_free(order, TRUE);
+    g_hash_table_destroy(files);
+
+    path = snap_path(statefile);
+    tmpfile = g_strconcat(path, ".tmp", NULL);
+
+    fd = open(tmpfile, O_WRONLY | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
+    out = fd >= 0 ? fdopen(fd, "w") : NULL;
+    if (!out) {
+        g_warning("cannot write cache snapshot %s: %s", tmpfile, strerror(errno));
+        if (fd >= 0)
+            close(fd);
+    } else {
+        gboolean ok;
+
+        ok = fprintf(out, "%s\t%d\t%d\t%d\t%zu\n", TAG_CACHESNAP,
+                     CACHESNAP_VERSION, nfiles, nextents, total) > 0;
+        ok = ok && fputs(body->str, out) >= 0;
+        ok = (fclose(out) == 0) && ok;
+
+        if (!ok || rename(tmpfile, path) < 0) {
+            g_warning("failed writing cache snapshot %s: %s", path, strerror(errno));
+            unlink(tmpfile);
+        } else {
+            g_message("cache snapshot: %d files, %d extents, %zu MB resident saved to %s",
+                      nfiles, nextents, total / (1024 * 1024), path);
+        }
+    }
+
+    g_string_free(body, TRUE);
+    g_free(tmpfile);
+    g_free(path);
+}
+
+/**
+ * Restore the most valuable part of the last snapshot
+ */
+int
+kp_cachesnap_restore(const char *statefile)
+{
+    char *path;
+    FILE *in;
+    char line[FILELEN + 128];
+    int version = 0, nfiles = 0, nextents = 0;
+    size_t total = 0;
+    long budget_kb;
+    size_t budget, used = 0;
+    GPtrArray *files;
+    snap_file_t *file = NULL;
+    GArray *maps;
+    GPtrArray *ptrs;
+    int issued = 0;
+    gboolean ok = TRUE, full = FALSE;
+
+    if (!statefile || !*statefile)
+        return 0;
+
+    path = snap_path(statefile);
+    in = fopen(path, "r");
+    if (!in) {
+        if (errno != ENOENT)
+            g_warning("cannot open cache snapshot %s: %s", path, strerror(errno));
+        g_free(path);
+        return 0;
+    }
+
+    if (!fgets(line, sizeof(line), in) ||
+        sscanf(line, TAG_CACHESNAP "\t%d\t%d\t%d\t%zu",
+               &version, &nfiles, &nextents, &total) != 4 ||
+        version != CACHESNAP_VERSION) {
+        g_warning("ignoring cache snapshot %s: bad header", path);
+        fclose(in);
+        g_free(path);
+        return 0;
+    }
+
+    budget_kb = kp_readahead_memavail();
+    budget = (size_t)budget_kb * 1024;
+
+    /* Files are stored highest weight first, so reading in order and
+     * stopping at the budget keeps the most valuable part */
+    files = g_ptr_array_new_with_free_func(snap_file_free);
+    while (!full && fgets(line, sizeof(line), in)) {
+        if (g_str_has_prefix(line, TAG_FILE "\t")) {
+            char weight[64], uri[FILELEN];
+
+            if (sscanf(line, TAG_FILE "\t%63s\t%" FILELENSTR "s", weight, uri) != 2) {
+                ok = FALSE;
+                break;
+            }
+            file = g_new0(snap_file_t, 1);
+            file->weight = g_ascii_strtod(weight, NULL);
+            file->path = g_filename_from_uri(uri, NULL, NULL);
+            file->extents = g_array_new(FALSE, FALSE, sizeof(snap_extent_t));
+            g_ptr_array_add(files, file);
+            if (!file->path) {
+                ok = FALSE;
+                break;
+            }
+        } else if (g_str_has_prefix(line, TAG_EXTENT "\t") && file) {
+            snap_extent_t ext;
+
+            if (sscanf(line, TAG_EXTENT "\t%zu\t%zu", &ext.offset, &ext.length) != 2) {
+                ok = FALSE;
+                break;
+            }
+            if (used + ext.length > budget) {
+                ext.length = budget - used;
+                full = TRUE;
+            }
+            if (ext.length > 0) {
+                g_array_append_val(file->extents, ext);
+                used += ext.length;
+            }
+        } else {
+            ok = FALSE;
+            break;
+        }
+    }
+    fclose(in);
+
+    if (!ok) {
+        g_warning("ignoring cache snapshot %s: syntax error", path);
+        g_ptr_array_free(files, TRUE);
+        g_free(path);
+        return 0;
+    }
+
+    /* Hand everything to the normal readahead path, which sorts by block */
+    maps = g_array_new(FALSE, TRUE, sizeof(kp_map_t));
+    for (guint i = 0; i < files->len; i++) {
+        snap_file_t *f = g_ptr_array_index(files, i);
+        for (guint j = 0; j < f->extents->len; j++) {
+            snap_extent_t *ext = &g_array_index(f->extents, snap_extent_t, j);
+            kp_map_t map = {0};
+
+            map.path = f->path;
+            map.offset = ext->offset;
+            map.length = ext->length;
+            map.block = -1;
+            g_array_append_val(maps, map);
+        }
+    }
+    ptrs = g_ptr_array_sized_new(maps->len);
+    for (guint i = 0; i < maps->len; i++)
+        g_ptr_array_add(ptrs, &g_array_index(maps, kp_map_t, i));
+
+    if (ptrs->len > 0)
+        issued = kp_readahead((kp_map_t **)ptrs->pdata, ptrs->len);
+
+    g_message("cache snapshot: restored %zu of %zu MB (%d requests, budget %ld MB) from %s",
+              used / (1024 * 1024), total / (1024 * 1024), issued,
+              budget_kb / 1024, path);
+
+    g_ptr_array_free(ptrs, TRUE);
+    g_array_free(maps, TRUE);
+    g_ptr_array_free(files, TRUE);
+    g_free(path);
+    return issued;
+}
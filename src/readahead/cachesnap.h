@@ -0,0 +1,41 @@
+/* cachesnap.h - Page-cache snapshot and restore for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef CACHESNAP_H
+#define CACHESNAP_H
+
+#include <glib.h>
+
+/**
+ * Record resident page ranges of all tracked maps and of
+ * system.cachesnapshot_extra into <statefile>.cachesnap
+ * Called at shutdown when system.cachesnapshot is enabled
+ * @param statefile Path of the state file the snapshot belongs to
+ */
+void kp_cachesnap_save(const char *statefile);
+
+/**
+ * Restore the highest-weighted part of <statefile>.cachesnap that fits
+ * the memory budget, through the normal readahead path
+ * @param statefile Path of the state file the snapshot belongs to
+ * @return Number of readahead requests issued
+ */
+int kp_cachesnap_restore(const char *statefile);
+
+/**
+ * Page-cache residency of one range, via cachestat() or mincore()
+ * @param path File to probe
+ * @param offset Start of the range
+ * @param length Length of the range
+ * @return Resident bytes in the range (0 if the file cannot be opened)
+ */
+size_t kp_cachesnap_resident(const char *path, size_t offset, size_t length);
+
+#endif /* CACHESNAP_H */
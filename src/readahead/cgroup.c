@@ -0,0 +1,293 @@
+/* cgroup.c - cgroup v2 memory protection for preloaded page cache
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Readahead cgroup
+ * =============================================================================
+ *
+ * Page cache is charged to the memory cgroup of the task that reads it in.
+ * Without help, preloaded pages share the daemon's (or the service slice's)
+ * cgroup and are reclaimed like any other cold cache, often before the user
+ * gets to launch the app, and nothing bounds them except the global budget.
+ *
+ * With system.cgroup enabled the daemon's own cgroup (which must be
+ * delegated: Delegate=yes in the unit) is split in two leaves:
+ *
+ *   <own cgroup>/                 cgroup.subtree_control: +memory
+ *     ├── daemon/                 the daemon process itself
+ *     └── readahead/              forked readahead workers
+ *            memory.low  = system.cgroupprotect  (kept over other cache)
+ *            memory.high = system.cgroupmax      (reclaimed above this)
+ *
+ * cgroup v2 forbids processes in a cgroup that distributes controllers to
+ * children, hence the "daemon" leaf. Workers join "readahead" right after
+ * fork() through a descriptor opened once.
+ *
+ * The prophet caps its budget to what memory.high leaves for file pages
+ * (kp_cgroup_budget), read from memory.current and memory.stat.
+ *
+ * memory.low only protects as far as the ancestors' protection reaches:
+ * set MemoryLow= on the unit, or rely on memory_recursiveprot.
+ *
+ * Any failure (cgroup v1, no delegation, read-only hierarchy) is logged
+ * once and leaves the daemon running as before.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "cgroup.h"
+#include "../utils/logging.h"
+#include "../config/config.h"
+
+#define CGROUP_ROOT         "/sys/fs/cgroup"
+#define CGROUP_DAEMON       "daemon"
+#define CGROUP_READAHEAD    "readahead"
+
+static struct {
+    unsigned int gen;       /* kp_config_generation() last applied */
+    char *readahead_dir;    /* Path of the readahead leaf, or NULL */
+    int procs_fd;           /* readahead/cgroup.procs, or -1 */
+} cg = { 0, NULL, -1 };
+
+/**
+ * Write a value to a cgroup control file
+ */
+static gboolean
+cg_write(const char *dir, const char *file, const char *value)
+{
+    char *path = g_build_filename(dir, file, NULL);
+    int fd;
+    ssize_t n;
+    gboolean ok;
+
+    fd = open(path, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        kp_debug("cgroup: cannot open %s: %s", path, strerror(errno));
+        g_free(path);
+        return FALSE;
+    }
+    n = write(fd, value, strlen(value));
+    ok = n == (ssize_t)strlen(value);
+    if (!ok)
+        kp_debug("cgroup: writing \"%s\" to %s: %s", value, path, strerror(errno));
+    close(fd);
+    g_free(path);
+    return ok;
+}
+
+/**
+ * Read a whole cgroup control file
+ */
+static char *
+cg_read(const char *dir, const char *file)
+{
+    char *path = g_build_filename(dir, file, NULL);
+    char *contents = NULL;
+
+    if (!g_file_get_contents(path, &contents, NULL, NULL))
+        contents = NULL;
+    g_free(path);
+    return contents;
+}
+
+/**
+ * Directory of the cgroup the daemon is in ("0::/path" in /proc/self/cgroup)
+ */
+static char *
+own_cgroup_dir(void)
+{
+    char *contents, *line, *dir = NULL;
+
+    if (!g_file_get_contents("/proc/self/cgroup", &contents, NULL, NULL))
+        return NULL;
+
+    line = strstr(contents, "0::");
+    if (line && (line == contents || line[-1] == '\n')) {
+        char *end = strchr(line, '\n');
+        if (end)
+            *end = '\0';
+        dir = g_build_filename(CGROUP_ROOT, line + 3, NULL);
+    }
+    g_free(contents);
+    return dir;
+}
+
+/**
+ * Split the daemon's cgroup into daemon/ and readahead/ leaves
+ */
+static gboolean
+cg_setup(void)
+{
+    char *own, *base, *daemon_dir, *procs;
+    gboolean ok = FALSE;
+
+    if (!g_file_test(CGROUP_ROOT "/cgroup.controllers", G_FILE_TEST_EXISTS)) {
+        g_message("cgroup: no unified (v2) hierarchy at %s, not using a readahead cgroup",
+                  CGROUP_ROOT);
+        return FALSE;
+    }
+
+    own = own_cgroup_dir();
+    if (!own) {
+        g_message("cgroup: cannot determine own cgroup, not using a readahead cgroup");
+        return FALSE;
+    }
+
+    /* Already moved by an earlier setup (before a failure or disable) */
+    if (!strcmp(strrchr(own, '/') + 1, CGROUP_DAEMON))
+        base = g_path_get_dirname(own);
+    else
+        base = g_strdup(own);
+    g_free(own);
+
+    daemon_dir = g_build_filename(base, CGROUP_DAEMON, NULL);
+    g_free(cg.readahead_dir);
+    cg.readahead_dir = g_build_filename(base, CGROUP_READAHEAD, NULL);
+
+    if ((mkdir(daemon_dir, 0755) < 0 && errno != EEXIST) ||
+        (mkdir(cg.readahead_dir, 0755) < 0 && errno != EEXIST)) {
+        g_message("cgroup: cannot create leaves under %s (%s); "
+                  "the unit needs Delegate=yes", base, strerror(errno));
+        goto out;
+    }
+
+    if (!cg_write(daemon_dir, "cgroup.procs", "0") ||
+        !cg_write(base, "cgroup.subtree_control", "+memory")) {
+        g_message("cgroup: cannot enable the memory controller under %s; "
+                  "the unit needs Delegate=yes", base);
+        goto out;
+    }
+
+    procs = g_build_filename(cg.readahead_dir, "cgroup.procs", NULL);
+    cg.procs_fd = open(procs, O_WRONLY | O_CLOEXEC);
+    g_free(procs);
+    if (cg.procs_fd < 0) {
+        g_message("cgroup: cannot open %s/cgroup.procs: %s",
+                  cg.readahead_dir, strerror(errno));
+        goto out;
+    }
+
+    g_message("cgroup: readahead workers charged to %s", cg.readahead_dir);
+    ok = TRUE;
+
+out:
+    if (!ok) {
+        g_free(cg.readahead_dir);
+        cg.readahead_dir = NULL;
+    }
+    g_free(daemon_dir);
+    g_free(base);
+    return ok;
+}
+
+/**
+ * Apply memory.low / memory.high from the configuration
+ */
+static void
+cg_apply_limits(gboolean enabled)
+{
+    char value[32];
+
+    if (!cg.readahead_dir)
+        return;
+
+    g_snprintf(value, sizeof(value), "%d", enabled ? kp_conf->system.cgroupprotect : 0);
+    cg_write(cg.readahead_dir, "memory.low", value);
+
+    if (enabled && kp_conf->system.cgroupmax > 0)
+        g_snprintf(value, sizeof(value), "%d", kp_conf->system.cgroupmax);
+    else
+        g_strlcpy(value, "max", sizeof(value));
+    cg_write(cg.readahead_dir, "memory.high", value);
+}
+
+void
+kp_cgroup_sync(void)
+{
+    unsigned int gen = kp_config_generation();
+
+    if (gen == cg.gen)
+        return;
+    cg.gen = gen;
+
+    if (!kp_conf->system.cgroup) {
+        /* Keep the leaves, just stop protecting and bounding */
+        cg_apply_limits(FALSE);
+        if (cg.procs_fd >= 0) {
+            close(cg.procs_fd);
+            cg.procs_fd = -1;
+        }
+        return;
+    }
+
+    /* Retried on the next config reload if it fails */
+    if (cg.procs_fd < 0 && !cg_setup())
+        return;
+
+    cg_apply_limits(TRUE);
+    kp_debug("cgroup: memory.low %d KB, memory.high %d KB",
+             kp_conf->system.cgroupprotect / 1024, kp_conf->system.cgroupmax / 1024);
+}
+
+int
+kp_cgroup_worker_fd(void)
+{
+    if (cg.procs_fd < 0)
+        return -1;
+    /* A config reload may close ours while the I/O thread still reads */
+    return fcntl(cg.procs_fd, F_DUPFD_CLOEXEC, 0);
+}
+
+void
+kp_cgroup_enter_worker(int procs_fd)
+{
+    ssize_t n G_GNUC_UNUSED;
+
+    if (procs_fd < 0)
+        return;
+    /* On failure the pages are just charged to the daemon's leaf */
+    n = write(procs_fd, "0", 1);
+}
+
+long
+kp_cgroup_budget(long memavail)
+{
+    char *contents, *line;
+    long long current, file = -1, room;
+
+    kp_cgroup_sync();
+    if (cg.procs_fd < 0 || kp_conf->system.cgroupmax <= 0)
+        return memavail;
+
+    contents = cg_read(cg.readahead_dir, "memory.current");
+    if (!contents)
+        return memavail;
+    current = g_ascii_strtoll(contents, NULL, 10);
+    g_free(contents);
+
+    contents = cg_read(cg.readahead_dir, "memory.stat");
+    if (contents) {
+        line = strstr(contents, "file ");
+        if (line && (line == contents || line[-1] == '\n'))
+            file = g_ascii_strtoll(line + 5, NULL, 10);
+        g_free(contents);
+    }
+    if (file < 0 || file > current)
+        file = current;
+
+    /* Page cache may grow to memory.high minus what is not page cache */
+    room = ((long long)kp_conf->system.cgroupmax - (current - file)) / 1024;
+    room = MAX(0, room);
+
+    kp_debug("cgroup: %lld KB charged (%lld KB page cache), %lld KB room under memory.high",
+             current / 1024, file / 1024, room);
+
+    return (long)MIN((long long)memavail, room);
+}
@@ -0,0 +1,53 @@
+/* cgroup.h - cgroup v2 memory protection for preloaded page cache
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef KP_CGROUP_H
+#define KP_CGROUP_H
+
+#include <glib.h>
+
+/**
+ * Set up (or update, after a config reload) the readahead cgroup
+ *
+ * With system.cgroup enabled, moves the daemon into a "daemon" leaf of
+ * its cgroup and creates a sibling "readahead" leaf whose memory.low and
+ * memory.high follow system.cgroupprotect / system.cgroupmax. Cheap when
+ * the configuration has not changed; call before every readahead batch.
+ */
+void kp_cgroup_sync(void);
+
+/**
+ * Own copy of the readahead cgroup's cgroup.procs, for a readahead plan
+ *
+ * @return File descriptor to close when done, or -1 when inactive
+ */
+int kp_cgroup_worker_fd(void);
+
+/**
+ * Move the calling (forked worker) process into the readahead cgroup,
+ * so the page cache it reads in is charged there. No-op for -1.
+ *
+ * @param procs_fd File descriptor from kp_cgroup_worker_fd()
+ */
+void kp_cgroup_enter_worker(int procs_fd);
+
+/**
+ * Reconcile a memory budget with the readahead cgroup
+ *
+ * Caps the budget to the room memory.high leaves for page cache
+ * (memory.high minus the cgroup's non-file usage), as read from
+ * memory.current and memory.stat.
+ *
+ * @param memavail Budget in kilobytes
+ * @return Budget in kilobytes, never larger than memavail
+ */
+long kp_cgroup_budget(long memavail);
+
+#endif /* KP_CGROUP_H */
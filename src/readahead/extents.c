@@ -0,0 +1,268 @@
+/* extents.c - Per-file interval sets for readahead selection in Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Readahead Extent Sets
+ * =============================================================================
+ *
+ * One file is often covered by several maps that overlap: the per-segment
+ * mmaps from /proc/PID/maps plus a whole-file map added for a manual app
+ * or a session seed. Charging every map's full length against the budget
+ * counts the shared bytes several times, and kp_readahead() only merges
+ * ranges that happen to end up next to each other after sorting.
+ *
+ * An extent set keeps, per file, the sorted union of the ranges added:
+ *
+ *   libfoo.so  [0 ─── 64K)  +  [0 ──────────── 1M)  +  [900K ─ 1.2M)
+ *              └─ union: [0 ─────────────────────────────── 1.2M)
+ *
+ *   kp_extents_uncovered() → bytes a map would add (what to charge)
+ *   kp_extents_add()       → merge it in
+ *   kp_extents_readahead() → one request per disjoint extent, whatever
+ *                            sortstrategy does to the order
+ *
+ * Files are identified like maps are: by (dev, ino) when known, by path
+ * otherwise. Extents remember the map they start with, so the block
+ * number set_block() looks up is cached on that map for the next cycle.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "extents.h"
+#include "readahead.h"
+
+/* One disjoint range of a file */
+typedef struct _extent_t
+{
+    size_t start;
+    size_t end;
+    kp_map_t *head;     /* Map starting at 'start' (carries the block cache) */
+} extent_t;
+
+/* All ranges of one file, sorted by start, neither overlapping nor adjacent */
+typedef struct _extent_file_t
+{
+    kp_map_t *first;    /* First map seen for the file (hash key) */
+    GArray *ranges;     /* extent_t */
+} extent_file_t;
+
+struct _kp_extents_t
+{
+    GHashTable *files;  /* kp_map_t* (file identity) -> extent_file_t */
+    GPtrArray *order;   /* extent_file_t, in the order files were added */
+    size_t total;       /* Bytes in the union */
+};
+
+/**
+ * Hash a map by file only (offset and length ignored)
+ */
+static guint
+file_hash(gconstpointer p)
+{
+    const kp_map_t *map = p;
+
+    if (map->ino) {
+        gint64 key = (gint64)((guint64)map->ino ^ ((guint64)map->dev << 32));
+        return g_int64_hash(&key);
+    }
+    return g_str_hash(map->path);
+}
+
+static gboolean
+file_equal(gconstpointer pa, gconstpointer pb)
+{
+    const kp_map_t *a = pa, *b = pb;
+
+    if (a->ino || b->ino)
+        return a->ino == b->ino && a->dev == b->dev;
+    return !strcmp(a->path, b->path);
+}
+
+static void
+extent_file_free(extent_file_t *file)
+{
+    g_array_free(file->ranges, TRUE);
+    g_slice_free(extent_file_t, file);
+}
+
+kp_extents_t *
+kp_extents_new(void)
+{
+    kp_extents_t *ex = g_slice_new(kp_extents_t);
+
+    ex->files = g_hash_table_new(file_hash, file_equal);
+    ex->order = g_ptr_array_new_with_free_func((GDestroyNotify)extent_file_free);
+    ex->total = 0;
+    return ex;
+}
+
+void
+kp_extents_free(kp_extents_t *ex)
+{
+    if (!ex)
+        return;
+    g_hash_table_destroy(ex->files);
+    g_ptr_array_free(ex->order, TRUE);
+    g_slice_free(kp_extents_t, ex);
+}
+
+/**
+ * Bytes of [start, end) not covered by a file's ranges
+ */
+static size_t
+file_uncovered(extent_file_t *file, size_t start, size_t end)
+{
+    size_t missing = end - start;
+
+    for (guint i = 0; i < file->ranges->len; i++) {
+        extent_t *e = &g_array_index(file->ranges, extent_t, i);
+
+        if (e->start >= end)
+            break;
+        if (e->end <= start)
+            continue;
+        missing -= MIN(e->end, end) - MAX(e->start, start);
+    }
+    return missing;
+}
+
+size_t
+kp_extents_uncovered(kp_extents_t *ex, kp_map_t *map)
+{
+    extent_file_t *file;
+
+    g_return_val_if_fail(ex, 0);
+    g_return_val_if_fail(map, 0);
+
+    file = g_hash_table_lookup(ex->files, map);
+    if (!file)
+        return map->length;
+    return file_uncovered(file, map->offset, map->offset + map->length);
+}
+
+size_t
+kp_extents_add(kp_extents_t *ex, kp_map_t *map)
+{
+    extent_file_t *file;
+    extent_t merged;
+    size_t added;
+    guint i, first;
+
+    g_return_val_if_fail(ex, 0);
+    g_return_val_if_fail(map, 0);
+
+    if (!map->length)
+        return 0;
+
+    file = g_hash_table_lookup(ex->files, map);
+    if (!file) {
+        file = g_slice_new(extent_file_t);
+        file->first = map;
+        file->ranges = g_array_new(FALSE, FALSE, sizeof(extent_t));
+        g_hash_table_insert(ex->files, map, file);
+        g_ptr_array_add(ex->order, file);
+    }
+
+    merged.start = map->offset;
+    merged.end = map->offset + map->length;
+    merged.head = map;
+    added = file_uncovered(file, merged.start, merged.end);
+
+    /* Skip ranges that end before the new one (adjacent ones merge) */
+    for (i = 0; i < file->ranges->len; i++) {
+        if (g_array_index(file->ranges, extent_t, i).end >= merged.start)
+            break;
+    }
+
+    /* Swallow every range that overlaps or touches it */
+    first = i;
+    while (i < file->ranges->len) {
+        extent_t *e = &g_array_index(file->ranges, extent_t, i);
+
+        if (e->start > merged.end)
+            break;
+        if (e->start <= merged.start) {
+            merged.start = e->start;
+            merged.head = e->head;
+        }
+        merged.end = MAX(merged.end, e->end);
+        i++;
+    }
+
+    g_array_remove_range(file->ranges, first, i - first);
+    g_array_insert_val(file->ranges, first, merged);
+
+    ex->total += added;
+    return added;
+}
+
+size_t
+kp_extents_total(kp_extents_t *ex)
+{
+    g_return_val_if_fail(ex, 0);
+    return ex->total;
+}
+
+int
+kp_extents_readahead(kp_extents_t *ex)
+{
+    GArray *maps;
+    GPtrArray *ptrs, *heads;
+    int issued;
+
+    g_return_val_if_fail(ex, 0);
+
+    maps = g_array_new(FALSE, TRUE, sizeof(kp_map_t));
+    heads = g_ptr_array_new();
+
+    for (guint i = 0; i < ex->order->len; i++) {
+        extent_file_t *file = g_ptr_array_index(ex->order, i);
+
+        for (guint j = 0; j < file->ranges->len; j++) {
+            extent_t *e = &g_array_index(file->ranges, extent_t, j);
+            kp_map_t map = {0};
+
+            map.path = e->head->path;
+            map.offset = e->start;
+            map.length = e->end - e->start;
+            map.dev = e->head->dev;
+            map.ino = e->head->ino;
+            map.block = e->head->block;
+            g_array_append_val(maps, map);
+            g_ptr_array_add(heads, e->head);
+        }
+    }
+
+    if (!maps->len) {
+        g_ptr_array_free(heads, TRUE);
+        g_array_free(maps, TRUE);
+        return 0;
+    }
+
+    ptrs = g_ptr_array_sized_new(maps->len);
+    for (guint i = 0; i < maps->len; i++)
+        g_ptr_array_add(ptrs, &g_array_index(maps, kp_map_t, i));
+
+    issued = kp_readahead((kp_map_t **)ptrs->pdata, ptrs->len);
+
+    /* Extents start where their head map does: keep the block lookup */
+    for (guint i = 0; i < maps->len; i++) {
+        kp_map_t *head = g_ptr_array_index(heads, i);
+
+        if (head->block == -1)
+            head->block = g_array_index(maps, kp_map_t, i).block;
+    }
+
+    g_ptr_array_free(ptrs, TRUE);
+    g_ptr_array_free(heads, TRUE);
+    g_array_free(maps, TRUE);
+
+    return issued;
+}
@@ -0,0 +1,54 @@
+/* extents.h - Per-file interval sets for readahead selection in Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef EXTENTS_H
+#define EXTENTS_H
+
+#include "../state/state.h"
+
+/* Union of selected map ranges, per file */
+typedef struct _kp_extents_t kp_extents_t;
+
+/**
+ * Create an empty extent set
+ * Maps added to it must stay alive until kp_extents_free()
+ */
+kp_extents_t *kp_extents_new(void);
+
+/**
+ * Free an extent set (the maps added to it are not touched)
+ */
+void kp_extents_free(kp_extents_t *ex);
+
+/**
+ * Bytes of a map not yet covered by the set
+ * @return What adding the map would grow the union by
+ */
+size_t kp_extents_uncovered(kp_extents_t *ex, kp_map_t *map);
+
+/**
+ * Add a map's range to the set, merging it with overlapping or
+ * adjacent ranges of the same file
+ * @return Bytes the union grew by
+ */
+size_t kp_extents_add(kp_extents_t *ex, kp_map_t *map);
+
+/**
+ * Total bytes in the union of all added ranges
+ */
+size_t kp_extents_total(kp_extents_t *ex);
+
+/**
+ * Read the merged extents through kp_readahead()
+ * @return Number of readahead requests issued
+ */
+int kp_extents_readahead(kp_extents_t *ex);
+
+#endif /* EXTENTS_H */
@@ -0,0 +1,283 @@
+/* fsclass.c - Filesystem classification for readahead in Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Filesystem Classes
+ * =============================================================================
+ *
+ * Maps can point at files on NFS home directories, sshfs or CIFS mounts.
+ * open()/readahead() on a slow or unreachable server blocks the worker
+ * (or the daemon itself for in-process reads) and holds up the whole
+ * batch. The readahead planner asks this module which class a file's
+ * filesystem belongs to and applies the configured policy.
+ *
+ * CLASSIFICATION (never touches the filesystem being classified):
+ *
+ *   st_dev ──> /proc/self/mountinfo "maj:min"  ──> fstype
+ *     │                                  miss (btrfs subvolumes, dev 0)
+ *     └──────> longest mount point prefix of the path ──> fstype
+ *                                        miss
+ *              statfs(path) f_type (last resort)
+ *
+ *   fstype                                       class
+ *   nfs, nfs4, cifs, smb3, ceph, 9p, afs,        NETWORK
+ *   glusterfs, lustre, fuse.sshfs, fuse.rclone…
+ *   fuse, fuse.*, fuseblk                        FUSE
+ *   tmpfs, ramfs, devtmpfs, proc, sysfs          MEMORY
+ *   autofs                                       AUTOFS
+ *   anything else                                LOCAL
+ *
+ * CACHING:
+ *   Results are cached per st_dev. The cache and the parsed mountinfo are
+ *   dropped every FSCLASS_TTL seconds so new and changed mounts are seen.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "fsclass.h"
+#include "../utils/logging.h"
+#include "../utils/mountinfo.h"
+#include "../state/state.h"
+
+#include <sys/sysmacros.h>
+#include <sys/vfs.h>
+#include <time.h>
+
+#define FSCLASS_TTL         300     /* seconds before cache and mountinfo are re-read */
+#define MOUNTINFO_PATH      "/proc/self/mountinfo"
+
+/* statfs() f_type values (not all are in <linux/magic.h>) */
+#define FS_MAGIC_NFS        0x6969
+#define FS_MAGIC_SMB        0x517B
+#define FS_MAGIC_CIFS       0xFF534D42
+#define FS_MAGIC_SMB2       0xFE534D42
+#define FS_MAGIC_CEPH       0x00C36400
+#define FS_MAGIC_AFS        0x5346414F
+#define FS_MAGIC_V9FS       0x01021997
+#define FS_MAGIC_FUSE       0x65735546
+#define FS_MAGIC_TMPFS      0x01021994
+#define FS_MAGIC_RAMFS      0x858458F6
+#define FS_MAGIC_AUTOFS     0x0187
+
+/* One line of mountinfo */
+typedef struct _mount_t
+{
+    dev_t dev;
+    char *mountpoint;
+    kp_fs_class_t fsclass;
+} mount_t;
+
+static struct {
+    GHashTable *devs;       /* guint64 dev -> class + 1 */
+    GArray *mounts;         /* mount_t */
+    time_t loaded;
+} fsc = { NULL, NULL, 0 };
+
+/* Network filesystem types, and FUSE subtypes that talk to a server */
+static const char *network_types[] = {
+    "nfs", "nfs4", "cifs", "smb3", "smbfs", "ncpfs", "ceph", "9p", "afs",
+    "glusterfs", "lustre", "gpfs", "davfs", "coda",
+    "fuse.sshfs", "fuse.rclone", "fuse.s3fs", "fuse.glusterfs",
+    "fuse.gvfsd-fuse", "fuse.davfs2", "fuse.curlftpfs", "fuse.goofys",
+    NULL
+};
+
+static const char *memory_types[] = {
+    "tmpfs", "ramfs", "devtmpfs", "proc", "sysfs", "cgroup2", "debugfs",
+    NULL
+};
+
+static gboolean
+in_list(const char *type, const char **list)
+{
+    for (int i = 0; list[i]; i++) {
+        if (!strcmp(type, list[i]))
+            return TRUE;
+    }
+    return FALSE;
+}
+
+static kp_fs_class_t
+class_of_type(const char *type)
+{
+    if (in_list(type, network_types))
+        return KP_FS_NETWORK;
+    if (!strcmp(type, "fuse") || !strcmp(type, "fuseblk") || g_str_has_prefix(type, "fuse."))
+        return KP_FS_FUSE;
+    if (in_list(type, memory_types))
+        return KP_FS_MEMORY;
+    if (!strcmp(type, "autofs"))
+        return KP_FS_AUTOFS;
+    return KP_FS_LOCAL;
+}
+
+static kp_fs_class_t
+class_of_magic(unsigned long magic)
+{
+    switch (magic) {
+        case FS_MAGIC_NFS:
+        case FS_MAGIC_SMB:
+        case FS_MAGIC_CIFS:
+        case FS_MAGIC_SMB2:
+        case FS_MAGIC_CEPH:
+        case FS_MAGIC_AFS:
+        case FS_MAGIC_V9FS:
+            return KP_FS_NETWORK;
+        case FS_MAGIC_FUSE:
+            return KP_FS_FUSE;
+        case FS_MAGIC_TMPFS:
+        case FS_MAGIC_RAMFS:
+            return KP_FS_MEMORY;
+        case FS_MAGIC_AUTOFS:
+            return KP_FS_AUTOFS;
+        default:
+            return KP_FS_LOCAL;
+    }
+}
+
+static void
+mounts_free(void)
+{
+    if (!fsc.mounts)
+        return;
+    for (guint i = 0; i < fsc.mounts->len; i++)
+        g_free(g_array_index(fsc.mounts, mount_t, i).mountpoint);
+    g_array_free(fsc.mounts, TRUE);
+    fsc.mounts = NULL;
+}
+
+/**
+ * (Re)load mountinfo and reset the per-device cache when stale
+ */
+static void
+fsclass_refresh(void)
+{
+    time_t now = time(NULL);
+    FILE *in;
+    char line[4096];
+
+    if (fsc.devs && now - fsc.loaded < FSCLASS_TTL && now >= fsc.loaded)
+        return;
+
+    if (!fsc.devs)
+        fsc.devs = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+    g_hash_table_remove_all(fsc.devs);
+    mounts_free();
+    fsc.mounts = g_array_new(FALSE, FALSE, sizeof(mount_t));
+    fsc.loaded = now;
+
+    in = fopen(MOUNTINFO_PATH, "r");
+    if (!in)
+        return;
+
+    /* id parent maj:min root mountpoint options [optional...] - fstype source super */
+    while (fgets(line, sizeof(line), in)) {
+        unsigned int major, minor;
+        char mountpoint[FILELEN];
+        char *sep;
+        char fstype[64];
+        mount_t m;
+
+        if (sscanf(line, "%*d %*d %u:%u %*s %"FILELENSTR"s", &major, &minor, mountpoint) != 3)
+            continue;
+        sep = strstr(line, " - ");
+        if (!sep || sscanf(sep + 3, "%63s", fstype) != 1)
+            continue;
+
+        kp_mountinfo_unescape(mountpoint);
+        m.dev = makedev(major, minor);
+        m.mountpoint = g_strdup(mountpoint);
+        m.fsclass = class_of_type(fstype);
+        g_array_append_val(fsc.mounts, m);
+    }
+    fclose(in);
+}
+
+/**
+ * Mount whose mount point is the longest prefix of path
+ */
+static const mount_t *
+mount_for_path(const char *path)
+{
+    const mount_t *best = NULL;
+    size_t best_len = 0;
+
+    /* Later lines override earlier ones mounted on the same point */
+    for (guint i = 0; i < fsc.mounts->len; i++) {
+        const mount_t *m = &g_array_index(fsc.mounts, mount_t, i);
+        size_t len = strlen(m->mountpoint);
+
+        if (len < best_len || strncmp(path, m->mountpoint, len))
+            continue;
+        if (len > 1 && path[len] != '/' && path[len] != '\0')
+            continue;
+        best = m;
+        best_len = len;
+    }
+    return best;
+}
+
+kp_fs_class_t
+kp_fsclass_get(dev_t dev, const char *path)
+{
+    const mount_t *m = NULL;
+    kp_fs_class_t fsclass = KP_FS_LOCAL;
+    struct statfs sfs;
+    guint64 key = dev;
+    gpointer cached;
+
+    fsclass_refresh();
+
+    if (dev) {
+        cached = g_hash_table_lookup(fsc.devs, &key);
+        if (cached)
+            return (kp_fs_class_t)(GPOINTER_TO_INT(cached) - 1);
+
+        for (guint i = 0; i < fsc.mounts->len; i++) {
+            if (g_array_index(fsc.mounts, mount_t, i).dev == dev) {
+                m = &g_array_index(fsc.mounts, mount_t, i);
+                break;
+            }
+        }
+    }
+
+    if (!m && path)
+        m = mount_for_path(path);
+
+    if (m)
+        fsclass = m->fsclass;
+    else if (path && statfs(path, &sfs) == 0)
+        fsclass = class_of_magic((unsigned long)sfs.f_type);
+
+    if (dev) {
+        guint64 *stored = g_new(guint64, 1);
+
+        *stored = key;
+        g_hash_table_insert(fsc.devs, stored, GINT_TO_POINTER(fsclass + 1));
+        if (fsclass != KP_FS_LOCAL)
+            kp_debug("filesystem of %s (dev %lu) is %s", path ? path : "?",
+                     (unsigned long)dev, kp_fsclass_name(fsclass));
+    }
+
+    return fsclass;
+}
+
+const char *
+kp_fsclass_name(kp_fs_class_t fsclass)
+{
+    switch (fsclass) {
+        case KP_FS_LOCAL:   return "local";
+        case KP_FS_NETWORK: return "network";
+        case KP_FS_FUSE:    return "fuse";
+        case KP_FS_MEMORY:  return "memory";
+        case KP_FS_AUTOFS:  return "autofs";
+    }
+    return "unknown";
+}
@@ -0,0 +1,48 @@
+/* fsclass.h - Filesystem classification for readahead in Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef FSCLASS_H
+#define FSCLASS_H
+
+#include <sys/types.h>
+#include <glib.h>
+
+/* What kind of filesystem a file lives on */
+typedef enum {
+    KP_FS_LOCAL = 0,    /* Block device backed: read normally */
+    KP_FS_NETWORK,      /* NFS, CIFS, Ceph, sshfs...: may stall or vanish */
+    KP_FS_FUSE,         /* Other userspace filesystems: may stall */
+    KP_FS_MEMORY,       /* tmpfs, ramfs...: already in memory */
+    KP_FS_AUTOFS        /* Automount trigger: reading would mount */
+} kp_fs_class_t;
+
+/* Policies for system.netfs / system.fusefs */
+#define KP_FS_POLICY_SKIP   0   /* Never read */
+#define KP_FS_POLICY_LIMIT  1   /* Read inline, up to system.netfsmax per batch */
+#define KP_FS_POLICY_LANE   2   /* Read in a detached worker with a timeout */
+
+/**
+ * Classify the filesystem a file is on
+ *
+ * Uses /proc/self/mountinfo (no I/O on the filesystem itself), falling
+ * back to statfs() f_type. Results are cached per st_dev.
+ *
+ * @param dev  st_dev of the file, or 0 if unknown
+ * @param path Path of the file (mount point lookup when dev is unknown)
+ * @return Filesystem class
+ */
+kp_fs_class_t kp_fsclass_get(dev_t dev, const char *path);
+
+/**
+ * Short name of a class, for logging
+ */
+const char *kp_fsclass_name(kp_fs_class_t fsclass);
+
+#endif /* FSCLASS_H */
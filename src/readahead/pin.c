@@ -0,0 +1,438 @@
+/* pin.c - Pinned (mlocked) tier for critical apps in Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Pinned Tier
+ * =============================================================================
+ *
+ * Preloading only helps if the pages are still there when the app starts;
+ * on a busy machine cache pressure evicts them between uses, however good
+ * the prediction. For the few apps listed in system.pinapps the daemon
+ * keeps the pages locked instead:
+ *
+ *   for each app (in the order listed):
+ *     ranges = its exemaps, most probable first      (learned by the spy)
+ *           or its ELF loaded ranges / whole binary  (never seen running)
+ *     each range: mmap(PROT_READ, MAP_SHARED) + mlock()
+ *     until system.pinmax bytes are locked (the last range is cut short)
+ *
+ * TICK (kp_pin_tick, once per cycle):
+ *   config changed                           → unpin all, pin again
+ *   memory PSI "full avg10" ≥ 5% or
+ *   MemAvailable < 5% of RAM                 → unpin all, suspend
+ *   suspended, PSI full < 1%, avail ≥ 10%    → pin again
+ *   a pinned file's dev/ino/size/mtime
+ *   changed (package upgrade)                → unpin all, pin the new files
+ *   every PIN_REFRESH seconds                → pin again (new exemaps)
+ *
+ * A mapping keeps its inode alive: without the upgrade check the old,
+ * deleted binary would stay locked while the new one goes cold.
+ *
+ * mlock() beyond RLIMIT_MEMLOCK needs CAP_IPC_LOCK; the soft limit is
+ * raised to the hard one, and a failure is logged once per configuration.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "pin.h"
+#include "../utils/logging.h"
+#include "fsclass.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../monitor/proc.h"
+#include "../daemon/stats.h"
+#include "../utils/lib_scanner.h"
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+
+#define PIN_REFRESH         3600    /* daemon seconds between full re-pins */
+#define PIN_SEVERE_PSI      5.0     /* memory "full avg10" % that unpins */
+#define PIN_RESUME_PSI      1.0     /* ...and below which pinning resumes */
+#define PIN_SEVERE_AVAIL    20      /* unpin below MemAvailable = RAM / 20 */
+#define PIN_RESUME_AVAIL    10      /* resume at MemAvailable ≥ RAM / 10 */
+#define MEMORY_PSI_PATH     "/proc/pressure/memory"
+
+/* One locked mapping */
+typedef struct _pin_region_t
+{
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    time_t mtime;
+    size_t offset;      /* Page aligned */
+    size_t length;
+    void *addr;
+} pin_region_t;
+
+static struct {
+    unsigned int gen;       /* kp_config_generation() last applied */
+    GPtrArray *apps;        /* Resolved paths from system.pinapps */
+    GPtrArray *regions;     /* pin_region_t */
+    GHashTable *keys;       /* "dev:ino:offset" of pinned regions */
+    size_t locked;          /* Locked bytes */
+    int apps_pinned;        /* Apps with at least one region locked */
+    int pinned_at;          /* kp_state->time of the last pin pass */
+    gboolean suspended;     /* Unpinned under memory pressure */
+    gboolean failed;        /* mlock refused, logged; wait for a reload */
+} pin = { 0, NULL, NULL, NULL, 0, 0, 0, FALSE, FALSE };
+
+static void
+region_free(gpointer data)
+{
+    pin_region_t *r = data;
+
+    munlock(r->addr, r->length);
+    munmap(r->addr, r->length);
+    g_free(r->path);
+    g_slice_free(pin_region_t, r);
+}
+
+static void
+unpin_all(void)
+{
+    if (pin.regions)
+        g_ptr_array_set_size(pin.regions, 0);
+    if (pin.keys)
+        g_hash_table_remove_all(pin.keys);
+    pin.locked = 0;
+    pin.apps_pinned = 0;
+}
+
+/**
+ * Re-read system.pinapps after a configuration change
+ */
+static void
+load_apps(void)
+{
+    char **paths;
+
+    if (pin.apps)
+        g_ptr_array_set_size(pin.apps, 0);
+    else
+        pin.apps = g_ptr_array_new_with_free_func(g_free);
+
+    if (!pin.regions) {
+        pin.regions = g_ptr_array_new_with_free_func(region_free);
+        pin.keys = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    }
+
+    if (kp_conf->system.pinmax <= 0 || !kp_conf->system.pinapps)
+        return;
+
+    paths = g_strsplit(kp_conf->system.pinapps, ";", -1);
+    for (char **p = paths; *p; p++) {
+        char *path = g_strstrip(*p);
+        char *resolved;
+
+        if (!*path)
+            continue;
+        resolved = resolve_binary_path(path);
+        if (resolved)
+            g_ptr_array_add(pin.apps, resolved);
+        else
+            g_warning("pin: skipping unresolvable app %s", path);
+    }
+    g_strfreev(paths);
+}
+
+/**
+ * Memory pressure, "full" avg10, in percent (0 if PSI is unavailable)
+ */
+static double
+read_memory_pressure_full(void)
+{
+    FILE *f;
+    char line[256];
+    double avg10 = 0;
+
+    f = fopen(MEMORY_PSI_PATH, "r");
+    if (!f)
+        return 0;
+    while (fgets(line, sizeof(line), f)) {
+        if (sscanf(line, "full avg10=%lf", &avg10) == 1)
+            break;
+    }
+    fclose(f);
+    return avg10;
+}
+
+/**
+ * Lock one range of a file; FALSE only when mlock itself is refused
+ */
+static gboolean
+pin_range(const char *path, size_t offset, size_t length)
+{
+    static long pagesize = 0;
+    pin_region_t *r;
+    struct stat st;
+    char *key;
+    void *addr;
+    int fd;
+
+    if (!pagesize)
+        pagesize = sysconf(_SC_PAGESIZE);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC
+#ifdef O_NOATIME
+              | O_NOATIME
+#endif
+              );
+    if (fd < 0)
+        return TRUE;
+    if (fstat(fd, &st) < 0 || !S_ISREG(st.st_mode) ||
+        kp_fsclass_get(st.st_dev, path) != KP_FS_LOCAL) {
+        close(fd);
+        return TRUE;
+    }
+
+    /* Page align, and stay inside the file as it is now */
+    length += offset % pagesize;
+    offset -= offset % pagesize;
+    if ((off_t)offset >= st.st_size) {
+        close(fd);
+        return TRUE;
+    }
+    length = MIN(length, (size_t)(st.st_size - offset));
+    length = (length + pagesize - 1) / pagesize * pagesize;
+
+    /* Hard cap: lock the head of the range that still fits */
+    if (pin.locked + length > (size_t)kp_conf->system.pinmax)
+        length = ((size_t)kp_conf->system.pinmax - pin.locked) / pagesize * pagesize;
+
+    key = g_strdup_printf("%lu:%lu:%zu", (unsigned long)st.st_dev,
+                          (unsigned long)st.st_ino, offset);
+    if (!length || g_hash_table_contains(pin.keys, key)) {
+        g_free(key);
+        close(fd);
+        return TRUE;
+    }
+
+    addr = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, (off_t)offset);
+    close(fd);
+    if (addr == MAP_FAILED) {
+        g_free(key);
+        return TRUE;
+    }
+
+    /* Faults the range in: synchronous, bounded by pinmax */
+    if (mlock(addr, length) < 0) {
+        int err = errno;
+
+        munmap(addr, length);
+        g_free(key);
+        if (err == ENOMEM || err == EPERM || err == EAGAIN) {
+            g_warning("pin: cannot lock %zu more KB (%s); raise LimitMEMLOCK= "
+                      "or grant CAP_IPC_LOCK. %zu KB stay pinned",
+                      length / 1024, strerror(err), pin.locked / 1024);
+            return FALSE;
+        }
+        return TRUE;
+    }
+
+    r = g_slice_new0(pin_region_t);
+    r->path = g_strdup(path);
+    r->dev = st.st_dev;
+    r->ino = st.st_ino;
+    r->size = st.st_size;
+    r->mtime = st.st_mtime;
+    r->offset = offset;
+    r->length = length;
+    r->addr = addr;
+    g_ptr_array_add(pin.regions, r);
+    g_hash_table_add(pin.keys, key);
+    pin.locked += length;
+    return TRUE;
+}
+
+/**
+ * Most probable exemaps first
+ */
+static gint
+exemap_prob_compare(gconstpointer pa, gconstpointer pb)
+{
+    const kp_exemap_t *a = *(kp_exemap_t * const *)pa;
+    const kp_exemap_t *b = *(kp_exemap_t * const *)pb;
+
+    return (a->prob < b->prob) - (a->prob > b->prob);
+}
+
+/**
+ * Lock the ranges of one app; FALSE when mlock is refused
+ */
+static gboolean
+pin_app(const char *path)
+{
+    kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, path);
+    size_t before = pin.locked;
+    gboolean ok = TRUE;
+
+    if (exe && exe->exemaps->len) {
+        GPtrArray *sorted = g_ptr_array_sized_new(exe->exemaps->len);
+
+        for (guint i = 0; i < exe->exemaps->len; i++)
+            g_ptr_array_add(sorted, g_ptr_array_index(exe->exemaps, i));
+        g_ptr_array_sort(sorted, exemap_prob_compare);
+
+        for (guint i = 0; ok && i < sorted->len; i++) {
+            kp_map_t *map = ((kp_exemap_t *)g_ptr_array_index(sorted, i))->map;
+            ok = pin_range(map->path, map->offset, map->length);
+        }
+        g_ptr_array_free(sorted, TRUE);
+    } else {
+        /* Not learned yet: what the dynamic loader reads of the binary */
+        GArray *ranges = kp_elf_load_ranges(path);
+
+        if (ranges) {
+            for (guint i = 0; ok && i < ranges->len; i++) {
+                kp_elf_range_t *er = &g_array_index(ranges, kp_elf_range_t, i);
+                ok = pin_range(path, er->offset, er->length);
+            }
+            g_array_free(ranges, TRUE);
+        } else {
+            ok = pin_range(path, 0, G_MAXSIZE);
+        }
+    }
+
+    if (pin.locked > before)
+        pin.apps_pinned++;
+    return ok;
+}
+
+static void
+pin_all(void)
+{
+    struct rlimit rl;
+
+    unpin_all();
+
+    /* Use whatever the hard limit allows (unlimited with CAP_IPC_LOCK) */
+    if (getrlimit(RLIMIT_MEMLOCK, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_MEMLOCK, &rl);
+    }
+
+    for (guint i = 0; i < pin.apps->len; i++) {
+        if (!pin_app(g_ptr_array_index(pin.apps, i))) {
+            pin.failed = TRUE;
+            break;
+        }
+    }
+    pin.pinned_at = kp_state->time;
+
+    kp_debug("pin: %d of %u apps pinned, %zu KB locked in %u ranges",
+             pin.apps_pinned, pin.apps->len, pin.locked / 1024, pin.regions->len);
+}
+
+/**
+ * Has any pinned file been replaced or modified on disk?
+ */
+static const char *
+changed_file(void)
+{
+    const char *last = NULL;
+
+    for (guint i = 0; i < pin.regions->len; i++) {
+        pin_region_t *r = g_ptr_array_index(pin.regions, i);
+        struct stat st;
+
+        /* Consecutive regions of one file: stat it once */
+        if (last && !strcmp(last, r->path))
+            continue;
+        last = r->path;
+
+        if (stat(r->path, &st) < 0 || st.st_dev != r->dev || st.st_ino != r->ino ||
+            st.st_size != r->size || st.st_mtime != r->mtime)
+            return r->path;
+    }
+    return NULL;
+}
+
+/**
+ * Bytes of the pinned regions resident in memory
+ */
+static size_t
+resident_bytes(void)
+{
+    static long pagesize = 0;
+    size_t resident = 0;
+
+    if (!pagesize)
+        pagesize = sysconf(_SC_PAGESIZE);
+
+    for (guint i = 0; i < pin.regions->len; i++) {
+        pin_region_t *r = g_ptr_array_index(pin.regions, i);
+        size_t pages = r->length / pagesize;
+        unsigned char *vec = g_malloc(pages);
+
+        if (mincore(r->addr, r->length, vec) == 0) {
+            for (size_t p = 0; p < pages; p++)
+                resident += (vec[p] & 1) ? (size_t)pagesize : 0;
+        }
+        g_free(vec);
+    }
+    return resident;
+}
+
+void
+kp_pin_tick(void)
+{
+    unsigned int gen = kp_config_generation();
+    const char *changed;
+    kp_memory_t mem;
+    double psi;
+
+    if (gen != pin.gen) {
+        pin.gen = gen;
+        pin.failed = FALSE;
+        pin.suspended = FALSE;
+        unpin_all();
+        load_apps();
+        if (pin.apps->len)
+            pin_all();
+    }
+
+    if (!pin.apps->len) {
+        kp_stats_record_pin("off", 0, 0, 0);
+        return;
+    }
+
+    psi = read_memory_pressure_full();
+    kp_proc_get_memstat(&mem);
+
+    if (!pin.suspended) {
+        if (psi >= PIN_SEVERE_PSI ||
+            (mem.available > 0 && mem.available < mem.total / PIN_SEVERE_AVAIL)) {
+            g_message("pin: severe memory pressure (PSI full %.1f%%, %d MB available), "
+                      "unpinning %zu KB", psi, mem.available / 1024, pin.locked / 1024);
+            unpin_all();
+            pin.suspended = TRUE;
+        }
+    } else if (psi < PIN_RESUME_PSI &&
+               (mem.available <= 0 || mem.available >= mem.total / PIN_RESUME_AVAIL)) {
+        g_message("pin: memory pressure cleared, pinning again");
+        pin.suspended = FALSE;
+        pin_all();
+    }
+
+    if (!pin.suspended) {
+        changed = changed_file();
+        if (changed) {
+            g_message("pin: %s changed on disk, pinning again", changed);
+            pin_all();
+        } else if (!pin.failed && kp_state->time - pin.pinned_at >= PIN_REFRESH) {
+            pin_all();
+        }
+    }
+
+    kp_stats_record_pin(pin.suspended ? "suspended" : pin.failed ? "limited" : "active",
+                        pin.apps_pinned, pin.locked, resident_bytes());
+}
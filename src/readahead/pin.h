@@ -0,0 +1,26 @@
+/* pin.h - Pinned (mlocked) tier for critical apps in Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef PIN_H
+#define PIN_H
+
+#include <glib.h>
+
+/**
+ * Keep the apps of system.pinapps locked in memory
+ *
+ * Pins (mmap + mlock) their learned map ranges up to system.pinmax,
+ * re-pins files that changed on disk (package upgrades), and unpins
+ * everything under severe memory pressure until it clears.
+ * Call once per cycle.
+ */
+void kp_pin_tick(void);
+
+#endif /* PIN_H */
@@ -26,18 +26,43 @@
  *      - SORT_BLOCK: By physical block number (best for HDDs)
  *
  *   2. MERGING: Adjacent file regions are merged into single requests
- *      to reduce system call overhead.
+ *      to reduce system call overhead. The prophet hands in ranges
+ *      already coalesced per file (extents.c), so overlaps never
+ *      depend on the sort order.
  *
  *   3. PARALLELISM: Fork child processes (configurable) to overlap
  *      I/O operations across multiple files.
  *
+ *   4. FILESYSTEM POLICY: Files on network and FUSE filesystems
+ *      (fsclass.c) are skipped, capped, or read after the local batch
+ *      by a detached "lane" worker with a timeout (system.netfs/fusefs),
+ *      so a dead NFS server cannot stall the preload of local apps.
+ *
+ *   5. CGROUP: With system.cgroup, forked workers join a dedicated
+ *      cgroup (cgroup.c) whose memory.low/high protect and bound the
+ *      page cache they pull in.
+ *
  * FLOW:
  *   kp_readahead(files, count)
  *     └─ sort_files()       → Optimize read order
+ *     └─ kp_readahead_ordered()
  *        └─ for each file:
  *           └─ merge adjacent regions
- *           └─ process_file() → readahead() syscall (possibly forked)
- *        └─ wait_for_children()
+ *           └─ issue_request() → filesystem policy, into the plan
+ *        └─ kp_pipeline_readahead(plan)
+ *
+ *   kp_readahead_execute(plan)   (I/O thread, or inline without pipeline)
+ *     └─ process_file() → readahead() syscall (possibly forked)
+ *     └─ wait_for_children()
+ *     └─ lane_start()
+ *
+ *   The plan owns copies of its paths and of the configuration it needs,
+ *   so building it (state, stats, fsclass: model thread) and reading it
+ *   (fork/wait: I/O thread) never touch the same data.
+ *
+ *   The boot plan (bootplan.c) sorts once via kp_readahead_sort() when it
+ *   is written and replays through kp_readahead_ordered() at startup, so
+ *   no block lookups hit the cold disk.
  *
  * =============================================================================
  */
@@ -47,8 +72,17 @@
 #include "../utils/logging.h"
 #include "../config/config.h"
 #include "../daemon/stats.h"
-
+#include "../monitor/proc.h"
+#include "../predict/budget.h"
+#include "fsclass.h"
+#include "cgroup.h"
+#include "../daemon/pipeline.h"
+#include "../daemon/power.h"
+
+#include <poll.h>
+#include <signal.h>
 #include <sys/ioctl.h>
+#include <sys/syscall.h>
 #include <sys/wait.h>
 #ifdef HAVE_LINUX_FS_H
 #include <linux/fs.h>
@@ -188,6 +222,32 @@ map_block_compare(const kp_map_t **pa, const kp_map_t **pb)
     return i;
 }
 
+/*
+ * One merged request. Paths live in the plan's string chunk, so a plan
+ * stays valid whatever happens to the maps it was built from.
+ */
+typedef struct _ra_req_t
+{
+    const char *path;
+    size_t offset;
+    size_t length;
+} ra_req_t;
+
+struct _kp_readahead_plan_t
+{
+    GArray *issue;          /* ra_req_t, read in order (local, "limit" policy) */
+    GArray *lane;           /* ra_req_t, deferred to the lane worker */
+    GStringChunk *paths;
+    int maxprocs;           /* system.maxprocs when the plan was built */
+    int netfstimeout;       /* system.netfstimeout when the plan was built */
+    int ioprio;             /* Builder's I/O priority, or -1 */
+    int cgroup_fd;          /* Own copy of readahead cgroup.procs, or -1 */
+};
+
+/* ioprio_set(2) constants (no glibc wrapper) */
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+
 /*
  * Process tracking for parallel readahead.
  * Counts active child processes to enforce maxprocs limit.
@@ -226,14 +286,15 @@ wait_for_children(void)
  * the kernel to start reading the specified file region into the page
  * cache in the background.
  *
- * @param path    Absolute path to the file
- * @param offset  Start offset within the file (bytes)
- * @param length  Number of bytes to readahead
+ * @param plan    Plan the request belongs to (maxprocs, cgroup)
+ * @param r       File region to read
  *
  * PARALLELISM:
  *   If maxprocs > 0, this function forks a child process to do the
  *   readahead. This allows overlapping multiple disk reads. The parent
  *   returns immediately while the child does the I/O and exits.
+ *   The child only makes system calls: with the pipeline running, it is
+ *   forked from a multi-threaded process.
  *
  * FILE FLAGS:
  *   O_RDONLY  - Read-only access
@@ -241,10 +302,10 @@ wait_for_children(void)
  *   O_NOATIME - Don't update access time (if available)
  */
 static void
-process_file(const char *path, size_t offset, size_t length)
+process_file(const kp_readahead_plan_t *plan, const ra_req_t *r)
 {
     int fd = -1;
-    int maxprocs = kp_conf->system.maxprocs;
+    int maxprocs = plan->maxprocs;
 
     if (procs >= maxprocs)
         wait_for_children();
@@ -266,6 +327,9 @@ process_file(const char *path, size_t offset, size_t length)
         if (status > 0) {
             return;  /* procs already incremented */
         }
+
+        /* Charge what this worker reads to the readahead cgroup */
+        kp_cgroup_enter_worker(plan->cgroup_fd);
     }
 
     /*
@@ -273,7 +337,7 @@ process_file(const char *path, size_t offset, size_t length)
      * Files are already validated by trusted path checks in config.c,
      * but this provides defense-in-depth.
      */
-    fd = open(path,
+    fd = open(r->path,
               O_RDONLY
             | O_NOCTTY
             | O_NOFOLLOW
@@ -282,7 +346,7 @@ process_file(const char *path, size_t offset, size_t length)
 #endif
            );
     if (fd >= 0) {
-        readahead(fd, offset, length);
+        readahead(fd, r->offset, r->length);
         close(fd);
     }
 
@@ -298,7 +362,8 @@ process_file(const char *path, size_t offset, size_t length)
  * Two-pass algorithm:
  *   1. If any file is missing block info, sort by path first (makes
  *      subsequent stat() calls faster due to directory caching), then
- *      call set_block() to retrieve block/inode info.
+ *      call set_block() to retrieve block/inode info. Files that are not
+ *      on a local filesystem are never opened here: they use map->ino.
  *   2. Sort by block number for optimal disk read order.
  *
  * @param files       Array of map pointers to sort in-place
@@ -325,9 +390,17 @@ sort_by_block_or_inode(kp_map_t **files, int file_count)
         /* Sorting by path, to make stat fast. */
         qsort(files, file_count, sizeof(*files), (GCompareFunc)map_path_compare);
 
-        for (i=0; i<file_count; i++)
-            if (files[i]->block == -1)
+        for (i=0; i<file_count; i++) {
+            if (files[i]->block != -1)
+                continue;
+            /* set_block() open()s the file on this thread: a hung network
+             * or FUSE mount would stall it. Those sort on the inode the
+             * map already has (fsclass only reads mountinfo) */
+            if (kp_fsclass_get(files[i]->dev, files[i]->path) != KP_FS_LOCAL)
+                files[i]->block = files[i]->ino;
+            else
                 set_block(files[i], kp_conf->system.sortstrategy == SORT_INODE);
+        }
     }
 
     /* Sorting by block. */
@@ -374,17 +447,206 @@ sort_files(kp_map_t **files, int file_count)
     }
 }
 
+/* Per-batch filesystem policy accounting */
+typedef struct _batch_t
+{
+    size_t slow_bytes;  /* Network/FUSE bytes issued or queued */
+    int skipped;        /* Requests dropped by policy */
+    kp_readahead_plan_t *plan;
+} batch_t;
+
 /**
- * Main readahead entry point - preload files into page cache
+ * Start an empty plan, capturing what executing it needs
+ */
+static kp_readahead_plan_t *
+plan_new(void)
+{
+    kp_readahead_plan_t *plan = g_slice_new0(kp_readahead_plan_t);
+
+    plan->issue = g_array_new(FALSE, FALSE, sizeof(ra_req_t));
+    plan->lane = g_array_new(FALSE, FALSE, sizeof(ra_req_t));
+    plan->paths = g_string_chunk_new(4096);
+    plan->maxprocs = kp_conf->system.maxprocs;
+    plan->netfstimeout = kp_conf->system.netfstimeout;
+#ifdef SYS_ioprio_get
+    /* I/O priority is per thread: rewarm/idle set it on the builder's */
+    plan->ioprio = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+#else
+    plan->ioprio = -1;
+#endif
+    plan->cgroup_fd = kp_cgroup_worker_fd();
+    return plan;
+}
+
+static void
+plan_add(kp_readahead_plan_t *plan, GArray *reqs,
+         const char *path, size_t offset, size_t length)
+{
+    ra_req_t r;
+
+    r.path = g_string_chunk_insert_const(plan->paths, path);
+    r.offset = offset;
+    r.length = length;
+    g_array_append_val(reqs, r);
+}
+
+void
+kp_readahead_plan_free(kp_readahead_plan_t *plan)
+{
+    if (!plan)
+        return;
+    g_array_free(plan->issue, TRUE);
+    g_array_free(plan->lane, TRUE);
+    g_string_chunk_free(plan->paths);
+    if (plan->cgroup_fd >= 0)
+        close(plan->cgroup_fd);
+    g_slice_free(kp_readahead_plan_t, plan);
+}
+
+/* Read end of the pipe held by the running lane worker, or -1 */
+static int lane_fd = -1;
+
+/**
+ * Check whether the previous lane worker is still running
  *
- * This is the core function called by the prediction engine to actually
- * load predicted files into memory. It optimizes I/O by:
- *   1. Sorting files to minimize disk seeks
- *   2. Merging adjacent regions in the same file
- *   3. Optionally parallelizing with fork()
+ * The worker holds the write end of a pipe; EOF means it exited.
+ */
+static gboolean
+lane_busy(void)
+{
+    struct pollfd pfd;
+
+    if (lane_fd < 0)
+        return FALSE;
+
+    pfd.fd = lane_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    if (poll(&pfd, 1, 0) == 0)
+        return TRUE;
+
+    close(lane_fd);
+    lane_fd = -1;
+    return FALSE;
+}
+
+/**
+ * Read the deferred network/FUSE requests in a detached worker
  *
- * @param files       Array of kp_map_t pointers (sorted by prediction priority)
- * @param file_count  Number of files to attempt to readahead
+ * The worker is a grandchild, so wait_for_children() never waits for it.
+ * It is killed by SIGALRM after netfstimeout seconds; a hung NFS mount
+ * then costs one stuck process per timeout instead of the whole batch.
+ */
+static void
+lane_start(const kp_readahead_plan_t *plan)
+{
+    GArray *lane = plan->lane;
+    int fds[2];
+    pid_t pid;
+
+    if (!lane->len)
+        return;
+
+    if (lane_busy()) {
+        kp_debug("network lane still busy, dropping %u requests", lane->len);
+        return;
+    }
+
+    if (pipe2(fds, O_CLOEXEC) < 0)
+        return;
+
+    pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return;
+    }
+
+    if (pid == 0) {
+        sigset_t none;
+
+        close(fds[0]);
+        if (fork() != 0)
+            _exit(0);
+
+        /* Forked from the pipeline's I/O thread, which blocks all signals */
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+
+        kp_cgroup_enter_worker(plan->cgroup_fd);
+        alarm(plan->netfstimeout);
+        for (guint i = 0; i < lane->len; i++) {
+            ra_req_t *r = &g_array_index(lane, ra_req_t, i);
+            int fd = open(r->path, O_RDONLY | O_NOCTTY | O_NOFOLLOW
+#ifdef O_NOATIME
+                          | O_NOATIME
+#endif
+                         );
+            if (fd >= 0) {
+                readahead(fd, r->offset, r->length);
+                close(fd);
+            }
+        }
+        _exit(0);
+    }
+
+    close(fds[1]);
+    lane_fd = fds[0];
+    waitpid(pid, NULL, 0);  /* intermediate child exits at once */
+
+    kp_debug("network lane started for %u requests", lane->len);
+}
+
+/**
+ * Add one merged request to the plan according to its filesystem's policy
+ *
+ * @return TRUE if the request was planned for reading or for the lane
+ */
+static gboolean
+issue_request(dev_t dev, const char *path, size_t offset, size_t length,
+              batch_t *batch)
+{
+    int policy;
+
+    switch (kp_fsclass_get(dev, path)) {
+        case KP_FS_LOCAL:
+            plan_add(batch->plan, batch->plan->issue, path, offset, length);
+            return TRUE;
+        case KP_FS_NETWORK:
+            policy = kp_conf->system.netfs;
+            break;
+        case KP_FS_FUSE:
+            policy = kp_conf->system.fusefs;
+            break;
+        default:
+            /* tmpfs is already in memory; autofs would trigger a mount */
+            batch->skipped++;
+            return FALSE;
+    }
+
+    if (policy == KP_FS_POLICY_SKIP ||
+        batch->slow_bytes + length > (size_t)kp_conf->system.netfsmax) {
+        batch->skipped++;
+        return FALSE;
+    }
+    batch->slow_bytes += length;
+
+    if (policy == KP_FS_POLICY_LIMIT)
+        plan_add(batch->plan, batch->plan->issue, path, offset, length);
+    else
+        plan_add(batch->plan, batch->plan->lane, path, offset, length);
+    return TRUE;
+}
+
+/**
+ * Issue readahead for an already ordered array of maps
+ *
+ * Walks the array in order, merging overlapping or adjacent regions of
+ * the same file into a single request, and plans them. The plan is
+ * executed by the pipeline's I/O thread, or right here without one.
+ *
+ * @param files       Array of kp_map_t pointers, in the order to read them
+ * @param file_count  Number of entries
  * @return            Number of readahead requests issued (after merging)
  *
  * MERGING LOGIC:
@@ -398,14 +660,17 @@ sort_files(kp_map_t **files, int file_count)
  *   Result: 2 readahead calls instead of 3
  */
 int
-kp_readahead(kp_map_t **files, int file_count)
+kp_readahead_ordered(kp_map_t **files, int file_count)
 {
     int i;
     const char *path = NULL;
+    dev_t dev = 0;
     size_t offset = 0, length = 0;
     int processed = 0;
+    batch_t batch = { 0, 0, NULL };
 
-    sort_files(files, file_count);
+    kp_cgroup_sync();
+    batch.plan = plan_new();
 
     for (i=0; i<file_count; i++) {
         if (path &&
@@ -418,25 +683,209 @@ kp_readahead(kp_map_t **files, int file_count)
         }
 
         if (path) {
-            process_file(path, offset, length);
-            kp_stats_record_preload(path);
-            processed++;
+            if (issue_request(dev, path, offset, length, &batch)) {
+                kp_stats_record_preload(path);
+                processed++;
+            }
             path = NULL;
         }
 
         path   = files[i]->path;
+        dev    = files[i]->dev;
         offset = files[i]->offset;
         length = files[i]->length;
     }
 
     if (path) {
-        process_file(path, offset, length);
-        kp_stats_record_preload(path);
-        processed++;
+        if (issue_request(dev, path, offset, length, &batch)) {
+            kp_stats_record_preload(path);
+            processed++;
+        }
         path = NULL;
     }
 
-    wait_for_children();
+    if (batch.skipped)
+        kp_debug("skipped %d readahead requests on network/FUSE/memory filesystems",
+                 batch.skipped);
+
+    if (processed)
+        kp_pipeline_readahead(batch.plan);
+    else
+        kp_readahead_plan_free(batch.plan);
 
     return processed;
 }
+
+void
+kp_readahead_execute(kp_readahead_plan_t *plan)
+{
+    int saved = -1;
+
+    g_return_if_fail(plan);
+
+#ifdef SYS_ioprio_set
+    if (plan->ioprio >= 0) {
+        saved = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+        if (saved == plan->ioprio ||
+            syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, plan->ioprio) < 0)
+            saved = -1;
+    }
+#endif
+
+    for (guint i = 0; i < plan->issue->len; i++)
+        process_file(plan, &g_array_index(plan->issue, ra_req_t, i));
+
+    wait_for_children();
+
+    /* Local files are done: now the slow ones, without waiting */
+    lane_start(plan);
+
+    kp_readahead_restore_ioprio(saved);
+}
+
+/**
+ * Memory the configuration allows for preloading, in kilobytes
+ *
+ * The memtotal/memfree/memcached formula (upstream prophet lines
+ * 196-199), before any scaling. Shared by the prophet's per-cycle budget
+ * and kp_readahead_memavail().
+ */
+long
+kp_readahead_membase(const kp_memory_t *mem)
+{
+    long memavail;
+
+    g_return_val_if_fail(mem, 0);
+
+    memavail  = (long)CLAMP(kp_conf->model.memtotal, -100, 100) * (mem->total / 100)
+              + (long)CLAMP(kp_conf->model.memfree, -100, 100)  * (mem->free  / 100);
+    memavail  = MAX(0, memavail);
+    memavail += (long)CLAMP(kp_conf->model.memcached, -100, 100) * (mem->cached / 100);
+    return memavail;
+}
+
+/**
+ * Memory available for preloading right now, in kilobytes
+ *
+ * Same formula, budget model scaling and power profile share as the
+ * prophet's per-cycle budget, for the out-of-cycle replays (boot plan,
+ * cache snapshot, rewarm, idle tier).
+ */
+long
+kp_readahead_memavail(void)
+{
+    kp_memory_t memstat;
+    long memavail;
+
+    kp_proc_get_memstat(&memstat);
+    memavail = kp_readahead_membase(&memstat);
+
+    /* Scaled by the factor the last prediction cycle settled on; the
+     * stats keep reporting that cycle's budget */
+    memavail = kp_budget_apply(memavail, &memstat);
+
+    /* On battery too: rewarm on resume is mostly a battery case */
+    return kp_power_budget(memavail);
+}
+
+/**
+ * Read one file range in the calling process
+ *
+ * No sorting, merging or forking: for callers that issue many small,
+ * individually abortable requests (idle tier).
+ */
+gboolean
+kp_readahead_range(const char *path, size_t offset, size_t length)
+{
+    int fd;
+    gboolean ok;
+
+    /* In-process: never risk blocking the daemon on a remote server */
+    if (kp_fsclass_get(0, path) != KP_FS_LOCAL)
+        return FALSE;
+
+    fd = open(path,
+              O_RDONLY
+            | O_NOCTTY
+            | O_NOFOLLOW
+#ifdef O_NOATIME
+            | O_NOATIME
+#endif
+           );
+    if (fd < 0)
+        return FALSE;
+
+    ok = readahead(fd, offset, length) == 0;
+    close(fd);
+    return ok;
+}
+
+/**
+ * Switch the daemon's I/O priority (inherited by readahead children)
+ *
+ * @return Previous I/O priority for kp_readahead_restore_ioprio(), or -1
+ */
+int
+kp_readahead_set_ioprio(int ioclass, int level)
+{
+#ifdef SYS_ioprio_set
+    int saved = syscall(SYS_ioprio_get, IOPRIO_WHO_PROCESS, 0);
+
+    if (saved < 0)
+        return -1;
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+                (ioclass << IOPRIO_CLASS_SHIFT) | level) < 0)
+        return -1;
+    return saved;
+#else
+    (void)ioclass;
+    (void)level;
+    return -1;
+#endif
+}
+
+/**
+ * Undo kp_readahead_set_ioprio()
+ */
+void
+kp_readahead_restore_ioprio(int saved)
+{
+#ifdef SYS_ioprio_set
+    if (saved >= 0)
+        syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, saved);
+#else
+    (void)saved;
+#endif
+}
+
+/**
+ * Sort maps into the configured read order
+ *
+ * Public wrapper around sort_files() for callers that want to persist
+ * the order (the boot plan) rather than read right away.
+ */
+void
+kp_readahead_sort(kp_map_t **files, int file_count)
+{
+    sort_files(files, file_count);
+}
+
+/**
+ * Main readahead entry point - preload files into page cache
+ *
+ * This is the core function called by the prediction engine to actually
+ * load predicted files into memory. It optimizes I/O by:
+ *   1. Sorting files to minimize disk seeks
+ *   2. Merging adjacent regions in the same file
+ *   3. Optionally parallelizing with fork()
+ *
+ * @param files       Array of kp_map_t pointers (sorted by prediction priority)
+ * @param file_count  Number of files to attempt to readahead
+ * @return            Number of readahead requests issued (after merging)
+ */
+int
+kp_readahead(kp_map_t **files, int file_count)
+{
+    sort_files(files, file_count);
+    return kp_readahead_ordered(files, file_count);
+}
@@ -24,4 +24,83 @@
  */
 int kp_readahead(kp_map_t **maps, int count);
 
+/**
+ * Perform readahead on maps already in read order (no sorting)
+ *
+ * Merges and applies the filesystem policies here; the reads themselves
+ * happen on the pipeline's I/O thread when it runs, so the maps may go
+ * away as soon as this returns.
+ *
+ * @param maps Array of kp_map_t pointers, in the order to read them
+ * @param count Number of maps
+ * @return Number of readahead requests issued (after merging)
+ */
+int kp_readahead_ordered(kp_map_t **maps, int count);
+
+/**
+ * kp_readahead_plan_t: Merged requests of one batch, ready to read
+ *
+ * Self-contained (paths, maxprocs, I/O priority, cgroup), so it can be
+ * executed on another thread than the one that built it.
+ */
+typedef struct _kp_readahead_plan_t kp_readahead_plan_t;
+
+/**
+ * Read a plan: fork workers per maxprocs, wait for them, then start the
+ * network/FUSE lane. Only ever called from one thread at a time.
+ *
+ * @param plan Plan built by kp_readahead_ordered(), still owned by the caller
+ */
+void kp_readahead_execute(kp_readahead_plan_t *plan);
+
+/**
+ * Free a plan
+ */
+void kp_readahead_plan_free(kp_readahead_plan_t *plan);
+
+/**
+ * Sort maps by the configured sortstrategy (block, inode or path)
+ *
+ * @param maps Array of kp_map_t pointers, sorted in place
+ * @param count Number of maps
+ */
+void kp_readahead_sort(kp_map_t **maps, int count);
+
+/**
+ * Memory the memtotal/memfree/memcached formula allows, unscaled
+ * @param mem Memory statistics
+ * @return Kilobytes
+ */
+long kp_readahead_membase(const kp_memory_t *mem);
+
+/**
+ * Memory available for preloading (prophet budget formula)
+ * @return Kilobytes that may be filled with readahead now
+ */
+long kp_readahead_memavail(void);
+
+/**
+ * Read one file range in the calling process (no sort, merge or fork)
+ * @return TRUE if the readahead request was issued
+ */
+gboolean kp_readahead_range(const char *path, size_t offset, size_t length);
+
+/* I/O scheduling classes for kp_readahead_set_ioprio() */
+#define KP_IOPRIO_CLASS_BE   2  /* Best effort, level 0 (high) - 7 (low) */
+#define KP_IOPRIO_CLASS_IDLE 3  /* Only when the disk is otherwise idle */
+
+/**
+ * Switch the daemon's I/O priority (inherited by readahead children)
+ * @param ioclass KP_IOPRIO_CLASS_*
+ * @param level Priority level within the class (0-7)
+ * @return Previous priority for kp_readahead_restore_ioprio(), or -1
+ */
+int kp_readahead_set_ioprio(int ioclass, int level);
+
+/**
+ * Restore the I/O priority saved by kp_readahead_set_ioprio()
+ * @param saved Return value of kp_readahead_set_ioprio()
+ */
+void kp_readahead_restore_ioprio(int saved);
+
 #endif /* READAHEAD_H */
@@ -0,0 +1,393 @@
+/* reclaim.c - Give back mispredicted preloads under memory pressure
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: Preload Reclaim
+ * =============================================================================
+ *
+ * Preloaded pages nobody asked for sit in the page cache like any other
+ * cache. When memory gets tight the kernel reclaims by LRU and may well
+ * throw out a running program's working set before our speculative pages.
+ * Since we know which pages are speculative, we can drop them first.
+ *
+ * RECORD (kp_reclaim_record, per preloaded range):
+ *   prophet  → ranges of the selected maps, with their lnprob
+ *   idle     → chunks read by the idle tier, lnprob 0 (least likely)
+ *   Kept for RECLAIM_TTL seconds of daemon time, at most RECLAIM_MAX.
+ *
+ * TICK (kp_reclaim_tick, once per cycle):
+ *   ranges of files a running exe maps      → forgotten (prediction paid off)
+ *   memory PSI "some avg10" ≥ reclaimpsi
+ *     or budget model THRASHING             → pressure
+ *   pressure: sort the rest by lnprob, closest to 0 first, older first,
+ *             POSIX_FADV_DONTNEED up to RECLAIM_BATCH per cycle
+ *
+ * COOLDOWN (kp_reclaim_cooling):
+ *   A range overlapping a dropped one of the same file is not selected
+ *   again for RECLAIM_COOLDOWN seconds (prophet maps and idle tier chunks
+ *   ask), or a PSI-triggered drop the budget model did not see as
+ *   thrashing would be read back by the next cycle. Mapped by a running
+ *   exe, it is released at once.
+ *
+ * DONTNEED only drops clean, unmapped pages, so a process mapping a file
+ * the state does not know about keeps its pages. Only local files are
+ * touched: opening a file on a hung NFS server would block the daemon.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "reclaim.h"
+#include "../utils/logging.h"
+#include "fsclass.h"
+#include "../config/config.h"
+#include "../state/state.h"
+#include "../daemon/stats.h"
+#include "../predict/budget.h"
+
+#define RECLAIM_TTL         1800                /* daemon seconds a range is remembered */
+#define RECLAIM_MAX         4096                /* ranges remembered */
+#define RECLAIM_BATCH       (64 * 1024 * 1024)  /* bytes dropped per cycle at most */
+#define RECLAIM_COOLDOWN    600                 /* daemon seconds a dropped range is not preloaded */
+#define MEMORY_PSI_PATH     "/proc/pressure/memory"
+
+/* One preloaded range */
+typedef struct _reclaim_range_t
+{
+    char *path;
+    dev_t dev;
+    ino_t ino;
+    size_t offset;
+    size_t length;
+    double lnprob;
+    int time;           /* kp_state->time when (last) preloaded */
+} reclaim_range_t;
+
+/* "dev:ino:offset:length" or "path:offset:length" -> reclaim_range_t */
+static GHashTable *ranges = NULL;
+
+/* "dev:ino" or path -> GPtrArray of dropped reclaim_range_t, time = when dropped */
+static GHashTable *dropped = NULL;
+
+static void
+range_free(gpointer data)
+{
+    reclaim_range_t *r = data;
+
+    g_free(r->path);
+    g_slice_free(reclaim_range_t, r);
+}
+
+static char *
+range_key(const char *path, dev_t dev, ino_t ino, size_t offset, size_t length)
+{
+    if (ino)
+        return g_strdup_printf("%lu:%lu:%zu:%zu", (unsigned long)dev,
+                               (unsigned long)ino, offset, length);
+    return g_strdup_printf("%s:%zu:%zu", path, offset, length);
+}
+
+static char *
+file_key(const char *path, dev_t dev, ino_t ino)
+{
+    if (ino)
+        return g_strdup_printf("%lu:%lu", (unsigned long)dev, (unsigned long)ino);
+    return g_strdup(path);
+}
+
+static void
+dropped_free(gpointer data)
+{
+    g_ptr_array_free(data, TRUE);
+}
+
+/**
+ * Drop the oldest range (table full)
+ */
+static void
+forget_oldest(void)
+{
+    GHashTableIter iter;
+    gpointer key, value, oldest = NULL;
+    int oldest_time = G_MAXINT;
+
+    g_hash_table_iter_init(&iter, ranges);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        reclaim_range_t *r = value;
+
+        if (r->time < oldest_time) {
+            oldest_time = r->time;
+            oldest = key;
+        }
+    }
+    if (oldest)
+        g_hash_table_remove(ranges, oldest);
+}
+
+void
+kp_reclaim_record(const char *path, dev_t dev, ino_t ino,
+                  size_t offset, size_t length, double lnprob)
+{
+    reclaim_range_t *r;
+    char *key;
+
+    g_return_if_fail(path);
+
+    if (!kp_conf->system.reclaim || !length)
+        return;
+
+    if (!ranges) {
+        ranges = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, range_free);
+        dropped = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, dropped_free);
+    }
+
+    key = range_key(path, dev, ino, offset, length);
+    r = g_hash_table_lookup(ranges, key);
+    if (r) {
+        g_free(key);
+    } else {
+        if (g_hash_table_size(ranges) >= RECLAIM_MAX)
+            forget_oldest();
+        r = g_slice_new0(reclaim_range_t);
+        r->path = g_strdup(path);
+        r->dev = dev;
+        r->ino = ino;
+        r->offset = offset;
+        r->length = length;
+        g_hash_table_insert(ranges, key, r);
+    }
+    r->lnprob = lnprob;
+    r->time = kp_state->time;
+}
+
+gboolean
+kp_reclaim_cooling(const char *path, dev_t dev, ino_t ino,
+                   size_t offset, size_t length)
+{
+    GPtrArray *list;
+    char *key;
+
+    if (!dropped || !g_hash_table_size(dropped))
+        return FALSE;
+
+    key = file_key(path, dev, ino);
+    list = g_hash_table_lookup(dropped, key);
+    g_free(key);
+    if (!list)
+        return FALSE;
+
+    for (guint i = 0; i < list->len; i++) {
+        reclaim_range_t *r = g_ptr_array_index(list, i);
+
+        if (offset < r->offset + r->length && r->offset < offset + length)
+            return TRUE;
+    }
+    return FALSE;
+}
+
+/**
+ * Memory pressure, "some" avg10, in percent (0 if PSI is unavailable)
+ */
+static double
+read_memory_pressure(void)
+{
+    FILE *f;
+    double avg10 = 0;
+
+    f = fopen(MEMORY_PSI_PATH, "r");
+    if (!f)
+        return 0;
+    if (fscanf(f, "some avg10=%lf", &avg10) != 1)
+        avg10 = 0;
+    fclose(f);
+    return avg10;
+}
+
+/* Files mapped by running exes, by identity and by path */
+typedef struct {
+    GHashTable *inodes;     /* "dev:ino" */
+    GHashTable *paths;
+} in_use_t;
+
+static void
+in_use_build(in_use_t *in_use)
+{
+    in_use->inodes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+    in_use->paths = g_hash_table_new(g_str_hash, g_str_equal);
+
+    for (GSList *l = kp_state->running_exes; l; l = l->next) {
+        kp_exe_t *exe = l->data;
+
+        for (guint i = 0; i < exe->exemaps->len; i++) {
+            kp_exemap_t *exemap = g_ptr_array_index(exe->exemaps, i);
+            kp_map_t *map = exemap->map;
+
+            if (map->ino)
+                g_hash_table_add(in_use->inodes,
+                                 g_strdup_printf("%lu:%lu", (unsigned long)map->dev,
+                                                 (unsigned long)map->ino));
+            g_hash_table_add(in_use->paths, map->path);
+        }
+    }
+}
+
+static gboolean
+in_use_has(in_use_t *in_use, const reclaim_range_t *r)
+{
+    if (r->ino) {
+        char key[64];
+
+        g_snprintf(key, sizeof(key), "%lu:%lu", (unsigned long)r->dev, (unsigned long)r->ino);
+        if (g_hash_table_contains(in_use->inodes, key))
+            return TRUE;
+    }
+    return g_hash_table_contains(in_use->paths, r->path);
+}
+
+static void
+in_use_free(in_use_t *in_use)
+{
+    g_hash_table_destroy(in_use->inodes);
+    g_hash_table_destroy(in_use->paths);
+}
+
+/**
+ * Least likely first, then oldest first
+ */
+static gint
+reclaim_order(gconstpointer pa, gconstpointer pb)
+{
+    const reclaim_range_t *a = *(reclaim_range_t * const *)pa;
+    const reclaim_range_t *b = *(reclaim_range_t * const *)pb;
+
+    if (a->lnprob != b->lnprob)
+        return a->lnprob > b->lnprob ? -1 : 1;
+    return a->time - b->time;
+}
+
+static gboolean
+drop_range(const reclaim_range_t *r)
+{
+    int fd, err;
+
+    if (kp_fsclass_get(r->dev, r->path) != KP_FS_LOCAL)
+        return FALSE;
+
+    fd = open(r->path, O_RDONLY | O_NONBLOCK | O_CLOEXEC
+#ifdef O_NOATIME
+              | O_NOATIME
+#endif
+              );
+    if (fd < 0)
+        return FALSE;
+
+    err = posix_fadvise(fd, (off_t)r->offset, (off_t)r->length, POSIX_FADV_DONTNEED);
+    close(fd);
+    if (err) {
+        kp_debug("reclaim: fadvise %s: %s", r->path, strerror(err));
+        return FALSE;
+    }
+    return TRUE;
+}
+
+void
+kp_reclaim_tick(void)
+{
+    GHashTableIter iter;
+    gpointer key, value;
+    GPtrArray *candidates;
+    in_use_t in_use;
+    double psi;
+    gboolean thrashing;
+    size_t freed = 0;
+    int count = 0;
+
+    if (!ranges)
+        return;
+    if (!kp_conf->system.reclaim) {
+        g_hash_table_remove_all(ranges);
+        g_hash_table_remove_all(dropped);
+        return;
+    }
+
+    /* Forget what was used or has aged out either way */
+    in_use_build(&in_use);
+    g_hash_table_iter_init(&iter, ranges);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        reclaim_range_t *r = value;
+
+        if (kp_state->time - r->time > RECLAIM_TTL || in_use_has(&in_use, r))
+            g_hash_table_iter_remove(&iter);
+    }
+    g_hash_table_iter_init(&iter, dropped);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+        GPtrArray *list = value;
+
+        for (guint i = list->len; i-- > 0; ) {
+            reclaim_range_t *r = g_ptr_array_index(list, i);
+
+            if (kp_state->time - r->time > RECLAIM_COOLDOWN || in_use_has(&in_use, r))
+                g_ptr_array_remove_index_fast(list, i);
+        }
+        if (!list->len)
+            g_hash_table_iter_remove(&iter);
+    }
+    in_use_free(&in_use);
+
+    if (!g_hash_table_size(ranges))
+        return;
+
+    psi = read_memory_pressure();
+    thrashing = kp_budget_model()->state == KP_BUDGET_THRASHING;
+    if (!thrashing && (kp_conf->system.reclaimpsi <= 0 || psi < kp_conf->system.reclaimpsi))
+        return;
+
+    candidates = g_ptr_array_new();
+    g_hash_table_iter_init(&iter, ranges);
+    while (g_hash_table_iter_next(&iter, &key, &value))
+        g_ptr_array_add(candidates, value);
+    g_ptr_array_sort(candidates, reclaim_order);
+
+    for (guint i = 0; i < candidates->len && freed < RECLAIM_BATCH; i++) {
+        reclaim_range_t *r = g_ptr_array_index(candidates, i);
+        gpointer orig_key;
+        GPtrArray *list;
+        char *fkey;
+
+        key = range_key(r->path, r->dev, r->ino, r->offset, r->length);
+        if (drop_range(r)) {
+            freed += r->length;
+            count++;
+            /* Moved to the cooldown table, not to be read back for a while */
+            r->time = kp_state->time;
+            g_hash_table_lookup_extended(ranges, key, &orig_key, NULL);
+            g_hash_table_steal(ranges, key);
+            g_free(orig_key);
+            fkey = file_key(r->path, r->dev, r->ino);
+            list = g_hash_table_lookup(dropped, fkey);
+            if (list) {
+                g_free(fkey);
+            } else {
+                list = g_ptr_array_new_with_free_func(range_free);
+                g_hash_table_insert(dropped, fkey, list);
+            }
+            g_ptr_array_add(list, r);
+        } else {
+            /* Not droppable: done with it */
+            g_hash_table_remove(ranges, key);
+        }
+        g_free(key);
+    }
+    g_ptr_array_free(candidates, TRUE);
+
+    kp_debug("reclaim: memory pressure %.1f%%%s, dropped %d preloaded ranges (%zu KB), %u remembered",
+             psi, thrashing ? ", working set thrashing" : "", count, freed / 1024,
+             g_hash_table_size(ranges));
+    kp_stats_record_reclaim(count, freed);
+}
@@ -0,0 +1,53 @@
+/* reclaim.h - Give back mispredicted preloads under memory pressure
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef RECLAIM_H
+#define RECLAIM_H
+
+#include <sys/types.h>
+#include <glib.h>
+
+/**
+ * Remember a preloaded range, so it can be dropped again under pressure
+ *
+ * Recording the same range again refreshes it.
+ *
+ * @param path   File path
+ * @param dev    st_dev of the file, or 0 if unknown
+ * @param ino    st_ino of the file, or 0 if unknown
+ * @param offset Start of the range
+ * @param length Length of the range
+ * @param lnprob ln(P(not needed)) of the prediction; ranges closest to 0
+ *               (least likely to be used) are dropped first
+ */
+void kp_reclaim_record(const char *path, dev_t dev, ino_t ino,
+                       size_t offset, size_t length, double lnprob);
+
+/**
+ * Does this range overlap one dropped under memory pressure recently?
+ *
+ * A dropped range stays out of the preload selection for a cooldown,
+ * or the next cycle would read it straight back in. Ranges match by
+ * file (dev/ino when known, else path). Arguments as for
+ * kp_reclaim_record().
+ */
+gboolean kp_reclaim_cooling(const char *path, dev_t dev, ino_t ino,
+                            size_t offset, size_t length);
+
+/**
+ * Check memory pressure and, when it is high, drop preloaded ranges
+ * no running process maps (POSIX_FADV_DONTNEED), least likely first
+ *
+ * Call once per cycle, after the scan. Triggers on memory PSI "some
+ * avg10" >= system.reclaimpsi or a thrashing budget model.
+ */
+void kp_reclaim_tick(void);
+
+#endif /* RECLAIM_H */
@@ -34,12 +34,20 @@
 #include "../config/config.h"
 #include "../daemon/pause.h"
 #include "../daemon/session.h"
+#include "../daemon/rewarm.h"
+#include "../daemon/pipeline.h"
+#include "../daemon/scheduler.h"
+#include "../daemon/power.h"
 #include "state.h"
 #include "state_io.h"
 #include "../monitor/proc.h"
 #include "../monitor/spy.h"
 #include "../predict/prophet.h"
+#include "../predict/idle.h"
+#include "../readahead/reclaim.h"
+#include "../readahead/pin.h"
 #include "../utils/seeding.h"
+#include "../readahead/bootplan.h"
 
 #include <fcntl.h>
 #include <unistd.h>
@@ -133,7 +141,7 @@ void kp_state_load(const char *statefile)
             }
         }
 
-        g_debug("loading state done");
+        kp_debug("loading state done");
     }
 
     /* Smart first-run seeding */
@@ -158,7 +166,7 @@ kp_state_register_manual_apps(void)
     
     if (!kp_conf->system.manual_apps_loaded ||
         kp_conf->system.manual_apps_count == 0) {
-        g_debug("No manual apps configured");
+        kp_debug("No manual apps configured");
         return;
     }
     
@@ -170,7 +178,7 @@ kp_state_register_manual_apps(void)
         
         exe = g_hash_table_lookup(kp_state->exes, *app_path);
         if (exe) {
-            g_debug("Manual app already tracked: %s", *app_path);
+            kp_debug("Manual app already tracked: %s", *app_path);
             already_tracked++;
             continue;
         }
@@ -220,7 +228,7 @@ void kp_state_save(const char *statefile)
         g_message("saving state to %s", statefile);
 
         tmpfile = g_strconcat(statefile, ".tmp", NULL);
-        g_debug("to be honest, saving state to %s", tmpfile);
+        kp_debug("to be honest, saving state to %s", tmpfile);
 
         fd = open(tmpfile, O_RDWR | O_CREAT | O_TRUNC | O_NOFOLLOW, 0600);
         if (fd < 0) {
@@ -251,7 +259,10 @@ void kp_state_save(const char *statefile)
                                tmpfile, statefile, strerror(errno));
                     unlink(tmpfile);
                 } else {
-                    g_debug("successfully renamed %s to %s", tmpfile, statefile);
+                    kp_debug("successfully renamed %s to %s", tmpfile, statefile);
+
+                    /* Precompute the next boot's readahead from this model */
+                    kp_bootplan_write(statefile);
                 }
             }
         }
@@ -260,7 +271,7 @@ void kp_state_save(const char *statefile)
 
         kp_state->dirty = FALSE;
 
-        g_debug("saving state done");
+        kp_debug("saving state done");
     }
 
     /* B009: Clear bad_exes after save. This is intentional - bad_exes
@@ -297,7 +308,7 @@ void kp_state_free(void)
     g_slist_free(kp_state->running_exes);
     kp_state->running_exes = NULL;
     g_ptr_array_free(kp_state->maps_arr, TRUE);
-    g_debug("freeing state memory done");
+    kp_debug("freeing state memory done");
 }
 
 /**
@@ -311,9 +322,19 @@ void kp_state_dump_log(void)
     fprintf(stderr, "num exes = %d\n", g_hash_table_size(kp_state->exes));
     fprintf(stderr, "num bad exes = %d\n", g_hash_table_size(kp_state->bad_exes));
     fprintf(stderr, "num maps = %d\n", g_hash_table_size(kp_state->maps));
+    for (guint i = 0; i < kp_state->maps_arr->len; i++) {
+        kp_map_t *map = g_ptr_array_index(kp_state->maps_arr, i);
+
+        if (!map->aliases)
+            continue;
+        fprintf(stderr, "map %s aliases:", map->path);
+        for (guint j = 0; j < map->aliases->len; j++)
+            fprintf(stderr, " %s", (char *)g_ptr_array_index(map->aliases, j));
+        fprintf(stderr, "\n");
+    }
     fprintf(stderr, "runtime state stats:\n");
     fprintf(stderr, "num running exes = %d\n", g_slist_length(kp_state->running_exes));
-    g_debug("state log dump done");
+    kp_debug("state log dump done");
 }
 
 /* ========================================================================
@@ -326,50 +347,106 @@ static gboolean
 kp_state_tick2(gpointer data)
 {
     if (kp_state->model_dirty) {
-        g_debug("state updating begin");
+        kp_debug("state updating begin");
         kp_spy_update_model(data);
         kp_state->model_dirty = FALSE;
-        g_debug("state updating end");
+        kp_debug("state updating end");
     }
 
     kp_state->time += (kp_conf->model.cycle + 1) / 2;
-    g_timeout_add_seconds((kp_conf->model.cycle + 1) / 2, kp_state_tick, data);
+    kp_sched_add((kp_conf->model.cycle + 1) / 2, 0, kp_state_tick, data);
     return FALSE;
 }
 
-static gboolean
-kp_state_tick(gpointer data)
+/**
+ * End of the tick: give back under pressure, then wait for the next half
+ */
+static void
+kp_state_tick_done(gpointer data)
+{
+    if (kp_conf->system.dopredict) {
+        /* Under memory pressure, give back what was mispredicted */
+        kp_reclaim_tick();
+        kp_pin_tick();
+    }
+
+    kp_state->time += kp_conf->model.cycle / 2;
+    kp_sched_add(kp_conf->model.cycle / 2, 0, kp_state_tick2, data);
+}
+
+/**
+ * Prediction complete (it may have taken several main loop slices)
+ */
+static void
+kp_state_tick_predicted(gpointer data)
 {
-    if (kp_conf->system.doscan) {
-        g_debug("state scanning begin");
-        kp_spy_scan(data);
+    kp_debug("state predicting end");
+    kp_idle_tick();
+    kp_state_tick_done(data);
+}
+
+/**
+ * Second half of the tick: model and prediction on a fresh snapshot
+ *
+ * Runs on the main loop, right away or once the pipeline's scanner
+ * thread delivers the snapshot (NULL when scanning is off).
+ */
+static void
+kp_state_tick_scanned(kp_proc_snapshot_t *snap, gpointer data)
+{
+    if (snap) {
+        kp_debug("state scanning begin");
+        kp_spy_scan_snapshot(snap);
         kp_state->dirty = kp_state->model_dirty = TRUE;
-        g_debug("state scanning end");
+        kp_debug("state scanning end");
     }
     if (kp_conf->system.dopredict) {
+        /* Sampled every cycle so a pause does not skew the baselines */
+        gboolean rewarm = kp_rewarm_check();
+
         if (kp_pause_is_active()) {
-            g_debug("preloading paused - skipping prediction");
+            kp_debug("preloading paused - skipping prediction");
+            kp_idle_stop();
         } else {
+            if (rewarm)
+                kp_rewarm_run();
+
             kp_session_check();
             if (kp_session_in_boot_window()) {
-                g_debug("session boot window active (%d sec remaining)",
-                        kp_session_window_remaining());
+                kp_debug("session boot window active (%d sec remaining)",
+                         kp_session_window_remaining());
                 kp_session_preload_top_apps(5);
             }
 
-            g_debug("state predicting begin");
-            kp_prophet_predict(data);
-            g_debug("state predicting end");
+            /* Continues in kp_state_tick_predicted once all slices ran */
+            kp_debug("state predicting begin");
+            kp_prophet_predict(kp_state_tick_predicted, data);
+            return;
         }
     }
 
-    kp_state->time += kp_conf->model.cycle / 2;
-    g_timeout_add_seconds(kp_conf->model.cycle / 2, kp_state_tick2, data);
+    kp_state_tick_done(data);
+}
+
+static gboolean
+kp_state_tick(gpointer data)
+{
+    /* Cycle, maxprocs, budget and idle tier of the current power profile */
+    kp_power_tick();
+
+    if (kp_conf->system.doscan)
+        kp_pipeline_scan(kp_state_tick_scanned, data);
+    else
+        kp_state_tick_scanned(NULL, data);
     return FALSE;
 }
 
 static const char *autosave_statefile;
 
+/* The autosave may wait up to a cycle to share a tick's wakeup; the cycle
+ * halves themselves run on time (slack 0) */
+#define AUTOSAVE_SLACK kp_conf->model.cycle
+
 /* B008 FIX: Eviction thresholds */
 #define EXE_EVICTION_THRESHOLD 1500  /* Start evicting when above this count */
 #define EXE_EVICTION_MAX_AGE (30 * 24 * 3600)  /* 30 days in seconds */
@@ -405,7 +482,8 @@ kp_state_autosave(gpointer user_data)
     
     /* B008 FIX: Evict old unused exes if table is too large */
     guint exe_count = g_hash_table_size(kp_state->exes);
-    if (exe_count > EXE_EVICTION_THRESHOLD) {
+    /* Not under a prediction in flight, which holds on to the exes */
+    if (exe_count > EXE_EVICTION_THRESHOLD && !kp_prophet_busy()) {
         int current_time = kp_state->time;
         guint before = exe_count;
         g_hash_table_foreach_remove(kp_state->exes, should_evict_exe, &current_time);
@@ -418,7 +496,7 @@ kp_state_autosave(gpointer user_data)
     
     kp_state_save(autosave_statefile);
 
-    g_timeout_add_seconds(kp_conf->system.autosave, kp_state_autosave, NULL);
+    kp_sched_add(kp_conf->system.autosave, AUTOSAVE_SLACK, kp_state_autosave, NULL);
     return FALSE;
 }
 
@@ -427,9 +505,9 @@ kp_state_autosave(gpointer user_data)
  */
 void kp_state_run(const char *statefile)
 {
-    g_timeout_add(0, kp_state_tick, NULL);
+    kp_sched_add(0, 0, kp_state_tick, NULL);
     if (statefile) {
         autosave_statefile = statefile;
-        g_timeout_add_seconds(kp_conf->system.autosave, kp_state_autosave, NULL);
+        kp_sched_add(kp_conf->system.autosave, AUTOSAVE_SLACK, kp_state_autosave, NULL);
     }
 }
@@ -28,7 +28,8 @@
  *       ├─ maps: GHashTable<kp_map_t*, int>     ← All known memory map regions
  *       │      │
  *       │      └─ kp_map_t (per file region)
- *       │             └─ Represents a specific (path, offset, length) tuple
+ *       │             └─ Represents a specific (file, offset, length) tuple,
+ *       │                keyed on (st_dev, st_ino) so path aliases share one
  *       │
  *       └─ bad_exes: GHashTable<path, size>     ← Executables too small to track
  *
@@ -88,11 +89,16 @@ typedef struct _kp_map_t
     int update_time;    /* Last time it was probed */
 
     /* Runtime fields: */
+    dev_t dev;          /* Device of the file, 0 if it could not be stat'ed */
+    ino_t ino;          /* Inode of the file; maps are keyed on (dev, ino) */
+    GPtrArray *aliases; /* Other paths seen for the same file, or NULL */
     int refcount;       /* Number of exes linking to this */
     double lnprob;      /* Log-probability of NOT being needed in next period */
     int seq;            /* Unique map sequence number */
     int block;          /* On-disk location of the start of the map */
     int priv;           /* For private local use of functions */
+    int sharers;        /* Candidate (not running) exes bidding on this map */
+    double share_users; /* Expected number of candidate exes served: Σ P(Xi=1) */
 } kp_map_t;
 
 /**
@@ -146,6 +152,14 @@ typedef struct _kp_exe_t
     double lnprob;              /* Log-probability of NOT being needed in next period */
     int seq;                    /* Unique exe sequence number */
     pool_type_t pool;           /* Pool classification (priority/observation) */
+
+    /* Cached config-derived decisions (see kp_stats_refresh_exe): */
+    unsigned int decision_gen;  /* kp_config_generation() they were made under */
+    unsigned int desktop_gen;   /* kp_desktop_generation() they were made under */
+    char *canonical_path;       /* realpath() of path, NULL if same or unresolvable */
+    pool_type_t class_pool;     /* classify_app_pool() result */
+    char *class_reason;         /* Why, owned by exe (NULL until classified) */
+    gboolean blacklisted;       /* kp_blacklist_contains(path) */
 } kp_exe_t;
 
 #define exe_is_running(exe) ((exe)->running_timestamp >= kp_state->last_running_timestamp)
@@ -279,6 +293,8 @@ void kp_map_free(kp_map_t *map);
 void kp_map_ref(kp_map_t *map);
 void kp_map_unref(kp_map_t *map);
 size_t kp_map_get_size(kp_map_t *map);
+void kp_map_add_alias(kp_map_t *map, const char *path);
+kp_map_t *kp_map_current(kp_map_t *map);
 guint kp_map_hash(kp_map_t *map);
 gboolean kp_map_equal(kp_map_t *a, kp_map_t *b);
 
@@ -299,6 +315,7 @@ void kp_markov_build_priority_mesh(void);  /* Build chains between all priority
 kp_exe_t * kp_exe_new(const char *path, gboolean running, GSet *exemaps);
 void kp_exe_free(kp_exe_t *exe);
 kp_exemap_t * kp_exe_map_new(kp_exe_t *exe, kp_map_t *map);
+size_t kp_exe_map_file(kp_exe_t *exe, const char *path, size_t file_size);
 
 /* Family management functions */
 kp_app_family_t * kp_family_new(const char *family_id, discovery_method_t method);
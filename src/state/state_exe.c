@@ -14,6 +14,10 @@
  *   exe.exemaps  = set of memory maps this exe uses
  *   exe.markovs  = set of correlations with other exes
  *
+ * Exes that were never seen running (manual apps, session seeds) get
+ * their maps from kp_exe_map_file(), which reads the ELF program headers
+ * instead of charging the whole file.
+ *
  * EXE LIFECYCLE:
  *   1. Discovered via /proc scan → kp_exe_new()
  *   2. Registered in global state → kp_state_register_exe()
@@ -27,6 +31,8 @@
 #include "common.h"
 #include "state.h"
 #include "state_exe.h"
+#include "../utils/logging.h"
+#include "../utils/lib_scanner.h"
 
 /**
  * Add map size to exe's total size
@@ -66,6 +72,14 @@ kp_exe_new(const char *path, gboolean running, GSet *exemaps)
     exe->time = 0;
     exe->change_timestamp = kp_state->time;
 
+    /* Decisions are computed lazily; generation 0 is always stale */
+    exe->decision_gen = 0;
+    exe->desktop_gen = 0;
+    exe->canonical_path = NULL;
+    exe->class_pool = POOL_OBSERVATION;
+    exe->class_reason = NULL;
+    exe->blacklisted = FALSE;
+
     /* Initialize weighted launch counting fields */
     exe->weighted_launches = 0.0;
     exe->raw_launches = 0;
@@ -131,6 +145,8 @@ kp_exe_free(kp_exe_t *exe)
         exe->running_pids = NULL;
     }
 
+    g_free(exe->canonical_path);
+    g_free(exe->class_reason);
     g_free(exe->path);
     exe->path = NULL;
     g_slice_free(kp_exe_t, exe);
@@ -154,6 +170,64 @@ kp_exe_map_new(kp_exe_t *exe, kp_map_t *map)
     return exemap;
 }
 
+/**
+ * Add a file an exe loads without having been seen running
+ *
+ * Used for manual apps and session seeds, which have no /proc maps yet.
+ * ELF objects get one map per range the dynamic loader reads (PT_LOAD
+ * segments plus dynamic/symbol tables), so embedded debug info and bundled
+ * data are not preloaded; anything else gets a single whole-file map.
+ * Maps already known to the state are reused.
+ *
+ * @param exe       Exe to attach the maps to
+ * @param path      File to map
+ * @param file_size Size of the file in bytes
+ * @return          Bytes covered by the new maps, 0 if none were added
+ */
+size_t
+kp_exe_map_file(kp_exe_t *exe, const char *path, size_t file_size)
+{
+    GArray *ranges;
+    kp_elf_range_t whole;
+    size_t covered = 0;
+
+    g_return_val_if_fail(exe, 0);
+    g_return_val_if_fail(path, 0);
+
+    whole.offset = 0;
+    whole.length = file_size;
+
+    ranges = kp_elf_load_ranges(path);
+    if (!ranges) {
+        ranges = g_array_new(FALSE, FALSE, sizeof(kp_elf_range_t));
+        g_array_append_val(ranges, whole);
+    }
+
+    for (guint i = 0; i < ranges->len; i++) {
+        kp_elf_range_t *r = &g_array_index(ranges, kp_elf_range_t, i);
+        kp_map_t *map;
+        gpointer orig_map;
+
+        map = kp_map_new(path, r->offset, r->length);
+        if (!map)
+            continue;
+        if (g_hash_table_lookup_extended(kp_state->maps, map, &orig_map, NULL)) {
+            kp_map_free(map);
+            map = (kp_map_t *)orig_map;
+        }
+
+        kp_exe_map_new(exe, map);
+        covered += r->length;
+    }
+
+    if (ranges->len > 1 || covered < file_size)
+        kp_debug("%s: %u loaded ranges, %zu of %zu bytes", path, ranges->len,
+                 covered, file_size);
+
+    g_array_free(ranges, TRUE);
+    return covered;
+}
+
 /**
  * Helper for creating markov with existing exe
  * (VERBATIM from upstream shift_preload_markov_new)
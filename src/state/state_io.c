@@ -36,6 +36,7 @@
 #include "../utils/crc32.h"
 #include "../config/config.h"
 #include "../monitor/proc.h"
+#include "../monitor/identity.h"
 #include "../daemon/stats.h"
 #include "state.h"
 #include "state_io.h"
@@ -75,12 +76,33 @@
  * READ CONTEXT
  * ======================================================================== */
 
+typedef struct
+{
+    kp_exe_t *exe;
+    kp_map_t *map;
+} exemap_key_t;
+
+static guint
+exemap_key_hash(gconstpointer p)
+{
+    const exemap_key_t *key = p;
+    return g_direct_hash(key->exe) * 31 + g_direct_hash(key->map);
+}
+
+static gboolean
+exemap_key_equal(gconstpointer a, gconstpointer b)
+{
+    const exemap_key_t *ka = a, *kb = b;
+    return ka->exe == kb->exe && ka->map == kb->map;
+}
+
 typedef struct _read_context_t
 {
     char *line;
     const char *errmsg;
     char *path;
     GHashTable *maps;
+    GHashTable *exemaps;        /* (exe, map) -> exemap already read */
     GHashTable *exes;
     kp_exe_t *current_exe;      /* Current exe for reading PIDS subsections */
     int expected_pids;          /* Number of PIDs to read */
@@ -116,7 +138,8 @@ is_pid_alive(pid_t pid)
  *
  * PIDs can be reused by the kernel. We must verify the PID is still
  * running the same executable we tracked, not a new process that
- * happened to get the same PID.
+ * happened to get the same PID. Interpreter-run apps are matched by
+ * their app key (kp_identity_resolve).
  */
 static gboolean
 verify_pid_exe_match(pid_t pid, const char *expected_path)
@@ -135,6 +158,11 @@ verify_pid_exe_match(pid_t pid, const char *expected_path)
     }
     actual_path[len] = '\0';
     
+    /* Scripts, jars and modules: /proc/PID/exe is the interpreter, the
+     * exe is keyed by the app it runs (as the spy keys it) */
+    if (strcmp(kp_identity_resolve(pid, actual_path), expected_path) == 0)
+        return TRUE;
+    
     /* Resolve both paths to canonical form (handle symlinks) */
     if (!realpath(expected_path, resolved_expected)) {
         /* Expected path doesn't exist anymore */
@@ -167,6 +195,7 @@ read_map(read_context_t *rc)
     int i, expansion;
     unsigned long offset, length;
     char *path;
+    gpointer orig_map;
 
     /* Parse: seq update_time offset length expansion uri */
     if (6 > sscanf(rc->line,
@@ -181,15 +210,27 @@ read_map(read_context_t *rc)
         return;
 
     map = kp_map_new(path, offset, length);
-    g_free(path);
     if (g_hash_table_lookup(rc->maps, GINT_TO_POINTER(i))) {
         rc->errmsg = READ_DUPLICATE_INDEX_ERROR;
         goto err;
     }
-    if (g_hash_table_lookup(kp_state->maps, map)) {
-        rc->errmsg = READ_DUPLICATE_OBJECT_ERROR;
-        goto err;
+    if (g_hash_table_lookup_extended(kp_state->maps, map, &orig_map, NULL)) {
+        kp_map_t *orig = (kp_map_t *)orig_map;
+
+        /* Same file under another path (state written before maps were
+         * keyed on inode), or the same path saved twice: once for the
+         * inode a package upgrade replaced, once for the new one. Both
+         * stat to the current file now; fold it into the map already read */
+        kp_map_add_alias(orig, path);
+        kp_map_free(map);
+        g_free(path);
+        if (update_time > orig->update_time)
+            orig->update_time = update_time;
+        kp_map_ref(orig);
+        g_hash_table_insert(rc->maps, GINT_TO_POINTER(i), orig);
+        return;
     }
+    g_free(path);
 
     map->update_time = update_time;
     kp_map_ref(map);
@@ -197,6 +238,7 @@ read_map(read_context_t *rc)
     return;
 
 err:
+    g_free(path);
     kp_map_free(map);
 }
 
@@ -246,7 +288,7 @@ read_exe(read_context_t *rc)
     
     if (fields_read >= 9) {
         /* Success - new format */
-        g_debug("Read exe in new 9-field format (weighted counting)");
+        kp_debug("Read exe in new 9-field format (weighted counting)");
     } else {
         /* Try 6-field format (pool but no weighted counting) */
         fields_read = sscanf(rc->line,
@@ -255,7 +297,7 @@ read_exe(read_context_t *rc)
         
         if (fields_read >= 6) {
             /* Migrating from pool-only format */
-            g_debug("Migrated 6-field exe entry (pool only): %s", rc->filebuf);
+            kp_debug("Migrated 6-field exe entry (pool only): %s", rc->filebuf);
         } else {
             /* Fall back to old 5-field format (original format) */
             if (5 > sscanf(rc->line,
@@ -265,7 +307,7 @@ read_exe(read_context_t *rc)
                 return;
             }
             pool = POOL_OBSERVATION;  /* Default for migrated apps */
-            g_debug("Migrated old 5-field exe entry to observation pool: %s", rc->filebuf);
+            kp_debug("Migrated old 5-field exe entry to observation pool: %s", rc->filebuf);
         }
     }
 
@@ -319,6 +361,7 @@ read_exemap(read_context_t *rc)
     kp_exe_t *exe;
     kp_map_t *map;
     kp_exemap_t *exemap;
+    exemap_key_t key, *pair;
     double prob;
 
     /* Parse: exe_seq map_seq probability */
@@ -336,7 +379,21 @@ read_exemap(read_context_t *rc)
         return;
     }
 
+    /* A map can be listed twice for one exe: folded by read_map(), or
+     * saved under its new file's seq after a package upgrade while the
+     * exe held the new map too. Keep the more likely of the two */
+    key.exe = exe;
+    key.map = map;
+    exemap = g_hash_table_lookup(rc->exemaps, &key);
+    if (exemap) {
+        exemap->prob = MAX(exemap->prob, prob);
+        return;
+    }
+
     exemap = kp_exe_map_new(exe, map);
+    pair = g_new(exemap_key_t, 1);
+    *pair = key;
+    g_hash_table_insert(rc->exemaps, pair, exemap);
     exemap->prob = prob;
 }
 
@@ -463,7 +520,7 @@ read_family(read_context_t *rc)
     
     /* BUG 3 FIX: Check for duplicate family IDs */
     if (g_hash_table_contains(kp_state->app_families, family_id)) {
-        g_debug("Family '%s' already exists, skipping duplicate", family_id);
+        kp_debug("Family '%s' already exists, skipping duplicate", family_id);
         kp_family_free(family);
         return;
     }
@@ -488,8 +545,8 @@ read_pids(read_context_t *rc)
     }
     
     rc->expected_pids = count;
-    g_debug("Reading %d PIDs for exe %s", count, 
-            rc->current_exe ? rc->current_exe->path : "unknown");
+    kp_debug("Reading %d PIDs for exe %s", count, 
+             rc->current_exe ? rc->current_exe->path : "unknown");
 }
 
 /* Read individual PID from state file
@@ -521,14 +578,14 @@ read_pid(read_context_t *rc)
     
     /* Validate: PID still exists and belongs to same executable */
     if (!is_pid_alive(pid)) {
-        g_debug("Skipping stale PID %d for %s (process exited)", 
-                pid, rc->current_exe->path);
+        kp_debug("Skipping stale PID %d for %s (process exited)", 
+                 pid, rc->current_exe->path);
         return;
     }
     
     if (!verify_pid_exe_match(pid, rc->current_exe->path)) {
-        g_debug("Skipping PID %d for %s (executable mismatch - PID reused)", 
-                pid, rc->current_exe->path);
+        kp_debug("Skipping PID %d for %s (executable mismatch - PID reused)", 
+                 pid, rc->current_exe->path);
         return;
     }
     
@@ -543,17 +600,18 @@ read_pid(read_context_t *rc)
     g_hash_table_insert(rc->current_exe->running_pids, 
                        GINT_TO_POINTER(pid), proc_info);
     
-    g_debug("Resumed tracking PID %d for %s (started %ld sec ago)",
-            pid, rc->current_exe->path, time(NULL) - start_time);
+    kp_debug("Resumed tracking PID %d for %s (started %ld sec ago)",
+             pid, rc->current_exe->path, time(NULL) - start_time);
 }
 
 /* Helper callbacks for state initialization */
 static void
-set_running_process_callback(pid_t G_GNUC_UNUSED pid, const char *path, int time)
+set_running_process_callback(pid_t pid, const char *path, int time)
 {
     kp_exe_t *exe;
 
-    exe = g_hash_table_lookup(kp_state->exes, path);
+    /* Keyed as the spy keys it: interpreters by the app they run */
+    exe = g_hash_table_lookup(kp_state->exes, kp_identity_resolve(pid, path));
     if (exe) {
         exe->running_timestamp = time;
         kp_state->running_exes = g_slist_prepend(kp_state->running_exes, exe);
@@ -569,8 +627,8 @@ set_markov_state_callback(kp_markov_t *markov)
 static void
 set_running_process_callback_wrapper(gpointer key, gpointer value, gpointer user_data)
 {
-    (void)key;
-    set_running_process_callback(0, (const char *)value, GPOINTER_TO_INT(user_data));
+    set_running_process_callback(GPOINTER_TO_INT(key), (const char *)value,
+                                 GPOINTER_TO_INT(user_data));
 }
 
 static void
@@ -597,6 +655,7 @@ kp_state_read_from_channel(GIOChannel *f)
     rc.current_exe = NULL;
     rc.expected_pids = 0;
     rc.maps = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, (GDestroyNotify)kp_map_unref);
+    rc.exemaps = g_hash_table_new_full(exemap_key_hash, exemap_key_equal, g_free, NULL);
     rc.exes = g_hash_table_new(g_direct_hash, g_direct_equal);
 
     linebuf = g_string_sized_new(100);
@@ -660,7 +719,7 @@ kp_state_read_from_channel(GIOChannel *f)
         else if (!strcmp(tag, TAG_CRC32))  read_crc32(&rc);
         else if (!strcmp(tag, TAG_PRELOAD_TIMES)) {
             /* Just a header, count is informational */
-            g_debug("Reading preload timestamps section");
+            kp_debug("Reading preload timestamps section");
         }
         else if (!strcmp(tag, TAG_PRELOAD_TIME) && lineno > 1) {
             /* PRELOAD <app_name> <timestamp> - but only NOT on line 1 (header uses PRELOAD too) */
@@ -679,6 +738,7 @@ kp_state_read_from_channel(GIOChannel *f)
 
     g_string_free(linebuf, TRUE);
     g_hash_table_destroy(rc.exes);
+    g_hash_table_destroy(rc.exemaps);
     g_hash_table_destroy(rc.maps);
 
     if (rc.err)
@@ -708,6 +768,7 @@ typedef struct _write_context_t
     GIOChannel *f;
     GString *line;
     GError *err;
+    GHashTable *moved;          /* Stale-inode map -> map of the current file */
 } write_context_t;
 
 #define write_it(s) \
@@ -730,11 +791,34 @@ write_header(write_context_t *wc)
     write_ln();
 }
 
+/**
+ * Find maps whose file was replaced (package upgrade) while a map of the
+ * new file exists too: they are saved as that map, so a load does not
+ * read the same file twice
+ */
+static void
+find_moved_maps(write_context_t *wc)
+{
+    for (guint i = 0; i < kp_state->maps_arr->len; i++) {
+        kp_map_t *map = g_ptr_array_index(kp_state->maps_arr, i);
+        kp_map_t *current = kp_map_current(map);
+
+        if (current != map)
+            g_hash_table_insert(wc->moved, map, current);
+    }
+    if (g_hash_table_size(wc->moved))
+        kp_debug("saving %u maps of replaced files as their new file",
+                 g_hash_table_size(wc->moved));
+}
+
 static void
 write_map(kp_map_t *map, gpointer G_GNUC_UNUSED data, write_context_t *wc)
 {
     char *uri;
 
+    if (g_hash_table_contains(wc->moved, map))
+        return;
+
     uri = g_filename_to_uri(map->path, NULL, &(wc->err));
     if (!uri)
         return;
@@ -821,7 +905,7 @@ write_pid_callback(gpointer key, gpointer value, gpointer user_data)
     
     /* Verify PID still alive before persisting */
     if (!is_pid_alive(pid)) {
-        g_debug("Skipping dead PID %d during save", pid);
+        kp_debug("Skipping dead PID %d during save", pid);
         return;
     }
     
@@ -840,8 +924,13 @@ write_pid_callback(gpointer key, gpointer value, gpointer user_data)
 static void
 write_exemap(kp_exemap_t *exemap, kp_exe_t *exe, write_context_t *wc)
 {
+    kp_map_t *map = g_hash_table_lookup(wc->moved, exemap->map);
+
+    if (!map)
+        map = exemap->map;
+
     write_tag(TAG_EXEMAP);
-    g_string_printf(wc->line, "%d\t%d\t%lg", exe->seq, exemap->map->seq, exemap->prob);
+    g_string_printf(wc->line, "%d\t%d\t%lg", exe->seq, map->seq, exemap->prob);
     write_string(wc->line);
     write_ln();
 }
@@ -960,7 +1049,9 @@ kp_state_write_to_channel(GIOChannel *f, int fd)
     wc.f = f;
     wc.line = g_string_sized_new(100);
     wc.err = NULL;
+    wc.moved = g_hash_table_new(g_direct_hash, g_direct_equal);
 
+    find_moved_maps(&wc);
     write_header(&wc);
     if (!wc.err) g_hash_table_foreach(kp_state->maps, (GHFunc)write_map, &wc);
     if (!wc.err) g_hash_table_foreach(kp_state->bad_exes, write_badexe_wrapper, &wc);
@@ -979,6 +1070,7 @@ kp_state_write_to_channel(GIOChannel *f, int fd)
     }
 
     g_string_free(wc.line, TRUE);
+    g_hash_table_destroy(wc.moved);
     if (wc.err) {
         char *tmp;
         tmp = g_strdup(wc.err->message);
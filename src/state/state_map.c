@@ -15,6 +15,18 @@
  *
  * Maps are shared between executables via reference counting.
  *
+ * Maps are identified by the file they cover, not the string used to reach
+ * it: /lib/x86_64-linux-gnu/libc.so.6 and /usr/lib/x86_64-linux-gnu/libc.so.6
+ * are one map on usrmerge systems, as are bind mounts and versioned
+ * symlinks. The key is (st_dev, st_ino, offset, length); the first path
+ * seen stays in map.path and the others are kept in map.aliases.
+ *
+ * Path -> inode lookups are cached and re-checked every KP_MAP_ID_TTL
+ * seconds. A changed inode or mtime (package upgrade) refreshes the entry,
+ * so new maps land on the new file while the old one ages out. Until it
+ * has, kp_map_current() leads from the old map to the new one; the state
+ * file is saved through it, and a load folds any remaining duplicates.
+ *
  * Exemaps (kp_exemap_t) connect executables to the maps they use:
  *
  *   exe ── exemap ──> map
@@ -27,6 +39,73 @@
 #include "common.h"
 #include "state.h"
 #include "state_map.h"
+#include "../utils/logging.h"
+
+#define KP_MAP_ID_TTL         60      /* seconds before a cached inode is re-checked */
+#define KP_MAP_ID_CACHE_MAX   16384   /* path cache entries before it is reset */
+#define KP_MAP_ALIASES_MAX    8       /* aliases remembered per map */
+
+/* Cached identity of a path */
+typedef struct _map_id_t
+{
+    dev_t dev;
+    ino_t ino;
+    time_t mtime;
+    int checked;        /* kp_state->time of the last stat() */
+} map_id_t;
+
+static GHashTable *map_ids = NULL;  /* path -> map_id_t */
+
+/* ========================================================================
+ * FILE IDENTITY
+ * ======================================================================== */
+
+/**
+ * Look up the (dev, ino) a path currently resolves to
+ *
+ * @param path File path
+ * @param dev  Output device, 0 if the file could not be stat'ed
+ * @param ino  Output inode, 0 if the file could not be stat'ed
+ */
+static void
+map_identity(const char *path, dev_t *dev, ino_t *ino)
+{
+    map_id_t *id;
+    struct stat st;
+
+    if (!map_ids)
+        map_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+
+    id = g_hash_table_lookup(map_ids, path);
+    if (!id || kp_state->time - id->checked >= KP_MAP_ID_TTL
+            || kp_state->time < id->checked) {
+        if (stat(path, &st) < 0 || !S_ISREG(st.st_mode)) {
+            if (id)
+                g_hash_table_remove(map_ids, path);
+            *dev = 0;
+            *ino = 0;
+            return;
+        }
+
+        if (!id) {
+            if (g_hash_table_size(map_ids) >= KP_MAP_ID_CACHE_MAX)
+                g_hash_table_remove_all(map_ids);
+            id = g_new(map_id_t, 1);
+            g_hash_table_insert(map_ids, g_strdup(path), id);
+        } else if (id->ino != st.st_ino || id->dev != st.st_dev
+                   || id->mtime != st.st_mtime) {
+            kp_debug("map identity of %s changed", path);
+        }
+
+        id->dev = st.st_dev;
+        id->ino = st.st_ino;
+        id->mtime = st.st_mtime;
+        id->checked = kp_state->time;
+    }
+
+    *dev = id->dev;
+    *ino = id->ino;
+}
 
 /* ========================================================================
  * MAP MANAGEMENT FUNCTIONS
@@ -54,9 +133,14 @@ kp_map_new(const char *path, size_t offset, size_t length)
     map->path = g_strdup(path);
     map->offset = offset;
     map->length = length;
+    map_identity(path, &map->dev, &map->ino);
+    map->aliases = NULL;
     map->refcount = 0;
     map->update_time = kp_state->time;
     map->block = -1;
+    map->lnprob = 0;
+    map->sharers = 0;
+    map->share_users = 0;
     return map;
 }
 
@@ -73,6 +157,8 @@ kp_map_free(kp_map_t *map)
 
     g_free(map->path);
     map->path = NULL;
+    if (map->aliases)
+        g_ptr_array_free(map->aliases, TRUE);
     g_slice_free(kp_map_t, map);
 }
 
@@ -143,29 +229,106 @@ kp_map_get_size(kp_map_t *map)
     return map->length;
 }
 
+/**
+ * Remember another path that reaches the same file as a map
+ *
+ * @param map  Map found under a different path
+ * @param path Path it was seen as
+ */
+void
+kp_map_add_alias(kp_map_t *map, const char *path)
+{
+    g_return_if_fail(map);
+    g_return_if_fail(path);
+
+    if (!strcmp(map->path, path))
+        return;
+
+    if (!map->aliases)
+        map->aliases = g_ptr_array_new_with_free_func(g_free);
+
+    for (guint i = 0; i < map->aliases->len; i++) {
+        if (!strcmp(g_ptr_array_index(map->aliases, i), path))
+            return;
+    }
+
+    if (map->aliases->len >= KP_MAP_ALIASES_MAX)
+        return;
+
+    g_ptr_array_add(map->aliases, g_strdup(path));
+    kp_debug("map %s also seen as %s", map->path, path);
+}
+
+/**
+ * Find the map that now stands for a map's path and range
+ *
+ * After a package upgrade the path resolves to a new inode. Once the new
+ * file was mapped too, both maps are registered; the old one only ages
+ * out. This returns the map of the current file in that case.
+ *
+ * @param map Registered map
+ * @return    Registered map of the file the path resolves to now, or map
+ *            itself if that is still its file or no such map exists
+ */
+kp_map_t *
+kp_map_current(kp_map_t *map)
+{
+    kp_map_t *probe;
+    gpointer current = NULL;
+
+    g_return_val_if_fail(map, NULL);
+
+    if (!map->ino)
+        return map;
+
+    probe = kp_map_new(map->path, map->offset, map->length);
+    if (probe->ino && (probe->ino != map->ino || probe->dev != map->dev))
+        g_hash_table_lookup_extended(kp_state->maps, probe, &current, NULL);
+    kp_map_free(probe);
+
+    return current ? (kp_map_t *)current : map;
+}
+
 /**
  * Hash function for maps
- * (VERBATIM from upstream preload_map_hash)
+ *
+ * Files that could be stat'ed hash on (dev, ino); the rest fall back to
+ * the path like upstream preload_map_hash.
  */
 guint
 kp_map_hash(kp_map_t *map)
 {
+    guint h;
+
     g_return_val_if_fail(map, 0);
     g_return_val_if_fail(map->path, 0);
 
-    return g_str_hash(map->path)
+    if (map->ino) {
+        gint64 key = (gint64)((guint64)map->ino ^ ((guint64)map->dev << 32));
+        h = g_int64_hash(&key);
+    } else
+        h = g_str_hash(map->path);
+
+    return h
          + g_direct_hash(GSIZE_TO_POINTER(map->offset))
          + g_direct_hash(GSIZE_TO_POINTER(map->length));
 }
 
 /**
  * Equality function for maps
- * (VERBATIM from upstream preload_map_equal)
+ *
+ * Two maps are equal if they cover the same range of the same inode,
+ * whatever path they were reached through. Maps whose file could not be
+ * stat'ed only match by path.
  */
 gboolean
 kp_map_equal(kp_map_t *a, kp_map_t *b)
 {
-    return a->offset == b->offset && a->length == b->length && !strcmp(a->path, b->path);
+    if (a->offset != b->offset || a->length != b->length)
+        return FALSE;
+    if (a->ino || b->ino)
+        return a->ino == b->ino && a->dev == b->dev;
+    return !strcmp(a->path, b->path);
 }
 
 /* ========================================================================
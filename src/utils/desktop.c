@@ -6,24 +6,83 @@
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
+ *
+ * =============================================================================
+ * INDEX CACHING AND INCREMENTAL REFRESH
+ * =============================================================================
+ *
+ * Every .desktop file seen gets an entry (including hidden / unresolvable
+ * ones, cached as "negative" entries with no exec path). Entries are saved
+ * to DESKTOP_CACHE_FILE and validated on the next startup:
+ *
+ *   - Directory mtime unchanged → no files added/removed/renamed, so the
+ *     cached file list is reused without readdir()
+ *   - File mtime unchanged (ns precision) → cached entry reused, no GKeyFile
+ *     parse and no Exec= resolution
+ *
+ * While running, an inotify watch on each existing directory updates single
+ * entries on create / write / delete / rename. IN_Q_OVERFLOW falls back to a
+ * full (still cache-assisted) rescan. A directory that is missing, or goes
+ * away, is waited for through a watch on its nearest existing parent, so a
+ * ~/.local/share/applications created later is picked up and scanned.
+ *
+ * The exec_path → app lookup table used on the hot path is a view rebuilt
+ * from the entries after every change, in directory priority order, so the
+ * "first .desktop file wins" rule holds regardless of event order.
+ *
+ * =============================================================================
  */
 
 #include "common.h"
 #include "desktop.h"
 #include "logging.h"
 #include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define DESKTOP_CACHE_FILE    PKGLOCALSTATEDIR "/desktop.cache"
+#define DESKTOP_CACHE_VERSION 1
+#define DESKTOP_MAX_DIRS      4
+
+#define DESKTOP_INOTIFY_MASK  (IN_CREATE | IN_CLOSE_WRITE | IN_DELETE | \
+                               IN_MOVED_FROM | IN_MOVED_TO | IN_ATTRIB | \
+                               IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define DESKTOP_PARENT_MASK   (IN_CREATE | IN_MOVED_TO | IN_DELETE_SELF | \
+                               IN_MOVE_SELF | IN_ONLYDIR)
 
 /**
- * Desktop application entry
+ * Desktop application entry (one per .desktop file)
  */
 typedef struct {
     char *app_name;        /* Display name (e.g., "Firefox") */
-    char *exec_path;       /* Resolved executable path */
+    char *exec_path;       /* Resolved executable path, NULL if not an app */
     char *desktop_file;    /* Path to .desktop file */
+    gint64 mtime;          /* .desktop file mtime (ns) when parsed */
+    int dir_index;         /* Index into desktop.dirs (scan priority) */
 } desktop_app_t;
 
-/* Global registry: exe_path → desktop_app_t */
-static GHashTable *desktop_apps = NULL;
+/**
+ * Scanned directory
+ */
+typedef struct {
+    char *path;
+    gint64 mtime;          /* Directory mtime (ns), -1 if missing */
+    int wd;                /* inotify watch descriptor, -1 if none */
+    int parent_wd;         /* Watch on the nearest existing parent while missing */
+} desktop_dir_t;
+
+/* Global desktop index */
+static struct {
+    GHashTable *entries;   /* desktop_file → desktop_app_t* (owned) */
+    GHashTable *apps;      /* exec_path → desktop_app_t* (view, not owned) */
+
+    desktop_dir_t dirs[DESKTOP_MAX_DIRS];
+    int n_dirs;
+
+    int inotify_fd;
+    guint inotify_source;
+
+    unsigned int generation;   /* Bumped whenever the app set may change */
+} desktop = { NULL, NULL, {{NULL, 0, -1, -1}}, 0, -1, 0, 0 };
 
 /**
  * Free desktop app entry
@@ -40,6 +99,15 @@ desktop_app_free(gpointer data)
     }
 }
 
+/**
+ * File mtime in nanoseconds (second granularity would miss quick rewrites)
+ */
+static gint64
+stat_mtime_ns(const struct stat *st)
+{
+    return (gint64)st->st_mtim.tv_sec * 1000000000LL + st->st_mtim.tv_nsec;
+}
+
 /**
  * Try to resolve snap wrapper to actual binary
  *
@@ -78,7 +146,7 @@ resolve_snap_binary(const char *wrapper_path)
     g_snprintf(snap_path, sizeof(snap_path),
                "/snap/%s/current/usr/lib/%s/%s", snap_name, snap_name, snap_name);
     if (access(snap_path, X_OK) == 0 && realpath(snap_path, resolved)) {
-        g_debug("Snap resolution: %s → %s", wrapper_path, resolved);
+        kp_debug("Snap resolution: %s → %s", wrapper_path, resolved);
         return g_strdup(resolved);
     }
     
@@ -86,7 +154,7 @@ resolve_snap_binary(const char *wrapper_path)
     g_snprintf(snap_path, sizeof(snap_path),
                "/snap/%s/current/usr/bin/%s", snap_name, snap_name);
     if (access(snap_path, X_OK) == 0 && realpath(snap_path, resolved)) {
-        g_debug("Snap resolution: %s → %s", wrapper_path, resolved);
+        kp_debug("Snap resolution: %s → %s", wrapper_path, resolved);
         return g_strdup(resolved);
     }
     
@@ -94,11 +162,11 @@ resolve_snap_binary(const char *wrapper_path)
     g_snprintf(snap_path, sizeof(snap_path),
                "/snap/%s/current/bin/%s", snap_name, snap_name);
     if (access(snap_path, X_OK) == 0 && realpath(snap_path, resolved)) {
-        g_debug("Snap resolution: %s → %s", wrapper_path, resolved);
+        kp_debug("Snap resolution: %s → %s", wrapper_path, resolved);
         return g_strdup(resolved);
     }
     
-    g_debug("Snap resolution failed for: %s", wrapper_path);
+    kp_debug("Snap resolution failed for: %s", wrapper_path);
     return NULL;
 }
 
@@ -190,25 +258,32 @@ resolve_exec_path(const char *exec_line)
 }
 
 /**
- * Parse a single .desktop file
+ * Parse a single .desktop file into an entry
+ *
+ * Always returns an entry: hidden, unloadable or unresolvable files become
+ * negative entries (exec_path NULL) so they are not re-parsed next time.
  */
-static void
-parse_desktop_file(const char *path)
+static desktop_app_t *
+parse_desktop_file(const char *path, int dir_index, gint64 mtime)
 {
     GKeyFile *kf;
     GError *error = NULL;
     char *exec = NULL;
     char *name = NULL;
-    char *resolved_path = NULL;
     desktop_app_t *app;
     gboolean is_hidden;
 
+    app = g_new0(desktop_app_t, 1);
+    app->desktop_file = g_strdup(path);
+    app->mtime = mtime;
+    app->dir_index = dir_index;
+
     kf = g_key_file_new();
     if (!g_key_file_load_from_file(kf, path, G_KEY_FILE_NONE, &error)) {
-        g_debug("Cannot load desktop file %s: %s", path, error->message);
+        kp_debug("Cannot load desktop file %s: %s", path, error->message);
         g_error_free(error);
         g_key_file_free(kf);
-        return;
+        return app;
     }
 
     /* Skip hidden applications (NoDisplay=true or Hidden=true) */
@@ -218,7 +293,7 @@ parse_desktop_file(const char *path)
     }
     if (is_hidden) {
         g_key_file_free(kf);
-        return;
+        return app;
     }
 
     /* Get Exec= and Name= */
@@ -226,69 +301,129 @@ parse_desktop_file(const char *path)
     name = g_key_file_get_string(kf, "Desktop Entry", "Name", NULL);
 
     if (!exec) {
-        g_debug("Desktop file %s has no Exec= line", path);
+        kp_debug("Desktop file %s has no Exec= line", path);
         goto cleanup;
     }
 
     /* Resolve Exec= to actual binary path */
-    resolved_path = resolve_exec_path(exec);
-    if (!resolved_path) {
-        g_debug("Cannot resolve Exec=%s from %s", exec, path);
-        goto cleanup;
-    }
-
-    /* Check if already registered (first .desktop file wins) */
-    if (g_hash_table_contains(desktop_apps, resolved_path)) {
-        g_debug("Already registered: %s (from earlier .desktop)", resolved_path);
+    app->exec_path = resolve_exec_path(exec);
+    if (!app->exec_path) {
+        kp_debug("Cannot resolve Exec=%s from %s", exec, path);
         goto cleanup;
     }
 
-    /* Create and register app */
-    app = g_new0(desktop_app_t, 1);
     app->app_name = name ? name : g_strdup("Unknown");
-    app->exec_path = g_strdup(resolved_path);
-    app->desktop_file = g_strdup(path);
-
-    g_hash_table_insert(desktop_apps, g_strdup(resolved_path), app);
-    g_debug("Registered desktop app: %s (%s)", app->app_name, resolved_path);
-
     name = NULL;  /* Ownership transferred to app */
 
 cleanup:
     g_free(exec);
     g_free(name);
-    g_free(resolved_path);
     g_key_file_free(kf);
+    return app;
+}
+
+/**
+ * Bring the entry for one .desktop file up to date
+ *
+ * @param cached  Table of previously known entries to reuse from (entries
+ *                are stolen from it), or NULL to consult desktop.entries
+ * @return TRUE if the index changed
+ */
+static gboolean
+refresh_desktop_file(int dir_index, const char *path, GHashTable *cached)
+{
+    GHashTable *source = cached ? cached : desktop.entries;
+    desktop_app_t *old, *app;
+    struct stat st;
+
+    old = g_hash_table_lookup(source, path);
+
+    if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (old && !cached) {
+            kp_debug("Desktop file removed: %s", path);
+            g_hash_table_remove(desktop.entries, path);
+            return TRUE;
+        }
+        return FALSE;
+    }
+
+    /* Reuse unchanged entry as long as its binary is still there */
+    if (old && old->mtime == stat_mtime_ns(&st) &&
+        (!old->exec_path || access(old->exec_path, F_OK) == 0)) {
+        if (cached) {
+            g_hash_table_steal(cached, path);
+            old->dir_index = dir_index;
+            g_hash_table_replace(desktop.entries, old->desktop_file, old);
+        }
+        return cached != NULL;
+    }
+
+    app = parse_desktop_file(path, dir_index, stat_mtime_ns(&st));
+    if (cached && old)
+        g_hash_table_remove(cached, path);
+    g_hash_table_replace(desktop.entries, app->desktop_file, app);
+    if (app->exec_path)
+        kp_debug("Registered desktop app: %s (%s)", app->app_name, app->exec_path);
+    return TRUE;
 }
 
 /**
  * Scan a directory for .desktop files
+ *
+ * When the directory mtime matches the cached one, its file list cannot
+ * have changed, so the cached entries are revalidated without readdir().
+ *
+ * @param cached        Entries loaded from the cache file (stolen on reuse),
+ *                      or NULL to refresh desktop.entries in place
+ * @param cached_mtime  Directory mtime recorded in the cache, -1 if unknown
  */
 static void
-scan_desktop_dir(const char *dir_path)
+scan_desktop_dir(int dir_index, GHashTable *cached, gint64 cached_mtime)
 {
+    desktop_dir_t *d = &desktop.dirs[dir_index];
     GDir *dir;
     const char *filename;
     struct stat st;
 
     /* Check if directory exists */
-    if (stat(dir_path, &st) != 0 || !S_ISDIR(st.st_mode)) {
-        g_debug("Desktop directory not found: %s", dir_path);
+    if (stat(d->path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        kp_debug("Desktop directory not found: %s", d->path);
+        d->mtime = -1;
+        return;
+    }
+    d->mtime = stat_mtime_ns(&st);
+
+    if (cached_mtime >= 0 && cached_mtime == d->mtime) {
+        GHashTableIter iter;
+        gpointer key, value;
+        GPtrArray *paths = g_ptr_array_new_with_free_func(g_free);
+
+        kp_debug("Desktop directory unchanged, using cache: %s", d->path);
+
+        g_hash_table_iter_init(&iter, cached);
+        while (g_hash_table_iter_next(&iter, &key, &value)) {
+            if (((desktop_app_t *)value)->dir_index == dir_index)
+                g_ptr_array_add(paths, g_strdup(key));
+        }
+        for (guint i = 0; i < paths->len; i++)
+            refresh_desktop_file(dir_index, g_ptr_array_index(paths, i), cached);
+
+        g_ptr_array_free(paths, TRUE);
         return;
     }
 
-    dir = g_dir_open(dir_path, 0, NULL);
+    dir = g_dir_open(d->path, 0, NULL);
     if (!dir) {
-        g_debug("Cannot open desktop directory: %s", dir_path);
+        kp_debug("Cannot open desktop directory: %s", d->path);
         return;
     }
 
-    g_debug("Scanning desktop files in: %s", dir_path);
+    kp_debug("Scanning desktop files in: %s", d->path);
 
     while ((filename = g_dir_read_name(dir))) {
         if (g_str_has_suffix(filename, ".desktop")) {
-            char *full_path = g_build_filename(dir_path, filename, NULL);
-            parse_desktop_file(full_path);
+            char *full_path = g_build_filename(d->path, filename, NULL);
+            refresh_desktop_file(dir_index, full_path, cached);
             g_free(full_path);
         }
     }
@@ -296,6 +431,403 @@ scan_desktop_dir(const char *dir_path)
     g_dir_close(dir);
 }
 
+/**
+ * Order entries by scan priority (directory order, then file name)
+ */
+static int
+desktop_entry_compare(gconstpointer pa, gconstpointer pb)
+{
+    const desktop_app_t *a = *(desktop_app_t * const *)pa;
+    const desktop_app_t *b = *(desktop_app_t * const *)pb;
+
+    if (a->dir_index != b->dir_index)
+        return a->dir_index - b->dir_index;
+    return strcmp(a->desktop_file, b->desktop_file);
+}
+
+/**
+ * Rebuild exec_path → app view (first .desktop file wins)
+ */
+static void
+rebuild_app_index(void)
+{
+    GHashTableIter iter;
+    gpointer value;
+    GPtrArray *sorted = g_ptr_array_sized_new(g_hash_table_size(desktop.entries));
+
+    g_hash_table_iter_init(&iter, desktop.entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (((desktop_app_t *)value)->exec_path)
+            g_ptr_array_add(sorted, value);
+    }
+    g_ptr_array_sort(sorted, desktop_entry_compare);
+
+    g_hash_table_remove_all(desktop.apps);
+    for (guint i = 0; i < sorted->len; i++) {
+        desktop_app_t *app = g_ptr_array_index(sorted, i);
+
+        if (g_hash_table_contains(desktop.apps, app->exec_path)) {
+            kp_debug("Already registered: %s (from earlier .desktop)", app->exec_path);
+            continue;
+        }
+        g_hash_table_insert(desktop.apps, app->exec_path, app);
+    }
+
+    g_ptr_array_free(sorted, TRUE);
+    desktop.generation++;
+}
+
+/**
+ * Load cached index
+ *
+ * @param dir_mtimes  Filled with cached mtime per configured dir (-1 if none)
+ * @return Table desktop_file → desktop_app_t* (entries in unknown dirs dropped)
+ */
+static GHashTable *
+load_desktop_cache(gint64 *dir_mtimes)
+{
+    GHashTable *cached;
+    GKeyFile *kf;
+    gchar **groups;
+
+    cached = g_hash_table_new_full(g_str_hash, g_str_equal, NULL, desktop_app_free);
+    for (int i = 0; i < desktop.n_dirs; i++)
+        dir_mtimes[i] = -1;
+
+    kf = g_key_file_new();
+    if (!g_key_file_load_from_file(kf, DESKTOP_CACHE_FILE, G_KEY_FILE_NONE, NULL) ||
+        g_key_file_get_integer(kf, "Cache", "version", NULL) != DESKTOP_CACHE_VERSION) {
+        g_key_file_free(kf);
+        return cached;
+    }
+
+    groups = g_key_file_get_groups(kf, NULL);
+    for (int g = 0; groups && groups[g]; g++) {
+        const char *group = groups[g];
+
+        if (g_str_has_prefix(group, "Dir ")) {
+            for (int i = 0; i < desktop.n_dirs; i++) {
+                if (strcmp(group + 4, desktop.dirs[i].path) == 0)
+                    dir_mtimes[i] = g_key_file_get_int64(kf, group, "mtime", NULL);
+            }
+        } else if (g_str_has_prefix(group, "File ")) {
+            char *dir = g_key_file_get_string(kf, group, "dir", NULL);
+            int dir_index = -1;
+
+            for (int i = 0; dir && i < desktop.n_dirs; i++) {
+                if (strcmp(dir, desktop.dirs[i].path) == 0)
+                    dir_index = i;
+            }
+            g_free(dir);
+            if (dir_index < 0)
+                continue;
+
+            desktop_app_t *app = g_new0(desktop_app_t, 1);
+            app->desktop_file = g_strdup(group + 5);
+            app->mtime = g_key_file_get_int64(kf, group, "mtime", NULL);
+            app->dir_index = dir_index;
+            app->exec_path = g_key_file_get_string(kf, group, "exec", NULL);
+            if (app->exec_path)
+                app->app_name = g_key_file_get_string(kf, group, "name", NULL);
+            if (app->exec_path && !app->app_name)
+                app->app_name = g_strdup("Unknown");
+            g_hash_table_replace(cached, app->desktop_file, app);
+        }
+    }
+
+    g_strfreev(groups);
+    g_key_file_free(kf);
+    return cached;
+}
+
+/**
+ * Save index so the next startup can skip unchanged files
+ */
+static void
+save_desktop_cache(void)
+{
+    GKeyFile *kf = g_key_file_new();
+    GHashTableIter iter;
+    gpointer value;
+    GError *error = NULL;
+    gchar *data;
+    gsize len;
+
+    g_key_file_set_integer(kf, "Cache", "version", DESKTOP_CACHE_VERSION);
+
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        if (desktop.dirs[i].mtime < 0 || strpbrk(desktop.dirs[i].path, "[]\n"))
+            continue;
+        char *group = g_strconcat("Dir ", desktop.dirs[i].path, NULL);
+        g_key_file_set_int64(kf, group, "mtime", desktop.dirs[i].mtime);
+        g_free(group);
+    }
+
+    g_hash_table_iter_init(&iter, desktop.entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        desktop_app_t *app = value;
+
+        /* Group names cannot hold brackets or newlines; such files just get re-parsed */
+        if (strpbrk(app->desktop_file, "[]\n"))
+            continue;
+
+        char *group = g_strconcat("File ", app->desktop_file, NULL);
+        g_key_file_set_string(kf, group, "dir", desktop.dirs[app->dir_index].path);
+        g_key_file_set_int64(kf, group, "mtime", app->mtime);
+        if (app->exec_path) {
+            g_key_file_set_string(kf, group, "exec", app->exec_path);
+            g_key_file_set_string(kf, group, "name", app->app_name);
+        }
+        g_free(group);
+    }
+
+    data = g_key_file_to_data(kf, &len, NULL);
+    if (!g_file_set_contents(DESKTOP_CACHE_FILE, data, len, &error)) {
+        kp_debug("Cannot write desktop cache %s: %s", DESKTOP_CACHE_FILE, error->message);
+        g_error_free(error);
+    }
+
+    g_free(data);
+    g_key_file_free(kf);
+}
+
+/**
+ * Rescan every directory (startup and inotify queue overflow)
+ *
+ * @param cached       Known entries to reuse (consumed)
+ * @param dir_mtimes   Cached directory mtimes, NULL to force readdir()
+ */
+static void
+rescan_all_dirs(GHashTable *cached, const gint64 *dir_mtimes)
+{
+    for (int i = 0; i < desktop.n_dirs; i++)
+        scan_desktop_dir(i, cached, dir_mtimes ? dir_mtimes[i] : -1);
+
+    if (g_hash_table_size(cached) > 0)
+        kp_debug("Dropped %u stale desktop entries", g_hash_table_size(cached));
+    g_hash_table_destroy(cached);
+
+    rebuild_app_index();
+    save_desktop_cache();
+}
+
+/**
+ * Stop watching the parent of a directory (kept while another dir shares it)
+ */
+static void
+unwatch_parent(int dir_index)
+{
+    int wd = desktop.dirs[dir_index].parent_wd;
+
+    desktop.dirs[dir_index].parent_wd = -1;
+    if (wd < 0)
+        return;
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        if (desktop.dirs[i].parent_wd == wd)
+            return;
+    }
+    inotify_rm_watch(desktop.inotify_fd, wd);
+}
+
+/**
+ * Watch a desktop directory, or while it is missing its nearest existing
+ * parent, whose events bring it back through desktop_dir_appeared()
+ *
+ * @return TRUE if the directory itself is watched
+ */
+static gboolean
+watch_desktop_dir(int dir_index)
+{
+    desktop_dir_t *d = &desktop.dirs[dir_index];
+    char *parent;
+
+    if (d->wd >= 0)
+        return TRUE;
+
+    d->wd = inotify_add_watch(desktop.inotify_fd, d->path, DESKTOP_INOTIFY_MASK);
+    if (d->wd >= 0) {
+        unwatch_parent(dir_index);
+        return TRUE;
+    }
+    if (errno != ENOENT && errno != ENOTDIR) {
+        kp_debug("Cannot watch %s: %s", d->path, strerror(errno));
+        return FALSE;
+    }
+
+    parent = g_path_get_dirname(d->path);
+    for (;;) {
+        int wd = inotify_add_watch(desktop.inotify_fd, parent, DESKTOP_PARENT_MASK);
+        char *up;
+
+        if (wd >= 0) {
+            if (wd != d->parent_wd) {
+                unwatch_parent(dir_index);
+                d->parent_wd = wd;
+                kp_debug("Waiting for %s in %s", d->path, parent);
+            }
+            break;
+        }
+        if (strcmp(parent, "/") == 0 || (errno != ENOENT && errno != ENOTDIR))
+            break;
+        up = g_path_get_dirname(parent);
+        g_free(parent);
+        parent = up;
+    }
+    g_free(parent);
+    return FALSE;
+}
+
+/**
+ * Watch and scan a directory if it exists (again)
+ * @return TRUE if the index may have changed
+ */
+static gboolean
+desktop_dir_appeared(int dir_index)
+{
+    if (!watch_desktop_dir(dir_index))
+        return FALSE;
+
+    kp_debug("Desktop directory appeared: %s", desktop.dirs[dir_index].path);
+    scan_desktop_dir(dir_index, NULL, -1);
+    return TRUE;
+}
+
+/**
+ * Drop all entries of a directory that went away
+ */
+static void
+forget_desktop_dir(int dir_index)
+{
+    GHashTableIter iter;
+    gpointer value;
+
+    g_hash_table_iter_init(&iter, desktop.entries);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+        if (((desktop_app_t *)value)->dir_index == dir_index)
+            g_hash_table_iter_remove(&iter);
+    }
+    desktop.dirs[dir_index].mtime = -1;
+
+    /* A moved directory keeps its watch; a deleted one is already gone */
+    inotify_rm_watch(desktop.inotify_fd, desktop.dirs[dir_index].wd);
+    desktop.dirs[dir_index].wd = -1;
+
+    /* Replaced in the meantime (rename over it), or wait for it */
+    desktop_dir_appeared(dir_index);
+}
+
+/**
+ * inotify callback: apply events to single entries
+ */
+static gboolean
+desktop_inotify_cb(GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    gboolean changed = FALSE;
+    gboolean overflow = FALSE;
+    ssize_t len;
+
+    (void)source;
+    (void)condition;
+    (void)data;
+
+    while ((len = read(desktop.inotify_fd, buf, sizeof(buf))) > 0) {
+        char *p = buf;
+
+        while (p < buf + len) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            int dir_index = -1;
+
+            p += sizeof(struct inotify_event) + ev->len;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                overflow = TRUE;
+                continue;
+            }
+
+            for (int i = 0; i < desktop.n_dirs; i++) {
+                if (desktop.dirs[i].wd == ev->wd)
+                    dir_index = i;
+                else if (desktop.dirs[i].parent_wd == ev->wd)
+                    changed |= desktop_dir_appeared(i);
+            }
+            if (dir_index < 0)
+                continue;
+
+            if (ev->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                kp_debug("Desktop directory gone: %s", desktop.dirs[dir_index].path);
+                forget_desktop_dir(dir_index);
+                changed = TRUE;
+                continue;
+            }
+
+            if (!ev->len || !g_str_has_suffix(ev->name, ".desktop"))
+                continue;
+
+            char *full_path = g_build_filename(desktop.dirs[dir_index].path, ev->name, NULL);
+            changed |= refresh_desktop_file(dir_index, full_path, NULL);
+            g_free(full_path);
+        }
+    }
+
+    if (overflow) {
+        /* Old entries become the reuse table; unchanged files aren't re-parsed */
+        GHashTable *cached = desktop.entries;
+
+        g_message("Desktop watch queue overflowed, rescanning");
+        desktop.entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                NULL, desktop_app_free);
+        g_hash_table_remove_all(desktop.apps);
+        for (int i = 0; i < desktop.n_dirs; i++)
+            watch_desktop_dir(i);
+        rescan_all_dirs(cached, NULL);
+        return TRUE;
+    }
+
+    if (changed) {
+        struct stat st;
+
+        for (int i = 0; i < desktop.n_dirs; i++) {
+            if (desktop.dirs[i].wd >= 0 && stat(desktop.dirs[i].path, &st) == 0)
+                desktop.dirs[i].mtime = stat_mtime_ns(&st);
+        }
+        rebuild_app_index();
+        save_desktop_cache();
+        g_message("Desktop index updated: %u GUI applications",
+                  g_hash_table_size(desktop.apps));
+    }
+
+    return TRUE;
+}
+
+/**
+ * Watch desktop directories for changes (missing ones through a parent)
+ */
+static void
+setup_inotify(void)
+{
+    GIOChannel *channel;
+    int watched = 0;
+
+    desktop.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (desktop.inotify_fd < 0) {
+        g_warning("inotify_init1 failed: %s (desktop index won't auto-refresh)",
+                  strerror(errno));
+        return;
+    }
+
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        if (watch_desktop_dir(i))
+            watched++;
+    }
+
+    channel = g_io_channel_unix_new(desktop.inotify_fd);
+    desktop.inotify_source = g_io_add_watch(channel, G_IO_IN, desktop_inotify_cb, NULL);
+    g_io_channel_unref(channel);
+
+    kp_debug("Watching %d desktop directories", watched);
+}
+
 /**
  * Initialize desktop file scanner
  */
@@ -303,34 +835,46 @@ void
 kp_desktop_init(void)
 {
     const char *home;
-    char *user_dir;
-    int count;
+    GHashTable *cached;
+    gint64 dir_mtimes[DESKTOP_MAX_DIRS];
+    int count, reused;
 
-    if (desktop_apps) {
+    if (desktop.entries) {
         g_warning("Desktop scanner already initialized");
         return;
     }
 
-    desktop_apps = g_hash_table_new_full(g_str_hash, g_str_equal,
-                                          g_free, desktop_app_free);
+    desktop.entries = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                            NULL, desktop_app_free);
+    desktop.apps = g_hash_table_new(g_str_hash, g_str_equal);
+
+    /* Directories in priority order (earlier wins on duplicate Exec=) */
+    desktop.n_dirs = 0;
+    desktop.dirs[desktop.n_dirs++].path = g_strdup("/usr/share/applications");
+    desktop.dirs[desktop.n_dirs++].path = g_strdup("/usr/local/share/applications");
+    /* Snap desktop files (Ubuntu/snapd) */
+    desktop.dirs[desktop.n_dirs++].path = g_strdup("/var/lib/snapd/desktop/applications");
+    /* User directory */
+    home = g_get_home_dir();
+    if (home)
+        desktop.dirs[desktop.n_dirs++].path = g_build_filename(home, ".local/share/applications", NULL);
 
-    /* Scan system directories */
-    scan_desktop_dir("/usr/share/applications");
-    scan_desktop_dir("/usr/local/share/applications");
+    for (int i = 0; i < desktop.n_dirs; i++) {
+        desktop.dirs[i].mtime = -1;
+        desktop.dirs[i].wd = -1;
+        desktop.dirs[i].parent_wd = -1;
+    }
 
-    /* Scan snap desktop files (Ubuntu/snapd) */
-    scan_desktop_dir("/var/lib/snapd/desktop/applications");
+    cached = load_desktop_cache(dir_mtimes);
+    reused = g_hash_table_size(cached);
+    rescan_all_dirs(cached, dir_mtimes);
 
-    /* Scan user directory */
-    home = g_get_home_dir();
-    if (home) {
-        user_dir = g_build_filename(home, ".local/share/applications", NULL);
-        scan_desktop_dir(user_dir);
-        g_free(user_dir);
-    }
+    setup_inotify();
 
-    count = g_hash_table_size(desktop_apps);
-    g_message("Desktop scanner initialized: discovered %d GUI applications", count);
+    count = g_hash_table_size(desktop.apps);
+    g_message("Desktop scanner initialized: discovered %d GUI applications "
+              "(%u desktop files, %d cached)",
+              count, g_hash_table_size(desktop.entries), reused);
 }
 
 /**
@@ -339,11 +883,11 @@ kp_desktop_init(void)
 gboolean
 kp_desktop_has_file(const char *exe_path)
 {
-    if (!desktop_apps || !exe_path) {
+    if (!desktop.apps || !exe_path) {
         return FALSE;
     }
 
-    return g_hash_table_contains(desktop_apps, exe_path);
+    return g_hash_table_contains(desktop.apps, exe_path);
 }
 
 /**
@@ -354,23 +898,49 @@ kp_desktop_get_name(const char *exe_path)
 {
     desktop_app_t *app;
 
-    if (!desktop_apps || !exe_path) {
+    if (!desktop.apps || !exe_path) {
         return NULL;
     }
 
-    app = g_hash_table_lookup(desktop_apps, exe_path);
+    app = g_hash_table_lookup(desktop.apps, exe_path);
     return app ? app->app_name : NULL;
 }
 
+/**
+ * Get desktop index generation
+ */
+unsigned int
+kp_desktop_generation(void)
+{
+    return desktop.generation;
+}
+
 /**
  * Free desktop scanner resources
  */
 void
 kp_desktop_free(void)
 {
-    if (desktop_apps) {
-        g_hash_table_destroy(desktop_apps);
-        desktop_apps = NULL;
-        g_debug("Desktop scanner freed");
+    if (desktop.inotify_source) {
+        g_source_remove(desktop.inotify_source);
+        desktop.inotify_source = 0;
+    }
+    if (desktop.inotify_fd >= 0) {
+        close(desktop.inotify_fd);
+        desktop.inotify_fd = -1;
+    }
+
+    if (desktop.entries) {
+        g_hash_table_destroy(desktop.apps);
+        g_hash_table_destroy(desktop.entries);
+        desktop.apps = NULL;
+        desktop.entries = NULL;
+
+        for (int i = 0; i < desktop.n_dirs; i++) {
+            g_free(desktop.dirs[i].path);
+            desktop.dirs[i].path = NULL;
+        }
+        desktop.n_dirs = 0;
+        kp_debug("Desktop scanner freed");
     }
 }
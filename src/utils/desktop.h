@@ -17,8 +17,15 @@
  * SCANNED DIRECTORIES:
  * - /usr/share/applications
  * - /usr/local/share/applications
+ * - /var/lib/snapd/desktop/applications
  * - ~/.local/share/applications
  *
+ * CACHING:
+ * The parsed index is persisted to PKGLOCALSTATEDIR/desktop.cache, keyed by
+ * directory and file mtime, so restarts only re-parse changed files. While
+ * running, inotify keeps individual entries current (apps installed or
+ * removed after startup are picked up without a restart).
+ *
  * PURPOSE:
  * Auto-promote GUI applications to priority pool without manual configuration.
  * Firefox, VS Code, etc. are automatically recognized and prioritized.
@@ -60,6 +67,15 @@ gboolean kp_desktop_has_file(const char *exe_path);
  */
 const char *kp_desktop_get_name(const char *exe_path);
 
+/**
+ * Get desktop index generation
+ *
+ * Incremented every time the set of known desktop apps may have changed
+ * (startup scan, inotify update). Callers caching kp_desktop_has_file()
+ * results can compare generations to know when to re-check.
+ */
+unsigned int kp_desktop_generation(void);
+
 /**
  * Free desktop scanner resources
  */
@@ -7,28 +7,780 @@
  * the Free Software Foundation; either version 2 of the License, or
  * (at your option) any later version.
  *
+ * =============================================================================
+ * MODULE OVERVIEW: In-process ELF Dependency Resolver
+ * =============================================================================
+ *
  * Discovers shared libraries via:
- * 1. ldd (ELF-linked dependencies)
+ * 1. ELF dynamic section (DT_NEEDED, resolved like ld.so does)
  * 2. Directory scan (for dlopen'd libraries like Firefox's libxul.so)
+ *
+ * Earlier versions ran /usr/bin/ldd through popen() for every session app.
+ * That cost a fork/exec per app, actually executed the target's loader
+ * sequence, and left us parsing human-readable text. The dependency graph
+ * is now read directly from the ELF headers:
+ *
+ *   - PT_DYNAMIC gives DT_NEEDED, DT_RUNPATH, DT_RPATH and DT_STRTAB
+ *   - $ORIGIN / ${ORIGIN} in search paths expand to the object's directory
+ *   - Bare sonames are resolved through /etc/ld.so.cache, then the default
+ *     system directories (same order as the dynamic loader)
+ *   - Candidates must match the executable's ELF class and machine, so a
+ *     32-bit or foreign-arch copy of a library is never picked up
+ *
+ * Only exes that have no process to look at need this (session apps).
+ * Exes registered by the spy take their maps from /proc/PID/maps, which
+ * already lists exactly what the loader and dlopen() mapped.
+ *
+ * LOADED RANGES (kp_elf_load_ranges):
+ *   Whole-file maps for manual and session apps would also read debug info,
+ *   .symtab and bundled data the loader never touches. The same parse
+ *   records what the loader does read:
+ *
+ *   - PT_LOAD segments, widened to page boundaries like mmap() does
+ *   - PT_DYNAMIC, and .dynsym/.dynstr/hash sections from the section table
+ *
+ *   Objects without a section table (packed/UPX style) or whose loaded
+ *   ranges cover nearly the whole file are left to a whole-file map.
+ *
+ * CACHING:
+ *   Every parsed object is kept in a table keyed by (dev, inode, mtime), so
+ *   an upgraded library is naturally re-read while unchanged ones are never
+ *   opened twice. Each object memoizes its resolved direct dependencies and,
+ *   once computed, its full transitive closure. The ld.so.cache index is
+ *   reloaded only when the cache file's mtime changes.
+ *
+ * LIMITATIONS:
+ *   - Only objects of the daemon's own ELF class/byte order are parsed
+ *   - DT_RPATH is applied per object; inheritance of the loading object's
+ *     RPATH (deprecated behaviour) is not emulated
+ *   - $LIB / $PLATFORM tokens are not expanded (those entries are skipped)
+ *
+ * =============================================================================
  */
 
 #include "lib_scanner.h"
+#include "logging.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <dirent.h>
+#include <elf.h>
+#include <link.h>
 #include <sys/stat.h>
 #include <glib.h>
 
 #define MAX_LIBS 256
-#define LINE_SIZE 1024
 #define MIN_LIB_SIZE (64 * 1024)  /* Only scan libs > 64 KB */
 
+#define LDSO_CACHE_FILE     "/etc/ld.so.cache"
+#define LDSO_CACHE_MAGIC    "glibc-ld.so.cache1.1"
+#define LDSO_CACHE_OLDMAGIC "ld.so-1.7.0"
+
+#define MAX_DYNAMIC_SIZE    (256 * 1024)   /* Sanity cap for PT_DYNAMIC */
+#define MAX_STRTAB_SIZE     (4 * 1024 * 1024)
+#define MAX_CACHED_OBJECTS  4096           /* Flush object cache beyond this */
+#define MAX_SECTIONS        4096           /* Sanity cap for e_shnum */
+#define LOAD_WHOLE_PERCENT  90             /* Loaded share above which the whole file is used */
+
+/* Default search directories after ld.so.cache (arch filtered by ELF check) */
+static const char *default_lib_dirs[] = {
+    "/lib/x86_64-linux-gnu",
+    "/usr/lib/x86_64-linux-gnu",
+    "/lib/aarch64-linux-gnu",
+    "/usr/lib/aarch64-linux-gnu",
+    "/lib64",
+    "/usr/lib64",
+    "/lib",
+    "/usr/lib",
+    NULL
+};
+
+/**
+ * Parsed ELF object (one per (dev, inode, mtime))
+ */
+typedef struct _elf_object_t {
+    char *path;             /* Path the object was first found under */
+    gboolean valid;         /* Native-class ELF with readable headers */
+    unsigned char elfclass;
+    Elf64_Half machine;
+
+    char **needed;          /* DT_NEEDED sonames (NULL-terminated) */
+    char *runpath;          /* DT_RUNPATH, or NULL */
+    char *rpath;            /* DT_RPATH, or NULL */
+    GArray *loads;          /* kp_elf_range_t the loader reads, or NULL */
+
+    gboolean deps_resolved;
+    GPtrArray *deps;        /* Direct deps (elf_object_t*), not owned */
+    GPtrArray *closure;     /* Transitive closure (elf_object_t*), or NULL */
+} elf_object_t;
+
+static struct {
+    GHashTable *objects;    /* "dev:ino:mtime" → elf_object_t* */
+
+    GHashTable *ldcache;    /* soname → GPtrArray of paths */
+    time_t ldcache_mtime;
+    gboolean ldcache_loaded;
+} resolver = { NULL, NULL, 0, FALSE };
+
+static void
+elf_object_free(elf_object_t *obj)
+{
+    if (!obj)
+        return;
+    g_free(obj->path);
+    g_strfreev(obj->needed);
+    g_free(obj->runpath);
+    g_free(obj->rpath);
+    if (obj->loads)
+        g_array_free(obj->loads, TRUE);
+    if (obj->deps)
+        g_ptr_array_free(obj->deps, TRUE);
+    if (obj->closure)
+        g_ptr_array_free(obj->closure, TRUE);
+    g_free(obj);
+}
+
+static void
+ldcache_entry_free(gpointer data)
+{
+    g_ptr_array_free((GPtrArray *)data, TRUE);
+}
+
+/**
+ * Read exactly len bytes at offset, FALSE on short read
+ */
+static gboolean
+read_at(int fd, void *buf, size_t len, off_t offset)
+{
+    ssize_t n = pread(fd, buf, len, offset);
+    return n >= 0 && (size_t)n == len;
+}
+
+/**
+ * Translate a virtual address to a file offset using PT_LOAD segments
+ */
+static gboolean
+vaddr_to_offset(const ElfW(Phdr) *phdrs, int phnum, ElfW(Addr) vaddr, off_t *offset)
+{
+    for (int i = 0; i < phnum; i++) {
+        const ElfW(Phdr) *ph = &phdrs[i];
+        if (ph->p_type != PT_LOAD)
+            continue;
+        if (vaddr >= ph->p_vaddr && vaddr < ph->p_vaddr + ph->p_filesz) {
+            *offset = ph->p_offset + (vaddr - ph->p_vaddr);
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+static gint
+range_compare(gconstpointer pa, gconstpointer pb)
+{
+    const kp_elf_range_t *a = pa, *b = pb;
+
+    if (a->offset != b->offset)
+        return a->offset < b->offset ? -1 : 1;
+    return 0;
+}
+
+static void
+add_range(GArray *ranges, size_t offset, size_t length, off_t file_size)
+{
+    kp_elf_range_t r;
+
+    if (length == 0 || (off_t)offset >= file_size)
+        return;
+    r.offset = offset;
+    r.length = MIN(length, (size_t)(file_size - offset));
+    g_array_append_val(ranges, r);
+}
+
+/**
+ * Record the file ranges the dynamic loader reads from an object
+ *
+ * Leaves obj->loads NULL when a whole-file map is the better answer.
+ */
+static void
+parse_load_ranges(elf_object_t *obj, int fd, const ElfW(Ehdr) *ehdr,
+                  const ElfW(Phdr) *phdrs, off_t file_size)
+{
+    static size_t page_size = 0;
+    ElfW(Shdr) *shdrs = NULL;
+    GArray *ranges;
+    size_t loaded = 0;
+    guint n;
+
+    /* Packed executables carry no section table and unpack themselves */
+    if (ehdr->e_shnum == 0 || ehdr->e_shnum > MAX_SECTIONS ||
+        ehdr->e_shentsize != sizeof(ElfW(Shdr)) ||
+        (off_t)ehdr->e_shoff + (off_t)ehdr->e_shnum * ehdr->e_shentsize > file_size)
+        return;
+
+    if (!page_size)
+        page_size = sysconf(_SC_PAGESIZE) > 0 ? (size_t)sysconf(_SC_PAGESIZE) : 4096;
+
+    ranges = g_array_new(FALSE, FALSE, sizeof(kp_elf_range_t));
+
+    /* ELF header and program headers */
+    add_range(ranges, 0, ehdr->e_phoff + (size_t)ehdr->e_phnum * ehdr->e_phentsize, file_size);
+
+    for (int i = 0; i < ehdr->e_phnum; i++) {
+        const ElfW(Phdr) *ph = &phdrs[i];
+        size_t start, end;
+
+        if (ph->p_type != PT_LOAD && ph->p_type != PT_DYNAMIC)
+            continue;
+        start = ph->p_offset & ~(page_size - 1);
+        end = (ph->p_offset + ph->p_filesz + page_size - 1) & ~(page_size - 1);
+        add_range(ranges, start, end - start, file_size);
+    }
+
+    shdrs = g_new(ElfW(Shdr), ehdr->e_shnum);
+    if (read_at(fd, shdrs, sizeof(ElfW(Shdr)) * ehdr->e_shnum, ehdr->e_shoff)) {
+        for (int i = 0; i < ehdr->e_shnum; i++) {
+            const ElfW(Shdr) *sh = &shdrs[i];
+
+            switch (sh->sh_type) {
+                case SHT_DYNSYM:
+                    /* The symbol table and the string table it links to */
+                    if (sh->sh_link < ehdr->e_shnum)
+                        add_range(ranges, shdrs[sh->sh_link].sh_offset,
+                                  shdrs[sh->sh_link].sh_size, file_size);
+                    /* fall through */
+                case SHT_DYNAMIC:
+                case SHT_HASH:
+                case SHT_GNU_HASH:
+                    add_range(ranges, sh->sh_offset, sh->sh_size, file_size);
+                    break;
+            }
+        }
+    }
+    g_free(shdrs);
+
+    /* Sort and merge overlapping or touching ranges */
+    g_array_sort(ranges, range_compare);
+    n = 0;
+    for (guint i = 0; i < ranges->len; i++) {
+        kp_elf_range_t *r = &g_array_index(ranges, kp_elf_range_t, i);
+        kp_elf_range_t *last = n ? &g_array_index(ranges, kp_elf_range_t, n - 1) : NULL;
+
+        if (last && r->offset <= last->offset + last->length) {
+            last->length = MAX(last->offset + last->length, r->offset + r->length) - last->offset;
+            continue;
+        }
+        g_array_index(ranges, kp_elf_range_t, n++) = *r;
+    }
+    g_array_set_size(ranges, n);
+
+    for (guint i = 0; i < ranges->len; i++)
+        loaded += g_array_index(ranges, kp_elf_range_t, i).length;
+
+    if (!ranges->len || loaded * 100 >= (size_t)file_size * LOAD_WHOLE_PERCENT) {
+        g_array_free(ranges, TRUE);
+        return;
+    }
+
+    obj->loads = ranges;
+}
+
+/**
+ * Parse the dynamic section of an ELF file into obj
+ *
+ * Only objects matching the daemon's own class and byte order are parsed;
+ * anything else leaves obj->valid FALSE (class/machine still recorded when
+ * the identification bytes are readable).
+ */
+static void
+parse_elf_object(elf_object_t *obj, int fd, off_t file_size)
+{
+    ElfW(Ehdr) ehdr;
+    ElfW(Phdr) *phdrs = NULL;
+    ElfW(Dyn) *dyn = NULL;
+    char *strtab = NULL;
+    const ElfW(Phdr) *dynamic = NULL;
+    GPtrArray *needed_offsets;
+    ElfW(Addr) strtab_addr = 0;
+    size_t strtab_size = 0;
+    ssize_t runpath_off = -1, rpath_off = -1;
+    off_t strtab_offset;
+    size_t ndyn;
+
+    if (!read_at(fd, &ehdr, sizeof(ehdr), 0))
+        return;
+
+    if (memcmp(ehdr.e_ident, ELFMAG, SELFMAG) != 0)
+        return;
+
+    obj->elfclass = ehdr.e_ident[EI_CLASS];
+    obj->machine = ehdr.e_machine;
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    if (ehdr.e_ident[EI_DATA] != ELFDATA2LSB)
+        return;
+#else
+    if (ehdr.e_ident[EI_DATA] != ELFDATA2MSB)
+        return;
+#endif
+    if (ehdr.e_ident[EI_CLASS] != (__ELF_NATIVE_CLASS == 64 ? ELFCLASS64 : ELFCLASS32))
+        return;
+    if (ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
+        return;
+    if (ehdr.e_phentsize != sizeof(ElfW(Phdr)) || ehdr.e_phnum == 0)
+        return;
+    if ((off_t)ehdr.e_phoff + (off_t)ehdr.e_phnum * ehdr.e_phentsize > file_size)
+        return;
+
+    phdrs = g_new(ElfW(Phdr), ehdr.e_phnum);
+    if (!read_at(fd, phdrs, sizeof(ElfW(Phdr)) * ehdr.e_phnum, ehdr.e_phoff))
+        goto out;
+
+    parse_load_ranges(obj, fd, &ehdr, phdrs, file_size);
+
+    for (int i = 0; i < ehdr.e_phnum; i++) {
+        if (phdrs[i].p_type == PT_DYNAMIC) {
+            dynamic = &phdrs[i];
+            break;
+        }
+    }
+
+    /* Static binaries have no PT_DYNAMIC: valid, just no dependencies */
+    if (!dynamic) {
+        obj->needed = g_new0(char *, 1);
+        obj->valid = TRUE;
+        goto out;
+    }
+
+    if (dynamic->p_filesz == 0 || dynamic->p_filesz > MAX_DYNAMIC_SIZE ||
+        (off_t)(dynamic->p_offset + dynamic->p_filesz) > file_size)
+        goto out;
+
+    ndyn = dynamic->p_filesz / sizeof(ElfW(Dyn));
+    dyn = g_new(ElfW(Dyn), ndyn);
+    if (!read_at(fd, dyn, ndyn * sizeof(ElfW(Dyn)), dynamic->p_offset))
+        goto out;
+
+    /* First pass: collect string table location and string offsets */
+    needed_offsets = g_ptr_array_new();
+    for (size_t i = 0; i < ndyn && dyn[i].d_tag != DT_NULL; i++) {
+        switch (dyn[i].d_tag) {
+            case DT_NEEDED:
+                g_ptr_array_add(needed_offsets, GSIZE_TO_POINTER(dyn[i].d_un.d_val));
+                break;
+            case DT_STRTAB:
+                strtab_addr = dyn[i].d_un.d_ptr;
+                break;
+            case DT_STRSZ:
+                strtab_size = dyn[i].d_un.d_val;
+                break;
+            case DT_RUNPATH:
+                runpath_off = dyn[i].d_un.d_val;
+                break;
+            case DT_RPATH:
+                rpath_off = dyn[i].d_un.d_val;
+                break;
+        }
+    }
+
+    if (!strtab_addr || strtab_size == 0 || strtab_size > MAX_STRTAB_SIZE ||
+        !vaddr_to_offset(phdrs, ehdr.e_phnum, strtab_addr, &strtab_offset) ||
+        strtab_offset + (off_t)strtab_size > file_size) {
+        g_ptr_array_free(needed_offsets, TRUE);
+        goto out;
+    }
+
+    strtab = g_malloc(strtab_size + 1);
+    if (!read_at(fd, strtab, strtab_size, strtab_offset)) {
+        g_ptr_array_free(needed_offsets, TRUE);
+        goto out;
+    }
+    strtab[strtab_size] = '\0';
+
+    /* Second pass: materialize strings (bounds-checked against STRSZ) */
+    obj->needed = g_new0(char *, needed_offsets->len + 1);
+    int n = 0;
+    for (guint i = 0; i < needed_offsets->len; i++) {
+        gsize off = GPOINTER_TO_SIZE(g_ptr_array_index(needed_offsets, i));
+        if (off < strtab_size && strtab[off])
+            obj->needed[n++] = g_strdup(strtab + off);
+    }
+    g_ptr_array_free(needed_offsets, TRUE);
+
+    if (runpath_off >= 0 && (size_t)runpath_off < strtab_size)
+        obj->runpath = g_strdup(strtab + runpath_off);
+    if (rpath_off >= 0 && (size_t)rpath_off < strtab_size)
+        obj->rpath = g_strdup(strtab + rpath_off);
+
+    obj->valid = TRUE;
+
+out:
+    g_free(strtab);
+    g_free(dyn);
+    g_free(phdrs);
+}
+
+/**
+ * Create the object cache, or flush it once it grew too large
+ */
+static void
+objects_init(void)
+{
+    if (!resolver.objects || g_hash_table_size(resolver.objects) > MAX_CACHED_OBJECTS) {
+        /* Closures hold pointers into the table, so flush it as a whole */
+        if (resolver.objects)
+            g_hash_table_destroy(resolver.objects);
+        resolver.objects = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                                 (GDestroyNotify)elf_object_free);
+    }
+}
+
+/**
+ * Look up (or parse and cache) the ELF object at path
+ *
+ * @return Cached object (owned by the cache), or NULL if path is not a
+ *         readable regular file
+ */
+static elf_object_t *
+get_object(const char *path)
+{
+    struct stat st;
+    elf_object_t *obj;
+    char *key;
+    int fd;
+
+    if (stat(path, &st) < 0 || !S_ISREG(st.st_mode))
+        return NULL;
+
+    key = g_strdup_printf("%lx:%lx:%lx",
+                          (unsigned long)st.st_dev,
+                          (unsigned long)st.st_ino,
+                          (unsigned long)st.st_mtime);
+
+    obj = g_hash_table_lookup(resolver.objects, key);
+    if (obj) {
+        g_free(key);
+        return obj;
+    }
+
+    obj = g_new0(elf_object_t, 1);
+    obj->path = g_strdup(path);
+
+    fd = open(path, O_RDONLY | O_CLOEXEC | O_NOCTTY);
+    if (fd >= 0) {
+        parse_elf_object(obj, fd, st.st_size);
+        close(fd);
+    }
+
+    g_hash_table_insert(resolver.objects, key, obj);
+    return obj;
+}
+
+/**
+ * Load /etc/ld.so.cache into soname → paths index
+ *
+ * Handles the "new" glibc format, either standalone (glibc >= 2.32 default)
+ * or appended after the legacy "ld.so-1.7.0" table. String offsets are
+ * relative to the start of the new-format header.
+ */
+static void
+ldcache_load(void)
+{
+    struct stat st;
+    gchar *contents = NULL;
+    gsize len = 0;
+    const char *base;
+    gsize base_len;
+    uint32_t nlibs;
+
+    if (stat(LDSO_CACHE_FILE, &st) < 0) {
+        if (resolver.ldcache)
+            g_hash_table_remove_all(resolver.ldcache);
+        resolver.ldcache_loaded = TRUE;
+        return;
+    }
+
+    if (resolver.ldcache_loaded && st.st_mtime == resolver.ldcache_mtime)
+        return;
+
+    resolver.ldcache_loaded = TRUE;
+    resolver.ldcache_mtime = st.st_mtime;
+
+    if (resolver.ldcache)
+        g_hash_table_remove_all(resolver.ldcache);
+    else
+        resolver.ldcache = g_hash_table_new_full(g_str_hash, g_str_equal,
+                                                 g_free, ldcache_entry_free);
+
+    if (!g_file_get_contents(LDSO_CACHE_FILE, &contents, &len, NULL))
+        return;
+
+    base = contents;
+    base_len = len;
+
+    /* Legacy header: skip its table (12-byte entries), align to 8 */
+    if (len >= 16 && memcmp(contents, LDSO_CACHE_OLDMAGIC, strlen(LDSO_CACHE_OLDMAGIC)) == 0) {
+        uint32_t old_n;
+        gsize skip;
+
+        memcpy(&old_n, contents + 12, sizeof(old_n));
+        skip = 16 + (gsize)old_n * 12;
+        skip = (skip + 7) & ~(gsize)7;
+        if (skip >= len)
+            goto out;
+        base = contents + skip;
+        base_len = len - skip;
+    }
+
+    if (base_len < 48 || memcmp(base, LDSO_CACHE_MAGIC, strlen(LDSO_CACHE_MAGIC)) != 0) {
+        kp_debug("lib_scanner: unrecognized %s format", LDSO_CACHE_FILE);
+        goto out;
+    }
+
+    memcpy(&nlibs, base + 20, sizeof(nlibs));
+    if ((gsize)nlibs > (base_len - 48) / 24)
+        goto out;
+
+    for (uint32_t i = 0; i < nlibs; i++) {
+        const char *entry = base + 48 + (gsize)i * 24;
+        uint32_t key_off, value_off;
+        const char *soname, *path;
+        GPtrArray *paths;
+
+        memcpy(&key_off, entry + 4, sizeof(key_off));
+        memcpy(&value_off, entry + 8, sizeof(value_off));
+        if (key_off >= base_len || value_off >= base_len)
+            continue;
+
+        soname = base + key_off;
+        path = base + value_off;
+        if (!memchr(soname, '\0', base_len - key_off) ||
+            !memchr(path, '\0', base_len - value_off) || path[0] != '/')
+            continue;
+
+        paths = g_hash_table_lookup(resolver.ldcache, soname);
+        if (!paths) {
+            paths = g_ptr_array_new_with_free_func(g_free);
+            g_hash_table_insert(resolver.ldcache, g_strdup(soname), paths);
+        }
+        g_ptr_array_add(paths, g_strdup(path));
+    }
+
+    kp_debug("lib_scanner: loaded %u sonames from %s",
+             g_hash_table_size(resolver.ldcache), LDSO_CACHE_FILE);
+
+out:
+    g_free(contents);
+}
+
+/**
+ * Accept candidate only if it is an ELF object compatible with the loader
+ */
+static elf_object_t *
+try_candidate(const char *path, const elf_object_t *loader)
+{
+    elf_object_t *obj = get_object(path);
+
+    if (!obj || !obj->valid)
+        return NULL;
+    if (obj->elfclass != loader->elfclass || obj->machine != loader->machine)
+        return NULL;
+    return obj;
+}
+
+/**
+ * Search a colon-separated path list (DT_RUNPATH / DT_RPATH) for soname
+ */
+static elf_object_t *
+search_path_list(const char *list, const char *soname, const elf_object_t *loader)
+{
+    char **dirs;
+    char *origin = NULL;
+    elf_object_t *found = NULL;
+
+    if (!list || !*list)
+        return NULL;
+
+    dirs = g_strsplit(list, ":", -1);
+    for (int i = 0; dirs[i] && !found; i++) {
+        char *dir = dirs[i];
+        char *expanded = NULL;
+        char *candidate;
+
+        if (!*dir)
+            continue;
+
+        if (strstr(dir, "$ORIGIN") || strstr(dir, "${ORIGIN}")) {
+            if (!origin) {
+                char *real = realpath(loader->path, NULL);
+                origin = g_path_get_dirname(real ? real : loader->path);
+                free(real);
+            }
+            /* Expand both spellings */
+            char **parts = g_strsplit(dir, "${ORIGIN}", -1);
+            char *tmp = g_strjoinv(origin, parts);
+            g_strfreev(parts);
+            parts = g_strsplit(tmp, "$ORIGIN", -1);
+            g_free(tmp);
+            expanded = g_strjoinv(origin, parts);
+            g_strfreev(parts);
+            dir = expanded;
+        }
+
+        /* Unsupported dynamic string tokens ($LIB, $PLATFORM) */
+        if (strchr(dir, '$') || dir[0] != '/') {
+            g_free(expanded);
+            continue;
+        }
+
+        candidate = g_build_filename(dir, soname, NULL);
+        found = try_candidate(candidate, loader);
+        g_free(candidate);
+        g_free(expanded);
+    }
+
+    g_free(origin);
+    g_strfreev(dirs);
+    return found;
+}
+
+/**
+ * Resolve one DT_NEEDED entry the way the dynamic loader would
+ *
+ * Order: DT_RPATH (only without DT_RUNPATH), DT_RUNPATH, ld.so.cache,
+ * default directories.
+ */
+static elf_object_t *
+resolve_soname(const char *soname, const elf_object_t *loader)
+{
+    elf_object_t *found;
+    GPtrArray *paths;
+
+    /* Names with a slash are paths, used as-is (only absolute ones here) */
+    if (strchr(soname, '/'))
+        return soname[0] == '/' ? try_candidate(soname, loader) : NULL;
+
+    if (!loader->runpath && (found = search_path_list(loader->rpath, soname, loader)))
+        return found;
+
+    if ((found = search_path_list(loader->runpath, soname, loader)))
+        return found;
+
+    paths = resolver.ldcache ? g_hash_table_lookup(resolver.ldcache, soname) : NULL;
+    if (paths) {
+        for (guint i = 0; i < paths->len; i++) {
+            if ((found = try_candidate(g_ptr_array_index(paths, i), loader)))
+                return found;
+        }
+    }
+
+    for (int i = 0; default_lib_dirs[i]; i++) {
+        char *candidate = g_build_filename(default_lib_dirs[i], soname, NULL);
+        found = try_candidate(candidate, loader);
+        g_free(candidate);
+        if (found)
+            return found;
+    }
+
+    return NULL;
+}
+
+/**
+ * Resolve (and memoize) the direct dependencies of obj
+ */
+static GPtrArray *
+object_deps(elf_object_t *obj)
+{
+    if (obj->deps_resolved)
+        return obj->deps;
+
+    obj->deps_resolved = TRUE;
+    obj->deps = g_ptr_array_new();
+
+    if (!obj->valid || !obj->needed)
+        return obj->deps;
+
+    for (int i = 0; obj->needed[i]; i++) {
+        elf_object_t *dep = resolve_soname(obj->needed[i], obj);
+        if (dep && dep != obj)
+            g_ptr_array_add(obj->deps, dep);
+        else if (!dep)
+            kp_debug("lib_scanner: %s: cannot resolve %s", obj->path, obj->needed[i]);
+    }
+
+    return obj->deps;
+}
+
+/**
+ * Compute (and memoize) the transitive dependency closure of obj
+ *
+ * Breadth-first over direct deps. When a dependency already has a memoized
+ * closure, it is merged wholesale instead of being walked again.
+ */
+static GPtrArray *
+object_closure(elf_object_t *obj)
+{
+    GHashTable *seen;
+    GQueue queue = G_QUEUE_INIT;
+    GPtrArray *closure;
+    elf_object_t *cur;
+
+    if (obj->closure)
+        return obj->closure;
+
+    closure = g_ptr_array_new();
+    seen = g_hash_table_new(g_direct_hash, g_direct_equal);
+    g_hash_table_add(seen, obj);
+    g_queue_push_tail(&queue, obj);
+
+    while ((cur = g_queue_pop_head(&queue)) != NULL) {
+        GPtrArray *deps = object_deps(cur);
+
+        for (guint i = 0; i < deps->len; i++) {
+            elf_object_t *dep = g_ptr_array_index(deps, i);
+
+            if (g_hash_table_contains(seen, dep))
+                continue;
+            g_hash_table_add(seen, dep);
+            g_ptr_array_add(closure, dep);
+
+            if (dep->closure) {
+                for (guint j = 0; j < dep->closure->len; j++) {
+                    elf_object_t *sub = g_ptr_array_index(dep->closure, j);
+                    if (!g_hash_table_contains(seen, sub)) {
+                        g_hash_table_add(seen, sub);
+                        g_ptr_array_add(closure, sub);
+                    }
+                }
+            } else {
+                g_queue_push_tail(&queue, dep);
+            }
+        }
+    }
+
+    g_hash_table_destroy(seen);
+    obj->closure = closure;
+    return closure;
+}
+
+/**
+ * Check if a library path is the dynamic loader itself
+ */
+static gboolean
+is_dynamic_loader(const char *path)
+{
+    const char *base = strrchr(path, '/');
+    base = base ? base + 1 : path;
+    return g_str_has_prefix(base, "ld-linux") || g_str_has_prefix(base, "ld64.so");
+}
+
 /**
  * Scan directory for .so files (catches dlopen'd libs like libxul.so)
  */
 static void
-scan_dir_for_libs(const char *dir_path, GPtrArray *libs)
+scan_dir_for_libs(const char *dir_path, GPtrArray *libs, GHashTable *seen)
 {
     DIR *dir;
     struct dirent *entry;
@@ -53,6 +805,9 @@ scan_dir_for_libs(const char *dir_path, GPtrArray *libs)
         
         snprintf(full_path, sizeof(full_path), "%s/%s", dir_path, name);
         
+        if (g_hash_table_contains(seen, full_path))
+            continue;
+        
         /* Skip if not a regular file or too small */
         if (stat(full_path, &st) < 0 || !S_ISREG(st.st_mode))
             continue;
@@ -60,7 +815,9 @@ scan_dir_for_libs(const char *dir_path, GPtrArray *libs)
         if (st.st_size < MIN_LIB_SIZE)
             continue;
         
-        g_ptr_array_add(libs, g_strdup(full_path));
+        char *copy = g_strdup(full_path);
+        g_hash_table_add(seen, copy);
+        g_ptr_array_add(libs, copy);
     }
     
     closedir(dir);
@@ -68,83 +825,59 @@ scan_dir_for_libs(const char *dir_path, GPtrArray *libs)
 
 /**
  * Scan executable for shared library dependencies
- * Uses ldd for ELF deps + directory scan for dlopen'd libs
+ * Reads ELF deps in-process + directory scan for dlopen'd libs
  */
 char **
 kp_scan_libraries(const char *exe_path)
 {
-    char cmd[PATH_MAX + 32];
-    char line[LINE_SIZE];
-    FILE *fp;
     GPtrArray *libs;
+    GHashTable *seen;
+    elf_object_t *exe;
     char *exe_dir;
     
     if (!exe_path)
         return NULL;
     
-    libs = g_ptr_array_new();
+    objects_init();
+    ldcache_load();
     
-    /* Phase 1: Use ldd for ELF-linked dependencies */
-    /* BUG 1 FIX: Use g_shell_quote to prevent command injection */
-    gchar *quoted_path = g_shell_quote(exe_path);
-    snprintf(cmd, sizeof(cmd), "/usr/bin/ldd %s 2>/dev/null", quoted_path);
-    g_free(quoted_path);
+    libs = g_ptr_array_new();
+    seen = g_hash_table_new(g_str_hash, g_str_equal);  /* Keys owned by libs */
     
-    fp = popen(cmd, "r");
-    if (fp) {
-        while (fgets(line, sizeof(line), fp) && libs->len < MAX_LIBS) {
-            char *arrow, *path_start, *path_end;
-            char *lib_path = NULL;
+    /* Phase 1: ELF-linked dependencies (memoized per library) */
+    exe = get_object(exe_path);
+    if (exe && exe->valid) {
+        GPtrArray *deps = object_deps(exe);
+        GPtrArray *closure;
+        
+        /* Warm per-library closures so other apps reuse them */
+        for (guint i = 0; i < deps->len; i++)
+            object_closure(g_ptr_array_index(deps, i));
+        
+        closure = object_closure(exe);
+        for (guint i = 0; i < closure->len && libs->len < MAX_LIBS; i++) {
+            elf_object_t *lib = g_ptr_array_index(closure, i);
             
-            /* Skip virtual libraries */
-            if (strstr(line, "linux-vdso") || 
-                strstr(line, "linux-gate") ||
-                strstr(line, "not found")) {
+            /* Skip the loader, same as the ldd-based scan did */
+            if (is_dynamic_loader(lib->path) || g_hash_table_contains(seen, lib->path))
                 continue;
-            }
             
-            /* Parse " => /path" pattern */
-            arrow = strstr(line, " => ");
-            if (arrow) {
-                path_start = arrow + 4;
-                path_end = strchr(path_start, ' ');
-                if (!path_end) path_end = strchr(path_start, '\n');
-                
-                if (path_end && path_end > path_start) {
-                    lib_path = g_strndup(path_start, path_end - path_start);
-                }
-            } else {
-                /* Direct path: "    /lib64/ld-linux.so" */
-                char *start = line;
-                while (*start == ' ' || *start == '\t') start++;
-                
-                if (*start == '/') {
-                    path_end = strchr(start, ' ');
-                    if (!path_end) path_end = strchr(start, '\n');
-                    
-                    if (path_end && path_end > start) {
-                        lib_path = g_strndup(start, path_end - start);
-                    }
-                }
-            }
-            
-            /* Add valid paths, skip ld-linux */
-            if (lib_path && lib_path[0] == '/' && !strstr(lib_path, "ld-linux")) {
-                g_ptr_array_add(libs, lib_path);
-            } else {
-                g_free(lib_path);
-            }
+            char *copy = g_strdup(lib->path);
+            g_hash_table_add(seen, copy);
+            g_ptr_array_add(libs, copy);
         }
-        pclose(fp);
+    } else {
+        kp_debug("lib_scanner: %s is not a native ELF object", exe_path);
     }
     
     /* Phase 2: Scan executable's directory for .so files (dlopen'd libs) */
     exe_dir = g_path_get_dirname(exe_path);
     if (exe_dir && strcmp(exe_dir, ".") != 0 && strcmp(exe_dir, "/usr/bin") != 0) {
         /* Only scan app-specific dirs like /usr/lib/firefox-esr/, not /usr/bin */
-        scan_dir_for_libs(exe_dir, libs);
+        scan_dir_for_libs(exe_dir, libs, seen);
     }
     g_free(exe_dir);
+    g_hash_table_destroy(seen);
     
     if (libs->len == 0) {
         g_ptr_array_free(libs, TRUE);
@@ -153,7 +886,7 @@ kp_scan_libraries(const char *exe_path)
     
     g_ptr_array_add(libs, NULL);  /* NULL terminator */
     
-    g_debug("lib_scanner: found %u libraries for %s", libs->len - 1, exe_path);
+    kp_debug("lib_scanner: found %u libraries for %s", libs->len - 1, exe_path);
     
     return (char **)g_ptr_array_free(libs, FALSE);
 }
@@ -173,3 +906,24 @@ kp_free_library_list(char **libs)
     g_free(libs);
 }
 
+/**
+ * File ranges the dynamic loader reads from an ELF object
+ */
+GArray *
+kp_elf_load_ranges(const char *path)
+{
+    elf_object_t *obj;
+    GArray *copy;
+
+    if (!path)
+        return NULL;
+
+    objects_init();
+    obj = get_object(path);
+    if (!obj || !obj->loads)
+        return NULL;
+
+    copy = g_array_sized_new(FALSE, FALSE, sizeof(kp_elf_range_t), obj->loads->len);
+    g_array_append_vals(copy, obj->loads->data, obj->loads->len);
+    return copy;
+}
@@ -7,9 +7,22 @@
 #define LIB_SCANNER_H
 
 #include <limits.h>
+#include <stddef.h>
+#include <glib.h>
+
+/* File range the dynamic loader reads from an ELF object */
+typedef struct {
+    size_t offset;
+    size_t length;
+} kp_elf_range_t;
 
 /**
- * Scan executable for shared library dependencies using ldd
+ * Scan executable for shared library dependencies
+ *
+ * Reads the ELF dynamic section in-process (no ldd / fork), resolving
+ * DT_NEEDED through RUNPATH/RPATH, /etc/ld.so.cache and default dirs.
+ * Results are memoized per (dev, inode, mtime), so repeated calls are cheap.
+ *
  * @param exe_path Path to executable
  * @return NULL-terminated array of library paths, or NULL on error
  *         Caller must free with kp_free_library_list()
@@ -21,4 +34,19 @@ char **kp_scan_libraries(const char *exe_path);
  */
 void kp_free_library_list(char **libs);
 
+/**
+ * File ranges the dynamic loader reads from an ELF object
+ *
+ * PT_LOAD segments (page aligned), PT_DYNAMIC and the dynamic symbol,
+ * string and hash tables, sorted and merged. Shares the per-(dev, inode,
+ * mtime) parse cache with kp_scan_libraries().
+ *
+ * @param path File to inspect
+ * @return Newly allocated GArray of kp_elf_range_t (free with
+ *         g_array_free), or NULL if the whole file should be read:
+ *         non-ELF, foreign class, packed, or loaded ranges covering
+ *         nearly all of it
+ */
+GArray *kp_elf_load_ranges(const char *path);
+
 #endif /* LIB_SCANNER_H */
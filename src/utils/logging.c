@@ -37,6 +37,20 @@
  *   On SIGHUP, kp_log_reopen() closes and reopens the log file. This
  *   allows logrotate to rename the old log and create a new one.
  *
+ * LEVEL GATING:
+ *   GLib formats a message before our handler sees its level, so hot
+ *   paths use kp_debug() (logging.h), which tests the level first.
+ *
+ * ASYNCHRONOUS WRITER (kp_log_start_writer, after daemonizing):
+ *
+ *   handler ──format──> ring[LOG_RING_SIZE] ──batch──> writer thread ──> write(2)
+ *                       full: drop + count          one write() per batch
+ *
+ *   A slow /var/log fills the ring instead of stalling the main loop;
+ *   dropped messages are reported once the writer catches up. Fatal
+ *   messages, forked children (which have no writer thread) and messages
+ *   before the writer starts are written synchronously.
+ *
  * =============================================================================
  */
 
@@ -45,6 +59,8 @@
 
 #include <time.h>
 
+#define LOG_RING_SIZE 1024          /* Queued messages before dropping */
+
 /*
  * Default log level.
  * 4 = Standard messages (G_LOG_LEVEL_MESSAGE and above)
@@ -55,6 +71,140 @@
 /* Global log level, accessible by other modules via extern in logging.h */
 int kp_log_level = DEFAULT_LOGLEVEL;
 
+/* Background writer state; lines are only queued from process 'pid' */
+static struct {
+    GMutex lock;
+    GCond cond;
+    GThread *thread;
+    pid_t pid;                      /* Process the writer runs in, 0 = none */
+    gboolean stop;
+    char *ring[LOG_RING_SIZE];      /* Formatted lines, newline included */
+    guint head;                     /* Oldest queued line */
+    guint count;
+    gulong dropped;                 /* Lines lost to a full ring */
+} writer;
+
+/**
+ * write(2) a whole buffer to stderr, retrying on short writes
+ */
+static void
+write_all(const char *buf, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = write(STDERR_FILENO, buf, len);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return;
+        }
+        buf += n;
+        len -= (size_t)n;
+    }
+}
+
+/**
+ * Format a log line: "[Thu Oct 17 12:00:00 2026] domain: message\n"
+ */
+static char *
+format_line(const char *log_domain, const char *message)
+{
+    char timestr[64];
+    time_t curtime = time(NULL);
+    struct tm tm;
+
+    /* ctime() layout, without its static buffer */
+    if (!localtime_r(&curtime, &tm) ||
+        !strftime(timestr, sizeof(timestr), "%a %b %e %H:%M:%S %Y", &tm))
+        g_strlcpy(timestr, "?", sizeof(timestr));
+
+    return g_strdup_printf("[%s] %s%s%s\n",
+                           timestr,
+                           log_domain ? log_domain : "",
+                           log_domain ? ": " : "",
+                           message);
+}
+
+/**
+ * Move queued lines (and a drop notice) into one buffer; lock held
+ */
+static GString *
+take_batch(void)
+{
+    GString *batch = g_string_sized_new(4096);
+
+    while (writer.count) {
+        char *line = writer.ring[writer.head];
+
+        g_string_append(batch, line);
+        g_free(line);
+        writer.head = (writer.head + 1) % LOG_RING_SIZE;
+        writer.count--;
+    }
+    if (writer.dropped) {
+        char *notice = g_strdup_printf("%lu log messages dropped (log writer behind)",
+                                       writer.dropped);
+        char *line = format_line(G_LOG_DOMAIN, notice);
+
+        g_string_append(batch, line);
+        g_free(line);
+        g_free(notice);
+        writer.dropped = 0;
+    }
+    return batch;
+}
+
+static gpointer
+writer_main(gpointer G_GNUC_UNUSED data)
+{
+    g_mutex_lock(&writer.lock);
+    for (;;) {
+        GString *batch;
+
+        while (!writer.count && !writer.dropped && !writer.stop)
+            g_cond_wait(&writer.cond, &writer.lock);
+        if (!writer.count && !writer.dropped && writer.stop)
+            break;
+
+        batch = take_batch();
+        g_mutex_unlock(&writer.lock);
+
+        /* The only blocking part, outside the lock */
+        write_all(batch->str, batch->len);
+        g_string_free(batch, TRUE);
+
+        g_mutex_lock(&writer.lock);
+    }
+    g_mutex_unlock(&writer.lock);
+    return NULL;
+}
+
+/**
+ * Queue a line for the writer thread
+ *
+ * @return FALSE if the writer is stopping (the caller writes it itself)
+ */
+static gboolean
+writer_queue(char *line)
+{
+    gboolean queued = FALSE;
+
+    g_mutex_lock(&writer.lock);
+    if (!writer.stop) {
+        if (writer.count < LOG_RING_SIZE) {
+            writer.ring[(writer.head + writer.count) % LOG_RING_SIZE] = line;
+            writer.count++;
+        } else {
+            writer.dropped++;
+            g_free(line);
+        }
+        g_cond_signal(&writer.cond);
+        queued = TRUE;
+    }
+    g_mutex_unlock(&writer.lock);
+    return queued;
+}
+
 /**
  * GLib log handler callback
  *
@@ -79,20 +229,21 @@ kp_log_handler(const char *log_domain,
                const char *message,
                gpointer G_GNUC_UNUSED user_data)
 {
-    time_t curtime;
-    char *timestr;
+    char *line;
 
     /* Ignore unimportant messages (upstream logic) */
     if (log_level <= G_LOG_LEVEL_ERROR << kp_log_level) {
-        curtime = time(NULL);
-        timestr = ctime(&curtime);
-        timestr[strlen(timestr) - 1] = '\0';  /* Remove trailing newline */
-
-        fprintf(stderr, "[%s] %s%s%s\n",
-                timestr,
-                log_domain ? log_domain : "",
-                log_domain ? ": " : "",
-                message);
+        line = format_line(log_domain, message);
+
+        /* Everything queued goes out before a fatal message */
+        if (log_level & G_LOG_FLAG_FATAL)
+            kp_log_stop_writer();
+
+        /* Forked children have no writer thread, and never take the lock */
+        if (writer.pid != getpid() || !writer_queue(line)) {
+            write_all(line, strlen(line));
+            g_free(line);
+        }
     }
 
     /* Handle fatal errors (upstream logic) */
@@ -149,6 +300,63 @@ kp_log_init(const char *logfile)
     g_log_set_default_handler(kp_log_handler, NULL);
 }
 
+/**
+ * Start the background log writer
+ */
+void
+kp_log_start_writer(void)
+{
+    static gboolean atexit_done = FALSE;
+    GError *error = NULL;
+
+    if (writer.pid == getpid())
+        return;
+
+    g_mutex_init(&writer.lock);
+    g_cond_init(&writer.cond);
+    writer.stop = FALSE;
+    writer.head = writer.count = 0;
+    writer.dropped = 0;
+
+    writer.thread = g_thread_try_new("log-writer", writer_main, NULL, &error);
+    if (!writer.thread) {
+        g_warning("cannot start log writer thread, logging synchronously: %s",
+                  error->message);
+        g_error_free(error);
+        return;
+    }
+    writer.pid = getpid();
+
+    /* Whatever path exit() is reached by, flush the ring first */
+    if (!atexit_done) {
+        atexit(kp_log_stop_writer);
+        atexit_done = TRUE;
+    }
+}
+
+/**
+ * Write out queued messages and stop the background log writer
+ */
+void
+kp_log_stop_writer(void)
+{
+    if (writer.pid != getpid() || !writer.thread)
+        return;
+
+    g_mutex_lock(&writer.lock);
+    writer.stop = TRUE;
+    g_cond_signal(&writer.cond);
+    g_mutex_unlock(&writer.lock);
+
+    /* The fatal path may run on the writer itself; never join yourself */
+    if (g_thread_self() != writer.thread)
+        g_thread_join(writer.thread);
+    else
+        g_thread_unref(writer.thread);
+    writer.thread = NULL;
+    writer.pid = 0;
+}
+
 /**
  * Reopen log file after rotation
  *
@@ -164,8 +372,8 @@ kp_log_init(const char *logfile)
  * @param logfile Path to log file (same as passed to kp_log_init)
  *
  * THREAD SAFETY:
- *   Not thread-safe (uses dup2). Should only be called from signal handler
- *   or main thread when no other threads are actively logging.
+ *   dup2() swaps the descriptor atomically: a batch the writer thread is
+ *   writing goes either to the old or to the new file, never lost.
  */
 void
 kp_log_reopen(const char *logfile)
@@ -38,10 +38,42 @@ void kp_log_init(const char *logfile);
  */
 void kp_log_reopen(const char *logfile);
 
+/**
+ * Start the background log writer
+ *
+ * From then on, messages are queued to a bounded ring buffer and written
+ * to stderr (the log file) in batches by a writer thread. Call after
+ * daemonizing: a forked process does not inherit the thread, and logs
+ * synchronously.
+ */
+void kp_log_start_writer(void);
+
+/**
+ * Write out queued messages and stop the background log writer
+ */
+void kp_log_stop_writer(void);
+
+/**
+ * Check whether messages of a GLib log level will be logged
+ * (same threshold as the log handler)
+ */
+#define kp_log_enabled(level) ((level) <= (G_LOG_LEVEL_ERROR << kp_log_level))
+
 /**
  * Check if debug logging is enabled
  * @return TRUE if debug messages will be logged
  */
-#define kp_is_debugging() (kp_log_level >= G_LOG_LEVEL_DEBUG)
+#define kp_is_debugging() kp_log_enabled(G_LOG_LEVEL_DEBUG)
+
+/**
+ * Level-gated g_debug()
+ *
+ * GLib formats a message before the handler can drop it; this skips the
+ * call, and the evaluation of its arguments, when debug is off.
+ */
+#define kp_debug(...) G_STMT_START {                    \
+    if (kp_is_debugging())                              \
+        g_debug(__VA_ARGS__);                           \
+} G_STMT_END
 
 #endif /* LOGGING_H */
@@ -0,0 +1,24 @@
+/* mountinfo.h - Helpers for /proc/PID/mountinfo parsing
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef MOUNTINFO_H
+#define MOUNTINFO_H
+
+/**
+ * Undo mountinfo's octal escapes in place
+ *
+ * The kernel writes space, tab, newline and backslash in the root and
+ * mount point fields as \040, \011, \012 and \134.
+ *
+ * @param s Field as read from mountinfo, rewritten in place
+ */
+void kp_mountinfo_unescape(char *s);
+
+#endif /* MOUNTINFO_H */
@@ -148,3 +148,304 @@ kp_path_in_directories(const char *path, char **prefixes, int count)
 
     return FALSE;
 }
+
+/*
+ * =============================================================================
+ * COMPILED PATH MATCHER
+ * =============================================================================
+ *
+ * The rule lists above used to be walked linearly for every path: one
+ * strlen+strncmp per mapprefix/exeprefix entry for every line of every
+ * /proc/PID/maps file, and one fnmatch() per excluded pattern for every
+ * hit and miss. kp_path_matcher_t compiles an ordered rule list once (at
+ * config load, so also on SIGHUP) into a byte trie keyed on each rule's
+ * literal prefix:
+ *
+ *   PREFIX rules  "/usr/", "!/"          terminate at the node for the prefix
+ *   DIR rules     "/opt"                 same, plus a '/' or '\0' boundary check
+ *   GLOB rules    "/usr/lib/ *.so"       hang off the node for "/usr/lib/" and
+ *                                        run fnmatch() only once a path reaches it
+ *
+ * Classifying a path is a single walk down the trie. Every node remembers
+ * the lowest rule index in its subtree, so the walk stops as soon as no
+ * deeper rule could beat the best match found so far. The lowest index
+ * wins, which is exactly the old first-match-wins order.
+ *
+ * Matchers created with memoize=TRUE also keep a bounded path → verdict
+ * memo. Repeated lookups for the same binary then cost one hash probe.
+ * The memo is per matcher, so rebuilding on reload drops it implicitly.
+ *
+ * =============================================================================
+ */
+
+/* Memo size cap; the whole memo is dropped when it fills up */
+#define MATCHER_MEMO_MAX 4096
+
+typedef enum {
+    RULE_PREFIX,
+    RULE_DIR,
+    RULE_GLOB
+} rule_kind_t;
+
+typedef struct {
+    rule_kind_t kind;
+    int verdict;
+    char *pattern;      /* Full glob (RULE_GLOB only) */
+    int next;           /* Next rule attached to the same node, -1 ends */
+} matcher_rule_t;
+
+typedef struct {
+    int child;          /* First child node, -1 if leaf */
+    int sibling;        /* Next sibling node, -1 if last */
+    int rules;          /* First rule ending at this node, -1 if none */
+    int min_rule;       /* Lowest rule index in this subtree */
+    guchar byte;        /* Edge label from parent */
+} matcher_node_t;
+
+struct _kp_path_matcher {
+    GArray *nodes;      /* matcher_node_t, node 0 is the root */
+    GArray *rules;      /* matcher_rule_t, in insertion (priority) order */
+    GHashTable *memo;   /* path → winning rule index, NULL unless memoizing */
+};
+
+/**
+ * Find or create the child of a node labelled with byte c
+ */
+static int
+matcher_child(kp_path_matcher_t *m, int parent, guchar c)
+{
+    matcher_node_t node;
+    int idx;
+
+    for (idx = g_array_index(m->nodes, matcher_node_t, parent).child;
+         idx >= 0;
+         idx = g_array_index(m->nodes, matcher_node_t, idx).sibling) {
+        if (g_array_index(m->nodes, matcher_node_t, idx).byte == c)
+            return idx;
+    }
+
+    node.child = -1;
+    node.sibling = g_array_index(m->nodes, matcher_node_t, parent).child;
+    node.rules = -1;
+    node.min_rule = G_MAXINT;
+    node.byte = c;
+    g_array_append_val(m->nodes, node);
+
+    idx = m->nodes->len - 1;
+    g_array_index(m->nodes, matcher_node_t, parent).child = idx;
+    return idx;
+}
+
+/**
+ * Insert a rule under the first len bytes of key
+ */
+static void
+matcher_insert(kp_path_matcher_t *m, const char *key, size_t len,
+               rule_kind_t kind, int verdict, const char *pattern)
+{
+    matcher_rule_t rule;
+    matcher_node_t *node;
+    int rule_idx = m->rules->len;
+    int idx = 0;
+    size_t i;
+
+    /* Rules arrive in priority order, so each node on the way down only
+     * needs its min_rule lowered the first time a rule passes through. */
+    for (i = 0; ; i++) {
+        node = &g_array_index(m->nodes, matcher_node_t, idx);
+        if (rule_idx < node->min_rule)
+            node->min_rule = rule_idx;
+        if (i == len)
+            break;
+        idx = matcher_child(m, idx, (guchar)key[i]);
+    }
+
+    rule.kind = kind;
+    rule.verdict = verdict;
+    rule.pattern = pattern ? g_strdup(pattern) : NULL;
+    rule.next = -1;
+    g_array_append_val(m->rules, rule);
+
+    /* Append at the tail so the per-node chain stays in priority order */
+    node = &g_array_index(m->nodes, matcher_node_t, idx);
+    if (node->rules < 0) {
+        node->rules = rule_idx;
+    } else {
+        int r = node->rules;
+        while (g_array_index(m->rules, matcher_rule_t, r).next >= 0)
+            r = g_array_index(m->rules, matcher_rule_t, r).next;
+        g_array_index(m->rules, matcher_rule_t, r).next = rule_idx;
+    }
+}
+
+/**
+ * Create an empty compiled matcher
+ *
+ * @param memoize  Keep a path → rule memo for repeated lookups
+ * @return         New matcher (free with kp_path_matcher_free)
+ */
+kp_path_matcher_t *
+kp_path_matcher_new(gboolean memoize)
+{
+    kp_path_matcher_t *m = g_new0(kp_path_matcher_t, 1);
+    matcher_node_t root = { -1, -1, -1, G_MAXINT, 0 };
+
+    m->nodes = g_array_new(FALSE, FALSE, sizeof(matcher_node_t));
+    m->rules = g_array_new(FALSE, FALSE, sizeof(matcher_rule_t));
+    g_array_append_val(m->nodes, root);
+
+    if (memoize)
+        m->memo = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+    return m;
+}
+
+/**
+ * Free a compiled matcher
+ */
+void
+kp_path_matcher_free(kp_path_matcher_t *m)
+{
+    guint i;
+
+    if (!m)
+        return;
+
+    for (i = 0; i < m->rules->len; i++)
+        g_free(g_array_index(m->rules, matcher_rule_t, i).pattern);
+
+    g_array_free(m->nodes, TRUE);
+    g_array_free(m->rules, TRUE);
+    if (m->memo)
+        g_hash_table_destroy(m->memo);
+    g_free(m);
+}
+
+/**
+ * Append a plain prefix rule (strncmp semantics, as in mapprefix)
+ */
+void
+kp_path_matcher_add_prefix(kp_path_matcher_t *m, const char *prefix, int verdict)
+{
+    g_return_if_fail(m && prefix);
+    matcher_insert(m, prefix, strlen(prefix), RULE_PREFIX, verdict, NULL);
+}
+
+/**
+ * Append a directory rule (kp_path_in_directories semantics)
+ */
+void
+kp_path_matcher_add_directory(kp_path_matcher_t *m, const char *dir, int verdict)
+{
+    g_return_if_fail(m && dir);
+    matcher_insert(m, dir, strlen(dir), RULE_DIR, verdict, NULL);
+}
+
+/**
+ * Append a glob rule (kp_pattern_match semantics)
+ *
+ * The literal head of the pattern (everything before the first wildcard
+ * or escape) becomes the trie key; fnmatch() only runs on paths sharing
+ * that head.
+ */
+void
+kp_path_matcher_add_glob(kp_path_matcher_t *m, const char *pattern, int verdict)
+{
+    size_t literal;
+
+    g_return_if_fail(m && pattern);
+
+    literal = strcspn(pattern, "*?[\\");
+    matcher_insert(m, pattern, literal, RULE_GLOB, verdict, pattern);
+}
+
+/**
+ * Check the rules attached to one node; return the first that matches
+ */
+static int
+matcher_node_match(const kp_path_matcher_t *m, const matcher_node_t *node,
+                   const char *path, size_t depth, int best)
+{
+    int r;
+
+    for (r = node->rules; r >= 0 && r < best;
+         r = g_array_index(m->rules, matcher_rule_t, r).next) {
+        const matcher_rule_t *rule = &g_array_index(m->rules, matcher_rule_t, r);
+
+        switch (rule->kind) {
+        case RULE_PREFIX:
+            return r;
+        case RULE_DIR:
+            if (path[depth] == '\0' || path[depth] == '/')
+                return r;
+            break;
+        case RULE_GLOB:
+            if (fnmatch(rule->pattern, path, FNM_PATHNAME) == 0)
+                return r;
+            break;
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Classify a path against a compiled matcher
+ *
+ * @param m         Compiled matcher (NULL behaves as an empty rule list)
+ * @param path      Path to classify
+ * @param fallback  Verdict to return when no rule matches
+ * @return          Verdict of the first matching rule in insertion order
+ */
+int
+kp_path_matcher_match(kp_path_matcher_t *m, const char *path, int fallback)
+{
+    const matcher_node_t *node;
+    gpointer memo_hit;
+    int best = G_MAXINT;
+    size_t depth = 0;
+
+    if (!m || !path)
+        return fallback;
+
+    /* The memo stores the winning rule index (or G_MAXINT for "none"),
+     * not the verdict, so it stays valid whatever fallback is passed. */
+    if (m->memo && g_hash_table_lookup_extended(m->memo, path, NULL, &memo_hit)) {
+        best = GPOINTER_TO_INT(memo_hit);
+        goto done;
+    }
+
+    node = &g_array_index(m->nodes, matcher_node_t, 0);
+    for (;;) {
+        int idx;
+
+        /* Nothing at or below this node can beat the current match */
+        if (node->min_rule >= best)
+            break;
+        best = matcher_node_match(m, node, path, depth, best);
+
+        if (path[depth] == '\0')
+            break;
+
+        for (idx = node->child; idx >= 0;
+             idx = g_array_index(m->nodes, matcher_node_t, idx).sibling) {
+            if (g_array_index(m->nodes, matcher_node_t, idx).byte == (guchar)path[depth])
+                break;
+        }
+        if (idx < 0)
+            break;
+
+        node = &g_array_index(m->nodes, matcher_node_t, idx);
+        depth++;
+    }
+
+    if (m->memo) {
+        if (g_hash_table_size(m->memo) >= MATCHER_MEMO_MAX)
+            g_hash_table_remove_all(m->memo);
+        g_hash_table_insert(m->memo, g_strdup(path), GINT_TO_POINTER(best));
+    }
+
+done:
+    return best == G_MAXINT ? fallback
+                            : g_array_index(m->rules, matcher_rule_t, best).verdict;
+}
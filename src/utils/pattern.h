@@ -24,6 +24,12 @@
  *
  * Note: STAR represents * (asterisk wildcard)
  *
+ * COMPILED MATCHERS:
+ *   Hot paths (mapprefix/exeprefix filtering, pool classification) use a
+ *   kp_path_matcher_t built once at config load. Rules are appended in
+ *   priority order; kp_path_matcher_match() returns the verdict of the
+ *   first rule that matches, in a single pass over the path.
+ *
  * =============================================================================
  */
 
@@ -64,4 +70,46 @@ gboolean kp_pattern_matches_any(const char *path, char **patterns, int count);
  */
 gboolean kp_path_in_directories(const char *path, char **prefixes, int count);
 
+/* Opaque compiled rule list (prefix trie + anchored globs) */
+typedef struct _kp_path_matcher kp_path_matcher_t;
+
+/**
+ * Create an empty compiled matcher
+ *
+ * @param memoize Keep a bounded path → result memo for repeated lookups
+ * @return New matcher, free with kp_path_matcher_free()
+ */
+kp_path_matcher_t *kp_path_matcher_new(gboolean memoize);
+
+/**
+ * Free a compiled matcher (NULL-safe)
+ */
+void kp_path_matcher_free(kp_path_matcher_t *m);
+
+/**
+ * Append a rule matching paths that start with prefix (strncmp semantics)
+ */
+void kp_path_matcher_add_prefix(kp_path_matcher_t *m, const char *prefix, int verdict);
+
+/**
+ * Append a rule matching dir itself and anything below it
+ * (same boundary rules as kp_path_in_directories)
+ */
+void kp_path_matcher_add_directory(kp_path_matcher_t *m, const char *dir, int verdict);
+
+/**
+ * Append a glob rule (same semantics as kp_pattern_match)
+ */
+void kp_path_matcher_add_glob(kp_path_matcher_t *m, const char *pattern, int verdict);
+
+/**
+ * Classify a path
+ *
+ * @param m Compiled matcher (NULL acts as an empty rule list)
+ * @param path Path to classify
+ * @param fallback Verdict returned when no rule matches
+ * @return Verdict of the first matching rule, in insertion order
+ */
+int kp_path_matcher_match(kp_path_matcher_t *m, const char *path, int fallback);
+
 #endif /* PATTERN_H */
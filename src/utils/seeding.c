@@ -8,11 +8,36 @@
  * - Shell history (bash/zsh)
  *
  * Provides immediate value on first daemon start.
+ *
+ * =============================================================================
+ * PIPELINE
+ * =============================================================================
+ *
+ * Seeders do many access()/stat()/fopen() calls on what is usually a cold
+ * disk, so they no longer run serially on the main thread:
+ *
+ *   ┌──────────────┐    seed_record_t     ┌──────────────────────────┐
+ *   │ thread pool  │ ──(path, score)───▶  │ GAsyncQueue              │
+ *   │ (producers)  │                      └────────────┬─────────────┘
+ *   └──────────────┘                                   │ main loop timer
+ *                                                      ▼
+ *                                         merge_record() → kp_state->exes
+ *
+ * - Producers never touch kp_state; only the main-loop consumer does
+ * - All producers share a wall-clock budget and a filesystem-probe budget;
+ *   once either is spent, remaining producers stop early
+ * - The daemon's first prediction tick runs on whatever has been merged so
+ *   far, and later ticks improve as records stream in
+ * - New exes are classified when merged, and the priority mesh is rebuilt
+ *   once all producers are done: both already ran at startup
+ *
+ * =============================================================================
  */
 
 #include "common.h"
 #include "seeding.h"
 #include "../state/state.h"
+#include "../daemon/stats.h"
 #include "logging.h"
 
 #include <sys/stat.h>
@@ -23,6 +48,88 @@
 #include <dirent.h>
 #include "desktop.h"
 
+#define SEED_THREADS            3       /* Worker threads for producers */
+#define SEED_TIME_BUDGET_SEC    30      /* Wall-clock budget for all producers */
+#define SEED_IO_BUDGET          5000    /* Max filesystem probes (stat/access/open) */
+#define SEED_MERGE_INTERVAL_MS  50      /* Consumer dispatch interval */
+#define SEED_MERGE_BATCH        64      /* Max records merged per dispatch */
+
+/* Seed sources (index into by_source[] summary) */
+typedef enum {
+    SEED_XDG_RECENT = 0,
+    SEED_DESKTOP_TIMES,
+    SEED_SHELL_HISTORY,
+    SEED_BROWSER_PROFILES,
+    SEED_DEV_TOOLS,
+    SEED_SYSTEM_PATTERNS,
+    SEED_N_SOURCES
+} seed_source_t;
+
+/**
+ * Candidate produced by a seeder
+ */
+typedef struct {
+    char *path;             /* Executable path, NULL = end-of-source marker */
+    double score;           /* Added to weighted_launches */
+    int raw;                /* Added to raw_launches */
+    gboolean desktop_only;  /* New exe only if it has a .desktop file */
+    seed_source_t source;
+} seed_record_t;
+
+/* Pipeline state */
+static struct {
+    GThreadPool *pool;
+    GAsyncQueue *queue;     /* seed_record_t* from producers */
+    guint merge_source;     /* Main-loop consumer timer */
+    gint64 deadline;        /* Monotonic time (µs) producers must stop by */
+    gint io_used;           /* Filesystem probes spent (atomic) */
+    gint cancelled;         /* Set on shutdown (atomic) */
+    int sources_pending;    /* Producers not yet finished (main thread) */
+    int by_source[SEED_N_SOURCES];
+    gint64 started;
+} seeder;
+
+/**
+ * Charge one filesystem probe against the budget
+ *
+ * @return FALSE once the time/IO budget is spent or seeding was cancelled;
+ *         producers must stop scanning when this happens
+ */
+static gboolean
+seed_probe(void)
+{
+    if (g_atomic_int_get(&seeder.cancelled))
+        return FALSE;
+    if (g_get_monotonic_time() > seeder.deadline)
+        return FALSE;
+    return g_atomic_int_add(&seeder.io_used, 1) < SEED_IO_BUDGET;
+}
+
+/**
+ * Hand a candidate to the consumer (any thread)
+ */
+static void
+seed_emit(seed_source_t source, const char *path, double score, int raw,
+          gboolean desktop_only)
+{
+    seed_record_t *rec = g_new0(seed_record_t, 1);
+
+    rec->path = path ? g_strdup(path) : NULL;
+    rec->score = score;
+    rec->raw = raw;
+    rec->desktop_only = desktop_only;
+    rec->source = source;
+    g_async_queue_push(seeder.queue, rec);
+}
+
+static void
+seed_record_free(gpointer data)
+{
+    seed_record_t *rec = data;
+    g_free(rec->path);
+    g_free(rec);
+}
+
 /* Seed from XDG recently-used files */
 static int
 kp_seed_from_xdg_recent(void)
@@ -35,9 +142,11 @@ kp_seed_from_xdg_recent(void)
     
     /* XDG recently-used is at ~/.local/share/recently-used.xbel */
     snprintf(xbel_path, sizeof(xbel_path), "%s/.local/share/recently-used.xbel", home);
+    if (!seed_probe())
+        return 0;
     fp = fopen(xbel_path, "r");
     if (!fp) {
-        g_debug("XDG recently-used file not found: %s", xbel_path);
+        kp_debug("XDG recently-used file not found: %s", xbel_path);
         return 0;
     }
     
@@ -58,31 +167,25 @@ kp_seed_from_xdg_recent(void)
             exec_line[len] = '\0';
             
             /* Extract first word (the actual binary) */
-            char *app_path = strtok(exec_line, " ");
+            char *saveptr = NULL;
+            char *app_path = strtok_r(exec_line, " ", &saveptr);
             if (!app_path || app_path[0] != '/') continue;
             
             /* Check if file exists */
+            if (!seed_probe()) break;
             if (access(app_path, X_OK) != 0) continue;
             
             /* Calculate score based on recency */
             double score = 5.0;  /* Base score for being in recently-used */
             
-            /* Check if exe already exists */
-            kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, app_path);
-            if (!exe) {
-                exe = kp_exe_new(app_path, FALSE, NULL);
-                exe->pool = POOL_PRIORITY;  /* Recently used = priority */
-                kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-            }
-            
-            exe->weighted_launches += score;
-            exe->raw_launches += 1;
+            /* Recently used = priority */
+            seed_emit(SEED_XDG_RECENT, app_path, score, 1, FALSE);
             seeded++;
         }
     }
     
     fclose(fp);
-    g_debug("Seeded %d apps from XDG recently-used", seeded);
+    kp_debug("Found %d apps in XDG recently-used", seeded);
     return seeded;
 }
 
@@ -107,17 +210,20 @@ kp_seed_from_desktop_times(void)
         const char *dir = (d < 2) ? desktop_dirs[d] : (d == 2 ? user_apps : NULL);
         if (!dir) break;
         
+        if (!seed_probe()) break;
         DIR *dp = opendir(dir);
         if (!dp) continue;
         
         struct dirent *entry;
-        while ((entry = readdir(dp))) {
+        gboolean budget_left = TRUE;
+        while (budget_left && (entry = readdir(dp))) {
             if (!g_str_has_suffix(entry->d_name, ".desktop")) continue;
             
             char desktop_path[PATH_MAX];
             struct stat st;
             snprintf(desktop_path, sizeof(desktop_path), "%s/%s", dir, entry->d_name);
             
+            if (!(budget_left = seed_probe())) break;
             if (stat(desktop_path, &st) != 0) continue;
             
             /* Calculate age in days */
@@ -130,6 +236,7 @@ kp_seed_from_desktop_times(void)
             double score = 3.0 * exp(-days_ago / 60.0);
             
             /* Parse desktop file to extract Exec= line */
+            if (!(budget_left = seed_probe())) break;
             FILE *desktop_fp = fopen(desktop_path, "r");
             if (!desktop_fp) continue;
             
@@ -157,16 +264,18 @@ kp_seed_from_desktop_times(void)
             strncpy(exec_copy, exec_value, sizeof(exec_copy) - 1);
             exec_copy[sizeof(exec_copy) - 1] = '\0';
             
-            char *binary = strtok(exec_copy, " ");
+            char *saveptr = NULL;
+            char *binary = strtok_r(exec_copy, " ", &saveptr);
             if (!binary) continue;
             
             /* Resolve to full path if needed */
             char full_path[PATH_MAX];
             if (binary[0] == '/') {
                 /* Already absolute path */
-                strncpy(full_path, binary, sizeof(full_path) - 1);
+                g_strlcpy(full_path, binary, sizeof(full_path));
             } else {
                 /* Search in PATH */
+                if (!(budget_left = seed_probe())) break;
                 snprintf(full_path, sizeof(full_path), "/usr/bin/%s", binary);
                 if (access(full_path, X_OK) != 0) {
                     snprintf(full_path, sizeof(full_path), "/bin/%s", binary);
@@ -183,22 +292,15 @@ kp_seed_from_desktop_times(void)
                 continue;  /* Skip wrapper scripts, we want the actual app */
             }
             
-            /* Seed the app */
-            kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, full_path);
-            if (!exe) {
-                exe = kp_exe_new(full_path,FALSE, NULL);
-                exe->pool = POOL_PRIORITY;  /* Desktop apps = priority */
-                kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-            }
-            
-            exe->weighted_launches += score;
-            exe->raw_launches += 1;
+            /* Seed the app (desktop apps = priority) */
+            seed_emit(SEED_DESKTOP_TIMES, full_path, score, 1, FALSE);
             seeded++;
         }
         closedir(dp);
+        if (!budget_left) break;
     }
     
-    g_debug("Seeded %d apps from desktop file times", seeded);
+    kp_debug("Found %d apps from desktop file times", seeded);
     return seeded;
 }
 
@@ -221,11 +323,13 @@ kp_seed_from_shell_history(void)
         char line[1024];
         
         snprintf(history_path, sizeof(history_path), "%s%s", home, history_files[i]);
+        if (!seed_probe()) break;
         fp = fopen(history_path, "r");
         if (!fp) continue;
         
         while (fgets(line, sizeof(line), fp)) {
-            char *cmd = strtok(line, " \t\n");
+            char *saveptr = NULL;
+            char *cmd = strtok_r(line, " \t\n", &saveptr);
             if (!cmd || cmd[0] == '#') continue;
             
             /* Skip common non-apps */
@@ -249,9 +353,9 @@ kp_seed_from_shell_history(void)
         const char *cmd = key;
         int count = GPOINTER_TO_INT(value);
         char full_path[PATH_MAX];
-        kp_exe_t *exe;
         
         /* Try to resolve command to full path */
+        if (!seed_probe()) break;
         snprintf(full_path, sizeof(full_path), "/usr/bin/%s", cmd);
         if (access(full_path, X_OK) != 0) {
             snprintf(full_path, sizeof(full_path), "/bin/%s", cmd);
@@ -260,27 +364,16 @@ kp_seed_from_shell_history(void)
             }
         }
         
-        /* Check if exe already exists */
-        exe = g_hash_table_lookup(kp_state->exes, full_path);
-        if (!exe) {
-            /* FILTER: Only seed apps with .desktop files (skip CLI tools) */
-            if (!kp_desktop_has_file(full_path)) {
-                continue;  /* Skip CLI tools like grep, ls, exec-in-shell */
-            }
-            exe = kp_exe_new(full_path, FALSE, NULL);
-            exe->pool = POOL_PRIORITY;  /* Desktop apps are us  er-initiated */
-            kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-        }
-        
+        /* FILTER: New exes only if they have .desktop files (skip CLI tools
+         * like grep, ls, exec-in-shell). Checked by the consumer, since the
+         * desktop index belongs to the main thread. */
         /* Score: sqrt to prevent domination by very frequent commands */
-        /* BUG FIX: Use += to accumulate, not = which clobbers prior seeding */
-        exe->weighted_launches += sqrt((double)count);
-        exe->raw_launches += count;
+        seed_emit(SEED_SHELL_HISTORY, full_path, sqrt((double)count), count, TRUE);
         seeded++;
     }
     
     g_hash_table_destroy(cmd_counts);
-    g_debug("Seeded %d apps from shell history", seeded);
+    kp_debug("Found %d commands in shell history", seeded);
     return seeded;
 }
 
@@ -311,34 +404,27 @@ kp_seed_from_browser_profiles(void)
         snprintf(profile_full, sizeof(profile_full), "%s/%s", home, browsers[i].profile_path);
         
         /* Check if profile directory exists and was accessed recently */
+        if (!seed_probe()) break;
         if (stat(profile_full, &st) == 0 && S_ISDIR(st.st_mode)) {
             double days_ago = (double)(now - st.st_mtime) / 86400.0;
             
             /* Only seed if used within last 30 days */
             if (days_ago <= 30) {
                 /* Check if browser binary exists */
-                if (access(browsers[i].binary_path, X_OK) == 0) {
-                    kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, browsers[i].binary_path);
-                    if (!exe) {
-                        exe = kp_exe_new(browsers[i].binary_path, FALSE, NULL);
-                        exe->pool = POOL_PRIORITY;
-                        kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                    }
-                    
+                if (seed_probe() && access(browsers[i].binary_path, X_OK) == 0) {
                     /* Score based on recency: 10.0 * exp(-days/15) */
                     double score = 10.0 * exp(-days_ago / 15.0);
-                    exe->weighted_launches += score;
-                    exe->raw_launches += 1;
+                    seed_emit(SEED_BROWSER_PROFILES, browsers[i].binary_path, score, 1, FALSE);
                     seeded++;
                     
-                    g_debug("Seeded browser: %s (profile age: %.1f days, score: %.2f)", 
+                    kp_debug("Seeded browser: %s (profile age: %.1f days, score: %.2f)", 
                            browsers[i].name, days_ago, score);
                 }
             }
         }
     }
     
-    g_debug("Seeded %d browsers from profile detection", seeded);
+    kp_debug("Found %d browsers from profile detection", seeded);
     return seeded;
 }
 
@@ -360,72 +446,237 @@ kp_seed_from_dev_tools(void)
     
     for (int i = 0; dev_tools[i]; i++) {
         /* Check if tool exists and was accessed recently */
+        if (!seed_probe()) break;
         if (stat(dev_tools[i], &st) == 0) {
             double days_ago = (double)(now - st.st_atime) / 86400.0;
             
             /* Only seed if accessed within last 60 days */
             if (days_ago <= 60) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, dev_tools[i]);
-                if (!exe) {
-                    exe = kp_exe_new(dev_tools[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                
                 /* Fixed score for dev tools */
                 double score = 4.0;
-                exe->weighted_launches += score;
-                exe->raw_launches += 1;
+                seed_emit(SEED_DEV_TOOLS, dev_tools[i], score, 1, FALSE);
                 seeded++;
             }
         }
     }
     
-    g_debug("Seeded %d developer tools", seeded);
+    kp_debug("Found %d developer tools", seeded);
     return seeded;
 }
 
+static int kp_seed_from_system_patterns(void);
+
 /**
- * Seed initial state from all available sources
+ * Producer job: run one seeder, then post its end-of-source marker
  */
-static int kp_seed_from_system_patterns(void);
+static void
+seed_job(gpointer data, gpointer user_data)
+{
+    seed_source_t source = GPOINTER_TO_INT(data) - 1;  /* +1: pool data can't be NULL */
 
-void
-kp_seed_from_sources(void)
+    (void)user_data;
+
+    switch (source) {
+        case SEED_XDG_RECENT:       kp_seed_from_xdg_recent(); break;
+        case SEED_DESKTOP_TIMES:    kp_seed_from_desktop_times(); break;
+        case SEED_SHELL_HISTORY:    kp_seed_from_shell_history(); break;
+        case SEED_BROWSER_PROFILES: kp_seed_from_browser_profiles(); break;
+        case SEED_SYSTEM_PATTERNS:  kp_seed_from_system_patterns(); break;
+        default: break;
+    }
+
+    seed_emit(source, NULL, 0, 0, FALSE);
+}
+
+/**
+ * Merge one candidate into the model (main thread only)
+ */
+static void
+merge_record(const seed_record_t *rec)
+{
+    kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, rec->path);
+
+    if (!exe) {
+        if (rec->desktop_only && !kp_desktop_has_file(rec->path))
+            return;
+        exe = kp_exe_new(rec->path, FALSE, NULL);
+        /* Startup reclassification has run by now: classify it the same
+         * way (cached per generation) */
+        kp_stats_refresh_exe(exe);
+        exe->pool = exe->class_pool;
+        kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
+    }
+
+    /* Accumulate: several sources may vouch for the same app */
+    exe->weighted_launches += rec->score;
+    exe->raw_launches += rec->raw;
+    kp_state->dirty = TRUE;
+    seeder.by_source[rec->source]++;
+}
+
+/**
+ * Log seeding summary once all producers are done
+ */
+static void
+seed_report(void)
 {
     int total_seeded = 0;
-    int by_source[6] = {0};
-    
-    g_message("=== Smart First-Run Seeding ===");
-    g_message("Analyzing user data to populate initial state...");
-    
-    by_source[0] = kp_seed_from_xdg_recent();
-    by_source[1] = kp_seed_from_desktop_times();
-    by_source[2] = kp_seed_from_shell_history();
-    by_source[3] = kp_seed_from_browser_profiles();
-    /* Disabled: dev_tools are mostly CLI without .desktop files */
-    by_source[4] = 0;  /* kp_seed_from_dev_tools(); */
-    by_source[5] = kp_seed_from_system_patterns();
-    
-    for (int i = 0; i < 6; i++) {
-        total_seeded += by_source[i];
+
+    for (int i = 0; i < SEED_N_SOURCES; i++) {
+        total_seeded += seeder.by_source[i];
     }
-    
+
     if (total_seeded > 0) {
-        g_message("Successfully seeded %d applications:", total_seeded);
-        g_message("  • XDG recently-used: %d apps", by_source[0]);
-        g_message("  • Desktop files: %d apps", by_source[1]);
-        g_message("  • Shell history: %d apps", by_source[2]);
-        g_message("  • Browser profiles: %d apps", by_source[3]);
-        g_message("  • Developer tools: %d apps", by_source[4]);
-        g_message("  • System defaults: %d apps", by_source[5]);
+        g_message("Successfully seeded %d applications in %.1fs (%d fs probes):",
+                  total_seeded,
+                  (g_get_monotonic_time() - seeder.started) / (double)G_USEC_PER_SEC,
+                  MIN(g_atomic_int_get(&seeder.io_used), SEED_IO_BUDGET));
+        g_message("  • XDG recently-used: %d apps", seeder.by_source[SEED_XDG_RECENT]);
+        g_message("  • Desktop files: %d apps", seeder.by_source[SEED_DESKTOP_TIMES]);
+        g_message("  • Shell history: %d apps", seeder.by_source[SEED_SHELL_HISTORY]);
+        g_message("  • Browser profiles: %d apps", seeder.by_source[SEED_BROWSER_PROFILES]);
+        g_message("  • Developer tools: %d apps", seeder.by_source[SEED_DEV_TOOLS]);
+        g_message("  • System defaults: %d apps", seeder.by_source[SEED_SYSTEM_PATTERNS]);
         g_message("Preheat is now ready with intelligent defaults!");
     } else {
         g_message("No seeding data available - will learn from your usage");
     }
+    if (g_atomic_int_get(&seeder.io_used) >= SEED_IO_BUDGET ||
+        g_get_monotonic_time() > seeder.deadline) {
+        g_message("Seeding budget exhausted; remaining sources were cut short");
+    }
     g_message("===============================");
 }
 
+/**
+ * Merge up to max queued records, counting end-of-source markers
+ */
+static void
+seed_merge_batch(int max)
+{
+    seed_record_t *rec;
+    int merged = 0;
+
+    while (merged < max && (rec = g_async_queue_try_pop(seeder.queue)) != NULL) {
+        if (rec->path) {
+            merge_record(rec);
+            merged++;
+        } else {
+            seeder.sources_pending--;
+        }
+        seed_record_free(rec);
+    }
+}
+
+/**
+ * Main-loop consumer: merge a batch of records per dispatch
+ */
+static gboolean
+seed_merge_tick(gpointer data)
+{
+    (void)data;
+
+    seed_merge_batch(SEED_MERGE_BATCH);
+
+    if (seeder.sources_pending > 0 || g_async_queue_length(seeder.queue) > 0)
+        return G_SOURCE_CONTINUE;
+
+    /* All producers finished and queue drained */
+    g_thread_pool_free(seeder.pool, FALSE, TRUE);
+    seeder.pool = NULL;
+    g_async_queue_unref(seeder.queue);
+    seeder.queue = NULL;
+    seeder.merge_source = 0;
+
+    seed_report();
+
+    /* The startup mesh was built before these exes were merged */
+    kp_markov_build_priority_mesh();
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * Seed initial state from all available sources
+ *
+ * Starts the background pipeline and returns immediately; results are
+ * merged into kp_state->exes from the main loop as they arrive.
+ */
+void
+kp_seed_from_sources(void)
+{
+    static const seed_source_t sources[] = {
+        SEED_XDG_RECENT,
+        SEED_DESKTOP_TIMES,
+        SEED_SHELL_HISTORY,
+        SEED_BROWSER_PROFILES,
+        /* Disabled: dev_tools are mostly CLI without .desktop files
+         * (kp_seed_from_dev_tools) */
+        SEED_SYSTEM_PATTERNS,
+    };
+    GError *error = NULL;
+
+    if (seeder.pool) {
+        kp_debug("Seeding already in progress");
+        return;
+    }
+
+    g_message("=== Smart First-Run Seeding ===");
+    g_message("Analyzing user data to populate initial state (in background)...");
+
+    memset(seeder.by_source, 0, sizeof(seeder.by_source));
+    g_atomic_int_set(&seeder.io_used, 0);
+    g_atomic_int_set(&seeder.cancelled, 0);
+    seeder.started = g_get_monotonic_time();
+    seeder.deadline = seeder.started + (gint64)SEED_TIME_BUDGET_SEC * G_USEC_PER_SEC;
+    seeder.queue = g_async_queue_new_full(seed_record_free);
+
+    seeder.pool = g_thread_pool_new(seed_job, NULL, SEED_THREADS, FALSE, &error);
+    if (!seeder.pool) {
+        /* No threads: run producers inline, consumer still merges */
+        g_warning("Cannot start seeding threads: %s (seeding inline)", error->message);
+        g_error_free(error);
+        seeder.sources_pending = G_N_ELEMENTS(sources);
+        for (guint i = 0; i < G_N_ELEMENTS(sources); i++)
+            seed_job(GINT_TO_POINTER(sources[i] + 1), NULL);
+        seed_merge_batch(G_MAXINT);
+        g_async_queue_unref(seeder.queue);
+        seeder.queue = NULL;
+        seed_report();
+        return;
+    }
+
+    seeder.sources_pending = 0;
+    for (guint i = 0; i < G_N_ELEMENTS(sources); i++) {
+        if (g_thread_pool_push(seeder.pool, GINT_TO_POINTER(sources[i] + 1), NULL))
+            seeder.sources_pending++;
+    }
+
+    seeder.merge_source = g_timeout_add(SEED_MERGE_INTERVAL_MS, seed_merge_tick, NULL);
+}
+
+/**
+ * Stop background seeding (shutdown)
+ */
+void
+kp_seed_shutdown(void)
+{
+    if (!seeder.pool)
+        return;
+
+    g_atomic_int_set(&seeder.cancelled, 1);
+    g_thread_pool_free(seeder.pool, TRUE, TRUE);   /* Drop queued jobs, join running */
+    seeder.pool = NULL;
+
+    if (seeder.merge_source) {
+        g_source_remove(seeder.merge_source);
+        seeder.merge_source = 0;
+    }
+
+    g_async_queue_unref(seeder.queue);             /* Frees unmerged records */
+    seeder.queue = NULL;
+    kp_debug("Seeding cancelled");
+}
+
 /* Seed system-specific default apps based on desktop environment */
 static int
 kp_seed_from_system_patterns(void)
@@ -436,7 +687,7 @@ kp_seed_from_system_patterns(void)
     
     /* Detect desktop environment */
     const char *de = desktop ? desktop : (session ? session : "unknown");
-    g_debug("Detected desktop environment: %s", de);
+    kp_debug("Detected desktop environment: %s", de);
     
     /* GNOME defaults */
     if (strstr(de, "GNOME") || strstr(de, "gnome")) {
@@ -448,16 +699,9 @@ kp_seed_from_system_patterns(void)
         };
         
         for (int i = 0; gnome_apps[i]; i++) {
+            if (!seed_probe()) break;
             if (access(gnome_apps[i], X_OK) == 0) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, gnome_apps[i]);
-                if (!exe) {
-                    exe = kp_exe_new(gnome_apps[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                /* BUG FIX: Use += to accumulate, not = which clobbers prior data */
-                exe->weighted_launches += 3.0;
-                exe->raw_launches += 1;
+                seed_emit(SEED_SYSTEM_PATTERNS, gnome_apps[i], 3.0, 1, FALSE);
                 seeded++;
             }
         }
@@ -473,16 +717,9 @@ kp_seed_from_system_patterns(void)
         };
         
         for (int i = 0; kde_apps[i]; i++) {
+            if (!seed_probe()) break;
             if (access(kde_apps[i], X_OK) == 0) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, kde_apps[i]);
-                if (!exe) {
-                    exe = kp_exe_new(kde_apps[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                /* BUG FIX: Use += to accumulate */
-                exe->weighted_launches += 3.0;
-                exe->raw_launches += 1;
+                seed_emit(SEED_SYSTEM_PATTERNS, kde_apps[i], 3.0, 1, FALSE);
                 seeded++;
             }
         }
@@ -497,22 +734,15 @@ kp_seed_from_system_patterns(void)
         };
         
         for (int i = 0; xfce_apps[i]; i++) {
+            if (!seed_probe()) break;
             if (access(xfce_apps[i], X_OK) == 0) {
-                kp_exe_t *exe = g_hash_table_lookup(kp_state->exes, xfce_apps[i]);
-                if (!exe) {
-                    exe = kp_exe_new(xfce_apps[i], FALSE, NULL);
-                    exe->pool = POOL_PRIORITY;
-                    kp_state_register_exe(exe, exe->pool == POOL_PRIORITY);
-                }
-                /* BUG FIX: Use += to accumulate */
-                exe->weighted_launches += 3.0;
-                exe->raw_launches += 1;
+                seed_emit(SEED_SYSTEM_PATTERNS, xfce_apps[i], 3.0, 1, FALSE);
                 seeded++;
             }
         }
     }
     
-    g_debug("Seeded %d system-specific apps for %s", seeded, de);
+    kp_debug("Found %d system-specific apps for %s", seeded, de);
     return seeded;
 }
 
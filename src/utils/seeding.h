@@ -14,7 +14,16 @@
 /**
  * Seed initial state from user data sources
  * Called on first run when state file is missing or empty
+ *
+ * Returns immediately: seeders run on a small thread pool and their results
+ * are merged into kp_state->exes from the main loop as they arrive.
  */
 void kp_seed_from_sources(void);
 
+/**
+ * Stop background seeding
+ * Called at shutdown before the state is saved/freed. Safe if idle.
+ */
+void kp_seed_shutdown(void);
+
 #endif /* SEEDING_H */
@@ -0,0 +1,165 @@
+/* spsc.c - Lock-free single-producer/single-consumer queue for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * =============================================================================
+ * MODULE OVERVIEW: SPSC Queue
+ * =============================================================================
+ *
+ * Connects two pipeline stages (pipeline.c). Exactly one thread pushes and
+ * exactly one thread pops, so a ring of pointers with two free-running
+ * indices needs no lock:
+ *
+ *          head (consumer writes)        tail (producer writes)
+ *            │                             │
+ *   slots: [ . | m1 | m2 | m3 | . | . | . | . ]     size = tail - head
+ *
+ *   push:  full if tail - head == capacity; store slot; publish tail
+ *   pop:   empty if head == tail; load slot; publish head
+ *
+ * The index stores and loads are GLib atomics (full barriers), so a slot
+ * is written before the tail that publishes it, and read before the head
+ * that frees it. Messages are handed over, never shared: after a push the
+ * producer must not touch the message again.
+ *
+ * WAKEUPS:
+ *   An eventfd counts pushes. Threads block in kp_spsc_wait(); the main
+ *   loop watches kp_spsc_fd(). The consumer clears the eventfd BEFORE
+ *   draining, so a push racing with the drain always leaves it readable.
+ *
+ * =============================================================================
+ */
+
+#include "common.h"
+#include "spsc.h"
+
+#include <poll.h>
+#include <sys/eventfd.h>
+
+struct _kp_spsc_t
+{
+    guint mask;             /* capacity - 1 */
+    gint head;              /* Next slot to pop (written by the consumer) */
+    gint tail;              /* Next slot to push (written by the producer) */
+    int fd;                 /* eventfd, readable while wakeups are pending */
+    gpointer slots[];
+};
+
+kp_spsc_t *
+kp_spsc_new(guint capacity)
+{
+    kp_spsc_t *q;
+    guint size = 1;
+    int fd;
+
+    while (size < MAX(capacity, 2))
+        size <<= 1;
+
+    fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    q = g_malloc0(sizeof(*q) + size * sizeof(gpointer));
+    q->mask = size - 1;
+    q->fd = fd;
+    return q;
+}
+
+void
+kp_spsc_free(kp_spsc_t *q, GDestroyNotify free_func)
+{
+    gpointer msg;
+
+    if (!q)
+        return;
+
+    while ((msg = kp_spsc_pop(q)))
+        if (free_func)
+            free_func(msg);
+    close(q->fd);
+    g_free(q);
+}
+
+gboolean
+kp_spsc_push(kp_spsc_t *q, gpointer msg)
+{
+    guint tail = (guint)q->tail;
+    guint head = (guint)g_atomic_int_get(&q->head);
+
+    g_return_val_if_fail(msg, FALSE);
+
+    if (tail - head > q->mask)
+        return FALSE;
+
+    q->slots[tail & q->mask] = msg;
+    g_atomic_int_set(&q->tail, (gint)(tail + 1));
+
+    kp_spsc_wake(q);
+    return TRUE;
+}
+
+gpointer
+kp_spsc_pop(kp_spsc_t *q)
+{
+    guint head = (guint)q->head;
+    gpointer msg;
+
+    if (head == (guint)g_atomic_int_get(&q->tail))
+        return NULL;
+
+    msg = q->slots[head & q->mask];
+    q->slots[head & q->mask] = NULL;
+    g_atomic_int_set(&q->head, (gint)(head + 1));
+    return msg;
+}
+
+int
+kp_spsc_fd(kp_spsc_t *q)
+{
+    return q->fd;
+}
+
+void
+kp_spsc_clear(kp_spsc_t *q)
+{
+    guint64 count;
+    ssize_t n G_GNUC_UNUSED;
+
+    n = read(q->fd, &count, sizeof(count));
+}
+
+gboolean
+kp_spsc_wait(kp_spsc_t *q, int timeout_ms)
+{
+    struct pollfd pfd;
+    int ret;
+
+    pfd.fd = q->fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    do
+        ret = poll(&pfd, 1, timeout_ms);
+    while (ret < 0 && errno == EINTR);
+
+    if (ret <= 0)
+        return FALSE;
+
+    kp_spsc_clear(q);
+    return TRUE;
+}
+
+void
+kp_spsc_wake(kp_spsc_t *q)
+{
+    guint64 one = 1;
+    ssize_t n G_GNUC_UNUSED;
+
+    /* Only fails when the counter would overflow: it is readable anyway */
+    n = write(q->fd, &one, sizeof(one));
+}
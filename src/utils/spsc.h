@@ -0,0 +1,74 @@
+/* spsc.h - Lock-free single-producer/single-consumer queue for Preheat
+ *
+ * Copyright (C) 2025 Preheat Contributors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ */
+
+#ifndef SPSC_H
+#define SPSC_H
+
+#include <glib.h>
+
+typedef struct _kp_spsc_t kp_spsc_t;
+
+/**
+ * Create a queue
+ *
+ * @param capacity Messages it holds at most (rounded up to a power of 2)
+ * @return New queue, or NULL if no eventfd could be created
+ */
+kp_spsc_t *kp_spsc_new(guint capacity);
+
+/**
+ * Free a queue and, with free_func, the messages still in it
+ *
+ * Neither side may use the queue any more.
+ */
+void kp_spsc_free(kp_spsc_t *q, GDestroyNotify free_func);
+
+/**
+ * Append a message (producer thread only)
+ *
+ * @return FALSE if the queue is full; the message stays the caller's
+ */
+gboolean kp_spsc_push(kp_spsc_t *q, gpointer msg);
+
+/**
+ * Take the oldest message (consumer thread only)
+ *
+ * @return The message, or NULL if the queue is empty
+ */
+gpointer kp_spsc_pop(kp_spsc_t *q);
+
+/**
+ * File descriptor that is readable after a push or kp_spsc_wake(),
+ * for watching the queue from a main loop (consumer side)
+ */
+int kp_spsc_fd(kp_spsc_t *q);
+
+/**
+ * Wait until the queue was pushed to or woken (consumer side)
+ *
+ * Clears the wakeup; pop until NULL afterwards.
+ *
+ * @param timeout_ms Milliseconds to wait at most, -1 for no limit
+ * @return FALSE on timeout
+ */
+gboolean kp_spsc_wait(kp_spsc_t *q, int timeout_ms);
+
+/**
+ * Clear a pending wakeup without waiting (consumer side, after kp_spsc_fd
+ * became readable)
+ */
+void kp_spsc_clear(kp_spsc_t *q);
+
+/**
+ * Wake the consumer without a message (e.g. to make it check a stop flag)
+ */
+void kp_spsc_wake(kp_spsc_t *q);
+
+#endif /* SPSC_H */
@@ -150,6 +150,31 @@ cmd_stats_verbose(void)
     int uptime = 0, apps = 0, priority_pool = 0, observation_pool = 0;
     size_t total_mb = 0;
     double hit_rate = 0;
+    int shared_maps = 0;
+    size_t shared_kb = 0;
+    unsigned long long shared_mb_total = 0;
+    int predict_slices = 0, predict_slices_max = 0;
+    double predict_cpu_ms = 0, predict_wall_ms = 0;
+    char budget_state[32] = "n/a";
+    double budget_factor = 0, refault_kbps = 0, activate_kbps = 0, steal_kbps = 0;
+    long budget_kb = 0, budget_base_kb = 0;
+    int available_kb = 0, inactive_kb = 0;
+    unsigned long reclaim_events = 0;
+    unsigned long long reclaim_mb = 0;
+    char pin_state[32] = "off";
+    int pinned_apps = 0;
+    size_t pinned_kb = 0, pinned_resident_kb = 0;
+    char pipeline[16] = "n/a";
+    double scan_ms = 0, model_ms = 0, io_ms = 0, io_wait_ms = 0;
+    unsigned int io_queued = 0;
+    unsigned long io_plans = 0, io_dropped = 0;
+    char sched_clock[16] = "n/a";
+    unsigned long wakeups = 0, sched_tasks = 0, batched = 0;
+    double wakeups_per_hour = 0;
+    char power_profile[16] = "n/a", platform_profile[32] = "none";
+    int power_capacity = -1;
+    double power_ac_s = 0, power_battery_s = 0, power_low_s = 0;
+    unsigned long power_switches = 0;
     
     struct {
         char name[128];
@@ -174,6 +199,48 @@ cmd_stats_verbose(void)
         sscanf(line, "observation_pool=%d", &observation_pool);
         sscanf(line, "total_preloaded_mb=%zu", &total_mb);
         sscanf(line, "memory_pressure_events=%lu", &mem_pressure);
+        sscanf(line, "shared_maps_last=%d", &shared_maps);
+        sscanf(line, "shared_kb_last=%zu", &shared_kb);
+        sscanf(line, "shared_mb_total=%llu", &shared_mb_total);
+        sscanf(line, "predict_slices_last=%d", &predict_slices);
+        sscanf(line, "predict_slices_max=%d", &predict_slices_max);
+        sscanf(line, "predict_cpu_ms=%lf", &predict_cpu_ms);
+        sscanf(line, "predict_wall_ms=%lf", &predict_wall_ms);
+        sscanf(line, "budget_state=%31s", budget_state);
+        sscanf(line, "budget_factor=%lf", &budget_factor);
+        sscanf(line, "budget_base_kb=%ld", &budget_base_kb);
+        sscanf(line, "budget_kb=%ld", &budget_kb);
+        sscanf(line, "budget_available_kb=%d", &available_kb);
+        sscanf(line, "budget_inactive_file_kb=%d", &inactive_kb);
+        sscanf(line, "budget_refault_kbps=%lf", &refault_kbps);
+        sscanf(line, "budget_activate_kbps=%lf", &activate_kbps);
+        sscanf(line, "budget_steal_kbps=%lf", &steal_kbps);
+        sscanf(line, "reclaim_events=%lu", &reclaim_events);
+        sscanf(line, "reclaim_mb_total=%llu", &reclaim_mb);
+        sscanf(line, "pin_state=%31s", pin_state);
+        sscanf(line, "pinned_apps=%d", &pinned_apps);
+        sscanf(line, "pinned_kb=%zu", &pinned_kb);
+        sscanf(line, "pinned_resident_kb=%zu", &pinned_resident_kb);
+        sscanf(line, "pipeline=%15s", pipeline);
+        sscanf(line, "pipeline_scan_ms=%lf", &scan_ms);
+        sscanf(line, "pipeline_model_ms=%lf", &model_ms);
+        sscanf(line, "pipeline_io_ms=%lf", &io_ms);
+        sscanf(line, "pipeline_io_wait_ms=%lf", &io_wait_ms);
+        sscanf(line, "pipeline_io_queued=%u", &io_queued);
+        sscanf(line, "pipeline_io_plans=%lu", &io_plans);
+        sscanf(line, "pipeline_io_dropped=%lu", &io_dropped);
+        sscanf(line, "sched_clock=%15s", sched_clock);
+        sscanf(line, "sched_wakeups=%lu", &wakeups);
+        sscanf(line, "sched_tasks=%lu", &sched_tasks);
+        sscanf(line, "sched_batched=%lu", &batched);
+        sscanf(line, "sched_wakeups_per_hour=%lf", &wakeups_per_hour);
+        sscanf(line, "power_profile=%15s", power_profile);
+        sscanf(line, "power_capacity=%d", &power_capacity);
+        sscanf(line, "power_platform_profile=%31s", platform_profile);
+        sscanf(line, "power_ac_s=%lf", &power_ac_s);
+        sscanf(line, "power_battery_s=%lf", &power_battery_s);
+        sscanf(line, "power_low_s=%lf", &power_low_s);
+        sscanf(line, "power_switches=%lu", &power_switches);
         
         /* Parse top apps */
         if (strncmp(line, "top_app_", 8) == 0 && num_top_apps < 20) {
@@ -270,8 +337,43 @@ cmd_stats_verbose(void)
         printf("    Avg Size:         %zu MB per app\n", total_mb / (num_top_apps > 0 ? num_top_apps : 1));
     }
     printf("    Pressure Events:  %lu", mem_pressure);
-    if (mem_pressure > 0) printf(" (skipped due to low memory)\n\n");
-    else printf("\n\n");
+    if (mem_pressure > 0) printf(" (skipped due to low memory)\n");
+    else printf("\n");
+    printf("    Budget:           %ld MB (formula %ld MB x %.2f, %s)\n",
+           budget_kb / 1024, budget_base_kb / 1024, budget_factor, budget_state);
+    printf("    Page Cache:       %d MB available, %d MB inactive file\n",
+           available_kb / 1024, inactive_kb / 1024);
+    printf("    Reclaim:          %.0f KB/s stolen, %.0f KB/s refault, %.0f KB/s activate\n",
+           steal_kbps, refault_kbps, activate_kbps);
+    printf("    Given Back:       %llu MB of preloads in %lu pressure events\n",
+           reclaim_mb, reclaim_events);
+    printf("    Pinned:           %d apps, %zu MB locked, %zu MB resident (%s)\n\n",
+           pinned_apps, pinned_kb / 1024, pinned_resident_kb / 1024, pin_state);
+
+    printf("  Prediction:\n");
+    printf("    Shared Maps:      %d in last plan (%zu KB)\n", shared_maps, shared_kb);
+    printf("    Shared Total:     %llu MB planned\n", shared_mb_total);
+    printf("    Slices:           %d last cycle (max %d), %.1f ms CPU in %.1f ms\n\n",
+           predict_slices, predict_slices_max, predict_cpu_ms, predict_wall_ms);
+
+    printf("  Pipeline (%s):\n", pipeline);
+    printf("    Last Cycle:       scan %.1f ms, model %.1f ms, I/O %.1f ms (waited %.1f ms)\n",
+           scan_ms, model_ms, io_ms, io_wait_ms);
+    printf("    Plans:            %lu read, %u queued, %lu dropped\n\n",
+           io_plans, io_queued, io_dropped);
+
+    printf("  Scheduler (%s clock):\n", sched_clock);
+    printf("    Wakeups:          %lu (%.1f per hour), %lu tasks, %lu batched\n\n",
+           wakeups, wakeups_per_hour, sched_tasks, batched);
+
+    printf("  Power (%s profile):\n", power_profile);
+    if (power_capacity >= 0)
+        printf("    Battery:          %d%%, platform profile %s\n",
+               power_capacity, platform_profile);
+    else
+        printf("    Battery:          none, platform profile %s\n", platform_profile);
+    printf("    Time:             AC %.1f h, battery %.1f h, low %.1f h (%lu switches)\n\n",
+           power_ac_s / 3600, power_battery_s / 3600, power_low_s / 3600, power_switches);
 
     printf("  Pool Breakdown:\n");
     printf("    Priority:     %d apps (actively preloaded)\n", priority_pool);